@@ -0,0 +1,229 @@
+#include "asset_cache.hpp"
+
+#include "utility/stl_helper.hpp"
+
+#include <cassert>
+
+//========================================
+CAssetCache::CAssetCache()
+{
+
+}
+
+CAssetCache::~CAssetCache()
+{
+	// Whoever owns the textures should have called Clear() while the context was current
+	assert(m_listTextures.empty());
+}
+
+void CAssetCache::SetBudget(SBudget const& _Budget)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	m_Budget = _Budget;
+
+	// Textures wait for the next Trim(), they can only be deleted on the context thread
+	TrimSpriteSheets();
+}
+
+CAssetCache::SBudget CAssetCache::GetBudget() const
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	return m_Budget;
+}
+
+CAssetCache::SStats CAssetCache::GetStats() const
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	SStats _Stats;
+	_Stats.m_uTextureBytes = m_uTextureBytes;
+	_Stats.m_uTextureCount = static_cast<uint32_t>(m_listTextures.size());
+	for (auto const& _Entry : m_listTextures)
+	{
+		_Stats.m_uTexturesPinned += (_Entry.m_uPins > 0) ? 1 : 0;
+	}
+	_Stats.m_uSheetBytes = m_uSheetBytes;
+	_Stats.m_uSheetCount = static_cast<uint32_t>(m_listSheets.size());
+	_Stats.m_uHits = m_uHits;
+	_Stats.m_uMisses = m_uMisses;
+	return _Stats;
+}
+//========================================
+
+//========================================
+bool CAssetCache::AcquireTexture(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom, uint32_t const _uCompressionVariant, uint32_t& _uTexture)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	auto _itKey = m_mapTextureKeys.find(MakeKey(_sPath, _uModifiedTime, _uScaleDenom, _uCompressionVariant));
+	if (_itKey == m_mapTextureKeys.end())
+	{
+		++m_uMisses;
+		return false;
+	}
+
+	tTextureIterator _itEntry = _itKey->second;
+	++_itEntry->m_uPins;
+	m_listTextures.splice(m_listTextures.begin(), m_listTextures, _itEntry);
+
+	_uTexture = _itEntry->m_uTexture;
+	++m_uHits;
+	return true;
+}
+
+void CAssetCache::InsertTexture(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom, uint32_t const _uCompressionVariant, uint32_t const _uTexture, uint64_t const _uBytes)
+{
+	assert(_uTexture != 0);
+
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	assert(m_mapTextureIds.find(_uTexture) == m_mapTextureIds.end());
+
+	STextureEntry _Entry;
+	_Entry.m_sKey = MakeKey(_sPath, _uModifiedTime, _uScaleDenom, _uCompressionVariant);
+	_Entry.m_uTexture = _uTexture;
+	_Entry.m_uBytes = _uBytes;
+	_Entry.m_uPins = 1;
+	m_listTextures.push_front(_Entry);
+
+	// Two opens can race to upload the same file, the older copy is only found by id
+	// from then on and ages out like anything else
+	m_mapTextureKeys[_Entry.m_sKey] = m_listTextures.begin();
+	m_mapTextureIds[_uTexture] = m_listTextures.begin();
+	m_uTextureBytes += _uBytes;
+}
+
+bool CAssetCache::ReleaseTexture(uint32_t const _uTexture)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	auto _itId = m_mapTextureIds.find(_uTexture);
+	if (_itId == m_mapTextureIds.end())
+	{
+		return false;
+	}
+
+	assert(_itId->second->m_uPins > 0);
+	--_itId->second->m_uPins;
+	return true;
+}
+
+void CAssetCache::Trim(tDeleteTexture const& _DeleteTexture)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	auto _itEntry = m_listTextures.end();
+	while (m_uTextureBytes > m_Budget.m_uTextureBytes && _itEntry != m_listTextures.begin())
+	{
+		--_itEntry;
+		if (_itEntry->m_uPins == 0)
+		{
+			tTextureIterator _itErase = _itEntry++;
+			EraseTexture(_itErase, _DeleteTexture);
+		}
+	}
+}
+
+void CAssetCache::Clear(tDeleteTexture const& _DeleteTexture)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	while (m_listTextures.empty() == false)
+	{
+		assert(m_listTextures.back().m_uPins == 0);
+		EraseTexture(std::prev(m_listTextures.end()), _DeleteTexture);
+	}
+
+	m_listSheets.clear();
+	m_mapSheetKeys.clear();
+	m_uSheetBytes = 0;
+}
+
+void CAssetCache::EraseTexture(tTextureIterator _itEntry, tDeleteTexture const& _DeleteTexture)
+{
+	auto _itKey = m_mapTextureKeys.find(_itEntry->m_sKey);
+	if (_itKey != m_mapTextureKeys.end() && _itKey->second == _itEntry)
+	{
+		m_mapTextureKeys.erase(_itKey);
+	}
+	m_mapTextureIds.erase(_itEntry->m_uTexture);
+
+	_DeleteTexture(_itEntry->m_uTexture);
+
+	m_uTextureBytes -= _itEntry->m_uBytes;
+	m_listTextures.erase(_itEntry);
+}
+//========================================
+
+//========================================
+bool CAssetCache::FindSpriteSheet(std::string const& _sPath, uint64_t const _uModifiedTime, CSpriteSheet& _SpriteSheet)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	auto _itKey = m_mapSheetKeys.find(MakeKey(_sPath, _uModifiedTime));
+	if (_itKey == m_mapSheetKeys.end())
+	{
+		++m_uMisses;
+		return false;
+	}
+
+	m_listSheets.splice(m_listSheets.begin(), m_listSheets, _itKey->second);
+	_SpriteSheet = _itKey->second->m_SpriteSheet;
+	++m_uHits;
+	return true;
+}
+
+void CAssetCache::InsertSpriteSheet(std::string const& _sPath, uint64_t const _uModifiedTime, CSpriteSheet const& _SpriteSheet)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+
+	std::string const _sKey = MakeKey(_sPath, _uModifiedTime);
+	auto _itKey = m_mapSheetKeys.find(_sKey);
+	if (_itKey != m_mapSheetKeys.end())
+	{
+		m_uSheetBytes -= _itKey->second->m_uBytes;
+		m_listSheets.erase(_itKey->second);
+		m_mapSheetKeys.erase(_itKey);
+	}
+
+	SSheetEntry _Entry;
+	_Entry.m_sKey = _sKey;
+	_Entry.m_SpriteSheet = _SpriteSheet;
+	_Entry.m_uBytes = EstimateBytes(_SpriteSheet);
+	m_listSheets.push_front(_Entry);
+
+	m_mapSheetKeys[_sKey] = m_listSheets.begin();
+	m_uSheetBytes += _Entry.m_uBytes;
+
+	TrimSpriteSheets();
+}
+
+void CAssetCache::TrimSpriteSheets()
+{
+	// Never evicts the newest, a single sheet over budget is still worth keeping for the next open
+	while (m_uSheetBytes > m_Budget.m_uSheetBytes && m_listSheets.size() > 1)
+	{
+		SSheetEntry const& _Entry = m_listSheets.back();
+		m_mapSheetKeys.erase(_Entry.m_sKey);
+		m_uSheetBytes -= _Entry.m_uBytes;
+		m_listSheets.pop_back();
+	}
+}
+//========================================
+
+//========================================
+std::string CAssetCache::MakeKey(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom /*= 1*/, uint32_t const _uCompressionVariant /*= 0*/)
+{
+	return stl_helper::Format("%s|%llu|%u|%x", _sPath.c_str(), static_cast<unsigned long long>(_uModifiedTime), _uScaleDenom, _uCompressionVariant);
+}
+
+uint64_t CAssetCache::EstimateBytes(CSpriteSheet const& _SpriteSheet)
+{
+	// Cells, their names (stored twice, as the key too) and a guess at the map node overhead
+	uint64_t _uBytes = sizeof(CSpriteSheet);
+	for (auto const& _Item : _SpriteSheet.GetSpriteData())
+	{
+		_uBytes += sizeof(_Item) + 32 + _Item.first.capacity() + _Item.second.m_sName.capacity();
+	}
+	return _uBytes;
+}
+//========================================
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "spritesheet.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+//========================================
+// Textures and sprite sheets kept across opens, so compounds that share atlases
+// don't parse, decode and upload them all over again.
+//
+// Entries are keyed by absolute path and modification time, so an edited file just
+// misses and its old entry ages out. Textures and sheets each have a byte budget,
+// least recently used entries are evicted first once one is exceeded.
+//
+// Textures are pinned while a scene uses them and only Trim()/Clear() ever delete
+// them, those must be called on the thread that owns the context. Everything else is
+// safe from any thread (the loader checks the cache from the pool).
+class CAssetCache
+{
+public:
+	typedef std::function<void(uint32_t _uTexture)> tDeleteTexture;
+
+	struct SBudget
+	{
+		uint64_t m_uTextureBytes = 512ull * 1024 * 1024;
+		uint64_t m_uSheetBytes = 32ull * 1024 * 1024;
+	};
+
+	struct SStats
+	{
+		uint64_t m_uTextureBytes = 0;
+		uint32_t m_uTextureCount = 0;
+		uint32_t m_uTexturesPinned = 0;
+		uint64_t m_uSheetBytes = 0;
+		uint32_t m_uSheetCount = 0;
+		uint32_t m_uHits = 0;
+		uint32_t m_uMisses = 0;
+	};
+
+	CAssetCache();
+	~CAssetCache();
+
+	void SetBudget(SBudget const& _Budget);
+	SBudget GetBudget() const;
+	SStats GetStats() const;
+
+	// Roughly what the driver keeps for one, RGB is padded out to 4 bytes a texel. A mip chain adds a third.
+	static uint64_t GetTextureBytes(int32_t const _iWidth, int32_t const _iHeight, bool const _bMipmaps = false)
+	{
+		uint64_t const _uBytes = static_cast<uint64_t>(_iWidth) * _iHeight * 4;
+		return _bMipmaps ? _uBytes * 4 / 3 : _uBytes;
+	}
+
+	//---------- textures
+	// _uScaleDenom is what the file was decoded at (see FileHelper::LoadImageFromFile()),
+	// a reduced copy never stands in for a full size one or the other way around. Likewise
+	// _uCompressionVariant (block_compression::SSettings::GetVariant(), 0 for plain pixels).
+	// Pins and returns the texture if this version of the file is cached
+	bool AcquireTexture(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom, uint32_t const _uCompressionVariant, uint32_t& _uTexture);
+	// Takes ownership of a texture that was just uploaded, it starts out pinned
+	void InsertTexture(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom, uint32_t const _uCompressionVariant, uint32_t const _uTexture, uint64_t const _uBytes);
+	// Unpins. False if the cache doesn't own the texture, the caller has to delete it.
+	bool ReleaseTexture(uint32_t const _uTexture);
+
+	// Deletes unpinned textures, least recently used first, until back under budget
+	void Trim(tDeleteTexture const& _DeleteTexture);
+	// Deletes every texture, none may still be pinned
+	void Clear(tDeleteTexture const& _DeleteTexture);
+
+	//---------- sprite sheets, copied in and out so nothing here is ever pinned
+	bool FindSpriteSheet(std::string const& _sPath, uint64_t const _uModifiedTime, CSpriteSheet& _SpriteSheet);
+	void InsertSpriteSheet(std::string const& _sPath, uint64_t const _uModifiedTime, CSpriteSheet const& _SpriteSheet);
+
+protected:
+	struct STextureEntry
+	{
+		std::string m_sKey;
+		uint32_t m_uTexture = 0;
+		uint64_t m_uBytes = 0;
+		uint32_t m_uPins = 0;
+	};
+
+	struct SSheetEntry
+	{
+		std::string m_sKey;
+		CSpriteSheet m_SpriteSheet;
+		uint64_t m_uBytes = 0;
+	};
+
+	typedef std::list<STextureEntry>::iterator tTextureIterator;
+	typedef std::list<SSheetEntry>::iterator tSheetIterator;
+
+	static std::string MakeKey(std::string const& _sPath, uint64_t const _uModifiedTime, uint32_t const _uScaleDenom = 1, uint32_t const _uCompressionVariant = 0);
+	static uint64_t EstimateBytes(CSpriteSheet const& _SpriteSheet);
+
+	// Expects m_Mutex to be held
+	void EraseTexture(tTextureIterator _itEntry, tDeleteTexture const& _DeleteTexture);
+	void TrimSpriteSheets();
+
+	mutable std::mutex m_Mutex;
+	SBudget m_Budget;
+
+	// Most recently used at the front
+	std::list<STextureEntry> m_listTextures;
+	std::map<std::string, tTextureIterator> m_mapTextureKeys;
+	std::map<uint32_t, tTextureIterator> m_mapTextureIds;
+	uint64_t m_uTextureBytes = 0;
+
+	std::list<SSheetEntry> m_listSheets;
+	std::map<std::string, tSheetIterator> m_mapSheetKeys;
+	uint64_t m_uSheetBytes = 0;
+
+	uint32_t m_uHits = 0;
+	uint32_t m_uMisses = 0;
+};
+//========================================
@@ -0,0 +1,339 @@
+#include "baked_timeline.hpp"
+#include "baked_timeline_kernels.hpp"
+
+#include "utility/cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+#include <emmintrin.h>
+#endif
+
+// stl
+#include <algorithm>
+#include <cassert>
+
+//========================================
+namespace baked_timeline
+{
+	void LerpChannelScalar(SLerpJob const& _Job, float const* _pKeys, float* _pOut)
+	{
+		for (uint32_t i = 0; i < _Job.m_uCount; ++i)
+		{
+			float const _fFirst = _pKeys[_Job.m_pPrev[i]];
+			float const _fSecond = _pKeys[_Job.m_pNext[i]];
+			_pOut[i] = _fFirst + (_fSecond - _fFirst) * _Job.m_pInterp[i];
+		}
+	}
+
+	void LerpColourScalar(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut)
+	{
+		for (uint32_t i = 0; i < _Job.m_uCount; ++i)
+		{
+			uint32_t const _uFirst = _pKeys[_Job.m_pPrev[i]];
+			uint32_t const _uSecond = _pKeys[_Job.m_pNext[i]];
+
+			uint32_t _uResult = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				int32_t const _iFirst = (_uFirst >> (c * 8)) & 0xFF;
+				int32_t const _iSecond = (_uSecond >> (c * 8)) & 0xFF;
+				float const _fValue = static_cast<float>(_iFirst) + static_cast<float>(_iSecond - _iFirst) * _Job.m_pInterp[i];
+				_uResult |= static_cast<uint32_t>(static_cast<int32_t>(_fValue)) << (c * 8);
+			}
+			_pOut[i] = _uResult;
+		}
+	}
+
+#if defined(SPRITE_TOOL_X86)
+	// No gather before AVX2, so lanes are loaded one at a time
+	void LerpChannelSSE2(SLerpJob const& _Job, float const* _pKeys, float* _pOut)
+	{
+		uint32_t const _uVectorCount = _Job.m_uCount & ~3u;
+
+		for (uint32_t i = 0; i < _uVectorCount; i += 4)
+		{
+			int32_t const* _pPrev = _Job.m_pPrev + i;
+			int32_t const* _pNext = _Job.m_pNext + i;
+
+			__m128 const _First = _mm_setr_ps(_pKeys[_pPrev[0]], _pKeys[_pPrev[1]], _pKeys[_pPrev[2]], _pKeys[_pPrev[3]]);
+			__m128 const _Second = _mm_setr_ps(_pKeys[_pNext[0]], _pKeys[_pNext[1]], _pKeys[_pNext[2]], _pKeys[_pNext[3]]);
+			__m128 const _Interp = _mm_loadu_ps(_Job.m_pInterp + i);
+
+			_mm_storeu_ps(_pOut + i, _mm_add_ps(_First, _mm_mul_ps(_mm_sub_ps(_Second, _First), _Interp)));
+		}
+
+		SLerpJob _Tail = { _Job.m_uCount - _uVectorCount, _Job.m_pPrev + _uVectorCount, _Job.m_pNext + _uVectorCount, _Job.m_pInterp + _uVectorCount };
+		LerpChannelScalar(_Tail, _pKeys, _pOut + _uVectorCount);
+	}
+
+	void LerpColourSSE2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut)
+	{
+		uint32_t const _uVectorCount = _Job.m_uCount & ~3u;
+		__m128i const _Mask = _mm_set1_epi32(0xFF);
+
+		for (uint32_t i = 0; i < _uVectorCount; i += 4)
+		{
+			int32_t const* _pPrev = _Job.m_pPrev + i;
+			int32_t const* _pNext = _Job.m_pNext + i;
+
+			__m128i const _First = _mm_setr_epi32(_pKeys[_pPrev[0]], _pKeys[_pPrev[1]], _pKeys[_pPrev[2]], _pKeys[_pPrev[3]]);
+			__m128i const _Second = _mm_setr_epi32(_pKeys[_pNext[0]], _pKeys[_pNext[1]], _pKeys[_pNext[2]], _pKeys[_pNext[3]]);
+			__m128 const _Interp = _mm_loadu_ps(_Job.m_pInterp + i);
+
+			__m128i _Result = _mm_setzero_si128();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128i const _Shift = _mm_cvtsi32_si128(c * 8);
+				__m128i const _FirstChannel = _mm_and_si128(_mm_srl_epi32(_First, _Shift), _Mask);
+				__m128i const _SecondChannel = _mm_and_si128(_mm_srl_epi32(_Second, _Shift), _Mask);
+
+				__m128 const _Delta = _mm_cvtepi32_ps(_mm_sub_epi32(_SecondChannel, _FirstChannel));
+				__m128 const _Value = _mm_add_ps(_mm_cvtepi32_ps(_FirstChannel), _mm_mul_ps(_Delta, _Interp));
+
+				_Result = _mm_or_si128(_Result, _mm_sll_epi32(_mm_cvttps_epi32(_Value), _Shift));
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_pOut + i), _Result);
+		}
+
+		SLerpJob _Tail = { _Job.m_uCount - _uVectorCount, _Job.m_pPrev + _uVectorCount, _Job.m_pNext + _uVectorCount, _Job.m_pInterp + _uVectorCount };
+		LerpColourScalar(_Tail, _pKeys, _pOut + _uVectorCount);
+	}
+#else
+	void LerpChannelSSE2(SLerpJob const& _Job, float const* _pKeys, float* _pOut)
+	{
+		LerpChannelScalar(_Job, _pKeys, _pOut);
+	}
+
+	void LerpColourSSE2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut)
+	{
+		LerpColourScalar(_Job, _pKeys, _pOut);
+	}
+#endif
+};
+//========================================
+
+//========================================
+void CBakedTimeline::SChannels::Resize(size_t _uSize)
+{
+	m_vectorPosX.resize(_uSize);
+	m_vectorPosY.resize(_uSize);
+	m_vectorScaleX.resize(_uSize);
+	m_vectorScaleY.resize(_uSize);
+	m_vectorAngle.resize(_uSize);
+	m_vectorAlpha.resize(_uSize);
+	m_vectorColour.resize(_uSize);
+	m_vectorAlignmentX.resize(_uSize);
+	m_vectorAlignmentY.resize(_uSize);
+	m_vectorFlip.resize(_uSize);
+	m_vectorShown.resize(_uSize);
+}
+
+void CBakedTimeline::SChannels::Set(size_t _uIndex, CCompoundSprite::SActorState const& _State)
+{
+	m_vectorPosX[_uIndex] = _State.m_fPosX;
+	m_vectorPosY[_uIndex] = _State.m_fPosY;
+	m_vectorScaleX[_uIndex] = _State.m_fScaleX;
+	m_vectorScaleY[_uIndex] = _State.m_fScaleY;
+	m_vectorAngle[_uIndex] = _State.m_fAngle;
+	m_vectorAlpha[_uIndex] = _State.m_fAlpha;
+	m_vectorColour[_uIndex] = _State.m_uColour;
+	m_vectorAlignmentX[_uIndex] = _State.m_uAlignmentX;
+	m_vectorAlignmentY[_uIndex] = _State.m_uAlignmentY;
+	m_vectorFlip[_uIndex] = _State.m_uFlip;
+	m_vectorShown[_uIndex] = _State.m_bShown ? 1 : 0;
+}
+
+CCompoundSprite::SActorState CBakedTimeline::SChannels::Get(size_t _uIndex) const
+{
+	CCompoundSprite::SActorState _State;
+	_State.m_fPosX = m_vectorPosX[_uIndex];
+	_State.m_fPosY = m_vectorPosY[_uIndex];
+	_State.m_fScaleX = m_vectorScaleX[_uIndex];
+	_State.m_fScaleY = m_vectorScaleY[_uIndex];
+	_State.m_fAngle = m_vectorAngle[_uIndex];
+	_State.m_fAlpha = m_vectorAlpha[_uIndex];
+	_State.m_uColour = m_vectorColour[_uIndex];
+	_State.m_uAlignmentX = m_vectorAlignmentX[_uIndex];
+	_State.m_uAlignmentY = m_vectorAlignmentY[_uIndex];
+	_State.m_uFlip = m_vectorFlip[_uIndex];
+	_State.m_bShown = m_vectorShown[_uIndex] != 0;
+	return _State;
+}
+//========================================
+
+//========================================
+void CBakedTimeline::Build(std::vector<CCompoundSprite::SActor> const& _vectorActors,
+						   std::map<uint32_t, std::vector<CCompoundSprite::STimelineFrame>> const& _mapTimelines)
+{
+	size_t const _uActorCount = _vectorActors.size();
+
+	m_vectorFirstKeyframe.resize(_uActorCount);
+	m_vectorKeyframeCount.resize(_uActorCount);
+
+	// Count first so the channels are allocated once
+	size_t _uKeyframeCount = 0;
+	for (auto const& _Actor : _vectorActors)
+	{
+		auto _itTimeline = _mapTimelines.find(_Actor.m_uID);
+		size_t _uFrames = (_itTimeline != _mapTimelines.end()) ? _itTimeline->second.size() : 0;
+		_uKeyframeCount += std::max<size_t>(_uFrames, 1);
+	}
+
+	m_vectorTimes.resize(_uKeyframeCount);
+	m_Keyframes.Resize(_uKeyframeCount);
+
+	uint32_t _uKeyframe = 0;
+	for (size_t i = 0; i < _uActorCount; ++i)
+	{
+		m_vectorFirstKeyframe[i] = _uKeyframe;
+
+		auto _itTimeline = _mapTimelines.find(_vectorActors[i].m_uID);
+		if (_itTimeline == _mapTimelines.end() || _itTimeline->second.empty())
+		{
+			// No timeline, hold the actor's own state
+			m_vectorTimes[_uKeyframe] = 0.0f;
+			m_Keyframes.Set(_uKeyframe, _vectorActors[i].m_State);
+			++_uKeyframe;
+		}
+		else
+		{
+			// Frames are already sorted by time (see CCompoundSprite::ParseJSONData)
+			for (auto const& _Frame : _itTimeline->second)
+			{
+				m_vectorTimes[_uKeyframe] = _Frame.m_fTime;
+				m_Keyframes.Set(_uKeyframe, _Frame.m_State);
+				++_uKeyframe;
+			}
+		}
+
+		m_vectorKeyframeCount[i] = _uKeyframe - m_vectorFirstKeyframe[i];
+	}
+
+	m_vectorCursors.assign(_uActorCount, 0);
+	m_vectorPrev.resize(_uActorCount);
+	m_vectorNext.resize(_uActorCount);
+	m_vectorInterp.resize(_uActorCount);
+	m_Evaluated.Resize(_uActorCount);
+	m_bEvaluated = false;
+}
+//========================================
+
+//========================================
+void CBakedTimeline::FindKeyframes(uint32_t const _uActorIndex, float const _fTime, uint32_t& _uCursor, int32_t& _iPrev, int32_t& _iNext, float& _fInterp) const
+{
+	uint32_t const _uFirst = m_vectorFirstKeyframe[_uActorIndex];
+	uint32_t const _uCount = m_vectorKeyframeCount[_uActorIndex];
+	float const* _pTimes = m_vectorTimes.data() + _uFirst;
+
+	// First keyframe at or after _fTime (lower bound), that's "next" and the one before it is "prev"
+	uint32_t _uNext = CCompoundSprite::c_uInvalidIndex;
+	if (_uCursor <= _uCount && (_uCursor == 0 || _pTimes[_uCursor - 1] < _fTime))
+	{
+		// Playing forwards, step on a little way from where we were last time
+		uint32_t _uStep = _uCursor;
+		for (uint32_t _uSteps = 0; _uSteps < 4 && _uStep < _uCount && _pTimes[_uStep] < _fTime; ++_uSteps)
+		{
+			++_uStep;
+		}
+
+		if (_uStep == _uCount || _pTimes[_uStep] >= _fTime)
+		{
+			_uNext = _uStep;
+		}
+	}
+
+	// Scrubbing, looping back round or jumped a long way
+	if (_uNext == CCompoundSprite::c_uInvalidIndex)
+	{
+		_uNext = static_cast<uint32_t>(std::lower_bound(_pTimes, _pTimes + _uCount, _fTime) - _pTimes);
+	}
+
+	_uCursor = _uNext;
+
+	if (_uNext == _uCount)
+	{
+		// Past the last keyframe, hold it
+		_iPrev = _iNext = _uFirst + _uCount - 1;
+		_fInterp = 0.0f;
+	}
+	else if (_uNext == 0 || _pTimes[_uNext] == _fTime)
+	{
+		// Before the first keyframe, or exactly on one
+		_iPrev = _iNext = _uFirst + _uNext;
+		_fInterp = 0.0f;
+	}
+	else
+	{
+		_iPrev = _uFirst + _uNext - 1;
+		_iNext = _uFirst + _uNext;
+		_fInterp = (_fTime - _pTimes[_uNext - 1]) / (_pTimes[_uNext] - _pTimes[_uNext - 1]);
+	}
+}
+
+CCompoundSprite::SActorState CBakedTimeline::EvaluateActor(uint32_t const _uActorIndex, float const _fTime, uint32_t* _pKeyframeCursor) const
+{
+	uint32_t _uCursor = (_pKeyframeCursor != nullptr) ? *_pKeyframeCursor : CCompoundSprite::c_uInvalidIndex;
+
+	int32_t _iPrev = 0, _iNext = 0;
+	float _fInterp = 0.0f;
+	FindKeyframes(_uActorIndex, _fTime, _uCursor, _iPrev, _iNext, _fInterp);
+
+	if (_pKeyframeCursor != nullptr)
+	{
+		*_pKeyframeCursor = _uCursor;
+	}
+
+	if (_iPrev == _iNext)
+	{
+		return m_Keyframes.Get(_iPrev);
+	}
+
+	return CCompoundSprite::InterpolateActorState(m_Keyframes.Get(_iPrev), m_Keyframes.Get(_iNext), _fInterp);
+}
+
+CBakedTimeline::SChannels const& CBakedTimeline::EvaluateAll(float const _fTime)
+{
+	// Every instance of a compound shares the same time, so it's usually only evaluated once a frame
+	if (m_bEvaluated && m_fEvaluatedTime == _fTime)
+	{
+		return m_Evaluated;
+	}
+
+	uint32_t const _uActorCount = GetActorCount();
+
+	for (uint32_t i = 0; i < _uActorCount; ++i)
+	{
+		FindKeyframes(i, _fTime, m_vectorCursors[i], m_vectorPrev[i], m_vectorNext[i], m_vectorInterp[i]);
+	}
+
+	static bool const s_bAVX2 = cpu_features::HasAVX2();
+	static bool const s_bSSE2 = cpu_features::HasSSE2();
+
+	auto _pLerpChannel = s_bAVX2 ? baked_timeline::LerpChannelAVX2 : (s_bSSE2 ? baked_timeline::LerpChannelSSE2 : baked_timeline::LerpChannelScalar);
+	auto _pLerpColour = s_bAVX2 ? baked_timeline::LerpColourAVX2 : (s_bSSE2 ? baked_timeline::LerpColourSSE2 : baked_timeline::LerpColourScalar);
+
+	baked_timeline::SLerpJob const _Job = { _uActorCount, m_vectorPrev.data(), m_vectorNext.data(), m_vectorInterp.data() };
+
+	_pLerpChannel(_Job, m_Keyframes.m_vectorPosX.data(), m_Evaluated.m_vectorPosX.data());
+	_pLerpChannel(_Job, m_Keyframes.m_vectorPosY.data(), m_Evaluated.m_vectorPosY.data());
+	_pLerpChannel(_Job, m_Keyframes.m_vectorScaleX.data(), m_Evaluated.m_vectorScaleX.data());
+	_pLerpChannel(_Job, m_Keyframes.m_vectorScaleY.data(), m_Evaluated.m_vectorScaleY.data());
+	_pLerpChannel(_Job, m_Keyframes.m_vectorAngle.data(), m_Evaluated.m_vectorAngle.data());
+	_pLerpChannel(_Job, m_Keyframes.m_vectorAlpha.data(), m_Evaluated.m_vectorAlpha.data());
+	_pLerpColour(_Job, m_Keyframes.m_vectorColour.data(), m_Evaluated.m_vectorColour.data());
+
+	for (uint32_t i = 0; i < _uActorCount; ++i)
+	{
+		int32_t const _iPrev = m_vectorPrev[i];
+		m_Evaluated.m_vectorAlignmentX[i] = m_Keyframes.m_vectorAlignmentX[_iPrev];
+		m_Evaluated.m_vectorAlignmentY[i] = m_Keyframes.m_vectorAlignmentY[_iPrev];
+		m_Evaluated.m_vectorFlip[i] = m_Keyframes.m_vectorFlip[_iPrev];
+		m_Evaluated.m_vectorShown[i] = m_Keyframes.m_vectorShown[_iPrev];
+	}
+
+	m_fEvaluatedTime = _fTime;
+	m_bEvaluated = true;
+
+	return m_Evaluated;
+}
+//========================================
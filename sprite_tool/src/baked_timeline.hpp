@@ -0,0 +1,73 @@
+#pragma once
+
+#include "compound_sprite.hpp"
+
+#include <cstdint>
+#include <vector>
+
+//========================================
+// Every keyframe of every actor in a compound, flattened into one set of
+// structure-of-arrays channels at load time.
+//
+// EvaluateAll() does the keyframe searches per actor, then interpolates each
+// channel for all actors in one vectorised pass (8 actors per instruction with
+// AVX2, 4 with SSE2). Results match InterpolateActorState() exactly.
+class CBakedTimeline
+{
+public:
+	struct SChannels
+	{
+		std::vector<float> m_vectorPosX;
+		std::vector<float> m_vectorPosY;
+		std::vector<float> m_vectorScaleX;
+		std::vector<float> m_vectorScaleY;
+		std::vector<float> m_vectorAngle;
+		std::vector<float> m_vectorAlpha;
+		std::vector<uint32_t> m_vectorColour;
+
+		// Not interpolated, always taken from the earlier keyframe
+		std::vector<uint32_t> m_vectorAlignmentX;
+		std::vector<uint32_t> m_vectorAlignmentY;
+		std::vector<uint32_t> m_vectorFlip;
+		std::vector<uint8_t> m_vectorShown;
+
+		void Resize(size_t _uSize);
+		void Set(size_t _uIndex, CCompoundSprite::SActorState const& _State);
+		CCompoundSprite::SActorState Get(size_t _uIndex) const;
+	};
+
+	void Build(std::vector<CCompoundSprite::SActor> const& _vectorActors,
+			   std::map<uint32_t, std::vector<CCompoundSprite::STimelineFrame>> const& _mapTimelines);
+
+	uint32_t GetActorCount() const { return static_cast<uint32_t>(m_vectorFirstKeyframe.size()); }
+
+	// Single actor, _pKeyframeCursor is optional (see CCompoundSprite::GetStateForActorIndexAtTime)
+	CCompoundSprite::SActorState EvaluateActor(uint32_t const _uActorIndex, float const _fTime, uint32_t* _pKeyframeCursor = nullptr) const;
+
+	// All actors, indexed the same as the compound's actors. Cached until called with a different time.
+	SChannels const& EvaluateAll(float const _fTime);
+
+protected:
+	// Finds prev/next keyframes (global indices) and the blend between them
+	void FindKeyframes(uint32_t const _uActorIndex, float const _fTime, uint32_t& _uCursor, int32_t& _iPrev, int32_t& _iNext, float& _fInterp) const;
+
+	// Per actor. Actors without a timeline get their rest state baked as a single keyframe,
+	// so every actor has at least one.
+	std::vector<uint32_t> m_vectorFirstKeyframe;
+	std::vector<uint32_t> m_vectorKeyframeCount;
+
+	// Per keyframe
+	std::vector<float> m_vectorTimes;
+	SChannels m_Keyframes;
+
+	//---------- EvaluateAll() scratch
+	std::vector<uint32_t> m_vectorCursors;
+	std::vector<int32_t> m_vectorPrev;
+	std::vector<int32_t> m_vectorNext;
+	std::vector<float> m_vectorInterp;
+
+	SChannels m_Evaluated;
+	float m_fEvaluatedTime = 0.0f;
+	bool m_bEvaluated = false;
+};
+//========================================
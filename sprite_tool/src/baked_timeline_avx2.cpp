@@ -0,0 +1,94 @@
+// baked_timeline_avx2.cpp : AVX2 interpolation kernels, only called when cpu_features::HasAVX2().
+//  Built with /arch:AVX2 (see the vcxproj), GCC/Clang get the target pragma below.
+
+#include "baked_timeline_kernels.hpp"
+
+#include "utility/cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+//========================================
+namespace baked_timeline
+{
+	void LerpChannelAVX2(SLerpJob const& _Job, float const* _pKeys, float* _pOut)
+	{
+		uint32_t const _uVectorCount = _Job.m_uCount & ~7u;
+
+		for (uint32_t i = 0; i < _uVectorCount; i += 8)
+		{
+			__m256i const _Prev = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_Job.m_pPrev + i));
+			__m256i const _Next = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_Job.m_pNext + i));
+
+			__m256 const _First = _mm256_i32gather_ps(_pKeys, _Prev, 4);
+			__m256 const _Second = _mm256_i32gather_ps(_pKeys, _Next, 4);
+			__m256 const _Interp = _mm256_loadu_ps(_Job.m_pInterp + i);
+
+			// Separate mul/add rather than FMA, to stay bit identical with InterpolateActorState()
+			_mm256_storeu_ps(_pOut + i, _mm256_add_ps(_First, _mm256_mul_ps(_mm256_sub_ps(_Second, _First), _Interp)));
+		}
+
+		SLerpJob _Tail = { _Job.m_uCount - _uVectorCount, _Job.m_pPrev + _uVectorCount, _Job.m_pNext + _uVectorCount, _Job.m_pInterp + _uVectorCount };
+		LerpChannelSSE2(_Tail, _pKeys, _pOut + _uVectorCount);
+	}
+
+	void LerpColourAVX2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut)
+	{
+		uint32_t const _uVectorCount = _Job.m_uCount & ~7u;
+		int const* _pKeysI = reinterpret_cast<int const*>(_pKeys);
+		__m256i const _Mask = _mm256_set1_epi32(0xFF);
+
+		for (uint32_t i = 0; i < _uVectorCount; i += 8)
+		{
+			__m256i const _Prev = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_Job.m_pPrev + i));
+			__m256i const _Next = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_Job.m_pNext + i));
+
+			__m256i const _First = _mm256_i32gather_epi32(_pKeysI, _Prev, 4);
+			__m256i const _Second = _mm256_i32gather_epi32(_pKeysI, _Next, 4);
+			__m256 const _Interp = _mm256_loadu_ps(_Job.m_pInterp + i);
+
+			__m256i _Result = _mm256_setzero_si256();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m256i const _Shift = _mm256_set1_epi32(c * 8);
+				__m256i const _FirstChannel = _mm256_and_si256(_mm256_srlv_epi32(_First, _Shift), _Mask);
+				__m256i const _SecondChannel = _mm256_and_si256(_mm256_srlv_epi32(_Second, _Shift), _Mask);
+
+				__m256 const _Delta = _mm256_cvtepi32_ps(_mm256_sub_epi32(_SecondChannel, _FirstChannel));
+				__m256 const _Value = _mm256_add_ps(_mm256_cvtepi32_ps(_FirstChannel), _mm256_mul_ps(_Delta, _Interp));
+
+				_Result = _mm256_or_si256(_Result, _mm256_sllv_epi32(_mm256_cvttps_epi32(_Value), _Shift));
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_pOut + i), _Result);
+		}
+
+		SLerpJob _Tail = { _Job.m_uCount - _uVectorCount, _Job.m_pPrev + _uVectorCount, _Job.m_pNext + _uVectorCount, _Job.m_pInterp + _uVectorCount };
+		LerpColourSSE2(_Tail, _pKeys, _pOut + _uVectorCount);
+	}
+};
+//========================================
+
+#else
+
+//========================================
+namespace baked_timeline
+{
+	void LerpChannelAVX2(SLerpJob const& _Job, float const* _pKeys, float* _pOut)
+	{
+		LerpChannelScalar(_Job, _pKeys, _pOut);
+	}
+
+	void LerpColourAVX2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut)
+	{
+		LerpColourScalar(_Job, _pKeys, _pOut);
+	}
+};
+//========================================
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+// Internal to CBakedTimeline, shared with the AVX2 translation unit.
+
+#include <cstdint>
+
+//========================================
+namespace baked_timeline
+{
+	// out[i] = keys[prev[i]] + (keys[next[i]] - keys[prev[i]]) * interp[i]
+	struct SLerpJob
+	{
+		uint32_t m_uCount;
+		int32_t const* m_pPrev;
+		int32_t const* m_pNext;
+		float const* m_pInterp;
+	};
+
+	// All variants do the same float operations in the same order as
+	// CCompoundSprite::InterpolateActorState(), keep it that way
+	void LerpChannelScalar(SLerpJob const& _Job, float const* _pKeys, float* _pOut);
+	void LerpChannelSSE2(SLerpJob const& _Job, float const* _pKeys, float* _pOut);
+	void LerpChannelAVX2(SLerpJob const& _Job, float const* _pKeys, float* _pOut);
+
+	// Per byte, truncated like the uint8_t cast in InterpolateActorState()
+	void LerpColourScalar(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut);
+	void LerpColourSSE2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut);
+	void LerpColourAVX2(SLerpJob const& _Job, uint32_t const* _pKeys, uint32_t* _pOut);
+};
+//========================================
@@ -0,0 +1,591 @@
+#include "compound_loader.hpp"
+
+#include "asset_cache.hpp"
+
+#include "utility/hash_helper.hpp"
+#include "utility/stl_helper.hpp"
+#include "utility/texture_cache.hpp"
+#include "utility/thread_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <exception>
+#include <functional>
+
+namespace
+{
+	// Rows of a streamed PNG decoded between encodes, or between halvings
+	size_t const c_uCompressBandBytes = 1024 * 1024;
+	size_t const c_uReduceBandBytes = 1024 * 1024;
+
+	bool IsPNGPath(std::string const& _sPath)
+	{
+		return _sPath.size() > 4 && stl_helper::ToLower(_sPath.substr(_sPath.size() - 4)) == ".png";
+	}
+
+	// Size after halving once for every step of _uScaleDenom, as mip levels are sized
+	void GetReducedSize(int32_t& _iWidth, int32_t& _iHeight, uint32_t const _uScaleDenom)
+	{
+		for (uint32_t _uDenom = _uScaleDenom; _uDenom > 1; _uDenom /= 2)
+		{
+			_iWidth = mip_chain::GetHalfSize(_iWidth);
+			_iHeight = mip_chain::GetHalfSize(_iHeight);
+		}
+	}
+
+	// PNGs have no reduced decode of their own, whole images are halved down after the fact
+	void ReduceImage(FileHelper::SImageData& _ImageData, int32_t& _iWidth, int32_t& _iHeight, uint32_t const _uScaleDenom)
+	{
+		for (uint32_t _uDenom = _uScaleDenom; _uDenom > 1 && _ImageData.m_pData != nullptr; _uDenom /= 2)
+		{
+			mip_chain::SLevel const _Level = mip_chain::Halve(_ImageData.m_pData->data(), _iWidth, _iHeight, _ImageData.m_uChannels);
+			_ImageData.m_pData = _Level.m_pData;
+			_iWidth = _Level.m_iWidth;
+			_iHeight = _Level.m_iHeight;
+		}
+	}
+
+	// Reads the rest of _Stream _iBandRows (a multiple of _uScaleDenom) at a time and halves each
+	// band once for every step of _uScaleDenom. _OnRows gets the reduced rows, GetReducedSize()
+	// wide and _iBandRows / _uScaleDenom at a time but for the last band. False if it can't be read.
+	bool ReadReducedBands(FileHelper::CPNGStream& _Stream, uint32_t const _uScaleDenom, int32_t const _iBandRows, std::function<void(uint8_t const* _pRows, int32_t _iRows)> const& _OnRows)
+	{
+		uint32_t const _uChannels = _Stream.GetChannels();
+
+		// Size of the image after each halving, the first is the PNG itself
+		std::vector<int32_t> _vectorWidths(1, _Stream.GetWidth());
+		std::vector<int32_t> _vectorHeights(1, _Stream.GetHeight());
+		for (uint32_t _uDenom = _uScaleDenom; _uDenom > 1; _uDenom /= 2)
+		{
+			_vectorWidths.push_back(mip_chain::GetHalfSize(_vectorWidths.back()));
+			_vectorHeights.push_back(mip_chain::GetHalfSize(_vectorHeights.back()));
+		}
+		size_t const _uSteps = _vectorWidths.size() - 1;
+		assert((_iBandRows % (1 << _uSteps)) == 0);
+
+		size_t const _uRowBytes = _Stream.GetRowBytes();
+		FileHelper::tPixelBuffer _vectorBand(_uRowBytes * _iBandRows);
+		FileHelper::tPixelBuffer _arrayScratch[2];
+		int32_t _iReducedRows = 0;
+
+		while (_Stream.IsFinished() == false)
+		{
+			int32_t _iRows = 0;
+			while (_iRows < _iBandRows)
+			{
+				int32_t const _iRead = _Stream.ReadRows(_vectorBand.data() + _iRows * _uRowBytes, _iBandRows - _iRows);
+				if (_iRead == 0)
+				{
+					break;
+				}
+				_iRows += _iRead;
+			}
+			if (_iRows == 0)
+			{
+				return false;
+			}
+
+			// Bands halve evenly all the way down, only the last one can have an odd row left over
+			uint8_t const* _pSource = _vectorBand.data();
+			for (size_t s = 0; s < _uSteps && _iRows > 0; ++s)
+			{
+				// Dropped like it is from any mip level, unless it's the only row
+				if ((_iRows & 1) != 0 && _vectorHeights[s] > 1)
+				{
+					--_iRows;
+				}
+				if (_iRows == 0)
+				{
+					break;
+				}
+
+				int32_t const _iHalfRows = mip_chain::GetHalfSize(_iRows);
+				FileHelper::tPixelBuffer& _vectorScratch = _arrayScratch[s % 2];
+				_vectorScratch.resize(static_cast<size_t>(_vectorWidths[s + 1]) * _iHalfRows * _uChannels);
+
+				mip_chain::HalveRows(_pSource, static_cast<size_t>(_vectorWidths[s]) * _uChannels, _vectorWidths[s], _iRows, _uChannels, _vectorScratch.data());
+				_pSource = _vectorScratch.data();
+				_iRows = _iHalfRows;
+			}
+
+			if (_iRows > 0)
+			{
+				assert(_iReducedRows + _iRows <= _vectorHeights.back());
+				_OnRows(_pSource, _iRows);
+				_iReducedRows += _iRows;
+			}
+		}
+
+		return _iReducedRows == _vectorHeights.back();
+	}
+};
+
+//========================================
+uint32_t const CCompoundLoader::c_uMinStreamTexels;
+CSpriteSheet::TextureRes const CCompoundLoader::c_eSheetTextureRes;
+//========================================
+
+//========================================
+CCompoundLoader::CCompoundLoader(std::string const& _sPath, std::string const& _sTextureFolder, CAssetCache* _pAssetCache, CSpriteSheet::TextureRes _eTextureRes, block_compression::SSettings const& _Compression, bool const _bMipmaps)
+	: m_sPath(_sPath)
+	, m_sTextureFolder(_sTextureFolder)
+	, m_pAssetCache(_pAssetCache)
+	, m_eTextureRes(_eTextureRes)
+	, m_Compression(_Compression)
+	, m_bMipmaps(_bMipmaps)
+	, m_bCancel(false)
+	, m_eStage(static_cast<uint32_t>(Stage::ParsingCompounds))
+	, m_uCompoundCount(0)
+	, m_uSheetsLoaded(0)
+	, m_uSheetsFailed(0)
+	, m_uTexturesDecoded(0)
+	, m_uTextureCount(0)
+{
+	m_Thread = std::thread(&CCompoundLoader::Run, this);
+}
+
+CCompoundLoader::~CCompoundLoader()
+{
+	Cancel();
+	m_Thread.join();
+
+	// Nobody is going to take these now, unpinning never deletes so it's fine on any thread
+	for (auto const& _Decoded : m_dequeDecodedImages)
+	{
+		if (_Decoded.m_uCachedTexture != 0)
+		{
+			m_pAssetCache->ReleaseTexture(_Decoded.m_uCachedTexture);
+		}
+	}
+}
+
+void CCompoundLoader::Cancel()
+{
+	m_bCancel = true;
+}
+
+CCompoundLoader::SProgress CCompoundLoader::GetProgress() const
+{
+	SProgress _Progress;
+	_Progress.m_eStage = GetStage();
+	_Progress.m_uCompoundCount = m_uCompoundCount;
+	_Progress.m_uSheetsLoaded = m_uSheetsLoaded;
+	_Progress.m_uSheetsFailed = m_uSheetsFailed;
+	_Progress.m_uTexturesDecoded = m_uTexturesDecoded;
+	_Progress.m_uTextureCount = m_uTextureCount;
+	return _Progress;
+}
+
+bool CCompoundLoader::IsSceneReady() const
+{
+	Stage const _eStage = GetStage();
+	return _eStage == Stage::DecodingTextures || _eStage == Stage::Done;
+}
+
+bool CCompoundLoader::IsFinished() const
+{
+	Stage const _eStage = GetStage();
+	if (_eStage != Stage::Done && _eStage != Stage::Failed && _eStage != Stage::Cancelled)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	return m_dequeDecodedImages.empty();
+}
+
+void CCompoundLoader::TakeScene(std::map<std::string, tSharedCompoundSprite>& _mapCompounds, std::map<std::string, CSpriteSheet>& _mapSpriteSheets)
+{
+	assert(IsSceneReady());
+
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	_mapCompounds = std::move(m_mapCompounds);
+	_mapSpriteSheets = std::move(m_mapSpriteSheets);
+	m_mapCompounds.clear();
+	m_mapSpriteSheets.clear();
+}
+
+bool CCompoundLoader::PopDecodedImage(SDecodedImage& _Decoded)
+{
+	std::lock_guard<std::mutex> _Lock(m_Mutex);
+	if (m_dequeDecodedImages.empty())
+	{
+		return false;
+	}
+
+	_Decoded = std::move(m_dequeDecodedImages.front());
+	m_dequeDecodedImages.pop_front();
+	return true;
+}
+//========================================
+
+//========================================
+void CCompoundLoader::Run()
+{
+	try
+	{
+		// Compounds, fans out over the pool as sub-compounds are found
+		//========================================
+		std::map<std::string, tSharedCompoundSprite> _mapCompounds;
+		if (CCompoundSprite::ParseJSONFileRecursive(FileHelper::GetAbsolutePath(m_sPath), _mapCompounds) == false)
+		{
+			fprintf(stdout, "Failed to load compound '%s'.\n", m_sPath.c_str());
+			SetStage(Stage::Failed);
+			return;
+		}
+		m_uCompoundCount = static_cast<uint32_t>(_mapCompounds.size());
+
+		std::vector<std::string> const _vectorTextures = GetRequiredTextures(_mapCompounds);
+		m_uTextureCount = static_cast<uint32_t>(_vectorTextures.size());
+
+		{
+			std::lock_guard<std::mutex> _Lock(m_Mutex);
+			m_mapCompounds = std::move(_mapCompounds);
+		}
+
+		if (m_bCancel)
+		{
+			SetStage(Stage::Cancelled);
+			return;
+		}
+		//========================================
+
+		// Sheets and images together. Sheets are queued first, they're what the first frame needs.
+		//========================================
+		SetStage(Stage::LoadingSheets);
+
+		CThreadPool& _ThreadPool = CThreadPool::GetShared();
+		CTaskGroup _ImageTasks(_ThreadPool);
+		CTaskGroup _SheetTasks(_ThreadPool);
+
+		for (auto const& _sTexture : _vectorTextures)
+		{
+			_SheetTasks.Run([this, _sTexture]()
+			{
+				if (m_bCancel)
+				{
+					return;
+				}
+
+				CSpriteSheet _SpriteSheet;
+				if (LoadSpriteSheet(m_sTextureFolder, _sTexture, _SpriteSheet, m_pAssetCache) == false)
+				{
+					// Its sprites aren't drawn at all
+					fprintf(stdout, "Failed to load sprite sheet '%s'.\n", _sTexture.c_str());
+					++m_uSheetsFailed;
+					++m_uSheetsLoaded;
+					return;
+				}
+
+				std::lock_guard<std::mutex> _Lock(m_Mutex);
+				m_mapSpriteSheets[_sTexture] = _SpriteSheet;
+				++m_uSheetsLoaded;
+			});
+		}
+
+		for (auto const& _sTexture : _vectorTextures)
+		{
+			_ImageTasks.Run([this, _sTexture]()
+			{
+				if (m_bCancel)
+				{
+					return;
+				}
+
+				SDecodedImage _Decoded = DecodeImage(m_sTextureFolder, _sTexture, m_pAssetCache, m_eTextureRes, m_Compression, m_bMipmaps);
+
+				std::lock_guard<std::mutex> _Lock(m_Mutex);
+				m_dequeDecodedImages.push_back(std::move(_Decoded));
+				++m_uTexturesDecoded;
+			});
+		}
+
+		_SheetTasks.Wait();
+		if (m_bCancel)
+		{
+			_ImageTasks.Wait();
+			SetStage(Stage::Cancelled);
+			return;
+		}
+
+		SetStage(Stage::DecodingTextures);
+
+		_ImageTasks.Wait();
+		SetStage(m_bCancel ? Stage::Cancelled : Stage::Done);
+		//========================================
+	}
+	catch (std::exception const& _Exception)
+	{
+		fprintf(stdout, "Failed to open '%s': %s\n", m_sPath.c_str(), _Exception.what());
+		SetStage(Stage::Failed);
+	}
+}
+//========================================
+
+//========================================
+std::vector<std::string> CCompoundLoader::GetRequiredTextures(std::map<std::string, tSharedCompoundSprite> const& _mapCompounds)
+{
+	std::vector<std::string> _vectorTextures;
+	for (auto const& _Item : _mapCompounds)
+	{
+		for (auto const& _TextureSprites : _Item.second->GetTextureSprites())
+		{
+			_vectorTextures.push_back(_TextureSprites.first);
+		}
+	}
+
+	// Compounds often share sheets, only load each once
+	std::sort(_vectorTextures.begin(), _vectorTextures.end());
+	_vectorTextures.erase(std::unique(_vectorTextures.begin(), _vectorTextures.end()), _vectorTextures.end());
+
+	return _vectorTextures;
+}
+
+std::map<std::string, std::set<std::string>> CCompoundLoader::GetRequiredSprites(std::map<std::string, tSharedCompoundSprite> const& _mapCompounds)
+{
+	std::map<std::string, std::set<std::string>> _mapSprites;
+	for (auto const& _Item : _mapCompounds)
+	{
+		for (auto const& _TextureSprites : _Item.second->GetTextureSprites())
+		{
+			_mapSprites[_TextureSprites.first].insert(_TextureSprites.second.begin(), _TextureSprites.second.end());
+		}
+	}
+	return _mapSprites;
+}
+
+bool CCompoundLoader::LoadSpriteSheet(std::string const& _sTextureFolder, std::string const& _sTexture, CSpriteSheet& _SpriteSheet, CAssetCache* _pAssetCache, std::set<std::string> const* _pSprites)
+{
+	std::string _sXmlPath = FileHelper::GetAbsolutePath(stl_helper::Format("%s/%s.xml", _sTextureFolder.c_str(), _sTexture.c_str()));
+
+	// Stamped before reading, if it changes underneath us the next open just misses
+	uint64_t const _uModifiedTime = FileHelper::GetFileModifiedTime(_sXmlPath);
+
+	_SpriteSheet = CSpriteSheet();
+	if (_pAssetCache != nullptr && _pAssetCache->FindSpriteSheet(_sXmlPath, _uModifiedTime, _SpriteSheet))
+	{
+		return true;
+	}
+
+	if (_SpriteSheet.ParseXMLFile(_sXmlPath, _pSprites) == false || _SpriteSheet.GetSpriteData().empty())
+	{
+		_SpriteSheet = CSpriteSheet();
+		return false;
+	}
+
+	_SpriteSheet.SetTextureRes(c_eSheetTextureRes);
+
+	if (_pAssetCache != nullptr && _pSprites == nullptr)
+	{
+		_pAssetCache->InsertSpriteSheet(_sXmlPath, _uModifiedTime, _SpriteSheet);
+	}
+	return true;
+}
+
+CCompoundLoader::SDecodedImage CCompoundLoader::DecodeImage(std::string const& _sTextureFolder, std::string const& _sTexture, CAssetCache* _pAssetCache, CSpriteSheet::TextureRes _eTextureRes, block_compression::SSettings const& _Compression, bool const _bMipmaps)
+{
+	SDecodedImage _Decoded;
+	_Decoded.m_sTexture = _sTexture;
+	_Decoded.m_sPath = FileHelper::GetAbsolutePath(stl_helper::Format("%s/%s", _sTextureFolder.c_str(), _sTexture.c_str()));
+	_Decoded.m_uModifiedTime = FileHelper::GetFileModifiedTime(_Decoded.m_sPath);
+	_Decoded.m_uScaleDenom = CSpriteSheet::GetDecodeScale(c_eSheetTextureRes, _eTextureRes);
+
+	uint32_t const _uCompressionVariant = _Compression.GetVariant();
+	if (_pAssetCache != nullptr && _pAssetCache->AcquireTexture(_Decoded.m_sPath, _Decoded.m_uModifiedTime, _Decoded.m_uScaleDenom, _uCompressionVariant, _Decoded.m_uCachedTexture))
+	{
+		_Decoded.m_uCompressionVariant = _uCompressionVariant;
+		return _Decoded;
+	}
+
+	if (_uCompressionVariant != 0 && DecodeCompressedImage(_Decoded, _Compression))
+	{
+		return _Decoded;
+	}
+
+	// The stream goes through the texture cache itself
+	if (IsPNGPath(_Decoded.m_sPath))
+	{
+		auto _pStream = std::make_shared<FileHelper::CPNGStream>();
+		if (_pStream->Open(_Decoded.m_sPath))
+		{
+			_Decoded.m_iWidth = _pStream->GetWidth();
+			_Decoded.m_iHeight = _pStream->GetHeight();
+			if (_Decoded.m_uScaleDenom > 1)
+			{
+				if (DecodeReducedPNG(*_pStream, _Decoded))
+				{
+					return AddMips(_Decoded, _bMipmaps);
+				}
+			}
+			else if (static_cast<uint64_t>(_Decoded.m_iWidth) * _Decoded.m_iHeight >= c_uMinStreamTexels)
+			{
+				_Decoded.m_pPNGStream = _pStream;
+				return _Decoded;
+			}
+			else
+			{
+				auto _pPixels = std::make_shared<FileHelper::tPixelBuffer>(_pStream->GetRowBytes() * _Decoded.m_iHeight);
+				_pStream->ReadRows(_pPixels->data(), _Decoded.m_iHeight);
+				_Decoded.m_ImageData.m_pData = _pPixels;
+				_Decoded.m_ImageData.m_uChannels = _pStream->GetChannels();
+				return AddMips(_Decoded, _bMipmaps);
+			}
+		}
+	}
+
+	// JPEG, JPNG and PNGs the stream can't read. Reopening the same texture loads the decoded
+	// pixels back instead of decoding again.
+	uint64_t _uSourceHash = 0;
+	bool _bUseTextureCache = false;
+	if (texture_cache::IsEnabled())
+	{
+		FileHelper::SFileView const _Source = FileHelper::MapFileContents(_Decoded.m_sPath);
+		if (_Source.IsEmpty() == false)
+		{
+			_uSourceHash = hash_helper::Hash64(_Source.m_pData, _Source.m_uSize);
+			_bUseTextureCache = true;
+
+			if (texture_cache::Load(_uSourceHash, _Decoded.m_uScaleDenom, _Decoded.m_iWidth, _Decoded.m_iHeight, _Decoded.m_ImageData))
+			{
+				return AddMips(_Decoded, _bMipmaps);
+			}
+		}
+	}
+
+	_Decoded.m_ImageData = FileHelper::LoadImageFromFile(_Decoded.m_sPath, _Decoded.m_iWidth, _Decoded.m_iHeight, _Decoded.m_uScaleDenom);
+	if (IsPNGPath(_Decoded.m_sPath))
+	{
+		ReduceImage(_Decoded.m_ImageData, _Decoded.m_iWidth, _Decoded.m_iHeight, _Decoded.m_uScaleDenom);
+	}
+
+	if (_bUseTextureCache && _Decoded.m_ImageData.m_pData != nullptr)
+	{
+		texture_cache::Store(_uSourceHash, _Decoded.m_uScaleDenom, _Decoded.m_iWidth, _Decoded.m_iHeight, _Decoded.m_ImageData);
+	}
+	return AddMips(_Decoded, _bMipmaps);
+}
+
+CCompoundLoader::SDecodedImage& CCompoundLoader::AddMips(SDecodedImage& _Decoded, bool const _bMipmaps)
+{
+	FileHelper::SImageData const& _ImageData = _Decoded.m_ImageData;
+	if (_bMipmaps && _ImageData.m_pData != nullptr && _ImageData.m_pData->empty() == false)
+	{
+		_Decoded.m_vectorMips = mip_chain::Generate(_ImageData.m_pData->data(), _Decoded.m_iWidth, _Decoded.m_iHeight, _ImageData.m_uChannels);
+	}
+	return _Decoded;
+}
+
+bool CCompoundLoader::DecodeReducedPNG(FileHelper::CPNGStream& _Stream, SDecodedImage& _Decoded)
+{
+	uint32_t const _uChannels = _Stream.GetChannels();
+	int32_t _iWidth = _Stream.GetWidth();
+	int32_t _iHeight = _Stream.GetHeight();
+	GetReducedSize(_iWidth, _iHeight, _Decoded.m_uScaleDenom);
+
+	size_t const _uReducedRowBytes = static_cast<size_t>(_iWidth) * _uChannels;
+	auto _pPixels = std::make_shared<FileHelper::tPixelBuffer>(_uReducedRowBytes * _iHeight);
+	uint8_t* _pOut = _pPixels->data();
+
+	int32_t const _iAlign = static_cast<int32_t>(_Decoded.m_uScaleDenom);
+	int32_t const _iBandRows = std::max<int32_t>(_iAlign, static_cast<int32_t>(c_uReduceBandBytes / _Stream.GetRowBytes()) & ~(_iAlign - 1));
+	bool const _bRead = ReadReducedBands(_Stream, _Decoded.m_uScaleDenom, _iBandRows, [&](uint8_t const* _pRows, int32_t const _iRows)
+	{
+		memcpy(_pOut, _pRows, _uReducedRowBytes * _iRows);
+		_pOut += _uReducedRowBytes * _iRows;
+	});
+	if (_bRead == false)
+	{
+		return false;
+	}
+
+	_Decoded.m_iWidth = _iWidth;
+	_Decoded.m_iHeight = _iHeight;
+	_Decoded.m_ImageData.m_pData = _pPixels;
+	_Decoded.m_ImageData.m_uChannels = _uChannels;
+	return true;
+}
+//========================================
+
+//========================================
+bool CCompoundLoader::DecodeCompressedImage(SDecodedImage& _Decoded, block_compression::SSettings const& _Compression)
+{
+	// Encoding takes far longer than decoding, so the blocks are always kept
+	FileHelper::SFileView const _Source = FileHelper::MapFileContents(_Decoded.m_sPath);
+	if (_Source.IsEmpty())
+	{
+		return false;
+	}
+
+	uint32_t const _uVariant = _Compression.GetVariant();
+	uint64_t const _uSourceHash = hash_helper::Hash64(_Source.m_pData, _Source.m_uSize);
+
+	block_compression::SCompressedImage _Compressed;
+	if (texture_cache::LoadCompressed(_uSourceHash, _Decoded.m_uScaleDenom, _uVariant, _Compressed) == false)
+	{
+		FileHelper::CPNGStream _Stream;
+		if (IsPNGPath(_Decoded.m_sPath) && _Stream.Open(_Decoded.m_sPath))
+		{
+			// A band of rows at a time, the whole image is never in memory. Below full size each
+			// band is halved down before it's encoded.
+			block_compression::Format const _eFormat = _Compression.ChooseFormat(FileHelper::PNGHasAlpha(_Source.m_pData, _Source.m_uSize));
+			if (_eFormat == block_compression::Format::None)
+			{
+				return false;
+			}
+
+			_Compressed.m_eFormat = _eFormat;
+			_Compressed.m_iWidth = _Stream.GetWidth();
+			_Compressed.m_iHeight = _Stream.GetHeight();
+			GetReducedSize(_Compressed.m_iWidth, _Compressed.m_iHeight, _Decoded.m_uScaleDenom);
+			_Compressed.m_pBlocks = std::make_shared<std::vector<uint8_t>>(block_compression::GetCompressedSize(_eFormat, _Compressed.m_iWidth, _Compressed.m_iHeight));
+
+			// Only the last band may be short of a whole number of blocks once it's reduced
+			int32_t const _iAlign = 4 * static_cast<int32_t>(_Decoded.m_uScaleDenom);
+			int32_t const _iBandRows = std::max<int32_t>(_iAlign, static_cast<int32_t>(c_uCompressBandBytes / _Stream.GetRowBytes()) / _iAlign * _iAlign);
+			size_t const _uReducedRowBytes = static_cast<size_t>(_Compressed.m_iWidth) * _Stream.GetChannels();
+			size_t const _uBlockRowBytes = block_compression::GetCompressedSize(_eFormat, _Compressed.m_iWidth, 4);
+
+			uint8_t* _pBlocks = _Compressed.m_pBlocks->data();
+			bool const _bRead = ReadReducedBands(_Stream, _Decoded.m_uScaleDenom, _iBandRows, [&](uint8_t const* _pRows, int32_t const _iRows)
+			{
+				block_compression::EncodeRows(_eFormat, _Compression.m_eQuality, _pRows, _uReducedRowBytes, _Stream.GetChannels(), _Compressed.m_iWidth, _iRows, _pBlocks);
+				_pBlocks += block_compression::GetBlockCount(_iRows) * _uBlockRowBytes;
+			});
+			if (_bRead == false)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			int32_t _iWidth = 0;
+			int32_t _iHeight = 0;
+			FileHelper::SImageData _ImageData = FileHelper::LoadImageFromFile(_Decoded.m_sPath, _iWidth, _iHeight, _Decoded.m_uScaleDenom);
+			if (_ImageData.m_pData == nullptr)
+			{
+				return false;
+			}
+			if (IsPNGPath(_Decoded.m_sPath))
+			{
+				ReduceImage(_ImageData, _iWidth, _iHeight, _Decoded.m_uScaleDenom);
+			}
+
+			bool const _bAlpha = block_compression::HasAlpha(_ImageData.m_pData->data(), static_cast<size_t>(_iWidth) * _iHeight, _ImageData.m_uChannels);
+			_Compressed = block_compression::Encode(_Compression.ChooseFormat(_bAlpha), _Compression.m_eQuality, _ImageData.m_pData->data(), _iWidth, _iHeight, _ImageData.m_uChannels);
+			if (_Compressed.m_pBlocks == nullptr)
+			{
+				return false;
+			}
+		}
+
+		texture_cache::StoreCompressed(_uSourceHash, _Decoded.m_uScaleDenom, _uVariant, _Compressed);
+	}
+
+	_Decoded.m_Compressed = _Compressed;
+	_Decoded.m_iWidth = _Compressed.m_iWidth;
+	_Decoded.m_iHeight = _Compressed.m_iHeight;
+	_Decoded.m_uCompressionVariant = _uVariant;
+	return true;
+}
+//========================================
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "compound_sprite.hpp"
+#include "spritesheet.hpp"
+
+#include "utility/block_compression.hpp"
+#include "utility/file_helper.hpp"
+#include "utility/mip_chain.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CAssetCache;
+
+//========================================
+// Opens a compound in the background: parses it and every sub-compound, then its
+// sprite sheets and images on the shared thread pool. Nothing here touches GL, the
+// owner polls it each frame and uploads the decoded images on the context thread.
+// With an asset cache, sheets and textures it already has are taken from it instead.
+//
+// The scene (compounds and sheets) is usable as soon as the sheets are parsed, which
+// is well before the images finish decoding, so it can be drawn with placeholders.
+class CCompoundLoader
+{
+public:
+	enum class Stage : uint32_t
+	{
+		ParsingCompounds = 0,
+		LoadingSheets,
+		DecodingTextures,	// scene is ready from here on
+		Done,
+		Failed,
+		Cancelled,
+	};
+
+	struct SProgress
+	{
+		Stage m_eStage = Stage::ParsingCompounds;
+		uint32_t m_uCompoundCount = 0;
+		uint32_t m_uSheetsLoaded = 0;
+		uint32_t m_uSheetsFailed = 0;	// of those loaded, left out of the scene
+		uint32_t m_uTexturesDecoded = 0;
+		uint32_t m_uTextureCount = 0;
+	};
+
+	// Below this a whole decoded PNG is only a few MB, not worth streaming
+	static uint32_t const c_uMinStreamTexels = 1024 * 1024;
+	// Every sheet is authored at this resolution
+	static CSpriteSheet::TextureRes const c_eSheetTextureRes = CSpriteSheet::TextureRes::High;
+
+	struct SDecodedImage
+	{
+		std::string m_sTexture;
+		FileHelper::SImageData m_ImageData;
+		// Large PNGs are opened but not decoded, whoever uploads them reads the rows
+		// straight into the texture. Set instead of m_ImageData.
+		std::shared_ptr<FileHelper::CPNGStream> m_pPNGStream;
+		// Encoded blocks when compression was asked for, set instead of either of the above
+		block_compression::SCompressedImage m_Compressed;
+		// Every level below m_ImageData when mipmaps were asked for. Streams and blocks have none,
+		// streams are mipmapped on the GPU once every row is in.
+		std::vector<mip_chain::SLevel> m_vectorMips;
+		int32_t m_iWidth = 0;
+		int32_t m_iHeight = 0;
+
+		// Asset cache key, absolute
+		std::string m_sPath;
+		uint64_t m_uModifiedTime = 0;
+		uint32_t m_uScaleDenom = 1;		// decoded at 1/n size
+		uint32_t m_uCompressionVariant = 0;	// block_compression::SSettings::GetVariant() of m_Compressed
+
+		// Non zero if the asset cache already had it, nothing was decoded and the texture
+		// is pinned for whoever takes this
+		uint32_t m_uCachedTexture = 0;
+	};
+
+	// _eTextureRes is the resolution textures are wanted at, _Compression how they're encoded and
+	// _bMipmaps whether they're mipmapped, see DecodeImage()
+	CCompoundLoader(std::string const& _sPath, std::string const& _sTextureFolder, CAssetCache* _pAssetCache = nullptr, CSpriteSheet::TextureRes _eTextureRes = CSpriteSheet::TextureRes::High,
+					block_compression::SSettings const& _Compression = block_compression::SSettings(), bool const _bMipmaps = false);
+	~CCompoundLoader();		// cancels, and waits for the worker
+
+	void Cancel();
+
+	std::string const& GetPath() const { return m_sPath; }
+	std::string const& GetTextureFolder() const { return m_sTextureFolder; }
+	CSpriteSheet::TextureRes GetTextureRes() const { return m_eTextureRes; }
+	SProgress GetProgress() const;
+
+	bool IsSceneReady() const;
+	// Stopped (done, failed or cancelled) and every decoded image has been taken
+	bool IsFinished() const;
+
+	// Moves the parsed compounds and sheets out, only once IsSceneReady()
+	void TakeScene(std::map<std::string, tSharedCompoundSprite>& _mapCompounds, std::map<std::string, CSpriteSheet>& _mapSpriteSheets);
+	// Next decoded image waiting to be uploaded, in the order they finished. False if there isn't one yet.
+	bool PopDecodedImage(SDecodedImage& _Decoded);
+
+	//---------- also used by the blocking load path, safe to call from any thread
+	static std::vector<std::string> GetRequiredTextures(std::map<std::string, tSharedCompoundSprite> const& _mapCompounds);
+	// Texture -> every sprite the compounds use from it
+	static std::map<std::string, std::set<std::string>> GetRequiredSprites(std::map<std::string, tSharedCompoundSprite> const& _mapCompounds);
+	// _pSprites (optional) loads only those cells, see CSpriteSheet::ParseXML(). Partial sheets
+	// aren't put in the asset cache. False if the XML is missing or none of its cells were found.
+	static bool LoadSpriteSheet(std::string const& _sTextureFolder, std::string const& _sTexture, CSpriteSheet& _SpriteSheet, CAssetCache* _pAssetCache = nullptr, std::set<std::string> const* _pSprites = nullptr);
+	// Below the resolution sheets are authored at, JPEG and JPNG are decoded straight at 1/2 or 1/4 size
+	// and PNGs are read a band at a time and halved down to it, before they're encoded when they're compressed.
+	// PNGs of c_uMinStreamTexels or more come back as a stream rather than pixels. Everything
+	// goes through the texture cache (see texture_cache.hpp), streams included.
+	// With _Compression enabled images come back as blocks instead (PNGs encoded a band at a
+	// time as they stream), and whatever can't be encoded falls back to pixels.
+	// With _bMipmaps, pixels come back with their mip chain (see mip_chain.hpp).
+	static SDecodedImage DecodeImage(std::string const& _sTextureFolder, std::string const& _sTexture, CAssetCache* _pAssetCache = nullptr, CSpriteSheet::TextureRes _eTextureRes = CSpriteSheet::TextureRes::High,
+									 block_compression::SSettings const& _Compression = block_compression::SSettings(), bool const _bMipmaps = false);
+
+protected:
+	// The whole of _Stream into m_ImageData, halved once for each step of m_uScaleDenom. False if it can't be read.
+	static bool DecodeReducedPNG(FileHelper::CPNGStream& _Stream, SDecodedImage& _Decoded);
+	// Fills in m_vectorMips for pixels when _bMipmaps is set
+	static SDecodedImage& AddMips(SDecodedImage& _Decoded, bool const _bMipmaps);
+
+	// Fills in m_Compressed, from the texture cache when it has them. False if it can't be decoded or encoded.
+	static bool DecodeCompressedImage(SDecodedImage& _Decoded, block_compression::SSettings const& _Compression);
+
+	void Run();
+	void SetStage(Stage _eStage) { m_eStage.store(static_cast<uint32_t>(_eStage)); }
+	Stage GetStage() const { return static_cast<Stage>(m_eStage.load()); }
+
+	std::string m_sPath;
+	std::string m_sTextureFolder;
+	CAssetCache* m_pAssetCache = nullptr;
+	CSpriteSheet::TextureRes m_eTextureRes = CSpriteSheet::TextureRes::High;
+	block_compression::SSettings m_Compression;
+	bool m_bMipmaps = false;
+
+	std::thread m_Thread;
+	std::atomic<bool> m_bCancel;
+
+	std::atomic<uint32_t> m_eStage;
+	std::atomic<uint32_t> m_uCompoundCount;
+	std::atomic<uint32_t> m_uSheetsLoaded;
+	std::atomic<uint32_t> m_uSheetsFailed;
+	std::atomic<uint32_t> m_uTexturesDecoded;
+	std::atomic<uint32_t> m_uTextureCount;
+
+	// Everything below is guarded by m_Mutex
+	mutable std::mutex m_Mutex;
+	std::map<std::string, tSharedCompoundSprite> m_mapCompounds;
+	std::map<std::string, CSpriteSheet> m_mapSpriteSheets;
+	std::deque<SDecodedImage> m_dequeDecodedImages;
+};
+//========================================
@@ -1,311 +1,1099 @@
 
 #include "compound_sprite.hpp"
+#include "baked_timeline.hpp"
 
-#include "rapidjson/document.h"
+#include "rapidjson/reader.h"
+#include "rapidjson/error/en.h"
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include "utility/binary_stream.hpp"
+#include "utility/compiled_cache.hpp"
 #include "utility/file_helper.hpp"
 #include "utility/stl_helper.hpp"
+#include "utility/thread_pool.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <stdlib.h>
 
 
 //========================================
+uint32_t const CCompoundSprite::c_uInvalidIndex;
+
 CCompoundSprite::SActor * CCompoundSprite::GetActorById(uint32_t _uId)
 {
-    for (auto & _Actor : m_vectorActors)
+    uint32_t _uIndex = GetActorIndexById(_uId);
+    if (_uIndex == c_uInvalidIndex)
+    {
+        return nullptr;
+    }
+
+    return &m_vectorActors[_uIndex];
+}
+
+uint32_t CCompoundSprite::GetActorIndexById(uint32_t _uId) const
+{
+    if (m_mapActorIndexById.empty())
+    {
+        return (_uId < m_vectorActorIndexById.size()) ? m_vectorActorIndexById[_uId] : c_uInvalidIndex;
+    }
+
+    auto _itIndex = m_mapActorIndexById.find(_uId);
+    return (_itIndex != m_mapActorIndexById.end()) ? _itIndex->second : c_uInvalidIndex;
+}
+
+void CCompoundSprite::BuildActorIndex()
+{
+    m_vectorActorIndexById.clear();
+    m_mapActorIndexById.clear();
+
+    uint32_t _uMaxId = 0;
+    for (auto const& _Actor : m_vectorActors)
+    {
+        _uMaxId = std::max(_uMaxId, _Actor.m_uID);
+    }
+
+    // uids are normally small and packed, only fall back to hashing if someone got creative.
+    // Walk backwards so duplicate ids resolve to the first actor, like the old linear search.
+    uint32_t const _uActorCount = static_cast<uint32_t>(m_vectorActors.size());
+    bool const _bDense = _uMaxId < _uActorCount * 2 + 64;
+    if (_bDense)
+    {
+        m_vectorActorIndexById.assign(_uActorCount > 0 ? _uMaxId + 1 : 0, c_uInvalidIndex);
+    }
+
+    for (uint32_t i = _uActorCount; i-- > 0;)
     {
-        if (_Actor.m_uID == _uId)
+        if (_bDense)
+        {
+            m_vectorActorIndexById[m_vectorActors[i].m_uID] = i;
+        }
+        else
         {
-            return &_Actor;
+            m_mapActorIndexById[m_vectorActors[i].m_uID] = i;
         }
     }
-
-    return nullptr;
 }
 //========================================
 
 //========================================
-CCompoundSprite::SActorState ParseActorState(rapidjson::Value const &_root)
+namespace
 {
-    CCompoundSprite::SActorState _ActorState;
+    // rapidjson's in-situ stream wants a terminated string, a mapped file isn't. Reads as
+    // '\0' past the end instead. Decoded strings are written back over the source.
+    struct SInsituStream
+    {
+        typedef char Ch;
 
-    using namespace rapidjson;
+        SInsituStream(char* _pBegin, size_t const _uSize)
+            : m_pSrc(_pBegin)
+            , m_pDst(nullptr)
+            , m_pHead(_pBegin)
+            , m_pEnd(_pBegin + _uSize)
+        { }
 
-    if (_root.HasMember("Alignment"))
+        Ch Peek() const { return (m_pSrc != m_pEnd) ? *m_pSrc : '\0'; }
+        Ch Take() { return (m_pSrc != m_pEnd) ? *m_pSrc++ : '\0'; }
+        size_t Tell() const { return static_cast<size_t>(m_pSrc - m_pHead); }
+
+        Ch* PutBegin() { return m_pDst = m_pSrc; }
+        void Put(Ch _c) { *m_pDst++ = _c; }
+        size_t PutEnd(Ch* _pBegin) { return static_cast<size_t>(m_pDst - _pBegin); }
+        void Flush() {}
+
+        Ch* Push(size_t _uCount) { Ch* _pBegin = m_pDst; m_pDst += _uCount; return _pBegin; }
+        void Pop(size_t _uCount) { m_pDst -= _uCount; }
+
+        char* m_pSrc;
+        char* m_pDst;
+        char* m_pHead;
+        char* m_pEnd;
+    };
+};
+
+namespace rapidjson
+{
+    template <>
+    struct StreamTraits<SInsituStream>
     {
-        Value const& _valAlignment = _root["Alignment"];
-        if (_valAlignment.IsArray() && _valAlignment.Size() == 2)
+        enum { copyOptimization = 1 };
+    };
+};
+
+// Fills the compound as rapidjson walks the file, there's no DOM. Actors and keyframes
+// are written where they're kept, timelines straight into m_mapTimelineStates when the
+// actor id comes before the keyframes (it does in everything the editor writes).
+//
+// Members the compound doesn't use are skipped whole. Missing members keep their defaults.
+class CCompoundSprite::CJSONHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CCompoundSprite::CJSONHandler>
+{
+public:
+    explicit CJSONHandler(CCompoundSprite& _Compound)
+        : m_Compound(_Compound)
+    {
+        m_arrayLevels[0].m_eContext = Context::Document;
+    }
+
+    bool Null() { return Other(); }
+    bool Bool(bool _bValue)
+    {
+        SLevel& _Level = Top();
+        if (m_uSkipDepth == 0 && _Level.m_eMember == Member::Shown && m_pState != nullptr &&
+            (_Level.m_eContext == Context::Actor || _Level.m_eContext == Context::Frame))
         {
-            _ActorState.m_uAlignmentX = _valAlignment[0].GetUint();
-            _ActorState.m_uAlignmentY = _valAlignment[1].GetUint();
+            m_pState->m_bShown = _bValue;
+            return true;
         }
+        return Other();
     }
+    bool Int(int _iValue) { return Number(_iValue); }
+    bool Uint(unsigned _uValue) { return Number(_uValue); }
+    bool Int64(int64_t _iValue) { return Number(static_cast<double>(_iValue)); }
+    bool Uint64(uint64_t _uValue) { return Number(static_cast<double>(_uValue)); }
+    bool Double(double _dValue) { return Number(_dValue); }
 
-    if (_root.HasMember("Alpha"))
+    bool String(char const* _pString, rapidjson::SizeType _uLength, bool)
     {
-        _ActorState.m_fAlpha = _root["Alpha"].GetFloat();
+        SLevel& _Level = Top();
+        if (m_uSkipDepth > 0)
+        {
+            return true;
+        }
+
+        if (_Level.m_eContext == Context::Actor && _Level.m_eMember == Member::Sprite)
+        {
+            m_Compound.m_vectorActors.back().m_sSprite.assign(_pString, _uLength);
+        }
+        else if (_Level.m_eContext == Context::SpriteInfo && _Level.m_eMember == Member::SpriteInfo)
+        {
+            m_sSprite.assign(_pString, _uLength);
+            m_bHasSprite = true;
+        }
+        else if (_Level.m_eContext == Context::SpriteInfo && _Level.m_eMember == Member::Texture)
+        {
+            m_sTexture.assign(_pString, _uLength);
+            m_bHasTexture = true;
+        }
+        else
+        {
+            return Other();
+        }
+        return true;
     }
-    _ActorState.m_fAngle = _root["Angle"].GetFloat();
 
-    if (_root.HasMember("Colour"))
+    bool Key(char const* _pString, rapidjson::SizeType _uLength, bool)
     {
-        _ActorState.m_uColour = _root["Colour"].GetUint();
+        if (m_uSkipDepth == 0)
+        {
+            Top().m_eMember = FindMember(_pString, _uLength);
+        }
+        return true;
     }
 
-    _ActorState.m_uFlip = _root["Flip"].GetUint();
-
-    Value const& _valPos = _root["Position"];
-    if (_valPos.IsArray() && _valPos.Size() == 2)
+    bool StartObject()
     {
-        _ActorState.m_fPosX = _valPos[0].GetFloat();
-        _ActorState.m_fPosY = _valPos[1].GetFloat();
+        if (m_uSkipDepth > 0)
+        {
+            ++m_uSkipDepth;
+            return true;
+        }
+
+        SLevel& _Level = Top();
+        switch (_Level.m_eContext)
+        {
+        case Context::Document:
+            return Push(Context::Root);
+
+        case Context::Root:
+            return (_Level.m_eMember == Member::StageOptions) ? Push(Context::StageOptions) : Skip();
+
+        case Context::SpriteInfoList:
+            m_bHasSprite = false;
+            m_bHasTexture = false;
+            return Push(Context::SpriteInfo);
+
+        case Context::ActorList:
+            m_Compound.m_vectorActors.emplace_back();
+            m_pState = &m_Compound.m_vectorActors.back().m_State;
+            return Push(Context::Actor);
+
+        case Context::TimelineList:
+            m_bHasTimelineActor = false;
+            m_bHasStage = false;
+            m_pFrames = nullptr;
+            return Push(Context::Timeline);
+
+        case Context::FrameList:
+            m_pFrames->emplace_back();
+            m_pState = &m_pFrames->back().m_State;
+            return Push(Context::Frame);
+
+        default:
+            Other();
+            return Skip();
+        }
     }
 
-    Value const& _valScale = _root["Scale"];
-    if (_valScale.IsArray() && _valScale.Size() == 2)
+    bool EndObject(rapidjson::SizeType)
     {
-        _ActorState.m_fScaleX = _valScale[0].GetFloat();
-        _ActorState.m_fScaleY = _valScale[1].GetFloat();
-    }
+        if (m_uSkipDepth > 0)
+        {
+            --m_uSkipDepth;
+            return true;
+        }
+
+        switch (Top().m_eContext)
+        {
+        case Context::SpriteInfo:
+            if (m_bHasSprite && m_bHasTexture)
+            {
+                m_Compound.m_mapTextureSprites[m_sTexture].insert(m_sSprite);
+            }
+            break;
 
-    _ActorState.m_bShown = _root["Shown"].GetBool();
+        case Context::Actor:
+        case Context::Frame:
+            m_pState = nullptr;
+            break;
 
-    return _ActorState;
-}
+        case Context::Timeline:
+            EndTimeline();
+            break;
 
-void CCompoundSprite::ParseJSONFileRecursive(std::string const& _sFile,
-                                             std::map<std::string, tSharedCompoundSprite>& _mapCompounds)
-{
-    std::string _sAbsPath = FileHelper::GetAbsolutePath(_sFile);
+        default:
+            break;
+        }
+        return Pop();
+    }
 
-    // If file not already loaded in our map
-    if (_mapCompounds.find(_sAbsPath) == _mapCompounds.end())
+    bool StartArray()
     {
-        // create and parse
-        tSharedCompoundSprite _pCompound(new CCompoundSprite());
-        _pCompound->ParseJSONFile(_sAbsPath);
-
-        // add to map
-        _mapCompounds[_sAbsPath] = _pCompound;
+        if (m_uSkipDepth > 0)
+        {
+            ++m_uSkipDepth;
+            return true;
+        }
 
-        // find any sub-compounds in this one
-        auto& _vectorActors = _pCompound->GetActors();
-        for (auto &_Actor : _vectorActors)
+        SLevel& _Level = Top();
+        switch (_Level.m_eContext)
         {
-            if (_Actor.m_uType == static_cast<uint32_t>(SActor::Type::Compound))
+        case Context::Root:
+            switch (_Level.m_eMember)
             {
-                // path should be relative, so modify current path to find new compound
-                std::string _sSubPath = _sAbsPath;
+            case Member::Alignment:
+            case Member::Point:
+                return Push(Context::Pair);
+            case Member::Actors:
+                return Push(Context::ActorList);
+            case Member::Timelines:
+                return Push(Context::TimelineList);
+            default:
+                return Skip();
+            }
 
-                size_t _uPos = _sSubPath.find_last_of("/");
-                if (_uPos == std::string::npos)
-                {
-                    _uPos = _sSubPath.find_last_of("\\");
-                }
-                _sSubPath.replace(_uPos+1, std::string::npos, _Actor.m_sSprite);
+        case Context::StageOptions:
+            return (_Level.m_eMember == Member::SpriteInfo) ? Push(Context::SpriteInfoList) : Skip();
 
-                _Actor.m_sSubCompoundPath = _sSubPath;
+        case Context::Actor:
+        case Context::Frame:
+            switch (_Level.m_eMember)
+            {
+            case Member::Alignment:
+            case Member::Position:
+            case Member::Scale:
+                return Push(Context::Pair);
+            default:
+                return Skip();
+            }
 
-                ParseJSONFileRecursive(_sSubPath, _mapCompounds);
+        case Context::Timeline:
+            if (_Level.m_eMember != Member::Stage)
+            {
+                return Skip();
             }
+
+            // Before the actor id is known the keyframes wait in scratch
+            m_pFrames = m_bHasTimelineActor ? &m_Compound.m_mapTimelineStates[m_uTimelineActorId] : &m_vectorScratchFrames;
+            m_pFrames->clear();
+            m_bHasStage = true;
+            return Push(Context::FrameList);
+
+        default:
+            Other();
+            return Skip();
         }
     }
-}
 
-void CCompoundSprite::ParseJSONFile(std::string const& _sFile)
-{
-    std::string _sAbsPath = FileHelper::GetAbsolutePath(_sFile);
+    bool EndArray(rapidjson::SizeType)
+    {
+        if (m_uSkipDepth > 0)
+        {
+            --m_uSkipDepth;
+            return true;
+        }
+
+        if (Top().m_eContext == Context::Pair)
+        {
+            SLevel const& _Pair = Top();
+            if (_Pair.m_uCount == 2)
+            {
+                SetPair(m_arrayLevels[m_uDepth - 1], _Pair.m_arrayValues[0], _Pair.m_arrayValues[1]);
+            }
+        }
+        return Pop();
+    }
 
-    std::string _sJson = FileHelper::GetFileContentsString(_sAbsPath);
+protected:
+    enum class Context : uint8_t
+    {
+        Document,
+        Root,
+        StageOptions,
+        SpriteInfoList,
+        SpriteInfo,
+        ActorList,
+        Actor,
+        TimelineList,
+        Timeline,
+        FrameList,
+        Frame,
+        Pair,       // two numbers, anything else makes it invalid
+    };
 
-    ParseJSONData(_sJson);
-}
+    enum class Member : uint8_t
+    {
+        Unknown,
+        Actors,
+        Alignment,
+        Alpha,
+        Angle,
+        Colour,
+        Flip,
+        Point,
+        Position,
+        Scale,
+        Shown,
+        Sprite,
+        SpriteInfo,
+        SpriteUid,
+        Stage,
+        StageLength,
+        StageOptions,
+        Texture,
+        Time,
+        Timelines,
+        Type,
+        Uid,
+        Version,
+    };
 
-void CCompoundSprite::ParseJSONData(std::string const& _sJSON)
-{
-    assert(_sJSON.empty() == false);
+    static Member FindMember(char const* _pString, size_t const _uLength)
+    {
+        struct SMemberName
+        {
+            char const* m_pName;
+            size_t m_uLength;
+            Member m_eMember;
+        };
+        static SMemberName const s_arrayMembers[] =
+        {
+            { "actors", 6, Member::Actors },
+            { "Alignment", 9, Member::Alignment },
+            { "Alpha", 5, Member::Alpha },
+            { "Angle", 5, Member::Angle },
+            { "Colour", 6, Member::Colour },
+            { "Flip", 4, Member::Flip },
+            { "Point", 5, Member::Point },
+            { "Position", 8, Member::Position },
+            { "Scale", 5, Member::Scale },
+            { "Shown", 5, Member::Shown },
+            { "sprite", 6, Member::Sprite },
+            { "SpriteInfo", 10, Member::SpriteInfo },
+            { "spriteuid", 9, Member::SpriteUid },
+            { "stage", 5, Member::Stage },
+            { "StageLength", 11, Member::StageLength },
+            { "stageOptions", 12, Member::StageOptions },
+            { "Texture", 7, Member::Texture },
+            { "Time", 4, Member::Time },
+            { "timelines", 9, Member::Timelines },
+            { "type", 4, Member::Type },
+            { "uid", 3, Member::Uid },
+            { "Version", 7, Member::Version },
+        };
 
-    using namespace rapidjson;
+        for (SMemberName const& _MemberName : s_arrayMembers)
+        {
+            if (_MemberName.m_uLength == _uLength && memcmp(_MemberName.m_pName, _pString, _uLength) == 0)
+            {
+                return _MemberName.m_eMember;
+            }
+        }
+        return Member::Unknown;
+    }
+
+    static uint32_t ToUint(double const _dValue)
+    {
+        return static_cast<uint32_t>(static_cast<int64_t>(_dValue));
+    }
+
+    struct SLevel
+    {
+        Context m_eContext = Context::Document;
+        Member m_eMember = Member::Unknown;
+        uint32_t m_uCount = 0;          // values seen, Pair only
+        double m_arrayValues[2] = {};
+    };
 
-    Document _doc;
-    _doc.Parse(_sJSON.c_str());
+    SLevel& Top() { return m_arrayLevels[m_uDepth]; }
 
-    // Read alignment
-    if (_doc.HasMember("Alignment"))
+    bool Push(Context const _eContext)
     {
-        Value& _valAlignment = _doc["Alignment"];
-        if (_valAlignment.IsArray() && _valAlignment.Size() == 2)
+        // Deeper than anything in a compound, can't be one
+        if (m_uDepth + 1 >= c_uMaxDepth)
         {
-            m_uAlignmentX = _valAlignment[0].GetUint();
-            m_uAlignmentY = _valAlignment[1].GetUint();
+            return false;
         }
+
+        m_arrayLevels[++m_uDepth] = SLevel();
+        m_arrayLevels[m_uDepth].m_eContext = _eContext;
+        return true;
+    }
+
+    bool Pop()
+    {
+        --m_uDepth;
+        return true;
+    }
+
+    bool Skip()
+    {
+        m_uSkipDepth = 1;
+        return true;
     }
 
-    // Read Point
-    if (_doc.HasMember("Point"))
+    // A value the compound doesn't want. Only matters inside a pair.
+    bool Other()
     {
-        Value& _valPoint = _doc["Point"];
-        if (_valPoint.IsArray() && _valPoint.Size() == 2)
+        if (m_uSkipDepth == 0 && Top().m_eContext == Context::Pair)
         {
-            m_fPointX = _valPoint[0].GetFloat();
-            m_fPointY = _valPoint[1].GetFloat();
+            Top().m_uCount = 3;
         }
+        return true;
     }
 
-    //---------- Read stage options
-    Value& _valStageOptions = _doc["stageOptions"];
-    if (_valStageOptions.IsObject())
+    bool Number(double const _dValue)
     {
-        m_fStageLength = _valStageOptions["StageLength"].GetFloat();
-        if (_valStageOptions.HasMember("Version"))
+        if (m_uSkipDepth > 0)
         {
-            m_iVersion = _valStageOptions["Version"].GetInt();
+            return true;
         }
 
-        Value& _valSpriteInfo = _valStageOptions["SpriteInfo"];
-
-        if (_valSpriteInfo.IsArray())
+        SLevel& _Level = Top();
+        switch (_Level.m_eContext)
         {
-            for (Value::ConstValueIterator _it = _valSpriteInfo.Begin(); _it != _valSpriteInfo.End(); ++_it)
+        case Context::Pair:
+            if (_Level.m_uCount < 2)
             {
-                std::string _sSprite = (*_it)["SpriteInfo"].GetString();
-                std::string _sTexture = (*_it)["Texture"].GetString();
+                _Level.m_arrayValues[_Level.m_uCount] = _dValue;
+            }
+            ++_Level.m_uCount;
+            break;
 
-                m_mapTextureSprites[_sTexture].insert(_sSprite);
+        case Context::StageOptions:
+            if (_Level.m_eMember == Member::StageLength)
+            {
+                m_Compound.m_fStageLength = static_cast<float>(_dValue);
+            }
+            else if (_Level.m_eMember == Member::Version)
+            {
+                m_Compound.m_iVersion = static_cast<int32_t>(_dValue);
+            }
+            break;
 
-                //std::cout << "Sprite: " << _sSprite << ", Texture: " << _sTexture << std::endl;
+        case Context::Actor:
+            if (_Level.m_eMember == Member::Type)
+            {
+                m_Compound.m_vectorActors.back().m_uType = ToUint(_dValue);
+            }
+            else if (_Level.m_eMember == Member::Uid)
+            {
+                m_Compound.m_vectorActors.back().m_uID = ToUint(_dValue);
+            }
+            else
+            {
+                SetState(_Level.m_eMember, _dValue);
             }
+            break;
+
+        case Context::Frame:
+            if (_Level.m_eMember == Member::Time)
+            {
+                m_pFrames->back().m_fTime = static_cast<float>(_dValue);
+            }
+            else
+            {
+                SetState(_Level.m_eMember, _dValue);
+            }
+            break;
+
+        case Context::Timeline:
+            if (_Level.m_eMember == Member::SpriteUid && m_bHasTimelineActor == false)
+            {
+                m_uTimelineActorId = ToUint(_dValue);
+                m_bHasTimelineActor = true;
+            }
+            break;
+
+        default:
+            break;
         }
+        return true;
     }
 
-    //---------- Read actors
-    Value& _valActors = _doc["actors"];
-    if (_valActors.IsArray())
+    void SetState(Member const _eMember, double const _dValue)
     {
-        for (Value::ConstValueIterator _it = _valActors.Begin(); _it != _valActors.End(); ++_it)
+        switch (_eMember)
         {
-            Value const& _valActor = (*_it);
+        case Member::Alpha:    m_pState->m_fAlpha = static_cast<float>(_dValue);  break;
+        case Member::Angle:    m_pState->m_fAngle = static_cast<float>(_dValue);  break;
+        case Member::Colour:   m_pState->m_uColour = ToUint(_dValue);             break;
+        case Member::Flip:     m_pState->m_uFlip = ToUint(_dValue);               break;
+        default:                                                               break;
+        }
+    }
 
-            SActor _Actor;
+    void SetPair(SLevel const& _Owner, double const _dX, double const _dY)
+    {
+        if (_Owner.m_eContext == Context::Root)
+        {
+            if (_Owner.m_eMember == Member::Alignment)
+            {
+                m_Compound.m_uAlignmentX = ToUint(_dX);
+                m_Compound.m_uAlignmentY = ToUint(_dY);
+            }
+            else if (_Owner.m_eMember == Member::Point)
+            {
+                m_Compound.m_fPointX = static_cast<float>(_dX);
+                m_Compound.m_fPointY = static_cast<float>(_dY);
+            }
+            return;
+        }
 
-            _Actor.m_State = ParseActorState(_valActor);
+        switch (_Owner.m_eMember)
+        {
+        case Member::Alignment:
+            m_pState->m_uAlignmentX = ToUint(_dX);
+            m_pState->m_uAlignmentY = ToUint(_dY);
+            break;
+        case Member::Position:
+            m_pState->m_fPosX = static_cast<float>(_dX);
+            m_pState->m_fPosY = static_cast<float>(_dY);
+            break;
+        case Member::Scale:
+            m_pState->m_fScaleX = static_cast<float>(_dX);
+            m_pState->m_fScaleY = static_cast<float>(_dY);
+            break;
+        default:
+            break;
+        }
+    }
 
-            _Actor.m_sSprite = _valActor["sprite"].GetString();
-            _Actor.m_uType = _valActor["type"].GetUint();
-            _Actor.m_uID = _valActor["uid"].GetUint();
+    void EndTimeline()
+    {
+        // No actor to put it on
+        if (m_bHasTimelineActor == false)
+        {
+            return;
+        }
 
-            m_vectorActors.push_back(_Actor);
+        // Lookups binary search on time, so make sure frames are in order. Stable so
+        // keyframes sharing a time keep their file order.
+        std::vector<STimelineFrame>& _vectorFrames = m_Compound.m_mapTimelineStates[m_uTimelineActorId];
+        if (m_bHasStage == false)
+        {
+            _vectorFrames.clear();
+        }
+        else if (m_pFrames == &m_vectorScratchFrames)
+        {
+            _vectorFrames.assign(m_vectorScratchFrames.begin(), m_vectorScratchFrames.end());
         }
+        std::stable_sort(_vectorFrames.begin(), _vectorFrames.end(), [](STimelineFrame const& _A, STimelineFrame const& _B) { return _A.m_fTime < _B.m_fTime; });
+
+        m_pFrames = nullptr;
     }
 
-    //---------- Read timelines
-    Value& _valTimelines = _doc["timelines"];
-    if (_valTimelines.IsArray())
+    static uint32_t const c_uMaxDepth = 16;
+
+    CCompoundSprite& m_Compound;
+
+    SLevel m_arrayLevels[c_uMaxDepth];
+    uint32_t m_uDepth = 0;
+    uint32_t m_uSkipDepth = 0;      // inside something being skipped
+
+    SActorState* m_pState = nullptr;                // actor or keyframe being read
+
+    std::vector<STimelineFrame>* m_pFrames = nullptr;
+    std::vector<STimelineFrame> m_vectorScratchFrames;
+    uint32_t m_uTimelineActorId = 0;
+    bool m_bHasTimelineActor = false;
+    bool m_bHasStage = false;
+
+    std::string m_sSprite;
+    std::string m_sTexture;
+    bool m_bHasSprite = false;
+    bool m_bHasTexture = false;
+};
+//========================================
+
+//========================================
+bool CCompoundSprite::ParseJSONFileRecursive(std::string const& _sFile,
+                                             std::map<std::string, tSharedCompoundSprite>& _mapCompounds)
+{
+    std::string const _sRootPath = FileHelper::GetAbsolutePath(_sFile);
+
+    CTaskGroup _TaskGroup(CThreadPool::GetShared());
+    std::mutex _Mutex;
+
+    // Claims the path so it's only parsed once, then parses it on the pool. Sub-compounds
+    // are queued as soon as their parent is parsed, so the whole tree parses in parallel.
+    std::function<void(std::string const&)> QueueCompound;
+    QueueCompound = [&](std::string const& _sPath)
     {
-        for (Value::ConstValueIterator _itTimeline = _valTimelines.Begin(); _itTimeline != _valTimelines.End(); ++_itTimeline)
+        std::string _sAbsPath = FileHelper::GetAbsolutePath(_sPath);
+
+        tSharedCompoundSprite _pCompound;
         {
-            Value const& _valTimeline = (*_itTimeline);
+            std::lock_guard<std::mutex> _Lock(_Mutex);
 
-            uint32_t _uActorId = _valTimeline["spriteuid"].GetUint();
+            // If file not already loaded in our map
+            if (_mapCompounds.find(_sAbsPath) != _mapCompounds.end())
+            {
+                return;
+            }
 
-            std::vector<STimelineFrame> _vectorFrames;
+            // add to map, nothing reads it until every task is done
+            _pCompound = std::make_shared<CCompoundSprite>();
+            _mapCompounds[_sAbsPath] = _pCompound;
+        }
 
-            Value const& _valStage = _valTimeline["stage"];
-            if (_valStage.IsArray())
+        _TaskGroup.Run([&QueueCompound, &_sRootPath, _pCompound, _sAbsPath]()
+        {
+            // Left in the map empty, actors using it just draw nothing. The root is the caller's
+            // to report.
+            if (_pCompound->ParseJSONFile(_sAbsPath) == false)
             {
-                for (Value::ConstValueIterator _itFrame = _valStage.Begin(); _itFrame != _valStage.End(); ++_itFrame)
+                if (_sAbsPath != _sRootPath)
                 {
-                    Value const& _valFrame = (*_itFrame);
+                    fprintf(stdout, "Failed to load sub-compound '%s'.\n", _sAbsPath.c_str());
+                }
+                return;
+            }
 
-                    STimelineFrame _Frame;
+            // find any sub-compounds in this one
+            auto& _vectorActors = _pCompound->GetActors();
+            for (auto &_Actor : _vectorActors)
+            {
+                if (_Actor.m_uType == static_cast<uint32_t>(SActor::Type::Compound))
+                {
+                    // path should be relative, so modify current path to find new compound
+                    std::string _sSubPath = _sAbsPath;
 
-                    _Frame.m_State = ParseActorState(_valFrame);
+                    size_t _uPos = _sSubPath.find_last_of("/");
+                    if (_uPos == std::string::npos)
+                    {
+                        _uPos = _sSubPath.find_last_of("\\");
+                    }
+                    _sSubPath.replace(_uPos+1, std::string::npos, _Actor.m_sSprite);
 
-                    _Frame.m_fTime = _valFrame["Time"].GetFloat();
+                    _Actor.m_sSubCompoundPath = _sSubPath;
 
-                    _vectorFrames.emplace_back(_Frame);
+                    QueueCompound(_sSubPath);
                 }
             }
+        });
+    };
 
-            m_mapTimelineStates[_uActorId] = _vectorFrames;
-        }
+    QueueCompound(_sFile);
+    _TaskGroup.Wait();
+
+    auto _itRoot = _mapCompounds.find(_sRootPath);
+    return _itRoot != _mapCompounds.end() && _itRoot->second->m_bParsed;
+}
+
+bool CCompoundSprite::ParseJSONFile(std::string const& _sFile)
+{
+    std::string _sAbsPath = FileHelper::GetAbsolutePath(_sFile);
+
+    FileHelper::SFileView _Compiled;
+    if (compiled_cache::Load(_sAbsPath, compiled_cache::Kind::Compound, _Compiled) &&
+        ReadCompiled(_Compiled.m_pData, _Compiled.m_uSize))
+    {
+        m_bParsed = true;
+        return true;
+    }
+
+    // Parsed in place in a copy on write mapping. The read only one keeps the original
+    // bytes for the cache to hash, both share the page cache.
+    FileHelper::SFileView const _Json = FileHelper::MapFileContents(_sAbsPath);
+    FileHelper::SFileView const _JsonInsitu = FileHelper::MapFileContentsWritable(_sAbsPath);
+    if (_Json.IsEmpty() || _JsonInsitu.m_uSize != _Json.m_uSize)
+    {
+        return false;
     }
 
-    return;
+    // Never cache a bad file, it would come back without the error every time after
+    if (ParseJSONData(reinterpret_cast<char*>(_JsonInsitu.m_pWritableData), _JsonInsitu.m_uSize) == false)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> _vectorCompiled;
+    WriteCompiled(_vectorCompiled);
+    compiled_cache::Store(_sAbsPath, compiled_cache::Kind::Compound, _Json, _vectorCompiled);
+    return true;
+}
+
+bool CCompoundSprite::ParseJSONData(char* _pJSON, size_t const _uSize)
+{
+    assert(_uSize > 0);
+
+    CJSONHandler _Handler(*this);
+    SInsituStream _Stream(_pJSON, _uSize);
+
+    rapidjson::Reader _Reader;
+    rapidjson::ParseResult const _Result = _Reader.Parse<rapidjson::kParseInsituFlag>(_Stream, _Handler);
+    if (_Result.IsError())
+    {
+        fprintf(stderr, "Compound JSON error at offset %zu: %s\n", _Result.Offset(), rapidjson::GetParseError_En(_Result.Code()));
+
+        // Whatever was read before the error goes, like the DOM's empty document did
+        *this = CCompoundSprite();
+        OnParsed();
+        return false;
+    }
+
+    OnParsed();
+    m_bParsed = true;
+    return true;
+}
+
+void CCompoundSprite::OnParsed()
+{
+    BuildActorIndex();
+
+    m_pBakedTimeline = std::make_shared<CBakedTimeline>();
+    m_pBakedTimeline->Build(m_vectorActors, m_mapTimelineStates);
 }
 //========================================
 
 //========================================
-CCompoundSprite::SActorState CCompoundSprite::GetStateForActorAtTime(uint32_t const _uActorId, float const _fTime)
+namespace
 {
-    SActorState _CurrentState;
+    // Bump whenever any of the records below change
+    uint32_t const c_uCompiledVersion = 1;
 
-    // Find actor for id
-    auto _pActor = GetActorById(_uActorId);
-    if (_pActor == nullptr)
+    struct SCompiledHeader
     {
-        // No actor found, return default state
-        return _CurrentState;
-    }
-    else
+        uint32_t m_uVersion = c_uCompiledVersion;
+        uint32_t m_uAlignmentX = 0;
+        uint32_t m_uAlignmentY = 0;
+        float m_fPointX = 0.0f;
+        float m_fPointY = 0.0f;
+        float m_fStageLength = 0.0f;
+        int32_t m_iVersion = 0;
+
+        uint32_t m_uActorCount = 0;
+        uint32_t m_uTextureCount = 0;
+        uint32_t m_uSpriteCount = 0;
+        uint32_t m_uTimelineCount = 0;
+        uint32_t m_uFrameCount = 0;
+    };
+
+    struct SCompiledState
+    {
+        uint32_t m_uAlignmentX;
+        uint32_t m_uAlignmentY;
+        float m_fAlpha;
+        float m_fAngle;
+        uint32_t m_uColour;
+        uint32_t m_uFlip;
+        float m_fPosX;
+        float m_fPosY;
+        float m_fScaleX;
+        float m_fScaleY;
+        uint32_t m_uShown;
+    };
+
+    struct SCompiledActor
     {
-        // Set current state to actor initial values
-        _CurrentState = _pActor->m_State;
+        SCompiledState m_State;
+        uint32_t m_uSprite;     // string index
+        uint32_t m_uType;
+        uint32_t m_uID;
+    };
+
+    // Sprites used from one texture, a range of the sprite string indices
+    struct SCompiledTexture
+    {
+        uint32_t m_uTexture;    // string index
+        uint32_t m_uFirstSprite;
+        uint32_t m_uSpriteCount;
+    };
+
+    // Keyframes for one actor, a range of the frames
+    struct SCompiledTimeline
+    {
+        uint32_t m_uActorId;
+        uint32_t m_uFirstFrame;
+        uint32_t m_uFrameCount;
+    };
+
+    struct SCompiledFrame
+    {
+        SCompiledState m_State;
+        float m_fTime;
+    };
+
+    SCompiledState CompileState(CCompoundSprite::SActorState const& _State)
+    {
+        SCompiledState _Compiled;
+        _Compiled.m_uAlignmentX = _State.m_uAlignmentX;
+        _Compiled.m_uAlignmentY = _State.m_uAlignmentY;
+        _Compiled.m_fAlpha = _State.m_fAlpha;
+        _Compiled.m_fAngle = _State.m_fAngle;
+        _Compiled.m_uColour = _State.m_uColour;
+        _Compiled.m_uFlip = _State.m_uFlip;
+        _Compiled.m_fPosX = _State.m_fPosX;
+        _Compiled.m_fPosY = _State.m_fPosY;
+        _Compiled.m_fScaleX = _State.m_fScaleX;
+        _Compiled.m_fScaleY = _State.m_fScaleY;
+        _Compiled.m_uShown = _State.m_bShown ? 1 : 0;
+        return _Compiled;
     }
 
-    // get timeline for sprite
-    auto _itTimeline = m_mapTimelineStates.find(_uActorId);
-    if (_itTimeline != m_mapTimelineStates.end())
+    CCompoundSprite::SActorState ExpandState(SCompiledState const& _Compiled)
     {
-        auto const& _vectorTimeline = _itTimeline->second;
+        CCompoundSprite::SActorState _State;
+        _State.m_uAlignmentX = _Compiled.m_uAlignmentX;
+        _State.m_uAlignmentY = _Compiled.m_uAlignmentY;
+        _State.m_fAlpha = _Compiled.m_fAlpha;
+        _State.m_fAngle = _Compiled.m_fAngle;
+        _State.m_uColour = _Compiled.m_uColour;
+        _State.m_uFlip = _Compiled.m_uFlip;
+        _State.m_fPosX = _Compiled.m_fPosX;
+        _State.m_fPosY = _Compiled.m_fPosY;
+        _State.m_fScaleX = _Compiled.m_fScaleX;
+        _State.m_fScaleY = _Compiled.m_fScaleY;
+        _State.m_bShown = (_Compiled.m_uShown != 0);
+        return _State;
+    }
+};
 
-        // search for prev/next keyframe on timeline for given time
-        STimelineFrame const* _pPrev = nullptr;
-        STimelineFrame const* _pNext = nullptr;
+void CCompoundSprite::WriteCompiled(std::vector<uint8_t>& _vectorData) const
+{
+    CStringTableWriter _Strings;
+
+    SCompiledHeader _Header;
+    _Header.m_uAlignmentX = m_uAlignmentX;
+    _Header.m_uAlignmentY = m_uAlignmentY;
+    _Header.m_fPointX = m_fPointX;
+    _Header.m_fPointY = m_fPointY;
+    _Header.m_fStageLength = m_fStageLength;
+    _Header.m_iVersion = m_iVersion;
+
+    std::vector<SCompiledActor> _vectorActors;
+    for (auto const& _Actor : m_vectorActors)
+    {
+        SCompiledActor _Compiled;
+        _Compiled.m_State = CompileState(_Actor.m_State);
+        _Compiled.m_uSprite = _Strings.Add(_Actor.m_sSprite);
+        _Compiled.m_uType = _Actor.m_uType;
+        _Compiled.m_uID = _Actor.m_uID;
+        _vectorActors.push_back(_Compiled);
+    }
 
-        for (auto const &_Frame : _vectorTimeline)
+    std::vector<SCompiledTexture> _vectorTextures;
+    std::vector<uint32_t> _vectorSprites;
+    for (auto const& _TextureSprites : m_mapTextureSprites)
+    {
+        SCompiledTexture _Compiled;
+        _Compiled.m_uTexture = _Strings.Add(_TextureSprites.first);
+        _Compiled.m_uFirstSprite = static_cast<uint32_t>(_vectorSprites.size());
+        _Compiled.m_uSpriteCount = static_cast<uint32_t>(_TextureSprites.second.size());
+        for (auto const& _sSprite : _TextureSprites.second)
         {
-            if (_Frame.m_fTime <= _fTime)
-            {
-                _pPrev = &_Frame;
-            }
+            _vectorSprites.push_back(_Strings.Add(_sSprite));
+        }
+        _vectorTextures.push_back(_Compiled);
+    }
 
-            if (_Frame.m_fTime >= _fTime)
-            {
-                _pNext = &_Frame;
-                break;
-            }
+    std::vector<SCompiledTimeline> _vectorTimelines;
+    std::vector<SCompiledFrame> _vectorFrames;
+    for (auto const& _Timeline : m_mapTimelineStates)
+    {
+        SCompiledTimeline _Compiled;
+        _Compiled.m_uActorId = _Timeline.first;
+        _Compiled.m_uFirstFrame = static_cast<uint32_t>(_vectorFrames.size());
+        _Compiled.m_uFrameCount = static_cast<uint32_t>(_Timeline.second.size());
+        for (auto const& _Frame : _Timeline.second)
+        {
+            SCompiledFrame _CompiledFrame;
+            _CompiledFrame.m_State = CompileState(_Frame.m_State);
+            _CompiledFrame.m_fTime = _Frame.m_fTime;
+            _vectorFrames.push_back(_CompiledFrame);
         }
+        _vectorTimelines.push_back(_Compiled);
+    }
+
+    _Header.m_uActorCount = static_cast<uint32_t>(_vectorActors.size());
+    _Header.m_uTextureCount = static_cast<uint32_t>(_vectorTextures.size());
+    _Header.m_uSpriteCount = static_cast<uint32_t>(_vectorSprites.size());
+    _Header.m_uTimelineCount = static_cast<uint32_t>(_vectorTimelines.size());
+    _Header.m_uFrameCount = static_cast<uint32_t>(_vectorFrames.size());
+
+    CBinaryWriter _Writer;
+    _Writer.Write(_Header);
+    _Strings.Write(_Writer);
+    _Writer.WriteArray(_vectorActors.data(), _vectorActors.size());
+    _Writer.WriteArray(_vectorTextures.data(), _vectorTextures.size());
+    _Writer.WriteArray(_vectorSprites.data(), _vectorSprites.size());
+    _Writer.WriteArray(_vectorTimelines.data(), _vectorTimelines.size());
+    _Writer.WriteArray(_vectorFrames.data(), _vectorFrames.size());
+
+    _vectorData.swap(_Writer.GetData());
+}
 
-        // If we found a previous and next keyframe for given time
-        if (_pNext != nullptr && 
-            _pPrev != nullptr)
+bool CCompoundSprite::ReadCompiled(uint8_t const* _pData, size_t _uSize)
+{
+    CBinaryReader _Reader(_pData, _uSize);
+
+    SCompiledHeader _Header;
+    if (_Reader.Read(_Header) == false || _Header.m_uVersion != c_uCompiledVersion)
+    {
+        return false;
+    }
+
+    CStringTableReader _Strings;
+    if (_Strings.Read(_Reader) == false)
+    {
+        return false;
+    }
+
+    SCompiledActor const* _pActors = _Reader.ReadArray<SCompiledActor>(_Header.m_uActorCount);
+    SCompiledTexture const* _pTextures = _Reader.ReadArray<SCompiledTexture>(_Header.m_uTextureCount);
+    uint32_t const* _pSprites = _Reader.ReadArray<uint32_t>(_Header.m_uSpriteCount);
+    SCompiledTimeline const* _pTimelines = _Reader.ReadArray<SCompiledTimeline>(_Header.m_uTimelineCount);
+    SCompiledFrame const* _pFrames = _Reader.ReadArray<SCompiledFrame>(_Header.m_uFrameCount);
+    if (_Reader.IsValid() == false)
+    {
+        return false;
+    }
+
+    // Check every index before building anything, so a bad file leaves us untouched
+    for (uint32_t i = 0; i < _Header.m_uActorCount; ++i)
+    {
+        if (_Strings.IsValidIndex(_pActors[i].m_uSprite) == false)
         {
-            if (_pNext == _pPrev)
-            {
-                _CurrentState = _pNext->m_State;
-            }
-            else
-            {
-                _CurrentState = InterpolateActorState(_pPrev->m_State, _pNext->m_State, (_fTime - _pPrev->m_fTime) / (_pNext->m_fTime - _pPrev->m_fTime));
-            }
+            return false;
         }
-        // If we only found a previous keyframe
-        else if (_pPrev != nullptr) 
+    }
+    for (uint32_t i = 0; i < _Header.m_uTextureCount; ++i)
+    {
+        SCompiledTexture const& _Texture = _pTextures[i];
+        if (_Strings.IsValidIndex(_Texture.m_uTexture) == false ||
+            _Texture.m_uFirstSprite > _Header.m_uSpriteCount ||
+            _Texture.m_uSpriteCount > _Header.m_uSpriteCount - _Texture.m_uFirstSprite)
         {
-            _CurrentState = _pPrev->m_State;
+            return false;
         }
-        // If we only found a next keyframe
-        else if (_pNext != nullptr)
+    }
+    for (uint32_t i = 0; i < _Header.m_uSpriteCount; ++i)
+    {
+        if (_Strings.IsValidIndex(_pSprites[i]) == false)
+        {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < _Header.m_uTimelineCount; ++i)
+    {
+        SCompiledTimeline const& _Timeline = _pTimelines[i];
+        if (_Timeline.m_uFirstFrame > _Header.m_uFrameCount ||
+            _Timeline.m_uFrameCount > _Header.m_uFrameCount - _Timeline.m_uFirstFrame)
         {
-            _CurrentState = _pNext->m_State;
+            return false;
         }
     }
 
-    return _CurrentState;
+    m_uAlignmentX = _Header.m_uAlignmentX;
+    m_uAlignmentY = _Header.m_uAlignmentY;
+    m_fPointX = _Header.m_fPointX;
+    m_fPointY = _Header.m_fPointY;
+    m_fStageLength = _Header.m_fStageLength;
+    m_iVersion = _Header.m_iVersion;
+
+    m_vectorActors.resize(_Header.m_uActorCount);
+    for (uint32_t i = 0; i < _Header.m_uActorCount; ++i)
+    {
+        SActor& _Actor = m_vectorActors[i];
+        _Actor.m_State = ExpandState(_pActors[i].m_State);
+        _Actor.m_sSprite = _Strings.Get(_pActors[i].m_uSprite);
+        _Actor.m_uType = _pActors[i].m_uType;
+        _Actor.m_uID = _pActors[i].m_uID;
+    }
+
+    for (uint32_t i = 0; i < _Header.m_uTextureCount; ++i)
+    {
+        SCompiledTexture const& _Texture = _pTextures[i];
+        std::set<std::string>& _setSprites = m_mapTextureSprites[_Strings.Get(_Texture.m_uTexture)];
+        for (uint32_t j = 0; j < _Texture.m_uSpriteCount; ++j)
+        {
+            _setSprites.insert(_setSprites.end(), _Strings.Get(_pSprites[_Texture.m_uFirstSprite + j]));
+        }
+    }
+
+    // Frames were written already sorted
+    for (uint32_t i = 0; i < _Header.m_uTimelineCount; ++i)
+    {
+        SCompiledTimeline const& _Timeline = _pTimelines[i];
+        std::vector<STimelineFrame>& _vectorFrames = m_mapTimelineStates[_Timeline.m_uActorId];
+        _vectorFrames.resize(_Timeline.m_uFrameCount);
+        for (uint32_t j = 0; j < _Timeline.m_uFrameCount; ++j)
+        {
+            SCompiledFrame const& _Frame = _pFrames[_Timeline.m_uFirstFrame + j];
+            _vectorFrames[j].m_State = ExpandState(_Frame.m_State);
+            _vectorFrames[j].m_fTime = _Frame.m_fTime;
+        }
+    }
+
+    OnParsed();
+    return true;
+}
+//========================================
+
+//========================================
+CCompoundSprite::SActorState CCompoundSprite::GetStateForActorAtTime(uint32_t const _uActorId, float const _fTime)
+{
+    uint32_t _uIndex = GetActorIndexById(_uActorId);
+    if (_uIndex == c_uInvalidIndex)
+    {
+        // No actor found, return default state
+        return SActorState();
+    }
+
+    return GetStateForActorIndexAtTime(_uIndex, _fTime);
 }
-//========================================
\ No newline at end of file
+
+CCompoundSprite::SActorState CCompoundSprite::GetStateForActorIndexAtTime(uint32_t const _uActorIndex, float const _fTime, uint32_t* _pKeyframeCursor) const
+{
+    if (!m_pBakedTimeline || _uActorIndex >= m_pBakedTimeline->GetActorCount())
+    {
+        return SActorState();
+    }
+
+    return m_pBakedTimeline->EvaluateActor(_uActorIndex, _fTime, _pKeyframeCursor);
+}
+//========================================
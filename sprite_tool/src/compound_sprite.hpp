@@ -6,11 +6,13 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 
 // forward declarations
 class CSpriteSheet;
 class CCompoundSprite;
+class CBakedTimeline;
 
 typedef std::shared_ptr<CCompoundSprite> tSharedCompoundSprite;
 
@@ -107,11 +109,23 @@ public:
 		float m_fTime = 0.0f;
 	};
 
-	static void ParseJSONFileRecursive(std::string const& _sFile, 
+	// Parses _sFile and every compound it references on the shared thread pool, returns once all are done.
+	// Sub-compounds that fail to load are reported and left empty. False if _sFile itself failed,
+	// which is left to the caller to report.
+	static bool ParseJSONFileRecursive(std::string const& _sFile, 
 									   std::map<std::string, tSharedCompoundSprite> &_mapCompounds);
 
-	void ParseJSONFile(std::string const& _sFile);
-	void ParseJSONData(std::string const& _sJSON);
+	// Goes through the compiled cache (see compiled_cache.hpp), only parses the JSON on a miss.
+	// False if the file is missing, empty or not valid JSON; nothing is cached then.
+	bool ParseJSONFile(std::string const& _sFile);
+	// Parses in place, _pJSON is written over. Needn't be null terminated. False on a JSON
+	// error, and the compound is left empty.
+	bool ParseJSONData(char* _pJSON, size_t const _uSize);
+
+	// Fixed layout binary form of everything ParseJSONData() reads. ReadCompiled() is false
+	// (and leaves the compound empty) if the data is damaged or from another version.
+	void WriteCompiled(std::vector<uint8_t>& _vectorData) const;
+	bool ReadCompiled(uint8_t const* _pData, size_t _uSize);
 
 	std::string const & GetTextureForSprite(std::string const& _sSprite)
 	{
@@ -129,16 +143,27 @@ public:
 		return s_Empty;
 	}
 
+	static uint32_t const c_uInvalidIndex = 0xFFFFFFFF;
+
 	SActorState GetStateForActorAtTime(uint32_t const _uActorId, float const _fTime);
 
+	// Same as above by actor index. _pKeyframeCursor is optional, it remembers where the last
+	// search ended so forward playback only ever steps a keyframe or two.
+	SActorState GetStateForActorIndexAtTime(uint32_t const _uActorIndex, float const _fTime, uint32_t* _pKeyframeCursor = nullptr) const;
+
+	// Every actor's keyframes in one place, for evaluating the whole compound at once
+	std::shared_ptr<CBakedTimeline> const& GetBakedTimeline() const { return m_pBakedTimeline; }
+
 	std::vector<SActor> & GetActors() { return m_vectorActors; }
 	SActor * GetActorById(uint32_t _uId);
+	uint32_t GetActorIndexById(uint32_t _uId) const;
 	std::map<std::string, std::set<std::string>> const& GetTextureSprites() const { return m_mapTextureSprites; }
 	std::map<uint32_t, std::vector<STimelineFrame>> const& GetTimelines() const { return m_mapTimelineStates; }
 
 	float const GetStageLength() const { return m_fStageLength; }
 
 protected:
+	class CJSONHandler;
 
 	std::vector< std::shared_ptr<CSpriteSheet> > m_vectorSpriteSheets;
 	//std::shared_ptr<CSpriteSheet> m_pSpriteSheet;
@@ -155,5 +180,17 @@ protected:
 
 	float m_fStageLength = 0.0f;
 	int32_t m_iVersion = 0;
+	bool m_bParsed = false;		// read without errors, from the JSON or the compiled cache
+
+	//---------- lookup tables, built once parsing is done
+	void OnParsed();
+	void BuildActorIndex();
+
+	// Actor id -> index into m_vectorActors. Dense table when the ids are, hashed otherwise.
+	std::vector<uint32_t> m_vectorActorIndexById;
+	std::unordered_map<uint32_t, uint32_t> m_mapActorIndexById;
+
+	// Keyframes of every actor, same actor order as m_vectorActors
+	std::shared_ptr<CBakedTimeline> m_pBakedTimeline;
 };
 //========================================
\ No newline at end of file
@@ -1,42 +1,29 @@
 
+#include "gl_render_helper.hpp"
+
 #include "spritesheet.hpp"
 #include "compound_sprite.hpp"
 
+#include "utility/stl_helper.hpp"
+
 #define GLEW_STATIC
 #include "GL/glew.h"
 
 #include "glm/glm.hpp"
 #include <glm/gtc/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale, glm::perspective
 
-#include <array>
+#include <cassert>
+#include <cmath>
+#include <string>
+
 
 //======================================== 
 namespace gl_render_helper
 {
-	void DrawSprite(glm::mat4 &_matModelView,
-					CSpriteSheet::SSpriteCell const& _SpriteCell, 
-					CCompoundSprite::SActorState const& _ActorState,
-					uint32_t _uShaderProgram,
-					uint32_t _uTexture)
+	SLocalRect CalculateLocalRect(CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  uint32_t const _uAlignmentX,
+								  uint32_t const _uAlignmentY)
 	{
-		if (_ActorState.m_bShown == false)
-		{
-			return;
-		}
-
-		struct SPosition
-		{
-			float xyz[3];
-		};
-		struct SColour
-		{
-			uint32_t colour;
-		};
-		struct STexCoord
-		{
-			float uv[2];
-		};
-
 		float _fHalfW = static_cast<float>(_SpriteCell.w) * 0.5f;
 		float _fHalfH = static_cast<float>(_SpriteCell.h) * 0.5f;
 
@@ -45,7 +32,7 @@ namespace gl_render_helper
 		float _fMaxX = static_cast<float>(_SpriteCell.w);
 		float _fMaxY = static_cast<float>(_SpriteCell.h);
 
-		switch (static_cast<CCompoundSprite::Alignment>(_ActorState.m_uAlignmentX))
+		switch (static_cast<CCompoundSprite::Alignment>(_uAlignmentX))
 		{
 			case CCompoundSprite::Alignment::Centre:
 			{
@@ -67,7 +54,7 @@ namespace gl_render_helper
 				break;
 		}
 
-		switch (static_cast<CCompoundSprite::Alignment>(_ActorState.m_uAlignmentY))
+		switch (static_cast<CCompoundSprite::Alignment>(_uAlignmentY))
 		{
 			case CCompoundSprite::Alignment::Centre:
 			{
@@ -89,6 +76,40 @@ namespace gl_render_helper
 				break;
 		}
 
+		SLocalRect _Rect;
+		_Rect.m_vec2Min = glm::vec2(_fMinX, _fMinY);
+		_Rect.m_vec2Max = glm::vec2(_fMaxX, _fMaxY);
+		return _Rect;
+	}
+
+	bool CalculateSpriteTransform(glm::mat4 const& _matModelView,
+								  CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  CCompoundSprite::SActorState const& _ActorState,
+								  SSpriteTransform& _Transform)
+	{
+		if (_ActorState.m_bShown == false)
+		{
+			return false;
+		}
+
+		return CalculateSpriteTransform(_matModelView,
+										_SpriteCell,
+										CalculateLocalRect(_SpriteCell, _ActorState.m_uAlignmentX, _ActorState.m_uAlignmentY),
+										_ActorState,
+										_Transform);
+	}
+
+	bool CalculateSpriteTransform(glm::mat4 const& _matModelView,
+								  CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  SLocalRect const& _Rect,
+								  CCompoundSprite::SActorState const& _ActorState,
+								  SSpriteTransform& _Transform)
+	{
+		if (_ActorState.m_bShown == false)
+		{
+			return false;
+		}
+
 		float _fScaleX = _ActorState.m_fScaleX * _SpriteCell.m_fTextureScale;
 		float _fScaleY = _ActorState.m_fScaleY * _SpriteCell.m_fTextureScale;
 		if (_ActorState.m_uFlip & static_cast<uint32_t>(CCompoundSprite::Flip::FlipX))
@@ -100,89 +121,110 @@ namespace gl_render_helper
 			_fScaleY *= -1;
 		}
 
-		_fMinX *= _fScaleX;
-		_fMinY *= _fScaleY;
-		_fMaxX *= _fScaleX;
-		_fMaxY *= _fScaleY;
+		// Actor space axes: scale, then translate to the actor position. Angle isn't applied,
+		// sprites have never been drawn rotated.
+		glm::vec2 const _vec2AxisX(_fScaleX, 0.0f);
+		glm::vec2 const _vec2AxisY(0.0f, _fScaleY);
+		glm::vec2 const _vec2Pos(_ActorState.m_fPosX, _ActorState.m_fPosY);
 
-		_fMinX += _ActorState.m_fPosX;
-		_fMinY += _ActorState.m_fPosY;
-		_fMaxX += _ActorState.m_fPosX;
-		_fMaxY += _ActorState.m_fPosY;
+		// Only the 2D affine part of the model view matters for sprites
+		glm::vec2 const _vec2ModelX(_matModelView[0].x, _matModelView[0].y);
+		glm::vec2 const _vec2ModelY(_matModelView[1].x, _matModelView[1].y);
+		glm::vec2 const _vec2ModelT(_matModelView[3].x, _matModelView[3].y);
 
-		glm::vec4 _vec4Min = _matModelView * glm::vec4(_fMinX, _fMinY, 0.0f, 1.0f);
-		glm::vec4 _vec4Max = _matModelView * glm::vec4(_fMaxX, _fMaxY, 0.0f, 1.0f);
-
-		SPosition _arrayPos[6] =
+		auto TransformPoint = [&](glm::vec2 const& _vec2Point)
 		{
-			{_vec4Min.x, _vec4Min.y, 0.0f},
-			{_vec4Max.x, _vec4Min.y, 0.0f},
-			{_vec4Max.x, _vec4Max.y, 0.0f},
-			{_vec4Max.x, _vec4Max.y, 0.0f},
-			{_vec4Min.x, _vec4Max.y, 0.0f},
-			{_vec4Min.x, _vec4Min.y, 0.0f},
+			glm::vec2 const _vec2Actor = _vec2Pos + _vec2AxisX * _vec2Point.x + _vec2AxisY * _vec2Point.y;
+			return _vec2ModelT + _vec2ModelX * _vec2Actor.x + _vec2ModelY * _vec2Actor.y;
 		};
-
-		SColour _arrayCol[6] =
+		auto TransformVector = [&](glm::vec2 const& _vec2Vector)
 		{
-			_ActorState.m_uColour,
-			_ActorState.m_uColour,
-			_ActorState.m_uColour,
-			_ActorState.m_uColour,
-			_ActorState.m_uColour,
-			_ActorState.m_uColour,
+			glm::vec2 const _vec2Actor = _vec2AxisX * _vec2Vector.x + _vec2AxisY * _vec2Vector.y;
+			return _vec2ModelX * _vec2Actor.x + _vec2ModelY * _vec2Actor.y;
 		};
 
-		STexCoord _arrayUV[6] =
-		{
-			{_SpriteCell.m_fMinX, _SpriteCell.m_fMinY},
-			{_SpriteCell.m_fMaxX, _SpriteCell.m_fMinY},
-			{_SpriteCell.m_fMaxX, _SpriteCell.m_fMaxY},
-			{_SpriteCell.m_fMaxX, _SpriteCell.m_fMaxY},
-			{_SpriteCell.m_fMinX, _SpriteCell.m_fMaxY},
-			{_SpriteCell.m_fMinX, _SpriteCell.m_fMinY},
-		};
+		glm::vec2 const _vec2Size = _Rect.m_vec2Max - _Rect.m_vec2Min;
+
+		_Transform.m_vec2Origin = TransformPoint(_Rect.m_vec2Min);
+		_Transform.m_vec2AxisX = TransformVector(glm::vec2(_vec2Size.x, 0.0f));
+		_Transform.m_vec2AxisY = TransformVector(glm::vec2(0.0f, _vec2Size.y));
 
-		GLint vpos_location = glGetAttribLocation(_uShaderProgram, "vPos");
-		GLint vcol_location = glGetAttribLocation(_uShaderProgram, "vCol");
-		GLint uv_location = glGetAttribLocation(_uShaderProgram, "uv");
+		_Transform.m_vec4UVRect = glm::vec4(_SpriteCell.m_fMinX, _SpriteCell.m_fMinY, _SpriteCell.m_fMaxX, _SpriteCell.m_fMaxY);
 
-		GLuint buffer_pos, buffer_col, buffer_uv;
+		_Transform.m_uColour = _ActorState.m_uColour;
 
-		//---------- pos
-		glGenBuffers(1, &buffer_pos);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_pos);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(SPosition) * 6, _arrayPos, GL_STATIC_DRAW);
+		return true;
+	}
 
-		glEnableVertexAttribArray(vpos_location);
-		glVertexAttribPointer(vpos_location, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+	bool CalculateSpriteQuad(glm::mat4 const& _matModelView,
+							 CSpriteSheet::SSpriteCell const& _SpriteCell,
+							 CCompoundSprite::SActorState const& _ActorState,
+							 SSpriteQuad& _Quad)
+	{
+		SSpriteTransform _Transform;
+		if (CalculateSpriteTransform(_matModelView, _SpriteCell, _ActorState, _Transform) == false)
+		{
+			return false;
+		}
 
-		//---------- colour
-		glGenBuffers(1, &buffer_col);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_col);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(SColour) * 6, _arrayCol, GL_STATIC_DRAW);
+		_Quad.m_vec2Pos[0] = _Transform.m_vec2Origin;
+		_Quad.m_vec2Pos[1] = _Transform.m_vec2Origin + _Transform.m_vec2AxisX;
+		_Quad.m_vec2Pos[2] = _Transform.m_vec2Origin + _Transform.m_vec2AxisX + _Transform.m_vec2AxisY;
+		_Quad.m_vec2Pos[3] = _Transform.m_vec2Origin + _Transform.m_vec2AxisY;
 
-		glEnableVertexAttribArray(vcol_location);
-		glVertexAttribPointer(vcol_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)0);
+		glm::vec4 const& _vec4UV = _Transform.m_vec4UVRect;
+		_Quad.m_vec2UV[0] = glm::vec2(_vec4UV.x, _vec4UV.y);
+		_Quad.m_vec2UV[1] = glm::vec2(_vec4UV.z, _vec4UV.y);
+		_Quad.m_vec2UV[2] = glm::vec2(_vec4UV.z, _vec4UV.w);
+		_Quad.m_vec2UV[3] = glm::vec2(_vec4UV.x, _vec4UV.w);
 
-		//---------- uv
-		glGenBuffers(1, &buffer_uv);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_uv);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(STexCoord) * 6, _arrayUV, GL_STATIC_DRAW);
+		_Quad.m_uColour = _Transform.m_uColour;
 
-		glEnableVertexAttribArray(uv_location);
-		glVertexAttribPointer(uv_location, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+		return true;
+	}
 
-		//---------- bind texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, _uTexture);
+	uint32_t CreateShaderProgram(char const* _pVertexSource, char const* _pFragmentSource)
+	{
+		GLuint _uVertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(_uVertexShader, 1, &_pVertexSource, nullptr);
+		glCompileShader(_uVertexShader);
+
+		GLuint _uFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(_uFragmentShader, 1, &_pFragmentSource, nullptr);
+		glCompileShader(_uFragmentShader);
+
+		GLuint _uProgram = glCreateProgram();
+		glAttachShader(_uProgram, _uVertexShader);
+		glAttachShader(_uProgram, _uFragmentShader);
+		glLinkProgram(_uProgram);
+
+		GLint _iProgramLinked;
+		glGetProgramiv(_uProgram, GL_LINK_STATUS, &_iProgramLinked);
+		if (_iProgramLinked != GL_TRUE)
+		{
+			GLsizei _iIgnored;
+			size_t const c_uLogSize = 4096;
+			char _LogVertex[c_uLogSize];
+			char _LogFragment[c_uLogSize];
+			char _LogProgram[c_uLogSize];
+
+			glGetShaderInfoLog(_uVertexShader, c_uLogSize, &_iIgnored, _LogVertex);
+			glGetShaderInfoLog(_uFragmentShader, c_uLogSize, &_iIgnored, _LogFragment);
+			glGetProgramInfoLog(_uProgram, c_uLogSize, &_iIgnored, _LogProgram);
+
+			std::string _sMessage = stl_helper::Format("%s\n%s\n%s", _LogVertex, _LogFragment, _LogProgram);
+			fprintf(stderr, "%s\n", _sMessage.c_str());
+
+			assert(false && _sMessage.c_str());
+		}
 
-		//---------- draw time
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		// Program keeps what it needs once linked
+		glDetachShader(_uProgram, _uVertexShader);
+		glDetachShader(_uProgram, _uFragmentShader);
+		glDeleteShader(_uVertexShader);
+		glDeleteShader(_uFragmentShader);
 
-		glDeleteBuffers(1, &buffer_pos);
-		glDeleteBuffers(1, &buffer_col);
-		glDeleteBuffers(1, &buffer_uv);
+		return _uProgram;
 	}
 };
 //========================================
\ No newline at end of file
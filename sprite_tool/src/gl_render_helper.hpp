@@ -9,10 +9,57 @@
 //========================================
 namespace gl_render_helper
 {
-	void DrawSprite(glm::mat4& _matModelView, 
-					CSpriteSheet::SSpriteCell const &_SpriteCell,
-					CCompoundSprite::SActorState const & _ActorState,
-					uint32_t _uShaderProgram,
-					uint32_t _uTexture);
+	// Sprite rect in cell pixels relative to the actor origin, before scale/flip
+	struct SLocalRect
+	{
+		glm::vec2 m_vec2Min = glm::vec2(0.0f);
+		glm::vec2 m_vec2Max = glm::vec2(0.0f);
+	};
+
+	// 2D affine taking the unit quad [0,1]x[0,1] to model view space
+	struct SSpriteTransform
+	{
+		glm::vec2 m_vec2Origin = glm::vec2(0.0f);
+		glm::vec2 m_vec2AxisX = glm::vec2(0.0f);
+		glm::vec2 m_vec2AxisY = glm::vec2(0.0f);
+
+		glm::vec4 m_vec4UVRect = glm::vec4(0.0f);	// min u, min v, max u, max v
+
+		uint32_t m_uColour = 0xFFFFFFFF;
+	};
+
+	// Corners are ordered min/min, max/min, max/max, min/max
+	struct SSpriteQuad
+	{
+		glm::vec2 m_vec2Pos[4];
+		glm::vec2 m_vec2UV[4];
+
+		uint32_t m_uColour = 0xFFFFFFFF;
+	};
+
+	SLocalRect CalculateLocalRect(CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  uint32_t const _uAlignmentX,
+								  uint32_t const _uAlignmentY);
+
+	// Returns false if the sprite shouldn't be drawn
+	bool CalculateSpriteTransform(glm::mat4 const& _matModelView,
+								  CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  CCompoundSprite::SActorState const& _ActorState,
+								  SSpriteTransform& _Transform);
+
+	// Same as above with the local rect already worked out, see CalculateLocalRect
+	bool CalculateSpriteTransform(glm::mat4 const& _matModelView,
+								  CSpriteSheet::SSpriteCell const& _SpriteCell,
+								  SLocalRect const& _LocalRect,
+								  CCompoundSprite::SActorState const& _ActorState,
+								  SSpriteTransform& _Transform);
+
+	// Returns false if the sprite shouldn't be drawn
+	bool CalculateSpriteQuad(glm::mat4 const& _matModelView,
+							 CSpriteSheet::SSpriteCell const& _SpriteCell,
+							 CCompoundSprite::SActorState const& _ActorState,
+							 SSpriteQuad& _Quad);
+
+	uint32_t CreateShaderProgram(char const* _pVertexSource, char const* _pFragmentSource);
 };
 //========================================
@@ -0,0 +1,467 @@
+// headless_main.cpp : Renders compound animations to PNG frame sequences without a window.
+//
+//  sprite_tool_headless --textures <folder> [--out <folder>] [--fps 30] [--size 512x512]
+//                       [--scale 1.0] [--jobs N] [--no-write] [--instanced]
+//                       [--software [--kernel scalar|sse2|avx2]] [--texture-res low|high|ultra]
+//                       [--texture-compression fast|normal|high]
+//                       [--compiled-cache <folder>|--no-compiled-cache] [--texture-cache-size <MB>]
+//                       [--pack <file>]...
+//                       <compound.json>...
+//  sprite_tool_headless --build-pack <folder> <file> [--store] [--restart-markers]
+//
+//  With --jobs N, N worker threads each get their own GL context and pull compounds
+//  off the list until it's empty. Frames/sec across all workers is reported at the end.
+//
+//  --software renders on the CPU with no GL context at all. Every kernel gives bit
+//  identical output, which is what golden image comparisons want.
+//
+//  --texture-compression encodes textures to BC1/BC3/BC7 on the CPU before uploading,
+//  whichever the context supports, and keeps the blocks in the compiled cache.
+//
+//  --restart-markers re-exports JPEG and JPNG textures into the pack with a restart
+//  marker at every MCU row (losslessly), so big ones are decoded on several threads.
+//
+//  Windows builds use sprite_tool_headless.vcxproj (hidden WGL window). Build servers
+//  without a display use CMakeLists.txt, which renders through EGL, or through OSMesa
+//  with -DSPRITE_TOOL_USE_OSMESA=ON.
+
+#include "headless/offscreen_context.hpp"
+#include "headless/headless_renderer.hpp"
+
+#include "sprite_batch.hpp"
+#include "software_rasterizer.hpp"
+
+#include "utility/asset_pack.hpp"
+#include "utility/compiled_cache.hpp"
+#include "utility/file_helper.hpp"
+#include "utility/texture_cache.hpp"
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct SOptions
+	{
+		std::string m_sTextureFolder;
+		std::vector<std::string> m_vectorCompounds;
+		std::vector<std::string> m_vectorOutputNames;	// one for each compound, see GetOutputNames
+		CHeadlessRenderer::SSettings m_Settings;
+		uint32_t m_uJobs = 1;
+		bool m_bSoftware = false;
+		CSoftwareRasterizer::Kernel m_eKernel = CSoftwareRasterizer::GetBestKernel();
+		CSpriteSheet::TextureRes m_eTextureRes = CSpriteSheet::TextureRes::High;
+		bool m_bTextureCompression = false;
+		block_compression::Quality m_eCompressionQuality = block_compression::Quality::Normal;
+
+		// Packing instead of rendering
+		std::string m_sPackFolder;
+		std::string m_sPackPath;
+		bool m_bPackCompress = true;
+		bool m_bPackRestartMarkers = false;
+	};
+
+	struct SWorkerResult
+	{
+		uint32_t m_uCompounds = 0;
+		uint32_t m_uFailed = 0;
+		uint64_t m_uFrames = 0;
+	};
+
+	void PrintUsage()
+	{
+		fprintf(stdout,
+				"usage: sprite_tool_headless --textures <folder> [options] <compound.json>...\n"
+				"       sprite_tool_headless --build-pack <folder> <file> [--store] [--restart-markers]\n"
+				"  --out <folder>     write frames to <folder>/<compound>/frame_#####.png, <compound> being\n"
+				"                     its path under the folder all the compounds share, less the extension\n"
+				"  --fps <n>          fixed timestep (default 30)\n"
+				"  --size <w>x<h>     framebuffer size (default 512x512)\n"
+				"  --scale <n>        viewport scale, as in the tool (default 1.0)\n"
+				"  --jobs <n>         render compounds on n threads/contexts (default 1)\n"
+				"  --no-write         render only, for measuring throughput\n"
+				"  --instanced        use the instanced render path\n"
+				"  --software         rasterise on the CPU, no GL needed\n"
+				"  --kernel <name>    software span kernel: scalar, sse2 or avx2 (default best supported)\n"
+				"  --texture-res <r>  low, high or ultra (default high). Below high, textures decode at 1/2 size,\n"
+				"                     PNG, JPEG and JPNG alike, block compressed or not\n"
+				"  --texture-compression <q>  block compress textures (BC1/BC3/BC7) at fast, normal or high quality, GL only\n"
+				"  --compiled-cache <folder>  where parsed compounds and sheets and decoded textures are cached (default ./sprite_tool_cache)\n"
+				"  --no-compiled-cache        always parse the JSON and XML and decode the textures\n"
+				"  --texture-cache-size <MB>  oldest decoded textures are removed past this (default 2048, 0 keeps none)\n"
+				"  --pack <file>      read assets from this pack, mounted over the folder it's in (repeatable)\n"
+				"  --build-pack <folder> <file>  pack every file under <folder> into <file> and exit\n"
+				"  --store            with --build-pack, don't compress anything\n"
+				"  --restart-markers  with --build-pack, rewrite JPEG/JPNG with restart markers so they decode on several threads\n");
+	}
+
+	bool ParseArguments(int _iArgc, char** _ppArgv, SOptions& _Options)
+	{
+		for (int i = 1; i < _iArgc; ++i)
+		{
+			std::string _sArg = _ppArgv[i];
+			bool const _bHasValue = (i + 1) < _iArgc;
+
+			if (_sArg == "--textures" && _bHasValue)
+			{
+				_Options.m_sTextureFolder = _ppArgv[++i];
+			}
+			else if (_sArg == "--out" && _bHasValue)
+			{
+				_Options.m_Settings.m_sOutputFolder = _ppArgv[++i];
+			}
+			else if (_sArg == "--fps" && _bHasValue)
+			{
+				_Options.m_Settings.m_fFramesPerSecond = static_cast<float>(atof(_ppArgv[++i]));
+			}
+			else if (_sArg == "--size" && _bHasValue)
+			{
+				// "<w>x<h>", sscanf trips the SDL checks
+				char* _pEnd = nullptr;
+				_Options.m_Settings.m_uWidth = static_cast<uint32_t>(strtoul(_ppArgv[++i], &_pEnd, 10));
+				if (*_pEnd != 'x')
+				{
+					return false;
+				}
+				_Options.m_Settings.m_uHeight = static_cast<uint32_t>(strtoul(_pEnd + 1, nullptr, 10));
+			}
+			else if (_sArg == "--scale" && _bHasValue)
+			{
+				_Options.m_Settings.m_fViewPortScale = static_cast<float>(atof(_ppArgv[++i]));
+			}
+			else if (_sArg == "--jobs" && _bHasValue)
+			{
+				_Options.m_uJobs = static_cast<uint32_t>(std::max(1, atoi(_ppArgv[++i])));
+			}
+			else if (_sArg == "--no-write")
+			{
+				_Options.m_Settings.m_bWriteFrames = false;
+			}
+			else if (_sArg == "--instanced")
+			{
+				_Options.m_Settings.m_bInstanced = true;
+			}
+			else if (_sArg == "--software")
+			{
+				_Options.m_bSoftware = true;
+			}
+			else if (_sArg == "--kernel" && _bHasValue)
+			{
+				std::string _sKernel = _ppArgv[++i];
+				if (_sKernel == "scalar")
+				{
+					_Options.m_eKernel = CSoftwareRasterizer::Kernel::Scalar;
+				}
+				else if (_sKernel == "sse2")
+				{
+					_Options.m_eKernel = CSoftwareRasterizer::Kernel::SSE2;
+				}
+				else if (_sKernel == "avx2")
+				{
+					_Options.m_eKernel = CSoftwareRasterizer::Kernel::AVX2;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			else if (_sArg == "--texture-res" && _bHasValue)
+			{
+				std::string _sRes = _ppArgv[++i];
+				if (_sRes == "low")
+				{
+					_Options.m_eTextureRes = CSpriteSheet::TextureRes::Low;
+				}
+				else if (_sRes == "high")
+				{
+					_Options.m_eTextureRes = CSpriteSheet::TextureRes::High;
+				}
+				else if (_sRes == "ultra")
+				{
+					_Options.m_eTextureRes = CSpriteSheet::TextureRes::Ultra;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			else if (_sArg == "--texture-compression" && _bHasValue)
+			{
+				std::string _sQuality = _ppArgv[++i];
+				_Options.m_bTextureCompression = true;
+				if (_sQuality == "fast")
+				{
+					_Options.m_eCompressionQuality = block_compression::Quality::Fast;
+				}
+				else if (_sQuality == "normal")
+				{
+					_Options.m_eCompressionQuality = block_compression::Quality::Normal;
+				}
+				else if (_sQuality == "high")
+				{
+					_Options.m_eCompressionQuality = block_compression::Quality::High;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			else if (_sArg == "--compiled-cache" && _bHasValue)
+			{
+				compiled_cache::SetDirectory(_ppArgv[++i]);
+			}
+			else if (_sArg == "--no-compiled-cache")
+			{
+				compiled_cache::SetDirectory("");
+			}
+			else if (_sArg == "--texture-cache-size" && _bHasValue)
+			{
+				texture_cache::SetMaxSize(strtoull(_ppArgv[++i], nullptr, 10) * 1024 * 1024);
+			}
+			else if (_sArg == "--pack" && _bHasValue)
+			{
+				if (CAssetPack::Mount(_ppArgv[++i]) == false)
+				{
+					return false;
+				}
+			}
+			else if (_sArg == "--build-pack" && (i + 2) < _iArgc)
+			{
+				_Options.m_sPackFolder = _ppArgv[++i];
+				_Options.m_sPackPath = _ppArgv[++i];
+			}
+			else if (_sArg == "--store")
+			{
+				_Options.m_bPackCompress = false;
+			}
+			else if (_sArg == "--restart-markers")
+			{
+				_Options.m_bPackRestartMarkers = true;
+			}
+			else if (_sArg.compare(0, 2, "--") == 0)
+			{
+				return false;
+			}
+			else
+			{
+				_Options.m_vectorCompounds.push_back(_sArg);
+			}
+		}
+
+		if (_Options.m_sPackFolder.empty() == false)
+		{
+			return _Options.m_sPackPath.empty() == false;
+		}
+
+		return _Options.m_sTextureFolder.empty() == false
+			&& _Options.m_vectorCompounds.empty() == false
+			&& _Options.m_Settings.m_fFramesPerSecond > 0.0f
+			&& _Options.m_Settings.m_uWidth > 0
+			&& _Options.m_Settings.m_uHeight > 0;
+	}
+
+	// "root/a/hero.json", "root/b/hero.json" -> "a/hero", "b/hero". Compounds with the same
+	// name in different folders get their own frames. Just the name for a single compound.
+	std::vector<std::string> GetOutputNames(std::vector<std::string> const& _vectorCompounds)
+	{
+		std::vector<std::string> _vectorPaths;
+		for (std::string const& _sCompound : _vectorCompounds)
+		{
+			std::string _sPath = FileHelper::GetAbsolutePath(_sCompound);
+			std::replace(_sPath.begin(), _sPath.end(), '\\', '/');
+			_vectorPaths.push_back(_sPath);
+		}
+
+		// Longest run of folders every path starts with, including the last '/'
+		std::string const& _sFirst = _vectorPaths.front();
+		size_t _uRootLength = _sFirst.find_last_of('/') + 1;
+		for (std::string const& _sPath : _vectorPaths)
+		{
+			size_t _uSame = 0;
+			while (_uSame < _uRootLength && _uSame < _sPath.size() && _sPath[_uSame] == _sFirst[_uSame])
+			{
+				++_uSame;
+			}
+
+			if (_uSame < _uRootLength)
+			{
+				size_t const _uSlash = (_uSame == 0) ? std::string::npos : _sFirst.rfind('/', _uSame - 1);
+				_uRootLength = (_uSlash == std::string::npos) ? 0 : _uSlash + 1;
+			}
+		}
+
+		std::vector<std::string> _vectorNames;
+		for (std::string const& _sPath : _vectorPaths)
+		{
+			std::string _sName = _sPath.substr(_uRootLength);
+
+			size_t const _uDot = _sName.find_last_of('.');
+			size_t const _uSlash = _sName.find_last_of('/');
+			if (_uDot != std::string::npos && (_uSlash == std::string::npos || _uDot > _uSlash))
+			{
+				_sName.erase(_uDot);
+			}
+
+			// Paths on different drives share nothing, keep the drive letter as a folder
+			_sName.erase(std::remove(_sName.begin(), _sName.end(), ':'), _sName.end());
+			_vectorNames.push_back(_sName);
+		}
+		return _vectorNames;
+	}
+
+	void RenderCompounds(SOptions const& _Options, std::atomic<uint32_t>& _NextCompound, SWorkerResult& _Result, CSpriteBatch& _SpriteBatch, CSoftwareRasterizer* _pSoftwareRasterizer)
+	{
+		CHeadlessRenderer _Renderer;
+		_Renderer.UseSoftwareRasterizer(_pSoftwareRasterizer);
+		_Renderer.SetTextureRes(_Options.m_eTextureRes);
+		if (_Options.m_bTextureCompression)
+		{
+			_Renderer.SetTextureCompression(_Options.m_eCompressionQuality);
+		}
+
+		for (;;)
+		{
+			uint32_t _uIndex = _NextCompound.fetch_add(1);
+			if (_uIndex >= _Options.m_vectorCompounds.size())
+			{
+				break;
+			}
+
+			std::string const& _sCompound = _Options.m_vectorCompounds[_uIndex];
+
+			++_Result.m_uCompounds;
+			if (_Renderer.Load(_sCompound, _Options.m_sTextureFolder) == false)
+			{
+				fprintf(stderr, "Failed to load '%s'.\n", _sCompound.c_str());
+				++_Result.m_uFailed;
+				continue;
+			}
+
+			_Result.m_uFrames += _Renderer.RenderAnimation(_SpriteBatch, _Options.m_Settings, _Options.m_vectorOutputNames[_uIndex]);
+		}
+
+		// Textures have to go while the context/rasterizer is still alive
+		_Renderer.Unload();
+	}
+
+	void RenderWorker(SOptions const& _Options, std::atomic<uint32_t>& _NextCompound, SWorkerResult& _Result)
+	{
+		if (_Options.m_bSoftware)
+		{
+			// Split the cores between the jobs rather than oversubscribing
+			CSoftwareRasterizer _Rasterizer;
+			_Rasterizer.SetKernel(_Options.m_eKernel);
+			_Rasterizer.SetThreadCount(std::max(1u, std::thread::hardware_concurrency() / _Options.m_uJobs));
+
+			// Never Init()'d, the batch only collects vertices for the rasterizer
+			CSpriteBatch _SpriteBatch;
+			RenderCompounds(_Options, _NextCompound, _Result, _SpriteBatch, &_Rasterizer);
+			return;
+		}
+
+		COffscreenContext _Context;
+		if (_Context.Create() == false || _Context.MakeCurrent() == false || COffscreenContext::InitGLEW() == false)
+		{
+			fprintf(stderr, "Failed to create an offscreen %s context.\n", COffscreenContext::GetBackendName());
+			return;
+		}
+
+		{
+			CSpriteBatch _SpriteBatch;
+			_SpriteBatch.Init();
+
+			RenderCompounds(_Options, _NextCompound, _Result, _SpriteBatch, nullptr);
+
+			_SpriteBatch.Shutdown();
+		}
+
+		_Context.ReleaseCurrent();
+	}
+};
+
+//========================================
+int main(int _iArgc, char** _ppArgv)
+{
+	SOptions _Options;
+	if (ParseArguments(_iArgc, _ppArgv, _Options) == false)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (_Options.m_sPackFolder.empty() == false)
+	{
+		return CAssetPack::Build(_Options.m_sPackFolder, _Options.m_sPackPath, _Options.m_bPackCompress, _Options.m_bPackRestartMarkers) ? 0 : 1;
+	}
+
+	// The same compound twice, or the same path with another extension
+	_Options.m_vectorOutputNames = GetOutputNames(_Options.m_vectorCompounds);
+	if (_Options.m_Settings.m_bWriteFrames && _Options.m_Settings.m_sOutputFolder.empty() == false)
+	{
+		std::map<std::string, size_t> _mapOutputs;
+		for (size_t i = 0; i < _Options.m_vectorOutputNames.size(); ++i)
+		{
+			auto const _Inserted = _mapOutputs.emplace(_Options.m_vectorOutputNames[i], i);
+			if (_Inserted.second == false)
+			{
+				fprintf(stderr, "'%s' and '%s' would write frames to the same folder.\n", _Options.m_vectorCompounds[_Inserted.first->second].c_str(), _Options.m_vectorCompounds[i].c_str());
+				return 1;
+			}
+		}
+	}
+
+	uint32_t const _uJobs = std::min<uint32_t>(_Options.m_uJobs, static_cast<uint32_t>(_Options.m_vectorCompounds.size()));
+
+	std::atomic<uint32_t> _NextCompound(0);
+	std::vector<SWorkerResult> _vectorResults(_uJobs);
+
+	auto _TimeStart = std::chrono::steady_clock::now();
+
+	if (_uJobs == 1)
+	{
+		RenderWorker(_Options, _NextCompound, _vectorResults[0]);
+	}
+	else
+	{
+		std::vector<std::thread> _vectorThreads;
+		for (uint32_t i = 0; i < _uJobs; ++i)
+		{
+			_vectorThreads.emplace_back(RenderWorker, std::cref(_Options), std::ref(_NextCompound), std::ref(_vectorResults[i]));
+		}
+		for (auto& _Thread : _vectorThreads)
+		{
+			_Thread.join();
+		}
+	}
+
+	double _dSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _TimeStart).count();
+
+	SWorkerResult _Total;
+	for (auto const& _Result : _vectorResults)
+	{
+		_Total.m_uCompounds += _Result.m_uCompounds;
+		_Total.m_uFailed += _Result.m_uFailed;
+		_Total.m_uFrames += _Result.m_uFrames;
+	}
+
+	fprintf(stdout, "%u compounds (%u failed), %llu frames in %.2fs on %u job(s) [%s]: %.1f frames/sec\n",
+			_Total.m_uCompounds,
+			_Total.m_uFailed,
+			static_cast<unsigned long long>(_Total.m_uFrames),
+			_dSeconds,
+			_uJobs,
+			_Options.m_bSoftware ? CSoftwareRasterizer::GetKernelName(std::min(_Options.m_eKernel, CSoftwareRasterizer::GetBestKernel())) : COffscreenContext::GetBackendName(),
+			_dSeconds > 0.0 ? _Total.m_uFrames / _dSeconds : 0.0);
+
+	return (_Total.m_uFailed == 0 && _Total.m_uCompounds == _Options.m_vectorCompounds.size()) ? 0 : 1;
+}
+//========================================
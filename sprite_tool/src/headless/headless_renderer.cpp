@@ -0,0 +1,263 @@
+#include "headless_renderer.hpp"
+
+#include "compound_sprite.hpp"
+#include "sprite_batch.hpp"
+#include "software_rasterizer.hpp"
+
+#include "utility/file_helper.hpp"
+#include "utility/stl_helper.hpp"
+
+// gl stuff
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+// stl
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//========================================
+CHeadlessRenderer::CHeadlessRenderer()
+{
+	// Nothing here browses sheets, only what's drawn is needed
+	m_bSelectiveSpriteSheets = true;
+	// One frame at a known scale, textures stay at the resolution asked for
+	m_bAutoTextureRes = false;
+}
+
+CHeadlessRenderer::~CHeadlessRenderer()
+{
+	// Context has to still be current for these
+	Unload();
+	ClearAssetCache();
+	DestroyFramebuffer();
+}
+//========================================
+
+//========================================
+void CHeadlessRenderer::SetTextureCompression(block_compression::Quality _eQuality)
+{
+	m_TextureCompression.m_bEnabled = true;
+	m_TextureCompression.m_eQuality = _eQuality;
+	if (m_pSoftwareRasterizer == nullptr)
+	{
+		DetectTextureCompression();
+	}
+}
+//========================================
+
+//========================================
+bool CHeadlessRenderer::Load(std::string const& _sCompoundPath, std::string const& _sTextureFolder)
+{
+	Unload();
+
+	if (LoadCompounds(_sCompoundPath) == false)
+	{
+		return false;
+	}
+
+	LoadCompoundAssets(_sTextureFolder);
+
+	if (BuildRootActorInstances(_sCompoundPath) == false)
+	{
+		return false;
+	}
+
+	m_sOpenFile = _sCompoundPath;
+
+	return true;
+}
+
+void CHeadlessRenderer::Unload()
+{
+	ClearScene();
+	m_sOpenFile.clear();
+}
+//========================================
+
+//========================================
+bool CHeadlessRenderer::CreateFramebuffer(uint32_t _uWidth, uint32_t _uHeight)
+{
+	if (m_uFramebuffer != 0 && m_uFramebufferWidth == _uWidth && m_uFramebufferHeight == _uHeight)
+	{
+		return true;
+	}
+
+	DestroyFramebuffer();
+
+	glGenTextures(1, &m_uColourTexture);
+	glBindTexture(GL_TEXTURE_2D, m_uColourTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _uWidth, _uHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_uFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_uFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_uColourTexture, 0);
+
+	GLenum _eStatus = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (_eStatus != GL_FRAMEBUFFER_COMPLETE)
+	{
+		fprintf(stderr, "Framebuffer incomplete (0x%x).\n", _eStatus);
+		DestroyFramebuffer();
+		return false;
+	}
+
+	m_uFramebufferWidth = _uWidth;
+	m_uFramebufferHeight = _uHeight;
+	m_vectorPixels.resize(static_cast<size_t>(_uWidth) * _uHeight * 4);
+
+	return true;
+}
+
+void CHeadlessRenderer::DestroyFramebuffer()
+{
+	if (m_uFramebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_uFramebuffer);
+		m_uFramebuffer = 0;
+	}
+	if (m_uColourTexture != 0)
+	{
+		glDeleteTextures(1, &m_uColourTexture);
+		m_uColourTexture = 0;
+	}
+	m_uFramebufferWidth = 0;
+	m_uFramebufferHeight = 0;
+}
+//========================================
+
+//========================================
+uint32_t CHeadlessRenderer::RenderAnimation(CSpriteBatch& _SpriteBatch, SSettings const& _Settings, std::string const& _sOutputName)
+{
+	bool const _bSoftware = (m_pSoftwareRasterizer != nullptr);
+
+	if (m_vectorActorInstances.empty())
+	{
+		return 0;
+	}
+
+	if (_bSoftware)
+	{
+		m_pSoftwareRasterizer->Resize(_Settings.m_uWidth, _Settings.m_uHeight);
+		m_vectorPixels.resize(static_cast<size_t>(_Settings.m_uWidth) * _Settings.m_uHeight * 4);
+	}
+	else if (CreateFramebuffer(_Settings.m_uWidth, _Settings.m_uHeight) == false)
+	{
+		return 0;
+	}
+
+	auto _itRoot = m_mapCompounds.find(FileHelper::GetAbsolutePath(m_sOpenFile));
+	assert(_itRoot != m_mapCompounds.end());
+
+	float const _fStageLength = _itRoot->second->GetStageLength();
+	float const _fTimeStep = 1.0f / _Settings.m_fFramesPerSecond;
+
+	// Always render at least one frame, for static compounds
+	uint32_t const _uFrameCount = std::max(1u, static_cast<uint32_t>(std::ceil(_fStageLength * _Settings.m_fFramesPerSecond)));
+
+	bool const _bWrite = _Settings.m_bWriteFrames && _Settings.m_sOutputFolder.empty() == false;
+	std::string _sFrameFolder;
+	if (_bWrite)
+	{
+		_sFrameFolder = stl_helper::Format("%s/%s", _Settings.m_sOutputFolder.c_str(), _sOutputName.c_str());
+		FileHelper::CreateDirectories(_sFrameFolder);
+	}
+
+	glm::mat4 _matViewProj = CalculateViewProjection(_Settings.m_uWidth, _Settings.m_uHeight, _Settings.m_fViewPortScale);
+
+	if (_bSoftware)
+	{
+		// The rasterizer consumes the vertex path output directly
+		_SpriteBatch.SetRenderPath(CSpriteBatch::RenderPath::Vertices);
+	}
+	else
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, m_uFramebuffer);
+		glViewport(0, 0, _Settings.m_uWidth, _Settings.m_uHeight);
+
+		// Keep the destination alpha meaningful so frames can be composited later
+		glEnable(GL_BLEND);
+		glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		_SpriteBatch.SetRenderPath(_Settings.m_bInstanced ? CSpriteBatch::RenderPath::Instanced : CSpriteBatch::RenderPath::Vertices);
+	}
+
+	for (uint32_t _uFrame = 0; _uFrame < _uFrameCount; ++_uFrame)
+	{
+		// Fixed timestep, never accumulate float error across frames
+		float const _fTime = _uFrame * _fTimeStep;
+
+		if (_bSoftware)
+		{
+			m_pSoftwareRasterizer->Clear(0);
+
+			_SpriteBatch.Begin(_matViewProj);
+			DrawActorInstances(_SpriteBatch, _fTime);
+			m_pSoftwareRasterizer->Draw(_SpriteBatch);
+		}
+		else
+		{
+			glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			_SpriteBatch.Begin(_matViewProj);
+			DrawActorInstances(_SpriteBatch, _fTime);
+			_SpriteBatch.End();
+		}
+
+		if (_bWrite == false)
+		{
+			continue;
+		}
+
+		if (_bSoftware)
+		{
+			m_vectorPixels = m_pSoftwareRasterizer->GetPixels();
+		}
+		else
+		{
+			glReadPixels(0, 0, _Settings.m_uWidth, _Settings.m_uHeight, GL_RGBA, GL_UNSIGNED_BYTE, m_vectorPixels.data());
+		}
+
+		// Colour was blended with SRC_ALPHA against a transparent clear (by either
+		// backend), so it's premultiplied by coverage. PNG wants straight alpha.
+		for (size_t i = 0; i < m_vectorPixels.size(); i += 4)
+		{
+			uint32_t _uAlpha = m_vectorPixels[i + 3];
+			if (_uAlpha != 0 && _uAlpha != 255)
+			{
+				for (size_t c = 0; c < 3; ++c)
+				{
+					uint32_t _uValue = (m_vectorPixels[i + c] * 255u + _uAlpha / 2) / _uAlpha;
+					m_vectorPixels[i + c] = static_cast<uint8_t>(std::min(_uValue, 255u));
+				}
+			}
+		}
+
+		std::string _sFramePath = stl_helper::Format("%s/frame_%05u.png", _sFrameFolder.c_str(), _uFrame);
+
+		// GL rows are bottom up
+		if (FileHelper::SavePNG(_sFramePath, m_vectorPixels.data(), _Settings.m_uWidth, _Settings.m_uHeight, 4, true) == false)
+		{
+			fprintf(stderr, "Failed to write '%s'.\n", _sFramePath.c_str());
+		}
+	}
+
+	if (_bSoftware == false)
+	{
+		// Make sure the work is actually done before anyone times us
+		glFinish();
+
+		glDisable(GL_BLEND);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	return _uFrameCount;
+}
+//========================================
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "sprite_tool.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class CSpriteBatch;
+class CSoftwareRasterizer;
+
+//========================================
+// Loads a compound (and everything it references) without any UI, then steps
+// it at a fixed timestep over its stage length rendering each frame into an FBO
+// (or a CSoftwareRasterizer).
+// Requires a current GL context (see COffscreenContext) unless a software rasterizer is used.
+class CHeadlessRenderer : public CSpriteTool
+{
+public:
+	struct SSettings
+	{
+		std::string m_sOutputFolder;	// empty, or m_bWriteFrames false, to skip writing
+		uint32_t m_uWidth = 512;
+		uint32_t m_uHeight = 512;
+		float m_fFramesPerSecond = 30.0f;
+		float m_fViewPortScale = 1.0f;
+		bool m_bInstanced = false;		// GL only
+		bool m_bWriteFrames = true;
+	};
+
+	CHeadlessRenderer();
+	~CHeadlessRenderer();
+
+	bool Load(std::string const& _sCompoundPath, std::string const& _sTextureFolder);
+	void Unload();
+
+	// Render on the CPU instead of GL, set before Load() so textures go to the right place.
+	// No GL context is needed at all in this mode.
+	void UseSoftwareRasterizer(CSoftwareRasterizer* _pSoftwareRasterizer) { m_pSoftwareRasterizer = _pSoftwareRasterizer; }
+	// Set before Load(), see CSpriteTool::m_eTextureRes
+	void SetTextureRes(CSpriteSheet::TextureRes _eTextureRes) { m_eTextureRes = _eTextureRes; }
+	// Set before Load(), with the context current, see CSpriteTool::m_TextureCompression. Ignored
+	// when rendering in software.
+	void SetTextureCompression(block_compression::Quality _eQuality);
+
+	// Frames are written to <m_sOutputFolder>/<_sOutputName>. Returns the number of frames rendered.
+	uint32_t RenderAnimation(CSpriteBatch& _SpriteBatch, SSettings const& _Settings, std::string const& _sOutputName);
+
+protected:
+	bool CreateFramebuffer(uint32_t _uWidth, uint32_t _uHeight);
+	void DestroyFramebuffer();
+
+	uint32_t m_uFramebuffer = 0;
+	uint32_t m_uColourTexture = 0;
+	uint32_t m_uFramebufferWidth = 0;
+	uint32_t m_uFramebufferHeight = 0;
+
+	std::vector<uint8_t> m_vectorPixels;
+};
+//========================================
@@ -0,0 +1,303 @@
+#include "offscreen_context.hpp"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#if defined(SPRITE_TOOL_USE_OSMESA)
+#include <GL/osmesa.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+//========================================
+COffscreenContext::COffscreenContext()
+{
+
+}
+
+COffscreenContext::~COffscreenContext()
+{
+	Destroy();
+}
+//========================================
+
+#if defined(SPRITE_TOOL_USE_OSMESA)
+
+//========================================
+bool COffscreenContext::Create()
+{
+	OSMesaContext _Context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL);
+	if (_Context == NULL)
+	{
+		fprintf(stderr, "OSMesa: failed to create context.\n");
+		return false;
+	}
+
+	m_pContext = _Context;
+
+	// Tiny dummy colour buffer, we render into FBOs
+	m_vectorOSMesaBuffer.resize(4 * 4 * 4);
+
+	return true;
+}
+
+void COffscreenContext::Destroy()
+{
+	if (m_pContext != nullptr)
+	{
+		OSMesaDestroyContext(static_cast<OSMesaContext>(m_pContext));
+		m_pContext = nullptr;
+	}
+	m_vectorOSMesaBuffer.clear();
+}
+
+bool COffscreenContext::MakeCurrent()
+{
+	return OSMesaMakeCurrent(static_cast<OSMesaContext>(m_pContext), m_vectorOSMesaBuffer.data(), GL_UNSIGNED_BYTE, 4, 4) == GL_TRUE;
+}
+
+void COffscreenContext::ReleaseCurrent()
+{
+	OSMesaMakeCurrent(NULL, NULL, GL_UNSIGNED_BYTE, 0, 0);
+}
+
+char const* COffscreenContext::GetBackendName()
+{
+	return "OSMesa";
+}
+//========================================
+
+#elif defined(_WIN32)
+
+//========================================
+bool COffscreenContext::Create()
+{
+	static char const* s_pClassName = "sprite_tool_offscreen";
+
+	WNDCLASSA _WindowClass = {};
+	_WindowClass.style = CS_OWNDC;
+	_WindowClass.lpfnWndProc = DefWindowProcA;
+	_WindowClass.hInstance = GetModuleHandleA(NULL);
+	_WindowClass.lpszClassName = s_pClassName;
+
+	// Fails harmlessly for every thread after the first
+	RegisterClassA(&_WindowClass);
+
+	// Never shown, only here so there's a DC to hang the context off
+	HWND _hWindow = CreateWindowA(s_pClassName, "", WS_OVERLAPPEDWINDOW, 0, 0, 16, 16, NULL, NULL, _WindowClass.hInstance, NULL);
+	if (_hWindow == NULL)
+	{
+		fprintf(stderr, "WGL: failed to create hidden window.\n");
+		return false;
+	}
+
+	HDC _hDC = GetDC(_hWindow);
+
+	PIXELFORMATDESCRIPTOR _PixelFormat = {};
+	_PixelFormat.nSize = sizeof(_PixelFormat);
+	_PixelFormat.nVersion = 1;
+	_PixelFormat.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL;
+	_PixelFormat.iPixelType = PFD_TYPE_RGBA;
+	_PixelFormat.cColorBits = 32;
+	_PixelFormat.cAlphaBits = 8;
+
+	int _iFormat = ChoosePixelFormat(_hDC, &_PixelFormat);
+	HGLRC _hContext = NULL;
+	if (_iFormat != 0 && SetPixelFormat(_hDC, _iFormat, &_PixelFormat) != FALSE)
+	{
+		// Compatibility context, drivers hand back their highest version anyway
+		_hContext = wglCreateContext(_hDC);
+	}
+
+	if (_hContext == NULL)
+	{
+		fprintf(stderr, "WGL: failed to create context.\n");
+		ReleaseDC(_hWindow, _hDC);
+		DestroyWindow(_hWindow);
+		return false;
+	}
+
+	m_pWindow = _hWindow;
+	m_pDisplay = _hDC;
+	m_pContext = _hContext;
+
+	return true;
+}
+
+void COffscreenContext::Destroy()
+{
+	if (m_pContext != nullptr)
+	{
+		wglDeleteContext(static_cast<HGLRC>(m_pContext));
+		m_pContext = nullptr;
+	}
+	if (m_pWindow != nullptr)
+	{
+		ReleaseDC(static_cast<HWND>(m_pWindow), static_cast<HDC>(m_pDisplay));
+		DestroyWindow(static_cast<HWND>(m_pWindow));
+		m_pWindow = nullptr;
+	}
+	m_pDisplay = nullptr;
+}
+
+bool COffscreenContext::MakeCurrent()
+{
+	return wglMakeCurrent(static_cast<HDC>(m_pDisplay), static_cast<HGLRC>(m_pContext)) != FALSE;
+}
+
+void COffscreenContext::ReleaseCurrent()
+{
+	wglMakeCurrent(NULL, NULL);
+}
+
+char const* COffscreenContext::GetBackendName()
+{
+	return "WGL";
+}
+//========================================
+
+#else
+
+//========================================
+bool COffscreenContext::Create()
+{
+	EGLDisplay _Display = EGL_NO_DISPLAY;
+
+	// Prefer the surfaceless platform, it needs neither X11 nor a DRM device
+	char const* _pClientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (_pClientExtensions != nullptr && strstr(_pClientExtensions, "EGL_MESA_platform_surfaceless") != nullptr)
+	{
+		auto _pGetPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (_pGetPlatformDisplay != nullptr)
+		{
+			_Display = _pGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+
+	if (_Display == EGL_NO_DISPLAY)
+	{
+		_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint _iMajor = 0, _iMinor = 0;
+	if (_Display == EGL_NO_DISPLAY || eglInitialize(_Display, &_iMajor, &_iMinor) == EGL_FALSE)
+	{
+		fprintf(stderr, "EGL: failed to initialise a display.\n");
+		return false;
+	}
+
+	if (eglBindAPI(EGL_OPENGL_API) == EGL_FALSE)
+	{
+		fprintf(stderr, "EGL: desktop OpenGL is not available.\n");
+		eglTerminate(_Display);
+		return false;
+	}
+
+	EGLint const _arrayConfigAttribs[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig _Config = nullptr;
+	EGLint _iNumConfigs = 0;
+	if (eglChooseConfig(_Display, _arrayConfigAttribs, &_Config, 1, &_iNumConfigs) == EGL_FALSE || _iNumConfigs == 0)
+	{
+		fprintf(stderr, "EGL: no suitable config.\n");
+		eglTerminate(_Display);
+		return false;
+	}
+
+	EGLint const _arrayContextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	EGLContext _Context = eglCreateContext(_Display, _Config, EGL_NO_CONTEXT, _arrayContextAttribs);
+	if (_Context == EGL_NO_CONTEXT)
+	{
+		fprintf(stderr, "EGL: failed to create a GL 3.3 context.\n");
+		eglTerminate(_Display);
+		return false;
+	}
+
+	m_pDisplay = _Display;
+	m_pContext = _Context;
+
+	return true;
+}
+
+void COffscreenContext::Destroy()
+{
+	if (m_pContext != nullptr)
+	{
+		eglDestroyContext(static_cast<EGLDisplay>(m_pDisplay), static_cast<EGLContext>(m_pContext));
+		m_pContext = nullptr;
+	}
+
+	// Displays are refcounted per process by EGL, terminating here would pull it
+	// out from under other threads' contexts
+	m_pDisplay = nullptr;
+}
+
+bool COffscreenContext::MakeCurrent()
+{
+	// Relies on EGL_KHR_surfaceless_context, all rendering goes to FBOs
+	return eglMakeCurrent(static_cast<EGLDisplay>(m_pDisplay), EGL_NO_SURFACE, EGL_NO_SURFACE, static_cast<EGLContext>(m_pContext)) == EGL_TRUE;
+}
+
+void COffscreenContext::ReleaseCurrent()
+{
+	eglMakeCurrent(static_cast<EGLDisplay>(m_pDisplay), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+char const* COffscreenContext::GetBackendName()
+{
+	return "EGL";
+}
+//========================================
+
+#endif
+
+//========================================
+bool COffscreenContext::InitGLEW()
+{
+	static std::once_flag s_Once;
+	static bool s_bResult = false;
+
+	std::call_once(s_Once, []()
+	{
+		// Core profile, extensions have to be queried the new way
+		glewExperimental = GL_TRUE;
+		GLenum _eError = glewInit();
+
+		// glewInit also tries to set up GLX which fails without an X display,
+		// the GL entry points are already loaded by then
+		s_bResult = (_eError == GLEW_OK || _eError == GLEW_ERROR_NO_GLX_DISPLAY);
+		if (s_bResult == false)
+		{
+			fprintf(stderr, "Error: %s\n", glewGetErrorString(_eError));
+		}
+
+		// glewInit can leave a GL_INVALID_ENUM behind on core contexts
+		glGetError();
+	});
+
+	return s_bResult;
+}
+//========================================
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//========================================
+// GL context with no visible window, for rendering on machines without a display.
+// Uses EGL (surfaceless platform where available), OSMesa when built with
+// SPRITE_TOOL_USE_OSMESA, or WGL on a hidden window on Windows. Rendering should
+// go to an FBO, there is no default framebuffer to speak of.
+class COffscreenContext
+{
+public:
+	COffscreenContext();
+	~COffscreenContext();
+
+	bool Create();
+	void Destroy();
+
+	bool MakeCurrent();
+	void ReleaseCurrent();
+
+	// Loads GL entry points, once per process, after the first MakeCurrent()
+	static bool InitGLEW();
+
+	static char const* GetBackendName();
+
+protected:
+	void* m_pDisplay = nullptr;		// EGLDisplay, or HDC for WGL
+	void* m_pContext = nullptr;
+	void* m_pWindow = nullptr;		// WGL only
+
+	// OSMesa always wants a colour buffer to be bound, even if we never use it
+	std::vector<uint8_t> m_vectorOSMesaBuffer;
+};
+//========================================
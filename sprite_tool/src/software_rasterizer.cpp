@@ -0,0 +1,622 @@
+#include "software_rasterizer.hpp"
+#include "software_rasterizer_kernels.hpp"
+
+#include "sprite_batch.hpp"
+
+#include "utility/cpu_features.hpp"
+
+#include "glm/glm.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+#include <emmintrin.h>
+#endif
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+	uint32_t const c_uTileSize = 64;
+
+	// Roughly where spawning threads stops paying for itself
+	uint32_t const c_uMinSpritesPerThread = 64;
+};
+
+//========================================
+namespace software_rasterizer
+{
+	void RasterSpanScalar(SSpan const& _Span)
+	{
+		float const _fTexMaxX = _Span.m_iTexWidth - 0.5f;
+		float const _fTexMaxY = _Span.m_iTexHeight - 0.5f;
+		int32_t const _iLastX = _Span.m_iTexWidth - 1;
+		int32_t const _iLastY = _Span.m_iTexHeight - 1;
+
+		for (uint32_t i = 0; i < _Span.m_uCount; ++i)
+		{
+			float const _fI = static_cast<float>(i);
+			float const _fS = _Span.m_fS + _fI * _Span.m_fDSDX;
+			float const _fT = _Span.m_fT + _fI * _Span.m_fDTDX;
+
+			if ((_fS >= 0.0f && _fS < 1.0f && _fT >= 0.0f && _fT < 1.0f) == false)
+			{
+				continue;
+			}
+
+			float _fTexX = _fS * _Span.m_fTexXScale + _Span.m_fTexX0;
+			float _fTexY = _fT * _Span.m_fTexYScale + _Span.m_fTexY0;
+			_fTexX = std::min(std::max(_fTexX, -0.5f), _fTexMaxX);
+			_fTexY = std::min(std::max(_fTexY, -0.5f), _fTexMaxY);
+
+			// floor() for values > -1, matches cvttps in the SIMD kernels
+			int32_t const _iX = static_cast<int32_t>(_fTexX + 1.0f) - 1;
+			int32_t const _iY = static_cast<int32_t>(_fTexY + 1.0f) - 1;
+			float const _fFracX = _fTexX - static_cast<float>(_iX);
+			float const _fFracY = _fTexY - static_cast<float>(_iY);
+
+			int32_t const _iX0 = std::min(std::max(_iX, 0), _iLastX);
+			int32_t const _iX1 = std::min(std::max(_iX + 1, 0), _iLastX);
+			int32_t const _iY0 = std::min(std::max(_iY, 0), _iLastY);
+			int32_t const _iY1 = std::min(std::max(_iY + 1, 0), _iLastY);
+
+			uint32_t const _u00 = _Span.m_pTexels[_iY0 * _Span.m_iTexWidth + _iX0];
+			uint32_t const _u10 = _Span.m_pTexels[_iY0 * _Span.m_iTexWidth + _iX1];
+			uint32_t const _u01 = _Span.m_pTexels[_iY1 * _Span.m_iTexWidth + _iX0];
+			uint32_t const _u11 = _Span.m_pTexels[_iY1 * _Span.m_iTexWidth + _iX1];
+
+			float _fColour[4];
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t const _uShift = c * 8;
+				float const _f00 = static_cast<float>((_u00 >> _uShift) & 0xFF);
+				float const _f10 = static_cast<float>((_u10 >> _uShift) & 0xFF);
+				float const _f01 = static_cast<float>((_u01 >> _uShift) & 0xFF);
+				float const _f11 = static_cast<float>((_u11 >> _uShift) & 0xFF);
+
+				float const _fTop = _f00 + (_f10 - _f00) * _fFracX;
+				float const _fBottom = _f01 + (_f11 - _f01) * _fFracX;
+				_fColour[c] = (_fTop + (_fBottom - _fTop) * _fFracY) * _Span.m_fTint[c];
+			}
+
+			// Source over, alpha = src + dst * (1 - src)
+			uint32_t const _uDest = _Span.m_pDest[i];
+			float const _fAlpha = _fColour[3] * (1.0f / 255.0f);
+			float const _fInvAlpha = 1.0f - _fAlpha;
+
+			uint32_t _uResult = 0;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t const _uShift = c * 8;
+				float const _fDest = static_cast<float>((_uDest >> _uShift) & 0xFF);
+				float const _fSource = (c == 3) ? _fColour[c] : _fColour[c] * _fAlpha;
+				float const _fOut = std::min(_fSource + _fDest * _fInvAlpha, 255.0f);
+				_uResult |= static_cast<uint32_t>(static_cast<int32_t>(_fOut + 0.5f)) << _uShift;
+			}
+			_Span.m_pDest[i] = _uResult;
+		}
+	}
+
+#if defined(SPRITE_TOOL_X86)
+	namespace
+	{
+		__m128 UnpackChannel(__m128i _Texels, int _iShift)
+		{
+			__m128i const _Mask = _mm_set1_epi32(0xFF);
+			switch (_iShift)
+			{
+				case 0: return _mm_cvtepi32_ps(_mm_and_si128(_Texels, _Mask));
+				case 8: return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(_Texels, 8), _Mask));
+				case 16: return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(_Texels, 16), _Mask));
+				default: return _mm_cvtepi32_ps(_mm_srli_epi32(_Texels, 24));
+			}
+		}
+
+		__m128i PackChannel(__m128 _Value)
+		{
+			_Value = _mm_min_ps(_Value, _mm_set1_ps(255.0f));
+			return _mm_cvttps_epi32(_mm_add_ps(_Value, _mm_set1_ps(0.5f)));
+		}
+	};
+
+	void RasterSpanSSE2(SSpan const& _Span)
+	{
+		__m128 const _Zero = _mm_setzero_ps();
+		__m128 const _One = _mm_set1_ps(1.0f);
+		__m128 const _MinTex = _mm_set1_ps(-0.5f);
+		__m128 const _MaxTexX = _mm_set1_ps(_Span.m_iTexWidth - 0.5f);
+		__m128 const _MaxTexY = _mm_set1_ps(_Span.m_iTexHeight - 0.5f);
+		__m128 const _LastX = _mm_set1_ps(static_cast<float>(_Span.m_iTexWidth - 1));
+		__m128 const _LastY = _mm_set1_ps(static_cast<float>(_Span.m_iTexHeight - 1));
+		__m128i const _OneI = _mm_set1_epi32(1);
+
+		__m128 const _Lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		__m128 const _Tint[4] =
+		{
+			_mm_set1_ps(_Span.m_fTint[0]), _mm_set1_ps(_Span.m_fTint[1]),
+			_mm_set1_ps(_Span.m_fTint[2]), _mm_set1_ps(_Span.m_fTint[3]),
+		};
+
+		for (uint32_t i = 0; i < _Span.m_uCount; i += 4)
+		{
+			uint32_t const _uCount = std::min(4u, _Span.m_uCount - i);
+
+			__m128 const _I = _mm_add_ps(_mm_set1_ps(static_cast<float>(i)), _Lane);
+			__m128 const _S = _mm_add_ps(_mm_set1_ps(_Span.m_fS), _mm_mul_ps(_I, _mm_set1_ps(_Span.m_fDSDX)));
+			__m128 const _T = _mm_add_ps(_mm_set1_ps(_Span.m_fT), _mm_mul_ps(_I, _mm_set1_ps(_Span.m_fDTDX)));
+
+			__m128 _Inside = _mm_and_ps(_mm_cmpge_ps(_S, _Zero), _mm_cmplt_ps(_S, _One));
+			_Inside = _mm_and_ps(_Inside, _mm_and_ps(_mm_cmpge_ps(_T, _Zero), _mm_cmplt_ps(_T, _One)));
+
+			// Mask off lanes past the end of the span
+			int _iMask = _mm_movemask_ps(_Inside) & ((1 << _uCount) - 1);
+			if (_iMask == 0)
+			{
+				continue;
+			}
+
+			__m128 _TexX = _mm_add_ps(_mm_mul_ps(_S, _mm_set1_ps(_Span.m_fTexXScale)), _mm_set1_ps(_Span.m_fTexX0));
+			__m128 _TexY = _mm_add_ps(_mm_mul_ps(_T, _mm_set1_ps(_Span.m_fTexYScale)), _mm_set1_ps(_Span.m_fTexY0));
+			_TexX = _mm_min_ps(_mm_max_ps(_TexX, _MinTex), _MaxTexX);
+			_TexY = _mm_min_ps(_mm_max_ps(_TexY, _MinTex), _MaxTexY);
+
+			__m128i const _IX = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_TexX, _One)), _OneI);
+			__m128i const _IY = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(_TexY, _One)), _OneI);
+			__m128 const _FX = _mm_cvtepi32_ps(_IX);
+			__m128 const _FY = _mm_cvtepi32_ps(_IY);
+			__m128 const _FracX = _mm_sub_ps(_TexX, _FX);
+			__m128 const _FracY = _mm_sub_ps(_TexY, _FY);
+
+			// No integer min/max before SSE4.1, the coords are small so clamp as floats
+			alignas(16) int32_t _arrayX0[4], _arrayX1[4], _arrayY0[4], _arrayY1[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(_arrayX0), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_FX, _Zero), _LastX)));
+			_mm_store_si128(reinterpret_cast<__m128i*>(_arrayX1), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_FX, _One), _Zero), _LastX)));
+			_mm_store_si128(reinterpret_cast<__m128i*>(_arrayY0), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_FY, _Zero), _LastY)));
+			_mm_store_si128(reinterpret_cast<__m128i*>(_arrayY1), _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_FY, _One), _Zero), _LastY)));
+
+			alignas(16) uint32_t _array00[4], _array10[4], _array01[4], _array11[4];
+			for (uint32_t l = 0; l < 4; ++l)
+			{
+				uint32_t const* _pRow0 = _Span.m_pTexels + _arrayY0[l] * _Span.m_iTexWidth;
+				uint32_t const* _pRow1 = _Span.m_pTexels + _arrayY1[l] * _Span.m_iTexWidth;
+				_array00[l] = _pRow0[_arrayX0[l]];
+				_array10[l] = _pRow0[_arrayX1[l]];
+				_array01[l] = _pRow1[_arrayX0[l]];
+				_array11[l] = _pRow1[_arrayX1[l]];
+			}
+
+			__m128i const _T00 = _mm_load_si128(reinterpret_cast<__m128i const*>(_array00));
+			__m128i const _T10 = _mm_load_si128(reinterpret_cast<__m128i const*>(_array10));
+			__m128i const _T01 = _mm_load_si128(reinterpret_cast<__m128i const*>(_array01));
+			__m128i const _T11 = _mm_load_si128(reinterpret_cast<__m128i const*>(_array11));
+
+			__m128 _Colour[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 const _F00 = UnpackChannel(_T00, c * 8);
+				__m128 const _F10 = UnpackChannel(_T10, c * 8);
+				__m128 const _F01 = UnpackChannel(_T01, c * 8);
+				__m128 const _F11 = UnpackChannel(_T11, c * 8);
+
+				__m128 const _Top = _mm_add_ps(_F00, _mm_mul_ps(_mm_sub_ps(_F10, _F00), _FracX));
+				__m128 const _Bottom = _mm_add_ps(_F01, _mm_mul_ps(_mm_sub_ps(_F11, _F01), _FracX));
+				_Colour[c] = _mm_mul_ps(_mm_add_ps(_Top, _mm_mul_ps(_mm_sub_ps(_Bottom, _Top), _FracY)), _Tint[c]);
+			}
+
+			// Partial spans go through a scratch copy so we never touch pixels past the end
+			alignas(16) uint32_t _arrayDest[4] = { 0, 0, 0, 0 };
+			memcpy(_arrayDest, _Span.m_pDest + i, _uCount * sizeof(uint32_t));
+			__m128i const _Dest = _mm_load_si128(reinterpret_cast<__m128i const*>(_arrayDest));
+
+			__m128 const _Alpha = _mm_mul_ps(_Colour[3], _mm_set1_ps(1.0f / 255.0f));
+			__m128 const _InvAlpha = _mm_sub_ps(_One, _Alpha);
+
+			__m128i _Result = _mm_setzero_si128();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 const _Source = (c == 3) ? _Colour[c] : _mm_mul_ps(_Colour[c], _Alpha);
+				__m128 const _Out = _mm_add_ps(_Source, _mm_mul_ps(UnpackChannel(_Dest, c * 8), _InvAlpha));
+				__m128i _Packed = PackChannel(_Out);
+				switch (c)
+				{
+					case 1: _Packed = _mm_slli_epi32(_Packed, 8); break;
+					case 2: _Packed = _mm_slli_epi32(_Packed, 16); break;
+					case 3: _Packed = _mm_slli_epi32(_Packed, 24); break;
+					default: break;
+				}
+				_Result = _mm_or_si128(_Result, _Packed);
+			}
+
+			__m128i const _Mask = _mm_castps_si128(_Inside);
+			_Result = _mm_or_si128(_mm_and_si128(_Mask, _Result), _mm_andnot_si128(_Mask, _Dest));
+
+			_mm_store_si128(reinterpret_cast<__m128i*>(_arrayDest), _Result);
+			memcpy(_Span.m_pDest + i, _arrayDest, _uCount * sizeof(uint32_t));
+		}
+	}
+#else
+	void RasterSpanSSE2(SSpan const& _Span)
+	{
+		RasterSpanScalar(_Span);
+	}
+#endif
+};
+//========================================
+
+//========================================
+CSoftwareRasterizer::CSoftwareRasterizer()
+{
+	m_eKernel = GetBestKernel();
+}
+
+CSoftwareRasterizer::~CSoftwareRasterizer()
+{
+
+}
+//========================================
+
+//========================================
+uint32_t CSoftwareRasterizer::CreateTexture(uint8_t const* _pData, uint32_t _uWidth, uint32_t _uHeight, uint32_t _uChannels)
+{
+	assert(_uChannels == 3 || _uChannels == 4);
+
+	// Reuse a free slot if there is one, ids are slot + 1 so 0 stays "no texture"
+	auto _itSlot = std::find_if(m_vectorTextures.begin(), m_vectorTextures.end(), [](STexture const& _Texture) { return _Texture.m_uWidth == 0; });
+	if (_itSlot == m_vectorTextures.end())
+	{
+		_itSlot = m_vectorTextures.insert(m_vectorTextures.end(), STexture());
+	}
+
+	STexture& _Texture = *_itSlot;
+	_Texture.m_uWidth = _uWidth;
+	_Texture.m_uHeight = _uHeight;
+	_Texture.m_vectorTexels.resize(static_cast<size_t>(_uWidth) * _uHeight);
+
+	uint32_t const _uTexture = static_cast<uint32_t>(_itSlot - m_vectorTextures.begin()) + 1;
+	if (_pData != nullptr)
+	{
+		UpdateTextureRows(_uTexture, 0, _uHeight, _pData, _uChannels);
+	}
+	return _uTexture;
+}
+
+void CSoftwareRasterizer::UpdateTextureRows(uint32_t _uTexture, uint32_t _uFirstRow, uint32_t _uRowCount, uint8_t const* _pData, uint32_t _uChannels)
+{
+	assert(_uChannels == 3 || _uChannels == 4);
+	assert(_uTexture != 0 && _uTexture <= m_vectorTextures.size());
+
+	STexture& _Texture = m_vectorTextures[_uTexture - 1];
+	assert(_uFirstRow + _uRowCount <= _Texture.m_uHeight);
+
+	size_t const _uTexelCount = static_cast<size_t>(_Texture.m_uWidth) * _uRowCount;
+	uint32_t* _pTexels = _Texture.m_vectorTexels.data() + static_cast<size_t>(_Texture.m_uWidth) * _uFirstRow;
+	for (size_t i = 0; i < _uTexelCount; ++i)
+	{
+		uint8_t const* _pTexel = _pData + i * _uChannels;
+		uint32_t const _uAlpha = (_uChannels == 4) ? _pTexel[3] : 0xFF;
+		_pTexels[i] = _pTexel[0] | (_pTexel[1] << 8) | (_pTexel[2] << 16) | (_uAlpha << 24);
+	}
+}
+
+void CSoftwareRasterizer::DeleteTexture(uint32_t _uTexture)
+{
+	if (_uTexture == 0 || _uTexture > m_vectorTextures.size())
+	{
+		return;
+	}
+
+	STexture& _Texture = m_vectorTextures[_uTexture - 1];
+	_Texture.m_vectorTexels = std::vector<uint32_t>();
+	_Texture.m_uWidth = 0;
+	_Texture.m_uHeight = 0;
+}
+
+void CSoftwareRasterizer::ClearTextures()
+{
+	m_vectorTextures.clear();
+}
+//========================================
+
+//========================================
+void CSoftwareRasterizer::Resize(uint32_t _uWidth, uint32_t _uHeight)
+{
+	m_uWidth = _uWidth;
+	m_uHeight = _uHeight;
+	m_vectorPixels.resize(static_cast<size_t>(_uWidth) * _uHeight * 4);
+
+	m_uTilesX = (_uWidth + c_uTileSize - 1) / c_uTileSize;
+	m_uTilesY = (_uHeight + c_uTileSize - 1) / c_uTileSize;
+	m_vectorTileBins.resize(m_uTilesX * m_uTilesY);
+}
+
+void CSoftwareRasterizer::Clear(uint32_t _uColour)
+{
+	uint32_t* _pPixels = reinterpret_cast<uint32_t*>(m_vectorPixels.data());
+	std::fill(_pPixels, _pPixels + static_cast<size_t>(m_uWidth) * m_uHeight, _uColour);
+}
+
+void CSoftwareRasterizer::SetKernel(Kernel _eKernel)
+{
+	m_eKernel = std::min(_eKernel, GetBestKernel());
+}
+
+CSoftwareRasterizer::Kernel CSoftwareRasterizer::GetBestKernel()
+{
+	if (cpu_features::HasAVX2())
+	{
+		return Kernel::AVX2;
+	}
+	if (cpu_features::HasSSE2())
+	{
+		return Kernel::SSE2;
+	}
+	return Kernel::Scalar;
+}
+
+char const* CSoftwareRasterizer::GetKernelName(Kernel _eKernel)
+{
+	switch (_eKernel)
+	{
+		case Kernel::AVX2: return "AVX2";
+		case Kernel::SSE2: return "SSE2";
+		default: return "scalar";
+	}
+}
+//========================================
+
+//========================================
+void CSoftwareRasterizer::Draw(CSpriteBatch const& _SpriteBatch)
+{
+	assert(_SpriteBatch.GetRenderPath() == CSpriteBatch::RenderPath::Vertices);
+
+	if (m_uWidth == 0 || m_uHeight == 0)
+	{
+		return;
+	}
+
+	SetupSprites(_SpriteBatch);
+	BinSprites();
+
+	uint32_t const _uTileCount = m_uTilesX * m_uTilesY;
+
+	uint32_t _uThreadCount = (m_uThreadCount != 0) ? m_uThreadCount : std::max(1u, std::thread::hardware_concurrency());
+	_uThreadCount = std::min(_uThreadCount, _uTileCount);
+	_uThreadCount = std::min(_uThreadCount, std::max(1u, static_cast<uint32_t>(m_vectorSetups.size()) / c_uMinSpritesPerThread));
+
+	// Tiles own disjoint pixels, so workers just pull the next tile until they run out
+	std::atomic<uint32_t> _NextTile(0);
+	auto _Worker = [&]()
+	{
+		for (uint32_t _uTile = _NextTile.fetch_add(1); _uTile < _uTileCount; _uTile = _NextTile.fetch_add(1))
+		{
+			RasterTile(_uTile);
+		}
+	};
+
+	std::vector<std::thread> _vectorThreads;
+	for (uint32_t i = 1; i < _uThreadCount; ++i)
+	{
+		_vectorThreads.emplace_back(_Worker);
+	}
+	_Worker();
+	for (auto& _Thread : _vectorThreads)
+	{
+		_Thread.join();
+	}
+}
+
+void CSoftwareRasterizer::SetupSprites(CSpriteBatch const& _SpriteBatch)
+{
+	m_vectorSetups.clear();
+
+	auto const& _vectorVertices = _SpriteBatch.GetVertices();
+	glm::mat4 const& _matViewProj = _SpriteBatch.GetViewProjection();
+
+	float const _fHalfWidth = m_uWidth * 0.5f;
+	float const _fHalfHeight = m_uHeight * 0.5f;
+
+	// Same mapping as glViewport(0, 0, w, h), y up
+	auto ToScreen = [&](CSpriteBatch::SVertex const& _Vertex) -> glm::vec2
+	{
+		glm::vec4 _vec4Clip = _matViewProj * glm::vec4(_Vertex.m_fX, _Vertex.m_fY, 0.0f, 1.0f);
+		return glm::vec2((_vec4Clip.x / _vec4Clip.w + 1.0f) * _fHalfWidth, (_vec4Clip.y / _vec4Clip.w + 1.0f) * _fHalfHeight);
+	};
+
+	for (auto const& _Run : _SpriteBatch.GetRuns())
+	{
+		if (_Run.m_uTexture == 0 || _Run.m_uTexture > m_vectorTextures.size())
+		{
+			continue;
+		}
+
+		STexture const& _Texture = m_vectorTextures[_Run.m_uTexture - 1];
+		if (_Texture.m_uWidth == 0)
+		{
+			continue;
+		}
+
+		for (uint32_t _uSprite = _Run.m_uFirstSprite; _uSprite < _Run.m_uFirstSprite + _Run.m_uSpriteCount; ++_uSprite)
+		{
+			// Corners are origin, +x axis, +x+y, +y axis (see CSpriteBatch::AddSprite)
+			CSpriteBatch::SVertex const* _pQuad = &_vectorVertices[_uSprite * 4];
+
+			glm::vec2 const _vec2Origin = ToScreen(_pQuad[0]);
+			glm::vec2 const _vec2AxisX = ToScreen(_pQuad[1]) - _vec2Origin;
+			glm::vec2 const _vec2AxisY = ToScreen(_pQuad[3]) - _vec2Origin;
+
+			float const _fDet = _vec2AxisX.x * _vec2AxisY.y - _vec2AxisX.y * _vec2AxisY.x;
+			if (std::fabs(_fDet) < 1e-6f)
+			{
+				continue;
+			}
+
+			glm::vec2 const _vec2Far = _vec2Origin + _vec2AxisX + _vec2AxisY;
+			float const _fMinX = std::min(std::min(_vec2Origin.x, _vec2Far.x), std::min(_vec2Origin.x + _vec2AxisX.x, _vec2Origin.x + _vec2AxisY.x));
+			float const _fMaxX = std::max(std::max(_vec2Origin.x, _vec2Far.x), std::max(_vec2Origin.x + _vec2AxisX.x, _vec2Origin.x + _vec2AxisY.x));
+			float const _fMinY = std::min(std::min(_vec2Origin.y, _vec2Far.y), std::min(_vec2Origin.y + _vec2AxisX.y, _vec2Origin.y + _vec2AxisY.y));
+			float const _fMaxY = std::max(std::max(_vec2Origin.y, _vec2Far.y), std::max(_vec2Origin.y + _vec2AxisX.y, _vec2Origin.y + _vec2AxisY.y));
+
+			SSpriteSetup _Setup;
+			_Setup.m_iMinX = std::max(0, static_cast<int32_t>(std::floor(_fMinX)));
+			_Setup.m_iMinY = std::max(0, static_cast<int32_t>(std::floor(_fMinY)));
+			_Setup.m_iMaxX = std::min(static_cast<int32_t>(m_uWidth), static_cast<int32_t>(std::ceil(_fMaxX)));
+			_Setup.m_iMaxY = std::min(static_cast<int32_t>(m_uHeight), static_cast<int32_t>(std::ceil(_fMaxY)));
+
+			if (_Setup.m_iMinX >= _Setup.m_iMaxX || _Setup.m_iMinY >= _Setup.m_iMaxY)
+			{
+				continue;
+			}
+
+			// Inverse of [AxisX AxisY], maps a screen offset from the origin back to the unit quad
+			_Setup.m_fOriginX = _vec2Origin.x;
+			_Setup.m_fOriginY = _vec2Origin.y;
+			_Setup.m_fDSDX = _vec2AxisY.y / _fDet;
+			_Setup.m_fDSDY = -_vec2AxisY.x / _fDet;
+			_Setup.m_fDTDX = -_vec2AxisX.y / _fDet;
+			_Setup.m_fDTDY = _vec2AxisX.x / _fDet;
+
+			// Texel centres are at +0.5, same as GL_LINEAR
+			float const _fU0 = _pQuad[0].m_fU, _fU1 = _pQuad[1].m_fU;
+			float const _fV0 = _pQuad[0].m_fV, _fV1 = _pQuad[3].m_fV;
+			_Setup.m_fTexX0 = _fU0 * _Texture.m_uWidth - 0.5f;
+			_Setup.m_fTexXScale = (_fU1 - _fU0) * _Texture.m_uWidth;
+			_Setup.m_fTexY0 = _fV0 * _Texture.m_uHeight - 0.5f;
+			_Setup.m_fTexYScale = (_fV1 - _fV0) * _Texture.m_uHeight;
+
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				_Setup.m_fTint[c] = ((_pQuad[0].m_uColour >> (c * 8)) & 0xFF) * (1.0f / 255.0f);
+			}
+
+			_Setup.m_pTexture = &_Texture;
+
+			m_vectorSetups.push_back(_Setup);
+		}
+	}
+}
+
+void CSoftwareRasterizer::BinSprites()
+{
+	for (auto& _vectorBin : m_vectorTileBins)
+	{
+		_vectorBin.clear();
+	}
+
+	// Setups are in draw order, so every bin ends up in painter's order too
+	for (uint32_t i = 0; i < m_vectorSetups.size(); ++i)
+	{
+		SSpriteSetup const& _Setup = m_vectorSetups[i];
+
+		uint32_t const _uTileMinX = _Setup.m_iMinX / c_uTileSize;
+		uint32_t const _uTileMaxX = (_Setup.m_iMaxX - 1) / c_uTileSize;
+		uint32_t const _uTileMinY = _Setup.m_iMinY / c_uTileSize;
+		uint32_t const _uTileMaxY = (_Setup.m_iMaxY - 1) / c_uTileSize;
+
+		for (uint32_t y = _uTileMinY; y <= _uTileMaxY; ++y)
+		{
+			for (uint32_t x = _uTileMinX; x <= _uTileMaxX; ++x)
+			{
+				m_vectorTileBins[y * m_uTilesX + x].push_back(i);
+			}
+		}
+	}
+}
+
+void CSoftwareRasterizer::RasterTile(uint32_t _uTile)
+{
+	std::vector<uint32_t> const& _vectorBin = m_vectorTileBins[_uTile];
+	if (_vectorBin.empty())
+	{
+		return;
+	}
+
+	software_rasterizer::tSpanKernel _pKernel = software_rasterizer::RasterSpanScalar;
+	switch (m_eKernel)
+	{
+		case Kernel::AVX2: _pKernel = software_rasterizer::RasterSpanAVX2; break;
+		case Kernel::SSE2: _pKernel = software_rasterizer::RasterSpanSSE2; break;
+		default: break;
+	}
+
+	int32_t const _iTileMinX = (_uTile % m_uTilesX) * c_uTileSize;
+	int32_t const _iTileMinY = (_uTile / m_uTilesX) * c_uTileSize;
+	int32_t const _iTileMaxX = std::min(_iTileMinX + static_cast<int32_t>(c_uTileSize), static_cast<int32_t>(m_uWidth));
+	int32_t const _iTileMaxY = std::min(_iTileMinY + static_cast<int32_t>(c_uTileSize), static_cast<int32_t>(m_uHeight));
+
+	uint32_t* _pPixels = reinterpret_cast<uint32_t*>(m_vectorPixels.data());
+
+	for (uint32_t _uSetup : _vectorBin)
+	{
+		SSpriteSetup const& _Setup = m_vectorSetups[_uSetup];
+
+		int32_t const _iMinX = std::max(_Setup.m_iMinX, _iTileMinX);
+		int32_t const _iMaxX = std::min(_Setup.m_iMaxX, _iTileMaxX);
+		int32_t const _iMinY = std::max(_Setup.m_iMinY, _iTileMinY);
+		int32_t const _iMaxY = std::min(_Setup.m_iMaxY, _iTileMaxY);
+
+		software_rasterizer::SSpan _Span;
+		_Span.m_fDSDX = _Setup.m_fDSDX;
+		_Span.m_fDTDX = _Setup.m_fDTDX;
+		_Span.m_fTexX0 = _Setup.m_fTexX0;
+		_Span.m_fTexXScale = _Setup.m_fTexXScale;
+		_Span.m_fTexY0 = _Setup.m_fTexY0;
+		_Span.m_fTexYScale = _Setup.m_fTexYScale;
+		memcpy(_Span.m_fTint, _Setup.m_fTint, sizeof(_Span.m_fTint));
+		_Span.m_pTexels = _Setup.m_pTexture->m_vectorTexels.data();
+		_Span.m_iTexWidth = static_cast<int32_t>(_Setup.m_pTexture->m_uWidth);
+		_Span.m_iTexHeight = static_cast<int32_t>(_Setup.m_pTexture->m_uHeight);
+
+		for (int32_t y = _iMinY; y < _iMaxY; ++y)
+		{
+			// Unit quad coords at the centre of pixel (0, y)
+			float const _fOffsetY = (y + 0.5f) - _Setup.m_fOriginY;
+			float const _fOffsetX = 0.5f - _Setup.m_fOriginX;
+			float const _fRowS = _fOffsetX * _Setup.m_fDSDX + _fOffsetY * _Setup.m_fDSDY;
+			float const _fRowT = _fOffsetX * _Setup.m_fDTDX + _fOffsetY * _Setup.m_fDTDY;
+
+			// Narrow the row to where 0 <= s,t < 1, padded by a pixel since the kernel
+			// does the exact per pixel test anyway
+			float _fSpanMin = static_cast<float>(_iMinX);
+			float _fSpanMax = static_cast<float>(_iMaxX);
+			bool _bEmpty = false;
+			float const _arrayStart[2] = { _fRowS, _fRowT };
+			float const _arrayStep[2] = { _Setup.m_fDSDX, _Setup.m_fDTDX };
+			for (uint32_t a = 0; a < 2; ++a)
+			{
+				if (std::fabs(_arrayStep[a]) < 1e-12f)
+				{
+					_bEmpty |= (_arrayStart[a] < 0.0f || _arrayStart[a] >= 1.0f);
+					continue;
+				}
+				float const _fX0 = -_arrayStart[a] / _arrayStep[a];
+				float const _fX1 = (1.0f - _arrayStart[a]) / _arrayStep[a];
+				_fSpanMin = std::max(_fSpanMin, std::min(_fX0, _fX1) - 1.0f);
+				_fSpanMax = std::min(_fSpanMax, std::max(_fX0, _fX1) + 1.0f);
+			}
+
+			if (_bEmpty || _fSpanMin >= _fSpanMax)
+			{
+				continue;
+			}
+
+			int32_t const _iStartX = std::max(_iMinX, static_cast<int32_t>(std::floor(_fSpanMin)));
+			int32_t const _iEndX = std::min(_iMaxX, static_cast<int32_t>(std::ceil(_fSpanMax)));
+			if (_iStartX >= _iEndX)
+			{
+				continue;
+			}
+
+			_Span.m_pDest = _pPixels + static_cast<size_t>(y) * m_uWidth + _iStartX;
+			_Span.m_uCount = static_cast<uint32_t>(_iEndX - _iStartX);
+			_Span.m_fS = _fRowS + _iStartX * _Setup.m_fDSDX;
+			_Span.m_fT = _fRowT + _iStartX * _Setup.m_fDTDX;
+
+			_pKernel(_Span);
+		}
+	}
+}
+//========================================
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class CSpriteBatch;
+
+//========================================
+// CPU render backend, draws the quads a CSpriteBatch collected (vertex path) into
+// an RGBA8 framebuffer without touching GL.
+//
+// The framebuffer is split into tiles, sprites are binned per tile in painter's
+// order and tiles are rasterised in parallel. Span kernels (bilinear sample,
+// tint, source-over blend) come in scalar, SSE2 and AVX2 flavours which all
+// produce bit identical output, so renders are deterministic across machines.
+class CSoftwareRasterizer
+{
+public:
+	enum class Kernel
+	{
+		Scalar = 0,
+		SSE2 = 1,
+		AVX2 = 2,
+	};
+
+	struct STexture
+	{
+		std::vector<uint32_t> m_vectorTexels;	// RGBA8, straight alpha
+		uint32_t m_uWidth = 0;
+		uint32_t m_uHeight = 0;
+	};
+
+	CSoftwareRasterizer();
+	~CSoftwareRasterizer();
+
+	// Accepts 3 or 4 channel images, returns a non zero id to hand to CSpriteBatch::AddSprite()
+	// _pData can be null and the rows filled in afterwards with UpdateTextureRows()
+	uint32_t CreateTexture(uint8_t const* _pData, uint32_t _uWidth, uint32_t _uHeight, uint32_t _uChannels);
+	void UpdateTextureRows(uint32_t _uTexture, uint32_t _uFirstRow, uint32_t _uRowCount, uint8_t const* _pData, uint32_t _uChannels);
+	void DeleteTexture(uint32_t _uTexture);
+	void ClearTextures();
+
+	void Resize(uint32_t _uWidth, uint32_t _uHeight);
+	void Clear(uint32_t _uColour);
+
+	// Batch must have been filled with RenderPath::Vertices
+	void Draw(CSpriteBatch const& _SpriteBatch);
+
+	// Falls back to the best supported kernel
+	void SetKernel(Kernel _eKernel);
+	Kernel GetKernel() const { return m_eKernel; }
+	static Kernel GetBestKernel();
+	static char const* GetKernelName(Kernel _eKernel);
+
+	// 0 = one per core
+	void SetThreadCount(uint32_t _uThreadCount) { m_uThreadCount = _uThreadCount; }
+
+	// Rows are bottom up, same as glReadPixels
+	std::vector<uint8_t> const& GetPixels() const { return m_vectorPixels; }
+	uint32_t GetWidth() const { return m_uWidth; }
+	uint32_t GetHeight() const { return m_uHeight; }
+
+protected:
+	// Screen space parallelogram and everything the span kernels need
+	struct SSpriteSetup
+	{
+		float m_fOriginX, m_fOriginY;
+		float m_fDSDX, m_fDSDY, m_fDTDX, m_fDTDY;	// screen -> unit quad
+		float m_fTexX0, m_fTexXScale;				// unit quad -> texel
+		float m_fTexY0, m_fTexYScale;
+		float m_fTint[4];
+		int32_t m_iMinX, m_iMinY, m_iMaxX, m_iMaxY;	// inclusive/exclusive, clamped to the framebuffer
+		STexture const* m_pTexture;
+	};
+
+	void SetupSprites(CSpriteBatch const& _SpriteBatch);
+	void BinSprites();
+	void RasterTile(uint32_t _uTile);
+
+	Kernel m_eKernel = Kernel::Scalar;
+	uint32_t m_uThreadCount = 0;
+
+	std::vector<STexture> m_vectorTextures;
+
+	uint32_t m_uWidth = 0;
+	uint32_t m_uHeight = 0;
+	std::vector<uint8_t> m_vectorPixels;
+
+	uint32_t m_uTilesX = 0;
+	uint32_t m_uTilesY = 0;
+	std::vector<SSpriteSetup> m_vectorSetups;
+	std::vector<std::vector<uint32_t>> m_vectorTileBins;
+};
+//========================================
@@ -0,0 +1,146 @@
+// software_rasterizer_avx2.cpp : AVX2 span kernel, only called when cpu_features::HasAVX2().
+//  Built with /arch:AVX2 (see the vcxproj), GCC/Clang get the target pragma below.
+
+#include "software_rasterizer_kernels.hpp"
+
+#include "utility/cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+//========================================
+namespace software_rasterizer
+{
+	namespace
+	{
+		__m256 UnpackChannel(__m256i _Texels, int _iShift)
+		{
+			__m256i const _Mask = _mm256_set1_epi32(0xFF);
+			return _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srlv_epi32(_Texels, _mm256_set1_epi32(_iShift)), _Mask));
+		}
+
+		__m256i PackChannel(__m256 _Value, int _iShift)
+		{
+			_Value = _mm256_min_ps(_Value, _mm256_set1_ps(255.0f));
+			__m256i const _Packed = _mm256_cvttps_epi32(_mm256_add_ps(_Value, _mm256_set1_ps(0.5f)));
+			return _mm256_sllv_epi32(_Packed, _mm256_set1_epi32(_iShift));
+		}
+	};
+
+	void RasterSpanAVX2(SSpan const& _Span)
+	{
+		__m256 const _Zero = _mm256_setzero_ps();
+		__m256 const _One = _mm256_set1_ps(1.0f);
+		__m256 const _MinTex = _mm256_set1_ps(-0.5f);
+		__m256 const _MaxTexX = _mm256_set1_ps(_Span.m_iTexWidth - 0.5f);
+		__m256 const _MaxTexY = _mm256_set1_ps(_Span.m_iTexHeight - 0.5f);
+		__m256i const _ZeroI = _mm256_setzero_si256();
+		__m256i const _OneI = _mm256_set1_epi32(1);
+		__m256i const _LastX = _mm256_set1_epi32(_Span.m_iTexWidth - 1);
+		__m256i const _LastY = _mm256_set1_epi32(_Span.m_iTexHeight - 1);
+		__m256i const _Stride = _mm256_set1_epi32(_Span.m_iTexWidth);
+		int const* _pTexels = reinterpret_cast<int const*>(_Span.m_pTexels);
+
+		__m256 const _Lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		__m256 const _Tint[4] =
+		{
+			_mm256_set1_ps(_Span.m_fTint[0]), _mm256_set1_ps(_Span.m_fTint[1]),
+			_mm256_set1_ps(_Span.m_fTint[2]), _mm256_set1_ps(_Span.m_fTint[3]),
+		};
+
+		for (uint32_t i = 0; i < _Span.m_uCount; i += 8)
+		{
+			uint32_t const _uCount = std::min(8u, _Span.m_uCount - i);
+
+			__m256 const _I = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), _Lane);
+			__m256 const _S = _mm256_add_ps(_mm256_set1_ps(_Span.m_fS), _mm256_mul_ps(_I, _mm256_set1_ps(_Span.m_fDSDX)));
+			__m256 const _T = _mm256_add_ps(_mm256_set1_ps(_Span.m_fT), _mm256_mul_ps(_I, _mm256_set1_ps(_Span.m_fDTDX)));
+
+			__m256 _Inside = _mm256_and_ps(_mm256_cmp_ps(_S, _Zero, _CMP_GE_OQ), _mm256_cmp_ps(_S, _One, _CMP_LT_OQ));
+			_Inside = _mm256_and_ps(_Inside, _mm256_and_ps(_mm256_cmp_ps(_T, _Zero, _CMP_GE_OQ), _mm256_cmp_ps(_T, _One, _CMP_LT_OQ)));
+
+			int _iMask = _mm256_movemask_ps(_Inside) & ((1 << _uCount) - 1);
+			if (_iMask == 0)
+			{
+				continue;
+			}
+
+			__m256 _TexX = _mm256_add_ps(_mm256_mul_ps(_S, _mm256_set1_ps(_Span.m_fTexXScale)), _mm256_set1_ps(_Span.m_fTexX0));
+			__m256 _TexY = _mm256_add_ps(_mm256_mul_ps(_T, _mm256_set1_ps(_Span.m_fTexYScale)), _mm256_set1_ps(_Span.m_fTexY0));
+			_TexX = _mm256_min_ps(_mm256_max_ps(_TexX, _MinTex), _MaxTexX);
+			_TexY = _mm256_min_ps(_mm256_max_ps(_TexY, _MinTex), _MaxTexY);
+
+			__m256i const _IX = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(_TexX, _One)), _OneI);
+			__m256i const _IY = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(_TexY, _One)), _OneI);
+			__m256 const _FracX = _mm256_sub_ps(_TexX, _mm256_cvtepi32_ps(_IX));
+			__m256 const _FracY = _mm256_sub_ps(_TexY, _mm256_cvtepi32_ps(_IY));
+
+			__m256i const _X0 = _mm256_min_epi32(_mm256_max_epi32(_IX, _ZeroI), _LastX);
+			__m256i const _X1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(_IX, _OneI), _ZeroI), _LastX);
+			__m256i const _Row0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_IY, _ZeroI), _LastY), _Stride);
+			__m256i const _Row1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(_IY, _OneI), _ZeroI), _LastY), _Stride);
+
+			__m256i const _T00 = _mm256_i32gather_epi32(_pTexels, _mm256_add_epi32(_Row0, _X0), 4);
+			__m256i const _T10 = _mm256_i32gather_epi32(_pTexels, _mm256_add_epi32(_Row0, _X1), 4);
+			__m256i const _T01 = _mm256_i32gather_epi32(_pTexels, _mm256_add_epi32(_Row1, _X0), 4);
+			__m256i const _T11 = _mm256_i32gather_epi32(_pTexels, _mm256_add_epi32(_Row1, _X1), 4);
+
+			__m256 _Colour[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				__m256 const _F00 = UnpackChannel(_T00, c * 8);
+				__m256 const _F10 = UnpackChannel(_T10, c * 8);
+				__m256 const _F01 = UnpackChannel(_T01, c * 8);
+				__m256 const _F11 = UnpackChannel(_T11, c * 8);
+
+				// Separate mul/add rather than FMA, to stay bit identical with the other kernels
+				__m256 const _Top = _mm256_add_ps(_F00, _mm256_mul_ps(_mm256_sub_ps(_F10, _F00), _FracX));
+				__m256 const _Bottom = _mm256_add_ps(_F01, _mm256_mul_ps(_mm256_sub_ps(_F11, _F01), _FracX));
+				_Colour[c] = _mm256_mul_ps(_mm256_add_ps(_Top, _mm256_mul_ps(_mm256_sub_ps(_Bottom, _Top), _FracY)), _Tint[c]);
+			}
+
+			alignas(32) uint32_t _arrayDest[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+			memcpy(_arrayDest, _Span.m_pDest + i, _uCount * sizeof(uint32_t));
+			__m256i const _Dest = _mm256_load_si256(reinterpret_cast<__m256i const*>(_arrayDest));
+
+			__m256 const _Alpha = _mm256_mul_ps(_Colour[3], _mm256_set1_ps(1.0f / 255.0f));
+			__m256 const _InvAlpha = _mm256_sub_ps(_One, _Alpha);
+
+			__m256i _Result = _mm256_setzero_si256();
+			for (int c = 0; c < 4; ++c)
+			{
+				__m256 const _Source = (c == 3) ? _Colour[c] : _mm256_mul_ps(_Colour[c], _Alpha);
+				__m256 const _Out = _mm256_add_ps(_Source, _mm256_mul_ps(UnpackChannel(_Dest, c * 8), _InvAlpha));
+				_Result = _mm256_or_si256(_Result, PackChannel(_Out, c * 8));
+			}
+
+			_Result = _mm256_blendv_epi8(_Dest, _Result, _mm256_castps_si256(_Inside));
+
+			_mm256_store_si256(reinterpret_cast<__m256i*>(_arrayDest), _Result);
+			memcpy(_Span.m_pDest + i, _arrayDest, _uCount * sizeof(uint32_t));
+		}
+	}
+};
+//========================================
+
+#else
+
+//========================================
+namespace software_rasterizer
+{
+	void RasterSpanAVX2(SSpan const& _Span)
+	{
+		RasterSpanScalar(_Span);
+	}
+};
+//========================================
+
+#endif
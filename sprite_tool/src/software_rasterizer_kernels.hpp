@@ -0,0 +1,38 @@
+#pragma once
+
+// Internal to the software rasterizer, shared between its translation units so the
+// AVX2 kernel can live in a file built with AVX2 enabled.
+
+#include <cstdint>
+
+//========================================
+namespace software_rasterizer
+{
+	// One row of pixels of one sprite. Pixel i is at unit quad coords
+	// (m_fS + i * m_fDSDX, m_fT + i * m_fDTDX), anything outside [0,1) is left alone.
+	struct SSpan
+	{
+		uint32_t* m_pDest;
+		uint32_t m_uCount;
+
+		float m_fS, m_fT;
+		float m_fDSDX, m_fDTDX;
+
+		float m_fTexX0, m_fTexXScale;
+		float m_fTexY0, m_fTexYScale;
+
+		float m_fTint[4];
+
+		uint32_t const* m_pTexels;
+		int32_t m_iTexWidth;
+		int32_t m_iTexHeight;
+	};
+
+	typedef void (*tSpanKernel)(SSpan const& _Span);
+
+	// Every kernel does the same float operations in the same order, keep it that way
+	void RasterSpanScalar(SSpan const& _Span);
+	void RasterSpanSSE2(SSpan const& _Span);
+	void RasterSpanAVX2(SSpan const& _Span);
+};
+//========================================
@@ -0,0 +1,428 @@
+#include "sprite_batch.hpp"
+
+#include "gl_render_helper.hpp"
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+static const char* s_ShaderVert =
+R"(
+    #version 330 core
+
+    uniform mat4 MVP;
+
+    in vec4 vCol;
+    in vec3 vPos;
+    in vec2 uv;
+
+    out vec4 color;
+    out vec2 uv_out;
+
+    void main()
+    {
+        gl_Position = MVP * vec4(vPos, 1.0);
+        color = vCol;
+        uv_out = uv;
+    }
+)";
+
+static const char* s_ShaderFrag =
+R"(
+    #version 330 core
+
+    uniform sampler2D image;
+
+    in vec4 color;
+    in vec2 uv_out;
+
+    out vec4 frag_colour;
+
+    void main()
+    {
+        frag_colour = color * texture(image, uv_out);
+    }
+)";
+
+static const char* s_ShaderVertInstanced =
+R"(
+    #version 330 core
+
+    uniform mat4 MVP;
+
+    in vec2 vCorner;
+
+    in vec2 iAxisX;
+    in vec2 iAxisY;
+    in vec2 iOrigin;
+    in vec4 iUVRect;
+    in vec4 iCol;
+
+    out vec4 color;
+    out vec2 uv_out;
+
+    void main()
+    {
+        vec2 pos = iOrigin + iAxisX * vCorner.x + iAxisY * vCorner.y;
+        gl_Position = MVP * vec4(pos, 0.0, 1.0);
+        color = iCol;
+        uv_out = mix(iUVRect.xy, iUVRect.zw, vCorner);
+    }
+)";
+
+static const char* s_ShaderFragInstanced =
+R"(
+    #version 330 core
+
+    uniform sampler2D image;
+
+    in vec4 color;
+    in vec2 uv_out;
+
+    out vec4 frag_colour;
+
+    void main()
+    {
+        frag_colour = color * texture(image, uv_out);
+    }
+)";
+
+namespace
+{
+	uint16_t NormalisedToUnorm16(float _fValue)
+	{
+		_fValue = std::min(std::max(_fValue, 0.0f), 1.0f);
+		return static_cast<uint16_t>(_fValue * 65535.0f + 0.5f);
+	}
+};
+
+//========================================
+CSpriteBatch::CSpriteBatch()
+{
+
+}
+
+CSpriteBatch::~CSpriteBatch()
+{
+	// Shutdown() must have been called while the context was still alive
+	assert(m_uVertexArray == 0);
+}
+//========================================
+
+//========================================
+void CSpriteBatch::Init()
+{
+	//---------- vertex path
+	m_uVertexProgram = gl_render_helper::CreateShaderProgram(s_ShaderVert, s_ShaderFrag);
+	m_iVertexMVPLocation = glGetUniformLocation(m_uVertexProgram, "MVP");
+
+	glGenVertexArrays(1, &m_uVertexArray);
+	glGenBuffers(1, &m_uVertexBuffer);
+	glGenBuffers(1, &m_uIndexBuffer);
+
+	glBindVertexArray(m_uVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, m_uVertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_uIndexBuffer);
+
+	// Attribute locations are looked up once, the layout lives in the VAO
+	GLint _iPosLocation = glGetAttribLocation(m_uVertexProgram, "vPos");
+	GLint _iColLocation = glGetAttribLocation(m_uVertexProgram, "vCol");
+	GLint _iUVLocation = glGetAttribLocation(m_uVertexProgram, "uv");
+
+	glEnableVertexAttribArray(_iPosLocation);
+	glVertexAttribPointer(_iPosLocation, 2, GL_FLOAT, GL_FALSE, sizeof(SVertex), (void*)offsetof(SVertex, m_fX));
+
+	glEnableVertexAttribArray(_iColLocation);
+	glVertexAttribPointer(_iColLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SVertex), (void*)offsetof(SVertex, m_uColour));
+
+	glEnableVertexAttribArray(_iUVLocation);
+	glVertexAttribPointer(_iUVLocation, 2, GL_FLOAT, GL_FALSE, sizeof(SVertex), (void*)offsetof(SVertex, m_fU));
+
+	glBindVertexArray(0);
+
+	//---------- instanced path
+	if (GLEW_VERSION_3_3)
+	{
+		m_uInstancedProgram = gl_render_helper::CreateShaderProgram(s_ShaderVertInstanced, s_ShaderFragInstanced);
+		m_iInstancedMVPLocation = glGetUniformLocation(m_uInstancedProgram, "MVP");
+
+		glGenVertexArrays(1, &m_uInstancedVertexArray);
+		glGenBuffers(1, &m_uUnitQuadBuffer);
+		glGenBuffers(1, &m_uInstanceBuffer);
+
+		glBindVertexArray(m_uInstancedVertexArray);
+
+		// Triangle strip order
+		float const _arrayUnitQuad[8] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+		glBindBuffer(GL_ARRAY_BUFFER, m_uUnitQuadBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(_arrayUnitQuad), _arrayUnitQuad, GL_STATIC_DRAW);
+
+		GLint _iCornerLocation = glGetAttribLocation(m_uInstancedProgram, "vCorner");
+		glEnableVertexAttribArray(_iCornerLocation);
+		glVertexAttribPointer(_iCornerLocation, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+		// Instance attribute pointers are set per run in DrawInstances()
+		char const* _arrayNames[5] = { "iAxisX", "iAxisY", "iOrigin", "iUVRect", "iCol" };
+		for (uint32_t i = 0; i < 5; ++i)
+		{
+			m_iInstanceAttribLocations[i] = glGetAttribLocation(m_uInstancedProgram, _arrayNames[i]);
+			glEnableVertexAttribArray(m_iInstanceAttribLocations[i]);
+			glVertexAttribDivisor(m_iInstanceAttribLocations[i], 1);
+		}
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	ReserveGPUSprites(1024);
+}
+
+void CSpriteBatch::Shutdown()
+{
+	glDeleteBuffers(1, &m_uVertexBuffer);
+	glDeleteBuffers(1, &m_uIndexBuffer);
+	glDeleteVertexArrays(1, &m_uVertexArray);
+	glDeleteProgram(m_uVertexProgram);
+
+	m_uVertexBuffer = 0;
+	m_uIndexBuffer = 0;
+	m_uVertexArray = 0;
+	m_uVertexProgram = 0;
+
+	if (m_uInstancedProgram != 0)
+	{
+		glDeleteBuffers(1, &m_uUnitQuadBuffer);
+		glDeleteBuffers(1, &m_uInstanceBuffer);
+		glDeleteVertexArrays(1, &m_uInstancedVertexArray);
+		glDeleteProgram(m_uInstancedProgram);
+
+		m_uUnitQuadBuffer = 0;
+		m_uInstanceBuffer = 0;
+		m_uInstancedVertexArray = 0;
+		m_uInstancedProgram = 0;
+	}
+
+	m_uGPUSpriteCapacity = 0;
+}
+
+void CSpriteBatch::SetRenderPath(RenderPath _ePath)
+{
+	if (_ePath == RenderPath::Instanced && IsInstancingSupported() == false)
+	{
+		_ePath = RenderPath::Vertices;
+	}
+	m_ePath = _ePath;
+}
+
+void CSpriteBatch::ReserveGPUSprites(uint32_t _uSpriteCount)
+{
+	if (_uSpriteCount <= m_uGPUSpriteCapacity)
+	{
+		return;
+	}
+
+	// Grow in powers of two so a busy scene settles quickly
+	uint32_t _uCapacity = std::max(m_uGPUSpriteCapacity, 1024u);
+	while (_uCapacity < _uSpriteCount)
+	{
+		_uCapacity *= 2;
+	}
+
+	// Quad indices never change, so they're only written when we grow
+	std::vector<uint32_t> _vectorIndices(_uCapacity * 6);
+	for (uint32_t i = 0; i < _uCapacity; ++i)
+	{
+		uint32_t const _uBase = i * 4;
+		_vectorIndices[i * 6 + 0] = _uBase + 0;
+		_vectorIndices[i * 6 + 1] = _uBase + 1;
+		_vectorIndices[i * 6 + 2] = _uBase + 2;
+		_vectorIndices[i * 6 + 3] = _uBase + 2;
+		_vectorIndices[i * 6 + 4] = _uBase + 3;
+		_vectorIndices[i * 6 + 5] = _uBase + 0;
+	}
+
+	glBindVertexArray(m_uVertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_uIndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, _vectorIndices.size() * sizeof(uint32_t), _vectorIndices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_uVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, _uCapacity * 4 * sizeof(SVertex), nullptr, GL_STREAM_DRAW);
+
+	if (m_uInstanceBuffer != 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_uInstanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, _uCapacity * sizeof(SInstance), nullptr, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_uGPUSpriteCapacity = _uCapacity;
+}
+//========================================
+
+//========================================
+void CSpriteBatch::Begin(glm::mat4 const& _matViewProj)
+{
+	m_matViewProj = _matViewProj;
+
+	m_vectorVertices.clear();
+	m_vectorInstances.clear();
+	m_vectorRuns.clear();
+	m_uSpriteCount = 0;
+}
+
+void CSpriteBatch::AddSprite(glm::mat4 const& _matModelView,
+							 CSpriteSheet::SSpriteCell const& _SpriteCell,
+							 CCompoundSprite::SActorState const& _ActorState,
+							 uint32_t _uTexture)
+{
+	AddSprite(_matModelView,
+			  _SpriteCell,
+			  gl_render_helper::CalculateLocalRect(_SpriteCell, _ActorState.m_uAlignmentX, _ActorState.m_uAlignmentY),
+			  _ActorState,
+			  _uTexture);
+}
+
+void CSpriteBatch::AddSprite(glm::mat4 const& _matModelView,
+							 CSpriteSheet::SSpriteCell const& _SpriteCell,
+							 gl_render_helper::SLocalRect const& _LocalRect,
+							 CCompoundSprite::SActorState const& _ActorState,
+							 uint32_t _uTexture)
+{
+	gl_render_helper::SSpriteTransform _Transform;
+	if (gl_render_helper::CalculateSpriteTransform(_matModelView, _SpriteCell, _LocalRect, _ActorState, _Transform) == false)
+	{
+		return;
+	}
+
+	if (m_ePath == RenderPath::Instanced)
+	{
+		SInstance _Instance;
+		_Instance.m_fAxisX[0] = _Transform.m_vec2AxisX.x;
+		_Instance.m_fAxisX[1] = _Transform.m_vec2AxisX.y;
+		_Instance.m_fAxisY[0] = _Transform.m_vec2AxisY.x;
+		_Instance.m_fAxisY[1] = _Transform.m_vec2AxisY.y;
+		_Instance.m_fOrigin[0] = _Transform.m_vec2Origin.x;
+		_Instance.m_fOrigin[1] = _Transform.m_vec2Origin.y;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			_Instance.m_uUVRect[i] = NormalisedToUnorm16(_Transform.m_vec4UVRect[i]);
+		}
+		_Instance.m_uColour = _Transform.m_uColour;
+		m_vectorInstances.push_back(_Instance);
+	}
+	else
+	{
+		glm::vec2 const _arrayCorners[4] =
+		{
+			_Transform.m_vec2Origin,
+			_Transform.m_vec2Origin + _Transform.m_vec2AxisX,
+			_Transform.m_vec2Origin + _Transform.m_vec2AxisX + _Transform.m_vec2AxisY,
+			_Transform.m_vec2Origin + _Transform.m_vec2AxisY,
+		};
+		glm::vec4 const& _vec4UV = _Transform.m_vec4UVRect;
+		float const _arrayU[4] = { _vec4UV.x, _vec4UV.z, _vec4UV.z, _vec4UV.x };
+		float const _arrayV[4] = { _vec4UV.y, _vec4UV.y, _vec4UV.w, _vec4UV.w };
+
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			SVertex _Vertex;
+			_Vertex.m_fX = _arrayCorners[i].x;
+			_Vertex.m_fY = _arrayCorners[i].y;
+			_Vertex.m_uColour = _Transform.m_uColour;
+			_Vertex.m_fU = _arrayU[i];
+			_Vertex.m_fV = _arrayV[i];
+			m_vectorVertices.push_back(_Vertex);
+		}
+	}
+
+	// Extend the current run if the texture hasn't changed, otherwise start a new one
+	if (m_vectorRuns.empty() || m_vectorRuns.back().m_uTexture != _uTexture)
+	{
+		SRun _Run;
+		_Run.m_uTexture = _uTexture;
+		_Run.m_uFirstSprite = m_uSpriteCount;
+		m_vectorRuns.push_back(_Run);
+	}
+	m_vectorRuns.back().m_uSpriteCount++;
+
+	m_uSpriteCount++;
+}
+
+void CSpriteBatch::End()
+{
+	if (m_vectorRuns.empty())
+	{
+		return;
+	}
+
+	ReserveGPUSprites(m_uSpriteCount);
+
+	glActiveTexture(GL_TEXTURE0);
+
+	if (m_ePath == RenderPath::Instanced)
+	{
+		DrawInstances();
+	}
+	else
+	{
+		DrawVertices();
+	}
+
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void CSpriteBatch::DrawVertices()
+{
+	// Orphan the old storage so we never stall on a buffer the GPU is still reading
+	glBindBuffer(GL_ARRAY_BUFFER, m_uVertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_uGPUSpriteCapacity * 4 * sizeof(SVertex), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_vectorVertices.size() * sizeof(SVertex), m_vectorVertices.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glUseProgram(m_uVertexProgram);
+	glUniformMatrix4fv(m_iVertexMVPLocation, 1, GL_FALSE, &m_matViewProj[0].x);
+	glBindVertexArray(m_uVertexArray);
+
+	for (auto const& _Run : m_vectorRuns)
+	{
+		glBindTexture(GL_TEXTURE_2D, _Run.m_uTexture);
+		glDrawElements(GL_TRIANGLES,
+					   _Run.m_uSpriteCount * 6,
+					   GL_UNSIGNED_INT,
+					   (void*)(static_cast<size_t>(_Run.m_uFirstSprite) * 6 * sizeof(uint32_t)));
+	}
+}
+
+void CSpriteBatch::DrawInstances()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_uInstanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, m_uGPUSpriteCapacity * sizeof(SInstance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_vectorInstances.size() * sizeof(SInstance), m_vectorInstances.data());
+
+	glUseProgram(m_uInstancedProgram);
+	glUniformMatrix4fv(m_iInstancedMVPLocation, 1, GL_FALSE, &m_matViewProj[0].x);
+	glBindVertexArray(m_uInstancedVertexArray);
+
+	for (auto const& _Run : m_vectorRuns)
+	{
+		// No base instance before GL 4.2, so point the instance attributes at the run instead
+		size_t const _uBase = static_cast<size_t>(_Run.m_uFirstSprite) * sizeof(SInstance);
+		glVertexAttribPointer(m_iInstanceAttribLocations[0], 2, GL_FLOAT, GL_FALSE, sizeof(SInstance), (void*)(_uBase + offsetof(SInstance, m_fAxisX)));
+		glVertexAttribPointer(m_iInstanceAttribLocations[1], 2, GL_FLOAT, GL_FALSE, sizeof(SInstance), (void*)(_uBase + offsetof(SInstance, m_fAxisY)));
+		glVertexAttribPointer(m_iInstanceAttribLocations[2], 2, GL_FLOAT, GL_FALSE, sizeof(SInstance), (void*)(_uBase + offsetof(SInstance, m_fOrigin)));
+		glVertexAttribPointer(m_iInstanceAttribLocations[3], 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SInstance), (void*)(_uBase + offsetof(SInstance, m_uUVRect)));
+		glVertexAttribPointer(m_iInstanceAttribLocations[4], 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SInstance), (void*)(_uBase + offsetof(SInstance, m_uColour)));
+
+		glBindTexture(GL_TEXTURE_2D, _Run.m_uTexture);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, _Run.m_uSpriteCount);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+//========================================
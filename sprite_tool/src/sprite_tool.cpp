@@ -6,6 +6,7 @@
 
 #include "version.hpp"
 
+#include "utility/asset_pack.hpp"
 #include "utility/file_helper.hpp"
 #include "utility/stl_helper.hpp"
 
@@ -28,50 +29,14 @@
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp" // glm::translate, glm::rotate, glm::scale, glm::perspective
 
-#include "gl_render_helper.hpp"
+#include "sprite_batch.hpp"
+#include "texture_uploader.hpp"
 
 // stl
 #include <iostream>
 #include <string>
 #include <functional>
-
-static const char* s_ShaderVert = 
-R"(
-    #version 330 core
-
-    uniform mat4 MVP;
-
-    attribute vec4 vCol;
-    attribute vec3 vPos;
-    attribute vec2 uv;
-
-    varying vec4 color;
-    varying vec2 uv_out;
-
-    void main()
-    {
-        gl_Position = MVP * vec4(vPos, 1.0);
-        color = vCol;
-        uv_out = uv;
-    };
-)";
-
-static const char* s_ShaderFrag =
-R"(
-    #version 330 core
-
-    uniform sampler2D image;
-
-    varying vec4 color;
-    varying vec2 uv_out;
-
-    void main()
-    {
-        gl_FragColor = color * texture(image, uv_out);
-    };
-)";
-
-
+#include <cmath>
 
 void error_callback(int error, const char* description)
 {
@@ -130,149 +95,6 @@ void SetupViewportFramebuffer(uint32_t& _uFBO, uint32_t & _uTexture, uint32_t &
     //========================================
 }
 
-void GetTexturesFromCompound(tSharedCompoundSprite &_pCompound, std::vector<std::string> & _vectorTextures)
-{
-    auto _mapTextureSprites = _pCompound->GetTextureSprites();
-    for (auto _item : _mapTextureSprites)
-    {
-        _vectorTextures.push_back(_item.first);
-    }
-}
-
-bool CSpriteTool::OpenJSONFile(std::string const& _sPath)
-{
-    std::string _sAbsPath = FileHelper::GetAbsolutePath(_sPath);
-
-    // Parse the compounds
-    CCompoundSprite::ParseJSONFileRecursive(_sAbsPath, m_mapCompounds);
-
-    // Failed to load any compounds?
-    if (m_mapCompounds.size() == 0)
-    {
-        fprintf(stdout, "Failed to load an compounds?.\n");
-        return false;
-    }
-
-    std::string _sTextureParentFolder = FileHelper::PickFolderDialog(_sPath);
-    if (_sTextureParentFolder.empty())
-    {
-        fprintf(stdout, "No texture folder supplied.\n");
-        return false;
-    }
-
-    // Get required textures from compounds
-    //========================================
-    std::vector<std::string> _vectorTexturesToLoad;
-    for (auto& _Item : m_mapCompounds)
-    {
-        GetTexturesFromCompound(_Item.second, _vectorTexturesToLoad);
-    }
-    //========================================
-
-    // Load required spritesheets
-    //========================================
-    LoadSpriteSheets(_sTextureParentFolder, _vectorTexturesToLoad, m_mapSpriteSheets);
-    //========================================
-
-    // Load textures into opengl
-    //========================================
-    LoadTextures(_sTextureParentFolder, _vectorTexturesToLoad, m_mapTextureNameId);
-    //========================================
-
-    return true;
-}
-
-std::vector<SActorInstance> CSpriteTool::BuildActorInstances(std::shared_ptr<CCompoundSprite>& _pCompound)
-{
-    std::vector<SActorInstance> _vectorInstances;
-
-    auto const& _vectorActors = _pCompound->GetActors();
-    for (auto const& _Actor : _vectorActors)
-    {
-        _vectorInstances.emplace_back();
-        SActorInstance &_ActorInstance = _vectorInstances.back();
-        _ActorInstance.m_pCompound = _pCompound;
-        _ActorInstance.m_uActorId = _Actor.m_uID;
-
-        switch (static_cast<CCompoundSprite::SActor::Type>(_Actor.m_uType))
-        {
-            // Do nothing, already have what we need above
-            case CCompoundSprite::SActor::Type::Sprite:
-            {
-                break;
-            }
-
-            //Recurse!
-            case CCompoundSprite::SActor::Type::Compound:
-            {
-                auto _itSubCompound = m_mapCompounds.find(_Actor.m_sSubCompoundPath);
-
-                if (_itSubCompound != m_mapCompounds.end())
-                {
-                    _ActorInstance.m_vectorActors = BuildActorInstances(_itSubCompound->second);
-                }
-                break;
-            }
-        }
-    }
-
-    return _vectorInstances;
-}
-
-void CSpriteTool::LoadSpriteSheets(std::string const& _sParentFolder, std::vector<std::string> const& _vectorTextures, std::map<std::string, CSpriteSheet>& _mapSpriteSheets)
-{
-    for (auto& _sTexture : _vectorTextures)
-    {
-        std::string _sXmlPath = stl_helper::Format("%s/%s.xml", _sParentFolder.c_str(), _sTexture.c_str());
-        std::string _sSpriteSheetXml = FileHelper::GetFileContentsString(_sXmlPath);
-
-        assert(_sSpriteSheetXml.empty() == false);
-
-        CSpriteSheet _SpriteSheet;
-        _SpriteSheet.ParseXML(_sSpriteSheetXml);
-        _SpriteSheet.SetTextureRes(CSpriteSheet::TextureRes::High);
-        _mapSpriteSheets[_sTexture] = _SpriteSheet;
-    }
-}
-
-void CSpriteTool::LoadTextures(std::string const& _sParentFolder, std::vector<std::string> const& _vectorTextures, std::map<std::string, uint32_t>& _mapTextureNameId)
-{
-    for (auto& _sTexture : _vectorTextures)
-    {
-        uint32_t& _uTextureId = _mapTextureNameId[_sTexture];
-
-        // Already loaded, skip
-        if (_uTextureId != 0)
-        {
-            continue;
-        }
-
-        fprintf(stdout, "Attempting to load texture '%s\\%s'.\n", _sParentFolder.c_str(), _sTexture.c_str());
-
-        std::string _sTexturePath = stl_helper::Format("%s/%s", _sParentFolder.c_str(), _sTexture.c_str());
-
-        int width = 0, height = 0;
-        auto _ImageData = FileHelper::LoadImageFromFile(_sTexturePath.c_str(), width, height);
-
-        if (_ImageData.m_pData != nullptr && _ImageData.m_pData->size() > 0)
-        {
-            uint32_t _eChannels = (_ImageData.m_uChannels == 4) ? GL_RGBA : GL_RGB;
-
-            glGenTextures(1, &_uTextureId);
-            glBindTexture(GL_TEXTURE_2D, _uTextureId);
-            glTexImage2D(GL_TEXTURE_2D, 0, _eChannels, width, height, 0, _eChannels, GL_UNSIGNED_BYTE, _ImageData.m_pData->data());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-        else
-        {
-            // fail
-            assert(false);
-        }
-    }
-}
-
 int CSpriteTool::Run()
 {
     //---------- Setup GLFW
@@ -330,47 +152,18 @@ int CSpriteTool::Run()
         fprintf(stderr, "Error: %s\n", glewGetErrorString(err));
         exit(EXIT_FAILURE);
     }
+    DetectTextureCompression();
     //========================================
 
     // NOTE: OpenGL error checks have been omitted for brevity
     //========================================
-    GLuint vertex_shader, fragment_shader, program;
-    GLint mvp_location;
-
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &s_ShaderVert, nullptr);
-    glCompileShader(vertex_shader);
-
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &s_ShaderFrag, nullptr);
-    glCompileShader(fragment_shader);
-
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-
-    GLint _iProgramLinked;
-    glGetProgramiv(program, GL_LINK_STATUS, &_iProgramLinked);
-    if (_iProgramLinked != GL_TRUE)
-    {
-        GLsizei _iIgnored;
-        size_t const c_uLogSize = 4096;
-        char _LogVertex[c_uLogSize];
-        char _LogFragment[c_uLogSize];
-        char _LogProgram[c_uLogSize];
-
-        glGetShaderInfoLog(vertex_shader, c_uLogSize, &_iIgnored, _LogVertex);
-        glGetShaderInfoLog(fragment_shader, c_uLogSize, &_iIgnored, _LogFragment);
-        glGetProgramInfoLog(program, c_uLogSize, &_iIgnored, _LogProgram);
 
-        std::string _sMessage = stl_helper::Format("%s\n%s\n%s", _LogVertex, _LogFragment, _LogProgram);
+    CSpriteBatch _SpriteBatch;
+    _SpriteBatch.Init();
 
-        assert(false && _sMessage.c_str());
-    }
-
-
-    mvp_location = glGetUniformLocation(program, "MVP");
+    CTextureUploader _TextureUploader;
+    _TextureUploader.Init();
+    m_pTextureUploader = &_TextureUploader;
     //========================================
 
 
@@ -480,43 +273,27 @@ int CSpriteTool::Run()
         //========================================
         if (m_sOpenFile.empty() == false)
         {
-            // Delete everything so we have a clean slate for next compound
+            std::string _sTextureParentFolder = FileHelper::PickFolderDialog(m_sOpenFile);
+            if (_sTextureParentFolder.empty())
             {
-                m_vectorActorInstances.clear();
-                m_mapCompounds.clear();
-                m_mapSpriteSheets.clear();
-                for (auto& item : m_mapTextureNameId)
-                {
-                    glDeleteTextures(1, &item.second);
-                }
-                m_mapTextureNameId.clear();
+                fprintf(stdout, "No texture folder supplied.\n");
             }
-
-            // Load new compound
-            bool _bRetVal = OpenJSONFile(m_sOpenFile);
-
-            // If success, build actors for rendering
-            if (_bRetVal == true)
+            else
             {
-                auto _itCompound = m_mapCompounds.find(FileHelper::GetAbsolutePath(m_sOpenFile));
-                if (_itCompound == m_mapCompounds.end())
-                {
-                    fprintf(stdout, "%s", "Couldn't find compound to build actor instances.");
-                }
-                else
-                {
-                    auto _pRootCompound = _itCompound->second;
-                    m_vectorActorInstances = BuildActorInstances(_pRootCompound);
-                }
+                // Loads in the background, the current scene keeps drawing until the new one is ready
+                StartCompoundLoad(m_sOpenFile, _sTextureParentFolder);
             }
 
             m_sOpenFile = "";
         }
-        //========================================
 
+        // Start switching sheets to the resolution this zoom wants, the uploads happen below
+        UpdateTextureResidency(ViewportData.m_uHeight);
+
+        // Swap in the new scene / upload finished textures, a few ms a frame at most
+        UpdateCompoundLoad(0.008);
+        //========================================
 
-        std::string _sIndent;
-        std::string _sTempHierarchy;
 
         // Draw our scene to the FBO
         //========================================
@@ -529,23 +306,13 @@ int CSpriteTool::Run()
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             glEnable(GL_BLEND);
 
-            float _fRatio = ViewportData.m_uWidth / (float)ViewportData.m_uHeight;
-
             m_fViewPortScale += static_cast<float>(m_dMouseScrollY) * 0.01f;
             m_fViewPortScale = std::fmaxf(m_fViewPortScale, 0.01f);
 
-            float _fScale = m_fViewPortScale * 0.01f;
-
-            glm::mat4 m, p, mvp;
-            m = glm::mat4(1.0f);
-            m = glm::scale(m, glm::vec3(_fScale, _fScale, _fScale));
-            m = glm::scale(m, glm::vec3(1, -1, 1));
-            p = glm::ortho(-_fRatio, _fRatio, -1.f, 1.f, 1.f, -1.f);
-            mvp = p * m;
-
-            glUseProgram(program);
-            glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*)&(mvp.operator[](0).x));
+            glm::mat4 mvp = CalculateViewProjection(ViewportData.m_uWidth, ViewportData.m_uHeight, m_fViewPortScale);
 
+            _SpriteBatch.SetRenderPath(m_bInstancedRendering ? CSpriteBatch::RenderPath::Instanced : CSpriteBatch::RenderPath::Vertices);
+            _SpriteBatch.Begin(mvp);
 
             if (m_vectorActorInstances.size() > 0)
             {
@@ -554,80 +321,10 @@ int CSpriteTool::Run()
                     m_fTime += float(_dDeltaTime) * m_fAnimationSpeedMult;
                 }
 
-                // create matrix stack
-                std::vector<glm::mat4> _vectorMatrixStack;
-                // push initial identity matrix
-                _vectorMatrixStack.push_back(glm::mat4(1.0f));
-                //_vectorMatrixStack.back() = glm::scale(_vectorMatrixStack.back(), glm::vec3(2, 2, 2));
-
-                //========================================
-                std::function<void(std::vector<SActorInstance> const &)> DrawActors;
-                DrawActors = [&](std::vector<SActorInstance> const & _vectorActorInstances)->void
-                {
-                    // Draw the actors
-                    for (auto const& _ActorInstance : _vectorActorInstances)
-                    {
-                        if (_ActorInstance.m_bShow == false)
-                        {
-                            continue;
-                        }
-
-                        auto _pCompound = _ActorInstance.m_pCompound;
-                        auto _pActor = _pCompound->GetActorById(_ActorInstance.m_uActorId);
-
-                        if (_pActor == nullptr)
-                        {
-                            assert(false);
-                            continue;
-                        }
-
-                        float _fTime = fmodf(m_fTime, _pCompound->GetStageLength());
-                        CCompoundSprite::SActorState _ActorState = _pCompound->GetStateForActorAtTime(_pActor->m_uID, _fTime);
-
-                        _sTempHierarchy += _sIndent + _pActor->m_sSprite + "\n";
-
-                        if (_ActorInstance.m_vectorActors.size() == 0)
-                        {
-                            std::string _sTexture = _pCompound->GetTextureForSprite(_pActor->m_sSprite);
-                            m_mapTextureNameId[_sTexture];
-
-                            CSpriteSheet const& _SpriteSheet = m_mapSpriteSheets[_sTexture];
-                            auto const& _mapSprites = _SpriteSheet.GetSpriteData();
-                            auto _itSprite = _mapSprites.find(_pActor->m_sSprite);
-                            if (_itSprite != _mapSprites.end())
-                            {
-                                CSpriteSheet::SSpriteCell const& _Cell = _itSprite->second;
-
-                                gl_render_helper::DrawSprite(_vectorMatrixStack.back(),
-                                                             _Cell,
-                                                             _ActorState,
-                                                             program,
-                                                             m_mapTextureNameId[_sTexture]);
-                            }
-                        }
-                        else
-                        {
-                            // copy current matrix, modify for this actor and push onto our stack
-                            glm::mat4 _matSub = _vectorMatrixStack.back();
-                            _matSub = glm::translate(_matSub, glm::vec3(_ActorState.m_fPosX, _ActorState.m_fPosY, 0.0f));
-                            _matSub = glm::scale(_matSub, glm::vec3(_ActorState.m_fScaleX, _ActorState.m_fScaleY, 0.0f));
-                            _vectorMatrixStack.push_back(_matSub);
-
-                            _sIndent += "\t";
-
-                            DrawActors(_ActorInstance.m_vectorActors);
-
-                            _sIndent = _sIndent.substr(0, _sIndent.size() - 1);
-
-                            _vectorMatrixStack.pop_back();
-                        }
-                    }
-                };
-                //========================================
-
-                DrawActors(m_vectorActorInstances);
-                
+                DrawActorInstances(_SpriteBatch, m_fTime);
             }
+
+            _SpriteBatch.End();
         }
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         //========================================
@@ -710,6 +407,66 @@ int CSpriteTool::Run()
                         {
                             m_sOpenFile = FileHelper::OpenFileDialog("json");
                         }
+                        if (ImGui::MenuItem("Mount Asset Pack..."))
+                        {
+                            std::string const _sPackPath = FileHelper::OpenFileDialog("stpack");
+                            if (_sPackPath.empty() == false && CAssetPack::Mount(_sPackPath) == false)
+                            {
+                                fprintf(stderr, "Couldn't mount asset pack %s\n", _sPackPath.c_str());
+                            }
+                        }
+                        if (ImGui::MenuItem("Unmount Asset Packs", nullptr, false, CAssetPack::HasMounts()))
+                        {
+                            CAssetPack::UnmountAll();
+                        }
+                        ImGui::Separator();
+                        bool _bPreviewTextures = (m_eTextureRes == CSpriteSheet::TextureRes::Low);
+                        if (ImGui::MenuItem("Preview Resolution Textures", nullptr, &_bPreviewTextures))
+                        {
+                            // Taken up by the next open, what's loaded now stays as it is
+                            m_eTextureRes = _bPreviewTextures ? CSpriteSheet::TextureRes::Low : CSpriteSheet::TextureRes::High;
+                        }
+                        // Switches what's open as the view zooms, starting from the resolution above
+                        ImGui::MenuItem("Match Texture Resolution to Zoom", nullptr, &m_bAutoTextureRes);
+                        // Also from the next open. Greyed out if the driver can't sample any of the formats.
+                        bool const _bCanCompress = m_TextureCompression.m_bS3TC || m_TextureCompression.m_bBPTC;
+                        ImGui::MenuItem("Compress Textures", nullptr, &m_TextureCompression.m_bEnabled, _bCanCompress);
+                        if (ImGui::BeginMenu("Compression Quality", _bCanCompress && m_TextureCompression.m_bEnabled))
+                        {
+                            static char const* const c_arrayQualityNames[] = { "Fast", "Normal", "High" };
+                            for (uint32_t i = 0; i < 3; ++i)
+                            {
+                                block_compression::Quality const _eQuality = static_cast<block_compression::Quality>(i);
+                                if (ImGui::MenuItem(c_arrayQualityNames[i], nullptr, m_TextureCompression.m_eQuality == _eQuality))
+                                {
+                                    m_TextureCompression.m_eQuality = _eQuality;
+                                }
+                            }
+                            ImGui::EndMenu();
+                        }
+                        ImGui::EndMenu();
+                    }
+
+                    if (ImGui::BeginMenu("Cache"))
+                    {
+                        CAssetCache::SStats const _Stats = m_AssetCache.GetStats();
+                        CAssetCache::SBudget _Budget = m_AssetCache.GetBudget();
+
+                        ImGui::Text("Textures: %u (%u in use), %.1f MB", _Stats.m_uTextureCount, _Stats.m_uTexturesPinned, _Stats.m_uTextureBytes / (1024.0 * 1024.0));
+                        ImGui::Text("Sprite sheets: %u, %.1f MB", _Stats.m_uSheetCount, _Stats.m_uSheetBytes / (1024.0 * 1024.0));
+                        ImGui::Text("Hits: %u, Misses: %u", _Stats.m_uHits, _Stats.m_uMisses);
+
+                        int _iTextureMB = static_cast<int>(_Budget.m_uTextureBytes / (1024 * 1024));
+                        int _iSheetMB = static_cast<int>(_Budget.m_uSheetBytes / (1024 * 1024));
+                        bool _bChanged = ImGui::SliderInt("Texture budget (MB)", &_iTextureMB, 0, 4096);
+                        _bChanged |= ImGui::SliderInt("Sprite sheet budget (MB)", &_iSheetMB, 0, 256);
+                        if (_bChanged)
+                        {
+                            _Budget.m_uTextureBytes = static_cast<uint64_t>(_iTextureMB) * 1024 * 1024;
+                            _Budget.m_uSheetBytes = static_cast<uint64_t>(_iSheetMB) * 1024 * 1024;
+                            m_AssetCache.SetBudget(_Budget);
+                            m_AssetCache.Trim([this](uint32_t _uTexture) { DeleteTexture(_uTexture); });
+                        }
                         ImGui::EndMenu();
                     }
 
@@ -742,6 +499,59 @@ int CSpriteTool::Run()
                     ImGui::Checkbox("Animate", &m_bAnimate);
                     ImGui::SameLine();
                     ImGui::SliderFloat("Animation Speed", &m_fAnimationSpeedMult, 0.0f, 10.0f);
+                    ImGui::SameLine();
+                    if (_SpriteBatch.IsInstancingSupported())
+                    {
+                        ImGui::Checkbox("Instanced", &m_bInstancedRendering);
+                        ImGui::SameLine();
+                    }
+                    ImGui::Text("Sprites: %u, Draw calls: %u", _SpriteBatch.GetSpriteCount(), _SpriteBatch.GetDrawCallCount());
+
+                    if (m_pCompoundLoader)
+                    {
+                        CCompoundLoader::SProgress const _Progress = m_pCompoundLoader->GetProgress();
+
+                        std::string _sStage;
+                        float _fProgress = 0.0f;
+                        switch (_Progress.m_eStage)
+                        {
+                            case CCompoundLoader::Stage::ParsingCompounds:
+                            {
+                                _sStage = "Parsing compounds";
+                                break;
+                            }
+                            case CCompoundLoader::Stage::LoadingSheets:
+                            case CCompoundLoader::Stage::DecodingTextures:
+                            {
+                                _sStage = stl_helper::Format("%u compounds, sheets %u/%u, textures %u/%u",
+                                                             _Progress.m_uCompoundCount,
+                                                             _Progress.m_uSheetsLoaded, _Progress.m_uTextureCount,
+                                                             _Progress.m_uTexturesDecoded, _Progress.m_uTextureCount);
+                                if (_Progress.m_uSheetsFailed > 0)
+                                {
+                                    _sStage += stl_helper::Format(" (%u sheets failed)", _Progress.m_uSheetsFailed);
+                                }
+                                if (_Progress.m_uTextureCount > 0)
+                                {
+                                    _fProgress = (_Progress.m_uSheetsLoaded + _Progress.m_uTexturesDecoded) / (2.0f * _Progress.m_uTextureCount);
+                                }
+                                break;
+                            }
+                            default:
+                            {
+                                _sStage = "Finishing";
+                                _fProgress = 1.0f;
+                                break;
+                            }
+                        }
+
+                        ImGui::ProgressBar(_fProgress, ImVec2(300.0f, 0.0f), _sStage.c_str());
+                        ImGui::SameLine();
+                        if (ImGui::Button("Cancel"))
+                        {
+                            CancelCompoundLoad();
+                        }
+                    }
 
                     ImTextureID id = (ImTextureID)uint64_t(ViewportData.m_uTexture);
                     vec2ViewportWindowSize = ImGui::GetContentRegionAvail();
@@ -752,63 +562,34 @@ int CSpriteTool::Run()
                 // Animation timeline
                 if (ImGui::Begin("timeline", nullptr))
                 {
-                    //========================================
-                    std::function<void(std::vector<SActorInstance> &)> DrawActorTimelines;
-                    DrawActorTimelines = [&](std::vector<SActorInstance> & _vectorActorInstances)->void
-                    {
-                        // Draw the actors
-                        for (auto & _ActorInstance : _vectorActorInstances)
-                        {
-                            ImGui::PushID(_ActorInstance.m_uActorId);
-
-                            auto _pCompound = _ActorInstance.m_pCompound;
-                            auto _pActor = _pCompound->GetActorById(_ActorInstance.m_uActorId);
-
-                            if (_pActor != nullptr)
-                            {
-
-                                float _fTime = fmodf(m_fTime, _pCompound->GetStageLength());
-                                CCompoundSprite::SActorState _ActorState = _pCompound->GetStateForActorAtTime(_pActor->m_uID, _fTime);
-
-                                if (_ActorInstance.m_vectorActors.size() == 0)
-                                {
-                                    //std::string _sTexture = _pCompound->GetTextureForSprite(_pActor->m_sSprite);
-                                    //m_mapTextureNameId[_sTexture];
-
-                                    //CSpriteSheet const& _SpriteSheet = mapSpriteSheets[_sTexture];
-                                    //auto const& _mapSprites = _SpriteSheet.GetSpriteData();
-                                    //auto _itSprite = _mapSprites.find(_pActor->m_sSprite);
-                                    //if (_itSprite != _mapSprites.end())
-                                    //{
-                                    //    CSpriteSheet::SSpriteCell const& _Cell = _itSprite->second;
-
+                    ImGui::Text("ROOT");
 
-                                    //    gl_render_helper::DrawSprite(_vectorMatrixStack.back(),
-                                    //                                 _Cell,
-                                    //                                 _ActorState,
-                                    //                                 program,
-                                    //                                 m_mapTextureNameId[_sTexture]);
+                    // Instances are in pre-order, so indenting to each one's depth lays out the tree
+                    uint32_t _uIndent = 0;
+                    for (uint32_t i = 0; i < m_vectorActorInstances.size(); ++i)
+                    {
+                        SActorInstance& _ActorInstance = m_vectorActorInstances[i];
 
-                                    //}
+                        for (; _uIndent < _ActorInstance.m_uDepth; ++_uIndent)
+                        {
+                            ImGui::Indent();
+                        }
+                        for (; _uIndent > _ActorInstance.m_uDepth; --_uIndent)
+                        {
+                            ImGui::Unindent();
+                        }
 
-                                    ImGui::Checkbox(_pActor->m_sSprite.c_str(), &_ActorInstance.m_bShow);
-                                }
-                                else
-                                {
-                                    ImGui::Checkbox(_pActor->m_sSprite.c_str(), &_ActorInstance.m_bShow);
-                                    ImGui::Indent();
-                                    DrawActorTimelines(_ActorInstance.m_vectorActors);
-                                    ImGui::Unindent();
-                                }
-                            }
+                        ImGui::PushID(static_cast<int>(i));
 
-                            ImGui::PopID();
-                        }
-                    };
-                    //========================================
+                        auto const& _Actor = _ActorInstance.m_pCompound->GetActors()[_ActorInstance.m_uActorIndex];
+                        ImGui::Checkbox(_Actor.m_sSprite.c_str(), &_ActorInstance.m_bShow);
 
-                    ImGui::Text("ROOT");
-                    DrawActorTimelines(m_vectorActorInstances);
+                        ImGui::PopID();
+                    }
+                    for (; _uIndent > 0; --_uIndent)
+                    {
+                        ImGui::Unindent();
+                    }
                 }
                 ImGui::End();
 
@@ -866,6 +647,14 @@ int CSpriteTool::Run()
         glfwSwapBuffers(window);
     }
 
+    m_pCompoundLoader.reset();
+    ClearScene();
+    ClearAssetCache();
+
+    m_pTextureUploader = nullptr;
+    _TextureUploader.Shutdown();
+    _SpriteBatch.Shutdown();
+
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -3,20 +3,53 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <future>
 
 #include "spritesheet.hpp"
+#include "gl_render_helper.hpp"
+#include "compound_loader.hpp"
+#include "asset_cache.hpp"
+
+#include "glm/glm.hpp"
 
 // forward delcaration
 class CCompoundSprite;
+class CSpriteBatch;
+class CSoftwareRasterizer;
+class CTextureUploader;
 
+// One node of the flattened actor tree. CSpriteTool::m_vectorActorInstances holds every
+// instance in pre-order, so a parent always comes before its children and a whole subtree
+// is the contiguous range [i, i + m_uSubtreeSize).
 struct SActorInstance
 {
+	static uint32_t const c_uNoParent = 0xFFFFFFFF;
+
 	bool m_bShow = true;
 
-	std::shared_ptr<CCompoundSprite> m_pCompound;
+	CCompoundSprite* m_pCompound = nullptr;	// owned by CSpriteTool::m_mapCompounds
 	uint32_t m_uActorId = 0;
+	uint32_t m_uActorIndex = 0;		// into m_pCompound->GetActors()
+
+	uint32_t m_uParent = c_uNoParent;	// index of the parent instance
+	uint32_t m_uSubtreeSize = 1;		// this instance and all of its descendants
+	uint32_t m_uDepth = 0;
 
-	std::vector<SActorInstance> m_vectorActors;
+	bool IsLeaf() const { return m_uSubtreeSize == 1; }
+
+	// Leaf sprites only, resolved once in BuildActorInstances so drawing does no string lookups.
+	// m_pSpriteCell points into m_mapSpriteSheets and is null if the sprite couldn't be found.
+	struct SRenderRecord
+	{
+		uint32_t m_uTexture = 0;
+		CSpriteSheet::SSpriteCell const* m_pSpriteCell = nullptr;
+
+		// Local quad for this alignment, redone if a keyframe changes it
+		uint32_t m_uAlignmentX = 0;
+		uint32_t m_uAlignmentY = 0;
+		gl_render_helper::SLocalRect m_LocalRect;
+	};
+	SRenderRecord m_Render;
 };
 
 //========================================
@@ -33,19 +66,100 @@ public:
 
 protected:
 
-	bool OpenJSONFile(std::string const &_sPath);
-
-	std::vector<SActorInstance> BuildActorInstances(std::shared_ptr<CCompoundSprite> & _pRootCompound);
-
-	void LoadSpriteSheets(std::string const &_sParentFolder, std::vector<std::string> const& _vectorTextures, std::map<std::string, CSpriteSheet> &_mapSpriteSheets);
-	void LoadTextures(std::string const& _sParentFolder, std::vector<std::string> const &_vectorTextures, std::map<std::string, uint32_t> &_mapTextureNameId);
+	// Opens in the background, see CCompoundLoader. UpdateCompoundLoad() has to be called every
+	// frame on the context thread to swap the scene in and upload textures as they're decoded.
+	void StartCompoundLoad(std::string const& _sPath, std::string const& _sTextureParentFolder);
+	void CancelCompoundLoad();
+	void UpdateCompoundLoad(double const _dUploadBudgetSeconds);
+
+	bool LoadCompounds(std::string const& _sPath);
+	void LoadCompoundAssets(std::string const& _sTextureParentFolder);
+	bool BuildRootActorInstances(std::string const& _sPath);
+	// Releases the scene's textures to the asset cache (or deletes them), then trims the cache
+	void ClearScene();
+	// Deletes everything the cache holds, call with the scene cleared before the context goes
+	void ClearAssetCache();
+
+	// Appends _Compound's actors (and their sub compounds) to _vectorInstances in pre-order
+	void BuildActorInstances(CCompoundSprite& _Compound, uint32_t const _uParent, std::vector<SActorInstance>& _vectorInstances);
+	void ResolveRenderRecord(CCompoundSprite& _Compound, CCompoundSprite::SActor const& _Actor, SActorInstance::SRenderRecord& _Render);
+
+	// Switches each sheet's texture between resolutions to suit m_fViewPortScale, call once a frame
+	// on the context thread. The new resolution decodes in the background, the old one stays bound
+	// until it's uploaded.
+	void UpdateTextureResidency(uint32_t const _uViewportHeight);
+	// Waits for any resolution switches still decoding and drops them
+	void CancelTextureResidency();
+
+	static glm::mat4 CalculateViewProjection(uint32_t const _uWidth, uint32_t const _uHeight, float const _fViewPortScale);
+	void DrawActorInstances(CSpriteBatch& _SpriteBatch, float const _fTime);
+
+	// Must be called on the thread that owns the GL context. _pMips (optional) is every level below.
+	uint32_t UploadTexture(uint8_t const* _pData, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels, std::vector<mip_chain::SLevel> const* _pMips = nullptr);
+	// Reads the rest of the stream into a new texture a band at a time, mipmapped on the GPU with GetMipmaps()
+	uint32_t UploadTexture(FileHelper::CPNGStream& _Stream);
+	// Blocks straight into a compressed texture, GL only
+	uint32_t UploadTexture(block_compression::SCompressedImage const& _Image);
+	void DeleteTexture(uint32_t const _uTexture);
+	void UploadDecodedImage(CCompoundLoader::SDecodedImage const& _Decoded);
+	void QueueDecodedImage(CCompoundLoader::SDecodedImage const& _Decoded);
+	// Puts a newly uploaded texture in the scene, releasing the one it replaces. A failed
+	// load (0) leaves a texture that's already there alone.
+	void SetSceneTexture(std::string const& _sTexture, uint32_t const _uTexture, uint32_t const _uScaleDenom);
+
+	// Picks up texture ids for leaves that were built before their texture finished loading,
+	// or whose texture has since been swapped for another resolution
+	void RefreshRenderRecordTextures();
+	uint32_t GetPlaceholderTexture();
 
 	std::map<std::string, std::shared_ptr<CCompoundSprite>> m_mapCompounds;
 	std::map<std::string, CSpriteSheet> m_mapSpriteSheets;
 
 	std::map<std::string, uint32_t> m_mapTextureNameId;
+	std::map<std::string, uint32_t> m_mapTextureScaleDenom;	// what each texture was decoded at
+	uint32_t m_uPlaceholderTexture = 0;
+
+	// Outlives the scene, so reopening or switching between related compounds reuses what it can
+	CAssetCache m_AssetCache;
+
+	std::unique_ptr<CCompoundLoader> m_pCompoundLoader;
+	bool m_bCompoundLoaderSceneApplied = false;
+
+	// When set, textures are loaded into this instead of GL (headless software rendering)
+	CSoftwareRasterizer* m_pSoftwareRasterizer = nullptr;
+
+	// Only load the sprite sheet cells the compounds use. Off in the tool, the sprite sheet
+	// window shows every cell.
+	bool m_bSelectiveSpriteSheets = false;
+
+	// Resolution textures are loaded at, from the next open. Below what the sheets are authored
+	// at, JPEG and JPNG textures are decoded straight at 1/2 or 1/4 size (previewing big atlases).
+	CSpriteSheet::TextureRes m_eTextureRes = CSpriteSheet::TextureRes::High;
+
+	// Pick each sheet's resolution from the zoom once it's open (see UpdateTextureResidency()),
+	// starting from m_eTextureRes. Off in the headless renderer, it draws one frame at a known scale.
+	bool m_bAutoTextureRes = true;
+	CSpriteSheet::TextureRes m_eSceneTextureRes = CSpriteSheet::TextureRes::High;
+	std::string m_sTextureParentFolder;
+	std::map<std::string, std::future<CCompoundLoader::SDecodedImage>> m_mapPendingTextures;
+
+	// Mipmap textures as they load. Never for the software rasterizer.
+	bool m_bMipmaps = true;
+	bool GetMipmaps() const { return m_bMipmaps && m_pSoftwareRasterizer == nullptr; }
+
+	// Block compress textures as they load, from the next open. The formats are filled in by
+	// DetectTextureCompression() once there's a context, nothing is compressed for the
+	// software rasterizer.
+	block_compression::SSettings m_TextureCompression;
+	void DetectTextureCompression();
+	block_compression::SSettings GetTextureCompression() const;
+
+	// When set (and not rendering in software), background loads stream their textures through this
+	CTextureUploader* m_pTextureUploader = nullptr;
+	bool m_bTextureIdsChanged = false;
 
 	std::vector<SActorInstance> m_vectorActorInstances;
+	std::vector<glm::mat4> m_vectorInstanceMatrices;	// per instance, only written for compounds
 
 	double m_dMouseScrollX = 0.0;
 	double m_dMouseScrollY = 0.0;
@@ -57,6 +171,8 @@ protected:
 	bool m_bAnimate = true;
 	float m_fAnimationSpeedMult = 1.0f;
 
+	bool m_bInstancedRendering = false;
+
 	std::string m_sOpenFile;
 };
 //========================================
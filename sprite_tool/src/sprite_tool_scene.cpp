@@ -0,0 +1,783 @@
+// sprite_tool_scene.cpp : Compound loading and scene drawing shared by the tool and the headless renderer.
+//  Nothing in here may depend on GLFW, ImGui or the file dialogs.
+
+
+#include "sprite_tool.hpp"
+
+#include "utility/file_helper.hpp"
+#include "utility/stl_helper.hpp"
+#include "utility/thread_pool.hpp"
+
+#include "spritesheet.hpp"
+#include "compound_sprite.hpp"
+#include "compound_loader.hpp"
+#include "baked_timeline.hpp"
+#include "sprite_batch.hpp"
+#include "software_rasterizer.hpp"
+#include "texture_uploader.hpp"
+
+// gl stuff
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp" // glm::translate, glm::rotate, glm::scale, glm::perspective
+
+// stl
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <set>
+#include <string>
+#include <utility>
+
+//========================================
+uint32_t const SActorInstance::c_uNoParent;
+//========================================
+
+namespace
+{
+    // Rows read from a PNG stream at a time by the blocking upload
+    size_t const c_uStreamBandBytes = 1024 * 1024;
+
+    // On screen size of a texel that moves a sheet up a resolution, or down one when the lower
+    // resolution's texels would still be this small. Kept apart so a zoom sitting right on the
+    // boundary doesn't reload every frame.
+    float const c_fTexelPixelsUp = 1.25f;
+    float const c_fTexelPixelsDown = 0.8f;
+};
+
+bool CSpriteTool::LoadCompounds(std::string const& _sPath)
+{
+    std::string _sAbsPath = FileHelper::GetAbsolutePath(_sPath);
+
+    // Parse the compounds, sub-compounds that fail are reported and left empty
+    if (CCompoundSprite::ParseJSONFileRecursive(_sAbsPath, m_mapCompounds) == false)
+    {
+        fprintf(stdout, "Failed to load compound '%s'.\n", _sPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void CSpriteTool::LoadCompoundAssets(std::string const& _sTextureParentFolder)
+{
+    // Get required textures from compounds
+    //========================================
+    std::vector<std::string> _vectorTexturesToLoad = CCompoundLoader::GetRequiredTextures(m_mapCompounds);
+
+    std::map<std::string, std::set<std::string>> _mapRequiredSprites;
+    if (m_bSelectiveSpriteSheets)
+    {
+        _mapRequiredSprites = CCompoundLoader::GetRequiredSprites(m_mapCompounds);
+    }
+    //========================================
+
+    // Parse spritesheets and decode images on the pool, all at once
+    //========================================
+    CThreadPool& _ThreadPool = CThreadPool::GetShared();
+    block_compression::SSettings const _TextureCompression = GetTextureCompression();
+    bool const _bMipmaps = GetMipmaps();
+
+    m_sTextureParentFolder = _sTextureParentFolder;
+    m_eSceneTextureRes = m_eTextureRes;
+
+    std::vector<std::future<std::pair<bool, CSpriteSheet>>> _vectorSheets;
+    std::vector<std::future<CCompoundLoader::SDecodedImage>> _vectorImages;
+    for (auto const& _sTexture : _vectorTexturesToLoad)
+    {
+        std::set<std::string> const* _pSprites = m_bSelectiveSpriteSheets ? &_mapRequiredSprites[_sTexture] : nullptr;
+        _vectorSheets.push_back(_ThreadPool.Submit([this, _sTextureParentFolder, _sTexture, _pSprites]()
+        {
+            CSpriteSheet _SpriteSheet;
+            bool const _bLoaded = CCompoundLoader::LoadSpriteSheet(_sTextureParentFolder, _sTexture, _SpriteSheet, &m_AssetCache, _pSprites);
+            return std::make_pair(_bLoaded, _SpriteSheet);
+        }));
+
+        // Already loaded, skip
+        auto _itTextureId = m_mapTextureNameId.find(_sTexture);
+        if (_itTextureId != m_mapTextureNameId.end() && _itTextureId->second != 0)
+        {
+            _vectorImages.emplace_back();
+            continue;
+        }
+
+        fprintf(stdout, "Attempting to load texture '%s\\%s'.\n", _sTextureParentFolder.c_str(), _sTexture.c_str());
+
+        _vectorImages.push_back(_ThreadPool.Submit([this, _sTextureParentFolder, _sTexture, _TextureCompression, _bMipmaps]()
+        {
+            return CCompoundLoader::DecodeImage(_sTextureParentFolder, _sTexture, &m_AssetCache, m_eTextureRes, _TextureCompression, _bMipmaps);
+        }));
+    }
+    //========================================
+
+    // Collect the results, only the texture upload has to happen on this (the context) thread
+    //========================================
+    for (size_t i = 0; i < _vectorTexturesToLoad.size(); ++i)
+    {
+        std::pair<bool, CSpriteSheet> _Sheet = _vectorSheets[i].get();
+        if (_Sheet.first == false)
+        {
+            // Its sprites aren't drawn at all
+            fprintf(stdout, "Failed to load sprite sheet '%s'.\n", _vectorTexturesToLoad[i].c_str());
+            continue;
+        }
+
+        m_mapSpriteSheets[_vectorTexturesToLoad[i]] = std::move(_Sheet.second);
+    }
+
+    for (size_t i = 0; i < _vectorTexturesToLoad.size(); ++i)
+    {
+        if (_vectorImages[i].valid() == false)
+        {
+            continue;
+        }
+
+        UploadDecodedImage(_vectorImages[i].get());
+    }
+    //========================================
+}
+
+void CSpriteTool::UploadDecodedImage(CCompoundLoader::SDecodedImage const& _Decoded)
+{
+    FileHelper::SImageData const& _ImageData = _Decoded.m_ImageData;
+
+    uint32_t _uTexture = 0;
+    if (_Decoded.m_uCachedTexture != 0)
+    {
+        // Already pinned for us
+        _uTexture = _Decoded.m_uCachedTexture;
+    }
+    else if (_Decoded.m_Compressed.m_pBlocks != nullptr)
+    {
+        _uTexture = UploadTexture(_Decoded.m_Compressed);
+
+        if (_uTexture != 0)
+        {
+            m_AssetCache.InsertTexture(_Decoded.m_sPath, _Decoded.m_uModifiedTime, _Decoded.m_uScaleDenom, _Decoded.m_uCompressionVariant, _uTexture, _Decoded.m_Compressed.m_pBlocks->size());
+        }
+    }
+    else if (_Decoded.m_pPNGStream != nullptr || (_ImageData.m_pData != nullptr && _ImageData.m_pData->size() > 0))
+    {
+        _uTexture = (_Decoded.m_pPNGStream != nullptr) ? UploadTexture(*_Decoded.m_pPNGStream)
+                                                       : UploadTexture(_ImageData.m_pData->data(), _Decoded.m_iWidth, _Decoded.m_iHeight, _ImageData.m_uChannels, &_Decoded.m_vectorMips);
+
+        if (_uTexture != 0)
+        {
+            bool const _bMipmapped = (_Decoded.m_vectorMips.empty() == false) || (_Decoded.m_pPNGStream != nullptr && GetMipmaps());
+            m_AssetCache.InsertTexture(_Decoded.m_sPath, _Decoded.m_uModifiedTime, _Decoded.m_uScaleDenom, 0, _uTexture, CAssetCache::GetTextureBytes(_Decoded.m_iWidth, _Decoded.m_iHeight, _bMipmapped));
+        }
+    }
+    else
+    {
+        // fail, drawn with the placeholder
+        fprintf(stdout, "Failed to load texture '%s'.\n", _Decoded.m_sTexture.c_str());
+    }
+
+    SetSceneTexture(_Decoded.m_sTexture, _uTexture, _Decoded.m_uScaleDenom);
+}
+
+void CSpriteTool::SetSceneTexture(std::string const& _sTexture, uint32_t const _uTexture, uint32_t const _uScaleDenom)
+{
+    auto _itTextureId = m_mapTextureNameId.find(_sTexture);
+    if (_itTextureId != m_mapTextureNameId.end() && _itTextureId->second != 0)
+    {
+        // Another resolution failed to load, better to keep drawing this one than the placeholder
+        if (_uTexture == 0)
+        {
+            return;
+        }
+
+        // The cache can hand back the same texture, pinned once more
+        uint32_t const _uOldTexture = _itTextureId->second;
+        if (m_AssetCache.ReleaseTexture(_uOldTexture) == false && _uOldTexture != _uTexture)
+        {
+            DeleteTexture(_uOldTexture);
+        }
+    }
+
+    m_mapTextureNameId[_sTexture] = _uTexture;
+    m_mapTextureScaleDenom[_sTexture] = _uScaleDenom;
+    m_bTextureIdsChanged = true;
+}
+
+//========================================
+void CSpriteTool::StartCompoundLoad(std::string const& _sPath, std::string const& _sTextureParentFolder)
+{
+    // Replaces any open already in flight, the current scene stays up until the new one is ready
+    m_pCompoundLoader.reset();
+    m_pCompoundLoader.reset(new CCompoundLoader(_sPath, _sTextureParentFolder, &m_AssetCache, m_eTextureRes, GetTextureCompression(), GetMipmaps()));
+    m_bCompoundLoaderSceneApplied = false;
+}
+
+void CSpriteTool::CancelCompoundLoad()
+{
+    if (m_pCompoundLoader)
+    {
+        m_pCompoundLoader->Cancel();
+    }
+}
+
+void CSpriteTool::UpdateCompoundLoad(double const _dUploadBudgetSeconds)
+{
+    if (m_pCompoundLoader)
+    {
+        CCompoundLoader& _Loader = *m_pCompoundLoader;
+
+        // Swap the new scene in as soon as it can be drawn, textures show as placeholders until uploaded
+        if (m_bCompoundLoaderSceneApplied == false && _Loader.IsSceneReady())
+        {
+            ClearScene();
+            _Loader.TakeScene(m_mapCompounds, m_mapSpriteSheets);
+            BuildRootActorInstances(_Loader.GetPath());
+            m_sTextureParentFolder = _Loader.GetTextureFolder();
+            m_eSceneTextureRes = _Loader.GetTextureRes();
+            m_bCompoundLoaderSceneApplied = true;
+        }
+
+        if (m_bCompoundLoaderSceneApplied)
+        {
+            auto const _Start = std::chrono::steady_clock::now();
+
+            CCompoundLoader::SDecodedImage _Decoded;
+            while (_Loader.PopDecodedImage(_Decoded))
+            {
+                if (m_pTextureUploader != nullptr && m_pSoftwareRasterizer == nullptr)
+                {
+                    QueueDecodedImage(_Decoded);
+                    continue;
+                }
+
+                // No uploader, straight to glTexImage2D. Spread over frames so the UI keeps drawing.
+                UploadDecodedImage(_Decoded);
+
+                if (std::chrono::duration<double>(std::chrono::steady_clock::now() - _Start).count() > _dUploadBudgetSeconds)
+                {
+                    break;
+                }
+            }
+        }
+
+        CCompoundLoader::Stage const _eStage = _Loader.GetProgress().m_eStage;
+        bool const _bStopped = (_eStage == CCompoundLoader::Stage::Failed || _eStage == CCompoundLoader::Stage::Cancelled);
+
+        // Finished, or never got far enough to replace what we had
+        if (_Loader.IsFinished() || (m_bCompoundLoaderSceneApplied == false && _bStopped))
+        {
+            m_pCompoundLoader.reset();
+        }
+    }
+
+    if (m_pTextureUploader != nullptr)
+    {
+        m_pTextureUploader->Update(_dUploadBudgetSeconds);
+    }
+
+    if (m_bTextureIdsChanged)
+    {
+        RefreshRenderRecordTextures();
+        m_bTextureIdsChanged = false;
+
+        // Nothing draws with a replaced resolution any more, it's only kept while there's room
+        m_AssetCache.Trim([this](uint32_t _uTexture) { DeleteTexture(_uTexture); });
+    }
+}
+
+void CSpriteTool::QueueDecodedImage(CCompoundLoader::SDecodedImage const& _Decoded)
+{
+    FileHelper::SImageData const& _ImageData = _Decoded.m_ImageData;
+
+    // Only known to the scene once every row is in, it draws as a placeholder until then
+    std::string const _sTexture = _Decoded.m_sTexture;
+    std::string const _sPath = _Decoded.m_sPath;
+    uint64_t const _uModifiedTime = _Decoded.m_uModifiedTime;
+    uint32_t const _uScaleDenom = _Decoded.m_uScaleDenom;
+    bool const _bMipmapped = (_Decoded.m_vectorMips.empty() == false) || (_Decoded.m_pPNGStream != nullptr && GetMipmaps());
+    uint64_t const _uBytes = CAssetCache::GetTextureBytes(_Decoded.m_iWidth, _Decoded.m_iHeight, _bMipmapped);
+    auto _OnComplete = [this, _sTexture, _sPath, _uModifiedTime, _uScaleDenom, _uBytes](uint32_t _uTexture)
+    {
+        m_AssetCache.InsertTexture(_sPath, _uModifiedTime, _uScaleDenom, 0, _uTexture, _uBytes);
+        SetSceneTexture(_sTexture, _uTexture, _uScaleDenom);
+    };
+
+    // Decoded band by band as the uploader gets to it
+    if (_Decoded.m_pPNGStream != nullptr)
+    {
+        m_pTextureUploader->Queue(_Decoded.m_pPNGStream, _OnComplete, GetMipmaps());
+        return;
+    }
+
+    // Cache hits, blocks (already a fraction of the size), failed decodes (and anything that
+    // isn't RGB/RGBA) take the blocking path
+    if (_Decoded.m_uCachedTexture != 0 || _Decoded.m_Compressed.m_pBlocks != nullptr || _ImageData.m_pData == nullptr || _ImageData.m_pData->empty() || (_ImageData.m_uChannels != 3 && _ImageData.m_uChannels != 4))
+    {
+        UploadDecodedImage(_Decoded);
+        return;
+    }
+
+    m_pTextureUploader->Queue(_ImageData.m_pData, _Decoded.m_iWidth, _Decoded.m_iHeight, _ImageData.m_uChannels, _OnComplete, _Decoded.m_vectorMips);
+}
+
+void CSpriteTool::UpdateTextureResidency(uint32_t const _uViewportHeight)
+{
+    // Finished decodes go in like an open's, the texture they replace is released once they're uploaded
+    for (auto _itPending = m_mapPendingTextures.begin(); _itPending != m_mapPendingTextures.end(); )
+    {
+        if (_itPending->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++_itPending;
+            continue;
+        }
+
+        CCompoundLoader::SDecodedImage const _Decoded = _itPending->second.get();
+        _itPending = m_mapPendingTextures.erase(_itPending);
+
+        if (m_pTextureUploader != nullptr && m_pSoftwareRasterizer == nullptr)
+        {
+            QueueDecodedImage(_Decoded);
+        }
+        else
+        {
+            UploadDecodedImage(_Decoded);
+        }
+    }
+
+    // Left alone while an open is still filling the scene in
+    if (m_bAutoTextureRes == false || m_pCompoundLoader || _uViewportHeight == 0 || m_mapTextureScaleDenom.empty())
+    {
+        return;
+    }
+
+    // A world unit is this many pixels tall (see CalculateViewProjection()), and a texel of a sheet
+    // decoded at 1/n size covers n of the texels it was authored with
+    float const _fPixelsPerUnit = m_fViewPortScale * 0.01f * static_cast<float>(_uViewportHeight) * 0.5f;
+    CSpriteSheet::TextureRes const _eAuthored = CCompoundLoader::c_eSheetTextureRes;
+    auto GetTexelPixels = [_fPixelsPerUnit, _eAuthored](int32_t const _iRes)
+    {
+        CSpriteSheet::TextureRes const _eRes = static_cast<CSpriteSheet::TextureRes>(_iRes);
+        return CSpriteSheet::GetTextureScale(_eAuthored) * static_cast<float>(CSpriteSheet::GetDecodeScale(_eAuthored, _eRes)) * _fPixelsPerUnit;
+    };
+
+    int32_t _iRes = static_cast<int32_t>(m_eSceneTextureRes);
+    while (_iRes < static_cast<int32_t>(CSpriteSheet::TextureRes::Ultra) && GetTexelPixels(_iRes) > c_fTexelPixelsUp)
+    {
+        ++_iRes;
+    }
+    while (_iRes > static_cast<int32_t>(CSpriteSheet::TextureRes::Low) && GetTexelPixels(_iRes - 1) <= c_fTexelPixelsDown)
+    {
+        --_iRes;
+    }
+    m_eSceneTextureRes = static_cast<CSpriteSheet::TextureRes>(_iRes);
+
+    // Ultra beyond what's authored decodes the same as High, nothing to reload for it
+    uint32_t const _uScaleDenom = CSpriteSheet::GetDecodeScale(_eAuthored, m_eSceneTextureRes);
+
+    CThreadPool& _ThreadPool = CThreadPool::GetShared();
+    block_compression::SSettings const _TextureCompression = GetTextureCompression();
+    bool const _bMipmaps = GetMipmaps();
+    CSpriteSheet::TextureRes const _eTextureRes = m_eSceneTextureRes;
+    std::string const _sTextureParentFolder = m_sTextureParentFolder;
+
+    for (auto& _Item : m_mapTextureScaleDenom)
+    {
+        std::string const& _sTexture = _Item.first;
+
+        // Failed loads aren't tried again
+        auto _itTextureId = m_mapTextureNameId.find(_sTexture);
+        if (_Item.second == _uScaleDenom || _itTextureId == m_mapTextureNameId.end() || _itTextureId->second == 0 || m_mapPendingTextures.count(_sTexture) != 0)
+        {
+            continue;
+        }
+
+        // Marked as switched straight away so it's only asked for once, a failed decode keeps the old texture
+        _Item.second = _uScaleDenom;
+        m_mapPendingTextures[_sTexture] = _ThreadPool.Submit([this, _sTextureParentFolder, _sTexture, _eTextureRes, _TextureCompression, _bMipmaps]()
+        {
+            return CCompoundLoader::DecodeImage(_sTextureParentFolder, _sTexture, &m_AssetCache, _eTextureRes, _TextureCompression, _bMipmaps);
+        });
+    }
+}
+
+void CSpriteTool::CancelTextureResidency()
+{
+    for (auto& _Item : m_mapPendingTextures)
+    {
+        // Nobody else is going to take the pin
+        CCompoundLoader::SDecodedImage const _Decoded = _Item.second.get();
+        if (_Decoded.m_uCachedTexture != 0)
+        {
+            m_AssetCache.ReleaseTexture(_Decoded.m_uCachedTexture);
+        }
+    }
+    m_mapPendingTextures.clear();
+}
+//========================================
+
+bool CSpriteTool::BuildRootActorInstances(std::string const& _sPath)
+{
+    auto _itCompound = m_mapCompounds.find(FileHelper::GetAbsolutePath(_sPath));
+    if (_itCompound == m_mapCompounds.end())
+    {
+        fprintf(stdout, "%s", "Couldn't find compound to build actor instances.");
+        return false;
+    }
+
+    m_vectorActorInstances.clear();
+    BuildActorInstances(*_itCompound->second, SActorInstance::c_uNoParent, m_vectorActorInstances);
+    m_vectorInstanceMatrices.resize(m_vectorActorInstances.size());
+
+    return true;
+}
+
+void CSpriteTool::ClearScene()
+{
+    CancelTextureResidency();
+
+    if (m_pTextureUploader != nullptr)
+    {
+        m_pTextureUploader->CancelAll();
+    }
+
+    m_vectorActorInstances.clear();
+    m_vectorInstanceMatrices.clear();
+    m_mapCompounds.clear();
+    m_mapSpriteSheets.clear();
+    for (auto& item : m_mapTextureNameId)
+    {
+        // Failed loads are 0, anything else the cache doesn't own is ours
+        if (item.second != 0 && m_AssetCache.ReleaseTexture(item.second) == false)
+        {
+            DeleteTexture(item.second);
+        }
+    }
+    m_mapTextureNameId.clear();
+    m_mapTextureScaleDenom.clear();
+
+    if (m_uPlaceholderTexture != 0)
+    {
+        DeleteTexture(m_uPlaceholderTexture);
+        m_uPlaceholderTexture = 0;
+    }
+
+    m_AssetCache.Trim([this](uint32_t _uTexture) { DeleteTexture(_uTexture); });
+}
+
+void CSpriteTool::ClearAssetCache()
+{
+    m_AssetCache.Clear([this](uint32_t _uTexture) { DeleteTexture(_uTexture); });
+}
+
+void CSpriteTool::BuildActorInstances(CCompoundSprite& _Compound, uint32_t const _uParent, std::vector<SActorInstance>& _vectorInstances)
+{
+    uint32_t const _uDepth = (_uParent == SActorInstance::c_uNoParent) ? 0 : _vectorInstances[_uParent].m_uDepth + 1;
+
+    auto const& _vectorActors = _Compound.GetActors();
+    for (uint32_t i = 0; i < _vectorActors.size(); ++i)
+    {
+        auto const& _Actor = _vectorActors[i];
+
+        // Indices only from here, recursing grows the vector
+        uint32_t const _uIndex = static_cast<uint32_t>(_vectorInstances.size());
+        _vectorInstances.emplace_back();
+        SActorInstance &_ActorInstance = _vectorInstances.back();
+        _ActorInstance.m_pCompound = &_Compound;
+        _ActorInstance.m_uActorId = _Actor.m_uID;
+        _ActorInstance.m_uActorIndex = i;
+        _ActorInstance.m_uParent = _uParent;
+        _ActorInstance.m_uDepth = _uDepth;
+
+        switch (static_cast<CCompoundSprite::SActor::Type>(_Actor.m_uType))
+        {
+            case CCompoundSprite::SActor::Type::Sprite:
+            {
+                ResolveRenderRecord(_Compound, _Actor, _ActorInstance.m_Render);
+                break;
+            }
+
+            //Recurse!
+            case CCompoundSprite::SActor::Type::Compound:
+            {
+                auto _itSubCompound = m_mapCompounds.find(_Actor.m_sSubCompoundPath);
+
+                if (_itSubCompound != m_mapCompounds.end())
+                {
+                    BuildActorInstances(*_itSubCompound->second, _uIndex, _vectorInstances);
+                }
+                break;
+            }
+        }
+
+        _vectorInstances[_uIndex].m_uSubtreeSize = static_cast<uint32_t>(_vectorInstances.size()) - _uIndex;
+    }
+}
+
+void CSpriteTool::ResolveRenderRecord(CCompoundSprite& _Compound, CCompoundSprite::SActor const& _Actor, SActorInstance::SRenderRecord& _Render)
+{
+    std::string const& _sTexture = _Compound.GetTextureForSprite(_Actor.m_sSprite);
+
+    auto _itSpriteSheet = m_mapSpriteSheets.find(_sTexture);
+    if (_itSpriteSheet == m_mapSpriteSheets.end())
+    {
+        return;
+    }
+
+    auto const& _mapSprites = _itSpriteSheet->second.GetSpriteData();
+    auto _itSprite = _mapSprites.find(_Actor.m_sSprite);
+    if (_itSprite == _mapSprites.end())
+    {
+        return;
+    }
+
+    // Texture may still be loading, it's 0 until then (see RefreshRenderRecordTextures)
+    auto _itTextureId = m_mapTextureNameId.find(_sTexture);
+    _Render.m_uTexture = (_itTextureId != m_mapTextureNameId.end()) ? _itTextureId->second : 0;
+
+    _Render.m_pSpriteCell = &_itSprite->second;
+    _Render.m_uAlignmentX = _Actor.m_State.m_uAlignmentX;
+    _Render.m_uAlignmentY = _Actor.m_State.m_uAlignmentY;
+    _Render.m_LocalRect = gl_render_helper::CalculateLocalRect(*_Render.m_pSpriteCell, _Render.m_uAlignmentX, _Render.m_uAlignmentY);
+}
+
+void CSpriteTool::RefreshRenderRecordTextures()
+{
+    for (auto& _ActorInstance : m_vectorActorInstances)
+    {
+        if (_ActorInstance.IsLeaf() && _ActorInstance.m_Render.m_pSpriteCell != nullptr)
+        {
+            CCompoundSprite& _Compound = *_ActorInstance.m_pCompound;
+            CCompoundSprite::SActor const& _Actor = _Compound.GetActors()[_ActorInstance.m_uActorIndex];
+
+            std::string const& _sTexture = _Compound.GetTextureForSprite(_Actor.m_sSprite);
+            auto _itTextureId = m_mapTextureNameId.find(_sTexture);
+            if (_itTextureId != m_mapTextureNameId.end())
+            {
+                _ActorInstance.m_Render.m_uTexture = _itTextureId->second;
+            }
+        }
+    }
+}
+
+uint32_t CSpriteTool::GetPlaceholderTexture()
+{
+    if (m_uPlaceholderTexture == 0)
+    {
+        // Flat, half transparent grey, tinted by the actor colour like any other sprite
+        uint8_t const _arrayTexel[4] = { 0xA0, 0xA0, 0xA0, 0x80 };
+        m_uPlaceholderTexture = UploadTexture(_arrayTexel, 1, 1, 4);
+    }
+    return m_uPlaceholderTexture;
+}
+
+uint32_t CSpriteTool::UploadTexture(uint8_t const* _pData, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels, std::vector<mip_chain::SLevel> const* _pMips)
+{
+    if (m_pSoftwareRasterizer != nullptr)
+    {
+        return m_pSoftwareRasterizer->CreateTexture(_pData, _iWidth, _iHeight, _uChannels);
+    }
+
+    uint32_t _uTextureId = 0;
+    uint32_t _eChannels = (_uChannels == 4) ? GL_RGBA : GL_RGB;
+
+    uint32_t const _uLevels = 1 + ((_pMips != nullptr) ? static_cast<uint32_t>(_pMips->size()) : 0);
+
+    // RGB rows, and the small levels of anything, aren't 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &_uTextureId);
+    glBindTexture(GL_TEXTURE_2D, _uTextureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, _eChannels, _iWidth, _iHeight, 0, _eChannels, GL_UNSIGNED_BYTE, _pData);
+    for (uint32_t i = 1; i < _uLevels; ++i)
+    {
+        mip_chain::SLevel const& _Level = (*_pMips)[i - 1];
+        glTexImage2D(GL_TEXTURE_2D, i, _eChannels, _Level.m_iWidth, _Level.m_iHeight, 0, _eChannels, GL_UNSIGNED_BYTE, _Level.m_pData->data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (_uLevels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _uLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    return _uTextureId;
+}
+
+uint32_t CSpriteTool::UploadTexture(FileHelper::CPNGStream& _Stream)
+{
+    int32_t const _iWidth = _Stream.GetWidth();
+    int32_t const _iHeight = _Stream.GetHeight();
+    uint32_t const _uChannels = _Stream.GetChannels();
+
+    // Only ever one band in memory, whatever the size of the image
+    int32_t const _iBandRows = std::max<int32_t>(1, static_cast<int32_t>(c_uStreamBandBytes / _Stream.GetRowBytes()));
+    FileHelper::tPixelBuffer _Band(_Stream.GetRowBytes() * _iBandRows);
+
+    if (m_pSoftwareRasterizer != nullptr)
+    {
+        uint32_t const _uTexture = m_pSoftwareRasterizer->CreateTexture(nullptr, _iWidth, _iHeight, _uChannels);
+        while (_Stream.IsFinished() == false)
+        {
+            int32_t const _iRow = _Stream.GetRowsRead();
+            int32_t const _iRows = _Stream.ReadRows(_Band.data(), _iBandRows);
+            m_pSoftwareRasterizer->UpdateTextureRows(_uTexture, _iRow, _iRows, _Band.data(), _uChannels);
+        }
+        return _uTexture;
+    }
+
+    uint32_t _uTextureId = 0;
+    uint32_t _eChannels = (_uChannels == 4) ? GL_RGBA : GL_RGB;
+
+    glGenTextures(1, &_uTextureId);
+    glBindTexture(GL_TEXTURE_2D, _uTextureId);
+    glTexImage2D(GL_TEXTURE_2D, 0, _eChannels, _iWidth, _iHeight, 0, _eChannels, GL_UNSIGNED_BYTE, nullptr);
+    while (_Stream.IsFinished() == false)
+    {
+        int32_t const _iRow = _Stream.GetRowsRead();
+        int32_t const _iRows = _Stream.ReadRows(_Band.data(), _iBandRows);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, _iRow, _iWidth, _iRows, _eChannels, GL_UNSIGNED_BYTE, _Band.data());
+    }
+
+    // Never had the whole image to build levels from on the CPU
+    bool const _bMipmaps = GetMipmaps() && glGenerateMipmap != nullptr;
+    if (_bMipmaps)
+    {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, _bMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return _uTextureId;
+}
+
+uint32_t CSpriteTool::UploadTexture(block_compression::SCompressedImage const& _Image)
+{
+    GLenum _eInternalFormat = 0;
+    switch (_Image.m_eFormat)
+    {
+        case block_compression::Format::BC1: _eInternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+        case block_compression::Format::BC3: _eInternalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+        case block_compression::Format::BC7: _eInternalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+        default: return 0;
+    }
+
+    if (m_pSoftwareRasterizer != nullptr || _Image.m_pBlocks == nullptr)
+    {
+        return 0;
+    }
+
+    uint32_t _uTextureId = 0;
+
+    glGenTextures(1, &_uTextureId);
+    glBindTexture(GL_TEXTURE_2D, _uTextureId);
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, _eInternalFormat, _Image.m_iWidth, _Image.m_iHeight, 0, static_cast<GLsizei>(_Image.m_pBlocks->size()), _Image.m_pBlocks->data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return _uTextureId;
+}
+
+void CSpriteTool::DetectTextureCompression()
+{
+    m_TextureCompression.m_bS3TC = (GLEW_EXT_texture_compression_s3tc != 0);
+    m_TextureCompression.m_bBPTC = (GLEW_ARB_texture_compression_bptc != 0 || GLEW_VERSION_4_2 != 0);
+}
+
+block_compression::SSettings CSpriteTool::GetTextureCompression() const
+{
+    block_compression::SSettings _Settings = m_TextureCompression;
+    if (m_pSoftwareRasterizer != nullptr)
+    {
+        _Settings.m_bEnabled = false;
+    }
+    return _Settings;
+}
+
+void CSpriteTool::DeleteTexture(uint32_t const _uTexture)
+{
+    if (m_pSoftwareRasterizer != nullptr)
+    {
+        m_pSoftwareRasterizer->DeleteTexture(_uTexture);
+    }
+    else
+    {
+        glDeleteTextures(1, &_uTexture);
+    }
+}
+
+glm::mat4 CSpriteTool::CalculateViewProjection(uint32_t const _uWidth, uint32_t const _uHeight, float const _fViewPortScale)
+{
+    float _fRatio = _uWidth / (float)_uHeight;
+
+    float _fScale = _fViewPortScale * 0.01f;
+
+    glm::mat4 m, p, mvp;
+    m = glm::mat4(1.0f);
+    m = glm::scale(m, glm::vec3(_fScale, _fScale, _fScale));
+    m = glm::scale(m, glm::vec3(1, -1, 1));
+    p = glm::ortho(-_fRatio, _fRatio, -1.f, 1.f, 1.f, -1.f);
+    mvp = p * m;
+
+    return mvp;
+}
+
+void CSpriteTool::DrawActorInstances(CSpriteBatch& _SpriteBatch, float const _fTime)
+{
+    glm::mat4 const _matRoot(1.0f);
+
+    m_vectorInstanceMatrices.resize(m_vectorActorInstances.size());
+
+    // Pre-order, so a compound's matrix is always written before any of its children read it
+    uint32_t const _uInstanceCount = static_cast<uint32_t>(m_vectorActorInstances.size());
+    for (uint32_t i = 0; i < _uInstanceCount; )
+    {
+        SActorInstance& _ActorInstance = m_vectorActorInstances[i];
+
+        // Hidden, skip the whole subtree
+        if (_ActorInstance.m_bShow == false)
+        {
+            i += _ActorInstance.m_uSubtreeSize;
+            continue;
+        }
+
+        CCompoundSprite* _pCompound = _ActorInstance.m_pCompound;
+        glm::mat4 const& _matParent = (_ActorInstance.m_uParent == SActorInstance::c_uNoParent) ? _matRoot : m_vectorInstanceMatrices[_ActorInstance.m_uParent];
+
+        float _fCompoundTime = fmodf(_fTime, _pCompound->GetStageLength());
+        // Evaluates every actor of the compound in one go, the first time it's seen at this time
+        CCompoundSprite::SActorState _ActorState = _pCompound->GetBakedTimeline()->EvaluateAll(_fCompoundTime).Get(_ActorInstance.m_uActorIndex);
+
+        if (_ActorInstance.IsLeaf())
+        {
+            SActorInstance::SRenderRecord& _Render = _ActorInstance.m_Render;
+            if (_Render.m_pSpriteCell != nullptr)
+            {
+                if (_ActorState.m_uAlignmentX != _Render.m_uAlignmentX || _ActorState.m_uAlignmentY != _Render.m_uAlignmentY)
+                {
+                    _Render.m_uAlignmentX = _ActorState.m_uAlignmentX;
+                    _Render.m_uAlignmentY = _ActorState.m_uAlignmentY;
+                    _Render.m_LocalRect = gl_render_helper::CalculateLocalRect(*_Render.m_pSpriteCell, _Render.m_uAlignmentX, _Render.m_uAlignmentY);
+                }
+
+                // Still loading (or failed to), the cell geometry is enough to draw something in the right place
+                uint32_t const _uTexture = (_Render.m_uTexture != 0) ? _Render.m_uTexture : GetPlaceholderTexture();
+
+                _SpriteBatch.AddSprite(_matParent,
+                                       *_Render.m_pSpriteCell,
+                                       _Render.m_LocalRect,
+                                       _ActorState,
+                                       _uTexture);
+            }
+        }
+        else
+        {
+            // parent matrix modified for this actor, read by its children
+            glm::mat4 _matSub = _matParent;
+            _matSub = glm::translate(_matSub, glm::vec3(_ActorState.m_fPosX, _ActorState.m_fPosY, 0.0f));
+            _matSub = glm::scale(_matSub, glm::vec3(_ActorState.m_fScaleX, _ActorState.m_fScaleY, 0.0f));
+            m_vectorInstanceMatrices[i] = _matSub;
+        }
+
+        ++i;
+    }
+}
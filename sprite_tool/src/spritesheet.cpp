@@ -1,7 +1,14 @@
 
 #include "spritesheet.hpp"
 
-#include "tiny_xml/ticpp.h"
+#include "utility/binary_stream.hpp"
+#include "utility/compiled_cache.hpp"
+#include "utility/file_helper.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 //========================================
 CSpriteSheet::CSpriteSheet()
@@ -16,109 +23,733 @@ CSpriteSheet::~CSpriteSheet()
 //========================================
 
 //========================================
-void CSpriteSheet::ParseCell(ticpp::Element* _pElemCell)
+namespace
 {
-	try
+	// Piece of the source, not terminated
+	struct SXMLText
 	{
-		SSpriteCell _Cell;
+		char const* m_pBegin = nullptr;
+		size_t m_uLength = 0;
 
-		_Cell.m_sName = _pElemCell->GetAttribute<std::string>("name");
+		template <size_t N>
+		bool Equals(char const (&_arrayString)[N]) const
+		{
+			return m_uLength == N - 1 && memcmp(m_pBegin, _arrayString, N - 1) == 0;
+		}
+		bool Equals(SXMLText const& _Other) const
+		{
+			return m_uLength == _Other.m_uLength && memcmp(m_pBegin, _Other.m_pBegin, m_uLength) == 0;
+		}
+	};
 
-		_pElemCell->GetAttribute("x", &_Cell.x);
-		_pElemCell->GetAttribute("y", &_Cell.y);
-		_pElemCell->GetAttribute("w", &_Cell.w);
-		_pElemCell->GetAttribute("h", &_Cell.h);
+	// Just enough XML for sprite sheets, one tag at a time with nothing kept but the current
+	// tag's attributes. The declaration, comments, CDATA, DOCTYPE and text are skipped, the
+	// schema only has elements and attributes.
+	class CXMLTagScanner
+	{
+	public:
+		enum class Tag
+		{
+			Start,
+			End,
+			Finished,
+			Error,
+		};
 
-		_pElemCell->GetAttribute("ax", &_Cell.ax, false);
-		_pElemCell->GetAttribute("ay", &_Cell.ay, false);
-		_pElemCell->GetAttribute("aw", &_Cell.aw, false);
-		_pElemCell->GetAttribute("ah", &_Cell.ah, false);
+		struct SAttribute
+		{
+			SXMLText m_Name;
+			SXMLText m_Value;	// entities not decoded, see DecodeText()
+		};
 
-		_Cell.CalculateNormalisedValues(m_uTexWidth, m_uTexHeight);
+		CXMLTagScanner(char const* _pXML, size_t const _uSize)
+			: m_pHead(_pXML)
+			, m_pCurrent(_pXML)
+			, m_pEnd(_pXML + _uSize)
+		{
+			m_vectorAttributes.reserve(16);
+		}
 
-		m_mapSpriteData[_Cell.m_sName] = _Cell;
-	}
-	catch (ticpp::Exception& error)
+		Tag Next()
+		{
+			for (;;)
+			{
+				char const* _pOpen = static_cast<char const*>(memchr(m_pCurrent, '<', m_pEnd - m_pCurrent));
+				if (_pOpen == nullptr)
+				{
+					return Tag::Finished;
+				}
+				m_pCurrent = _pOpen + 1;
+
+				if (StartsWith("!--"))
+				{
+					if (SkipPast("-->") == false)
+					{
+						return Tag::Error;
+					}
+				}
+				else if (StartsWith("![CDATA["))
+				{
+					if (SkipPast("]]>") == false)
+					{
+						return Tag::Error;
+					}
+				}
+				else if (StartsWith("?"))
+				{
+					if (SkipPast("?>") == false)
+					{
+						return Tag::Error;
+					}
+				}
+				else if (StartsWith("!"))
+				{
+					if (SkipPast(">") == false)
+					{
+						return Tag::Error;
+					}
+				}
+				else if (StartsWith("/"))
+				{
+					++m_pCurrent;
+					m_Name = ReadName();
+					SkipWhitespace();
+					if (m_Name.m_uLength == 0 || m_pCurrent == m_pEnd || *m_pCurrent != '>')
+					{
+						return Tag::Error;
+					}
+					++m_pCurrent;
+					return Tag::End;
+				}
+				else
+				{
+					return ReadStartTag();
+				}
+			}
+		}
+
+		SXMLText const& GetName() const { return m_Name; }
+		// <Cell ... />, there's no end tag to come
+		bool IsEmptyElement() const { return m_bEmptyElement; }
+		size_t GetOffset() const { return static_cast<size_t>(m_pCurrent - m_pHead); }
+
+		template <size_t N>
+		SXMLText const* FindAttribute(char const (&_arrayName)[N]) const
+		{
+			for (SAttribute const& _Attribute : m_vectorAttributes)
+			{
+				if (_Attribute.m_Name.Equals(_arrayName))
+				{
+					return &_Attribute.m_Value;
+				}
+			}
+			return nullptr;
+		}
+
+	protected:
+		template <size_t N>
+		bool StartsWith(char const (&_arrayString)[N]) const
+		{
+			return static_cast<size_t>(m_pEnd - m_pCurrent) >= N - 1 && memcmp(m_pCurrent, _arrayString, N - 1) == 0;
+		}
+
+		template <size_t N>
+		bool SkipPast(char const (&_arrayString)[N])
+		{
+			char const* _pFound = std::search(m_pCurrent, m_pEnd, _arrayString, _arrayString + N - 1);
+			if (_pFound == m_pEnd)
+			{
+				return false;
+			}
+			m_pCurrent = _pFound + N - 1;
+			return true;
+		}
+
+		static bool IsWhitespace(char const _c)
+		{
+			return _c == ' ' || _c == '\t' || _c == '\n' || _c == '\r';
+		}
+
+		void SkipWhitespace()
+		{
+			while (m_pCurrent != m_pEnd && IsWhitespace(*m_pCurrent))
+			{
+				++m_pCurrent;
+			}
+		}
+
+		SXMLText ReadName()
+		{
+			SXMLText _Name;
+			_Name.m_pBegin = m_pCurrent;
+			while (m_pCurrent != m_pEnd && IsWhitespace(*m_pCurrent) == false &&
+				   *m_pCurrent != '/' && *m_pCurrent != '>' && *m_pCurrent != '=')
+			{
+				++m_pCurrent;
+			}
+			_Name.m_uLength = static_cast<size_t>(m_pCurrent - _Name.m_pBegin);
+			return _Name;
+		}
+
+		Tag ReadStartTag()
+		{
+			m_vectorAttributes.clear();
+			m_bEmptyElement = false;
+
+			m_Name = ReadName();
+			if (m_Name.m_uLength == 0)
+			{
+				return Tag::Error;
+			}
+
+			for (;;)
+			{
+				SkipWhitespace();
+				if (m_pCurrent == m_pEnd)
+				{
+					return Tag::Error;
+				}
+
+				if (*m_pCurrent == '>')
+				{
+					++m_pCurrent;
+					return Tag::Start;
+				}
+
+				if (*m_pCurrent == '/')
+				{
+					if (m_pEnd - m_pCurrent < 2 || m_pCurrent[1] != '>')
+					{
+						return Tag::Error;
+					}
+					m_pCurrent += 2;
+					m_bEmptyElement = true;
+					return Tag::Start;
+				}
+
+				SAttribute _Attribute;
+				_Attribute.m_Name = ReadName();
+				SkipWhitespace();
+				if (_Attribute.m_Name.m_uLength == 0 || m_pCurrent == m_pEnd || *m_pCurrent != '=')
+				{
+					return Tag::Error;
+				}
+				++m_pCurrent;
+				SkipWhitespace();
+				if (m_pCurrent == m_pEnd || (*m_pCurrent != '"' && *m_pCurrent != '\''))
+				{
+					return Tag::Error;
+				}
+
+				char const _cQuote = *m_pCurrent++;
+				char const* _pClose = static_cast<char const*>(memchr(m_pCurrent, _cQuote, m_pEnd - m_pCurrent));
+				if (_pClose == nullptr)
+				{
+					return Tag::Error;
+				}
+				_Attribute.m_Value.m_pBegin = m_pCurrent;
+				_Attribute.m_Value.m_uLength = static_cast<size_t>(_pClose - m_pCurrent);
+				m_pCurrent = _pClose + 1;
+
+				m_vectorAttributes.push_back(_Attribute);
+			}
+		}
+
+		char const* m_pHead;
+		char const* m_pCurrent;
+		char const* m_pEnd;
+
+		SXMLText m_Name;
+		bool m_bEmptyElement = false;
+		std::vector<SAttribute> m_vectorAttributes;
+	};
+
+	void AppendUTF8(uint32_t const _uCodePoint, std::string& _sOut)
 	{
-		fprintf(stderr, "%s\n", error.m_details.c_str());
-		assert(false);
+		if (_uCodePoint < 0x80)
+		{
+			_sOut += static_cast<char>(_uCodePoint);
+		}
+		else if (_uCodePoint < 0x800)
+		{
+			_sOut += static_cast<char>(0xC0 | (_uCodePoint >> 6));
+			_sOut += static_cast<char>(0x80 | (_uCodePoint & 0x3F));
+		}
+		else if (_uCodePoint < 0x10000)
+		{
+			_sOut += static_cast<char>(0xE0 | (_uCodePoint >> 12));
+			_sOut += static_cast<char>(0x80 | ((_uCodePoint >> 6) & 0x3F));
+			_sOut += static_cast<char>(0x80 | (_uCodePoint & 0x3F));
+		}
+		else
+		{
+			_sOut += static_cast<char>(0xF0 | (_uCodePoint >> 18));
+			_sOut += static_cast<char>(0x80 | ((_uCodePoint >> 12) & 0x3F));
+			_sOut += static_cast<char>(0x80 | ((_uCodePoint >> 6) & 0x3F));
+			_sOut += static_cast<char>(0x80 | (_uCodePoint & 0x3F));
+		}
 	}
-}
 
-void CSpriteSheet::ParseAnimation(ticpp::Element* _pElemAnim)
-{
-	std::string _sAnimName;
-	_pElemAnim->GetAttribute("name", &_sAnimName);
+	// Attribute value with the predefined and numeric entities decoded. Unknown ones are
+	// left as they are, like TinyXML did.
+	void DecodeText(SXMLText const& _Text, std::string& _sOut)
+	{
+		char const* _pCurrent = _Text.m_pBegin;
+		char const* const _pEnd = _Text.m_pBegin + _Text.m_uLength;
+
+		char const* _pAmpersand = static_cast<char const*>(memchr(_pCurrent, '&', _Text.m_uLength));
+		if (_pAmpersand == nullptr)
+		{
+			_sOut.assign(_pCurrent, _Text.m_uLength);
+			return;
+		}
+
+		struct SEntity
+		{
+			char const* m_pName;
+			size_t m_uLength;
+			char m_cValue;
+		};
+		static SEntity const s_arrayEntities[] =
+		{
+			{ "amp;", 4, '&' },
+			{ "lt;", 3, '<' },
+			{ "gt;", 3, '>' },
+			{ "quot;", 5, '"' },
+			{ "apos;", 5, '\'' },
+		};
+
+		_sOut.clear();
+		while (_pAmpersand != nullptr)
+		{
+			_sOut.append(_pCurrent, _pAmpersand);
+			_pCurrent = _pAmpersand + 1;
+
+			size_t const _uLeft = static_cast<size_t>(_pEnd - _pCurrent);
+			bool _bDecoded = false;
+
+			char const* _pSemicolon = static_cast<char const*>(memchr(_pCurrent, ';', _uLeft));
+			if (_uLeft > 1 && *_pCurrent == '#' && _pSemicolon != nullptr)
+			{
+				bool const _bHex = (_pCurrent[1] == 'x' || _pCurrent[1] == 'X');
+				char* _pParsedEnd = nullptr;
+				unsigned long const _uCodePoint = strtoul(_pCurrent + (_bHex ? 2 : 1), &_pParsedEnd, _bHex ? 16 : 10);
+				if (_pParsedEnd == _pSemicolon && _uCodePoint > 0 && _uCodePoint <= 0x10FFFF)
+				{
+					AppendUTF8(static_cast<uint32_t>(_uCodePoint), _sOut);
+					_pCurrent = _pSemicolon + 1;
+					_bDecoded = true;
+				}
+			}
+			else
+			{
+				for (SEntity const& _Entity : s_arrayEntities)
+				{
+					if (_uLeft >= _Entity.m_uLength && memcmp(_pCurrent, _Entity.m_pName, _Entity.m_uLength) == 0)
+					{
+						_sOut += _Entity.m_cValue;
+						_pCurrent += _Entity.m_uLength;
+						_bDecoded = true;
+						break;
+					}
+				}
+			}
+
+			if (_bDecoded == false)
+			{
+				_sOut += '&';
+			}
+
+			_pAmpersand = static_cast<char const*>(memchr(_pCurrent, '&', _pEnd - _pCurrent));
+		}
+		_sOut.append(_pCurrent, _pEnd);
+	}
 
-	// Loop through all cells of the animation
-	ticpp::Element* _pAnimCell = _pElemAnim->FirstChildElement("Cell", false);
-	while (_pAnimCell)
+	// Leading whitespace and sign, then digits up to the first thing that isn't one (like
+	// stream extraction). False if there are no digits.
+	bool ParseUint(SXMLText const* _pText, uint32_t& _uValue)
 	{
-		ParseCell(_pAnimCell);
+		if (_pText == nullptr)
+		{
+			return false;
+		}
+
+		char const* _pCurrent = _pText->m_pBegin;
+		char const* const _pEnd = _pText->m_pBegin + _pText->m_uLength;
+		while (_pCurrent != _pEnd && (*_pCurrent == ' ' || *_pCurrent == '\t' || *_pCurrent == '\n' || *_pCurrent == '\r'))
+		{
+			++_pCurrent;
+		}
+
+		bool _bNegative = false;
+		if (_pCurrent != _pEnd && (*_pCurrent == '-' || *_pCurrent == '+'))
+		{
+			_bNegative = (*_pCurrent == '-');
+			++_pCurrent;
+		}
 
-		_pAnimCell = _pAnimCell->NextSiblingElement("Cell", false);
+		if (_pCurrent == _pEnd || *_pCurrent < '0' || *_pCurrent > '9')
+		{
+			return false;
+		}
+
+		uint32_t _uParsed = 0;
+		while (_pCurrent != _pEnd && *_pCurrent >= '0' && *_pCurrent <= '9')
+		{
+			_uParsed = _uParsed * 10 + static_cast<uint32_t>(*_pCurrent - '0');
+			++_pCurrent;
+		}
+
+		_uValue = _bNegative ? (0u - _uParsed) : _uParsed;
+		return true;
 	}
-}
+};
 
-void CSpriteSheet::ParseXML(std::string const& _sXML)
+void CSpriteSheet::ParseXML(char const* _pXML, size_t const _uSize, std::set<std::string> const* _pSprites /*= nullptr*/)
 {
-	try
+	enum class Element
 	{
-		ticpp::Document _Document = ticpp::Document();
+		SpriteInformation,
+		FrameInformation,
+		Animation,
+		Other,
+	};
+
+	struct SOpenElement
+	{
+		Element m_eElement;
+		SXMLText m_Name;
+	};
+
+	CXMLTagScanner _Scanner(_pXML, _uSize);
+
+	std::vector<SOpenElement> _vectorOpen;
+	_vectorOpen.reserve(8);
+
+	bool _bHasSpriteInformation = false;
+	bool _bHasFrameInformation = false;
+
+	std::string _sName;		// reused for every cell, no allocation once it's big enough
+
+	for (;;)
+	{
+		CXMLTagScanner::Tag const _eTag = _Scanner.Next();
+		if (_eTag == CXMLTagScanner::Tag::Finished)
+		{
+			break;
+		}
+
+		if (_eTag == CXMLTagScanner::Tag::Error)
+		{
+			fprintf(stderr, "Sprite sheet XML error at offset %zu.\n", _Scanner.GetOffset());
+			break;
+		}
+
+		if (_eTag == CXMLTagScanner::Tag::End)
+		{
+			if (_vectorOpen.empty() || _vectorOpen.back().m_Name.Equals(_Scanner.GetName()) == false)
+			{
+				fprintf(stderr, "Sprite sheet XML has a mismatched end tag at offset %zu.\n", _Scanner.GetOffset());
+				break;
+			}
+			_vectorOpen.pop_back();
+			continue;
+		}
 
-		_Document.Parse(_sXML, true, TIXML_ENCODING_UTF8);
+		SXMLText const& _Name = _Scanner.GetName();
+		Element const _eParent = _vectorOpen.empty() ? Element::Other : _vectorOpen.back().m_eElement;
+		Element _eElement = Element::Other;
 
-		// Get root element
-		ticpp::Element *_pElemSpriteInfo = _Document.FirstChildElement("SpriteInformation");
+		// Only the first SpriteInformation and FrameInformation count, like the old DOM lookups
+		if (_vectorOpen.empty() && _bHasSpriteInformation == false && _Name.Equals("SpriteInformation"))
+		{
+			_eElement = Element::SpriteInformation;
+			_bHasSpriteInformation = true;
+		}
+		else if (_eParent == Element::SpriteInformation && _bHasFrameInformation == false && _Name.Equals("FrameInformation"))
+		{
+			_eElement = Element::FrameInformation;
+			_bHasFrameInformation = true;
 
-		ticpp::Element* _pElemFrameInfo = _pElemSpriteInfo->FirstChildElement("FrameInformation");
-		if (_pElemFrameInfo)
+			if (SXMLText const* _pValue = _Scanner.FindAttribute("name"))
+			{
+				DecodeText(*_pValue, m_sTexName);
+			}
+			if (SXMLText const* _pValue = _Scanner.FindAttribute("type"))
+			{
+				DecodeText(*_pValue, m_sTexType);
+			}
+			ParseUint(_Scanner.FindAttribute("texw"), m_uTexWidth);
+			ParseUint(_Scanner.FindAttribute("texh"), m_uTexHeight);
+		}
+		else if (_eParent == Element::FrameInformation && _Name.Equals("Animation"))
+		{
+			_eElement = Element::Animation;
+		}
+		else if ((_eParent == Element::FrameInformation || _eParent == Element::Animation) && _Name.Equals("Cell"))
 		{
-			// Get texture info
-			_pElemFrameInfo->GetAttribute("name", &m_sTexName);
-			_pElemFrameInfo->GetAttribute("type", &m_sTexType);
-			_pElemFrameInfo->GetAttribute("texw", &m_uTexWidth);
-			_pElemFrameInfo->GetAttribute("texh", &m_uTexHeight);
+			SXMLText const* _pCellName = _Scanner.FindAttribute("name");
+			if (_pCellName != nullptr)
+			{
+				DecodeText(*_pCellName, _sName);
+			}
+			else
+			{
+				_sName.clear();
+			}
 
-			// Find the sprite cell infos
-			ticpp::Element* _pChildElem = _pElemFrameInfo->FirstChildElement(false);
-			while (_pChildElem)
+			// Cells nobody wants aren't read any further
+			bool const _bWanted = (_pSprites == nullptr) || (_pCellName != nullptr && _pSprites->count(_sName) > 0);
+			if (_bWanted)
 			{
-				if (_pChildElem->Value() == "Cell")
+				SSpriteCell _Cell;
+				bool const _bValid = _pCellName != nullptr &&
+					ParseUint(_Scanner.FindAttribute("x"), _Cell.x) &&
+					ParseUint(_Scanner.FindAttribute("y"), _Cell.y) &&
+					ParseUint(_Scanner.FindAttribute("w"), _Cell.w) &&
+					ParseUint(_Scanner.FindAttribute("h"), _Cell.h);
+
+				if (_bValid)
 				{
-					ParseCell(_pChildElem);
+					ParseUint(_Scanner.FindAttribute("ax"), _Cell.ax);
+					ParseUint(_Scanner.FindAttribute("ay"), _Cell.ay);
+					ParseUint(_Scanner.FindAttribute("aw"), _Cell.aw);
+					ParseUint(_Scanner.FindAttribute("ah"), _Cell.ah);
+
+					_Cell.m_sName = _sName;
+					_Cell.CalculateNormalisedValues(m_uTexWidth, m_uTexHeight);
+
+					auto _itCell = m_mapSpriteData.lower_bound(_sName);
+					if (_itCell != m_mapSpriteData.end() && _itCell->first == _sName)
+					{
+						_itCell->second = std::move(_Cell);
+					}
+					else
+					{
+						m_mapSpriteData.emplace_hint(_itCell, _sName, std::move(_Cell));
+					}
 				}
-				else if (_pChildElem->Value() == "Animation")
+				else
 				{
-					ParseAnimation(_pChildElem);
+					fprintf(stderr, "Sprite sheet cell '%s' is missing its name or rectangle.\n", _sName.c_str());
 				}
-
-				_pChildElem = _pChildElem->NextSiblingElement(false);
 			}
 		}
+
+		if (_Scanner.IsEmptyElement() == false)
+		{
+			_vectorOpen.push_back(SOpenElement{ _eElement, _Name });
+		}
 	}
-	catch (ticpp::Exception& error)
+
+	if (_bHasFrameInformation == false)
 	{
-		fprintf(stderr, "%s\n", error.m_details.c_str());
-		assert(false);
+		fprintf(stderr, "Sprite sheet has no SpriteInformation/FrameInformation.\n");
 	}
 }
 
-void CSpriteSheet::SetTextureRes(TextureRes _eRes)
+bool CSpriteSheet::ParseXMLFile(std::string const& _sPath, std::set<std::string> const* _pSprites /*= nullptr*/)
 {
-	m_eResolution = _eRes;
+	FileHelper::SFileView _Compiled;
+	if (compiled_cache::Load(_sPath, compiled_cache::Kind::SpriteSheet, _Compiled) &&
+		ReadCompiled(_Compiled.m_pData, _Compiled.m_uSize, _pSprites))
+	{
+		return true;
+	}
+
+	FileHelper::SFileView const _XML = FileHelper::MapFileContents(_sPath);
+	if (_XML.IsEmpty())
+	{
+		return false;
+	}
 
-	float _fScale = 1.0f;
-	switch (m_eResolution)
+	ParseXML(_XML.GetChars(), _XML.m_uSize, _pSprites);
+
+	if (_pSprites != nullptr)
 	{
-		case CSpriteSheet::TextureRes::Low: {_fScale = 1.0f; break; }
-		case CSpriteSheet::TextureRes::High: {_fScale = 0.5f; break; }
-		case CSpriteSheet::TextureRes::Ultra: {_fScale = 0.25f; break; }
+		return true;
 	}
 
+	std::vector<uint8_t> _vectorCompiled;
+	WriteCompiled(_vectorCompiled);
+	compiled_cache::Store(_sPath, compiled_cache::Kind::SpriteSheet, _XML, _vectorCompiled);
+	return true;
+}
+
+void CSpriteSheet::SetTextureRes(TextureRes _eRes)
+{
+	m_eResolution = _eRes;
+
+	float const _fScale = GetTextureScale(m_eResolution);
 	for (auto &_itSpriteData : m_mapSpriteData)
 	{
 		_itSpriteData.second.m_fTextureScale = _fScale;
 	}
 }
-//========================================
\ No newline at end of file
+
+float CSpriteSheet::GetTextureScale(TextureRes _eRes)
+{
+	switch (_eRes)
+	{
+		case CSpriteSheet::TextureRes::Low: return 1.0f;
+		case CSpriteSheet::TextureRes::High: return 0.5f;
+		case CSpriteSheet::TextureRes::Ultra: return 0.25f;
+	}
+	return 1.0f;
+}
+
+uint32_t CSpriteSheet::GetDecodeScale(TextureRes _eAuthored, TextureRes _eWanted)
+{
+	int32_t const _iSteps = static_cast<int32_t>(_eAuthored) - static_cast<int32_t>(_eWanted);
+	return (_iSteps > 0) ? (1u << _iSteps) : 1u;
+}
+//========================================
+
+//========================================
+namespace
+{
+	// Bump whenever either record changes
+	uint32_t const c_uCompiledVersion = 1;
+
+	struct SCompiledHeader
+	{
+		uint32_t m_uVersion = c_uCompiledVersion;
+		uint32_t m_uTexName = 0;	// string index
+		uint32_t m_uTexType = 0;	// string index
+		uint32_t m_uTexWidth = 0;
+		uint32_t m_uTexHeight = 0;
+		uint32_t m_uResolution = 0;
+		uint32_t m_uCellCount = 0;
+	};
+
+	struct SCompiledCell
+	{
+		uint32_t m_uName;	// string index
+		uint32_t x, y;
+		uint32_t w, h;
+		uint32_t ax, ay;
+		uint32_t aw, ah;
+		float m_fMinX, m_fMinY;
+		float m_fMaxX, m_fMaxY;
+		float m_fTextureScale;
+	};
+};
+
+void CSpriteSheet::WriteCompiled(std::vector<uint8_t>& _vectorData) const
+{
+	CStringTableWriter _Strings;
+
+	SCompiledHeader _Header;
+	_Header.m_uTexName = _Strings.Add(m_sTexName);
+	_Header.m_uTexType = _Strings.Add(m_sTexType);
+	_Header.m_uTexWidth = m_uTexWidth;
+	_Header.m_uTexHeight = m_uTexHeight;
+	_Header.m_uResolution = static_cast<uint32_t>(m_eResolution);
+	_Header.m_uCellCount = static_cast<uint32_t>(m_mapSpriteData.size());
+
+	std::vector<SCompiledCell> _vectorCells;
+	_vectorCells.reserve(m_mapSpriteData.size());
+	for (auto const& _Item : m_mapSpriteData)
+	{
+		SSpriteCell const& _Cell = _Item.second;
+
+		SCompiledCell _Compiled;
+		_Compiled.m_uName = _Strings.Add(_Cell.m_sName);
+		_Compiled.x = _Cell.x;
+		_Compiled.y = _Cell.y;
+		_Compiled.w = _Cell.w;
+		_Compiled.h = _Cell.h;
+		_Compiled.ax = _Cell.ax;
+		_Compiled.ay = _Cell.ay;
+		_Compiled.aw = _Cell.aw;
+		_Compiled.ah = _Cell.ah;
+		_Compiled.m_fMinX = _Cell.m_fMinX;
+		_Compiled.m_fMinY = _Cell.m_fMinY;
+		_Compiled.m_fMaxX = _Cell.m_fMaxX;
+		_Compiled.m_fMaxY = _Cell.m_fMaxY;
+		_Compiled.m_fTextureScale = _Cell.m_fTextureScale;
+		_vectorCells.push_back(_Compiled);
+	}
+
+	CBinaryWriter _Writer;
+	_Writer.Write(_Header);
+	_Strings.Write(_Writer);
+	_Writer.WriteArray(_vectorCells.data(), _vectorCells.size());
+
+	_vectorData.swap(_Writer.GetData());
+}
+
+bool CSpriteSheet::ReadCompiled(uint8_t const* _pData, size_t _uSize, std::set<std::string> const* _pSprites /*= nullptr*/)
+{
+	CBinaryReader _Reader(_pData, _uSize);
+
+	SCompiledHeader _Header;
+	if (_Reader.Read(_Header) == false || _Header.m_uVersion != c_uCompiledVersion)
+	{
+		return false;
+	}
+
+	CStringTableReader _Strings;
+	if (_Strings.Read(_Reader) == false)
+	{
+		return false;
+	}
+
+	SCompiledCell const* _pCells = _Reader.ReadArray<SCompiledCell>(_Header.m_uCellCount);
+	if (_Reader.IsValid() == false ||
+		_Strings.IsValidIndex(_Header.m_uTexName) == false ||
+		_Strings.IsValidIndex(_Header.m_uTexType) == false ||
+		_Header.m_uResolution > static_cast<uint32_t>(TextureRes::Ultra))
+	{
+		return false;
+	}
+
+	for (uint32_t i = 0; i < _Header.m_uCellCount; ++i)
+	{
+		if (_Strings.IsValidIndex(_pCells[i].m_uName) == false)
+		{
+			return false;
+		}
+	}
+
+	m_sTexName = _Strings.Get(_Header.m_uTexName);
+	m_sTexType = _Strings.Get(_Header.m_uTexType);
+	m_uTexWidth = _Header.m_uTexWidth;
+	m_uTexHeight = _Header.m_uTexHeight;
+	m_eResolution = static_cast<TextureRes>(_Header.m_uResolution);
+
+	// Written in key order, so every insert goes straight on the end
+	m_mapSpriteData.clear();
+	std::string _sName;
+	for (uint32_t i = 0; i < _Header.m_uCellCount; ++i)
+	{
+		SCompiledCell const& _Compiled = _pCells[i];
+
+		_Strings.Get(_Compiled.m_uName, _sName);
+		if (_pSprites != nullptr && _pSprites->count(_sName) == 0)
+		{
+			continue;
+		}
+
+		SSpriteCell _Cell;
+		_Cell.m_sName = _sName;
+		_Cell.x = _Compiled.x;
+		_Cell.y = _Compiled.y;
+		_Cell.w = _Compiled.w;
+		_Cell.h = _Compiled.h;
+		_Cell.ax = _Compiled.ax;
+		_Cell.ay = _Compiled.ay;
+		_Cell.aw = _Compiled.aw;
+		_Cell.ah = _Compiled.ah;
+		_Cell.m_fMinX = _Compiled.m_fMinX;
+		_Cell.m_fMinY = _Compiled.m_fMinY;
+		_Cell.m_fMaxX = _Compiled.m_fMaxX;
+		_Cell.m_fMaxY = _Compiled.m_fMaxY;
+		_Cell.m_fTextureScale = _Compiled.m_fTextureScale;
+
+		m_mapSpriteData.emplace_hint(m_mapSpriteData.end(), _Cell.m_sName, _Cell);
+	}
+
+	return true;
+}
+//========================================
@@ -1,15 +1,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
+#include <set>
 #include <string>
 #include <memory>
-
-// Forward declarations
-namespace ticpp
-{
-	class Element;
-};
+#include <vector>
 
 //========================================
 class CSpriteSheet
@@ -47,16 +44,28 @@ public:
 	CSpriteSheet();
 	~CSpriteSheet();
 
-	void ParseXML(std::string const &_sXML);
+	// _pSprites (optional) is every cell that's wanted, the rest are skipped without being
+	// read. Compounds use a handful of the cells in a sheet.
+	void ParseXML(char const* _pXML, size_t const _uSize, std::set<std::string> const* _pSprites = nullptr);
+	// Goes through the compiled cache, only parses the XML on a miss. False if the file is missing or empty.
+	// A partial (_pSprites) parse isn't written to the cache.
+	bool ParseXMLFile(std::string const& _sPath, std::set<std::string> const* _pSprites = nullptr);
+
+	// Fixed layout binary form of everything ParseXML() reads. ReadCompiled() takes _pSprites like ParseXML().
+	void WriteCompiled(std::vector<uint8_t>& _vectorData) const;
+	bool ReadCompiled(uint8_t const* _pData, size_t _uSize, std::set<std::string> const* _pSprites = nullptr);
 
 	std::map<std::string, SSpriteCell> const& GetSpriteData() const { return m_mapSpriteData; }
 
 	void SetTextureRes(TextureRes _eRes);
 
-protected:
-	void ParseCell(ticpp::Element* _pElemCell);
-	void ParseAnimation(ticpp::Element* _pElemAnim);
+	// How much smaller (1, 2 or 4) a texture authored at _eAuthored can be decoded when only
+	// _eWanted is needed. Cell UVs are normalised so they still line up with the smaller texture.
+	static uint32_t GetDecodeScale(TextureRes _eAuthored, TextureRes _eWanted);
+	// World units a texel of a sheet authored at _eRes covers (Low is 1)
+	static float GetTextureScale(TextureRes _eRes);
 
+protected:
 	std::map<std::string, SSpriteCell> m_mapSpriteData;
 
 	std::string m_sTexName;
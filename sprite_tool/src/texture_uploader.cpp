@@ -0,0 +1,321 @@
+#include "texture_uploader.hpp"
+
+// gl stuff
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+// stl
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+//========================================
+uint32_t const CTextureUploader::c_uDefaultRingSize;
+uint32_t const CTextureUploader::c_uSegmentCount;
+
+namespace
+{
+	// Decoding is the slow part of a stream band, kept well under a segment so one band
+	// doesn't blow the frame budget on its own
+	size_t const c_uStreamBandBytes = 1024 * 1024;
+};
+//========================================
+
+//========================================
+CTextureUploader::CTextureUploader()
+{
+
+}
+
+CTextureUploader::~CTextureUploader()
+{
+	// Context has to still be current
+	Shutdown();
+}
+
+void CTextureUploader::Init(uint32_t const _uRingSize)
+{
+	Shutdown();
+
+	m_uRingSize = _uRingSize;
+	m_uSegmentSize = _uRingSize / c_uSegmentCount;
+	m_uSegment = 0;
+	m_bTextureStorage = (GLEW_ARB_texture_storage != 0);
+
+	glGenBuffers(1, &m_uBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uBuffer);
+
+	if (GLEW_ARB_buffer_storage && GLEW_ARB_sync)
+	{
+		GLbitfield const _uFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_uRingSize, nullptr, _uFlags);
+		m_pMapped = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_uRingSize, _uFlags));
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void CTextureUploader::Shutdown()
+{
+	CancelAll();
+
+	for (auto& _pFence : m_arrayFences)
+	{
+		if (_pFence != nullptr)
+		{
+			glDeleteSync(static_cast<GLsync>(_pFence));
+			_pFence = nullptr;
+		}
+	}
+
+	if (m_uBuffer != 0)
+	{
+		if (m_pMapped != nullptr)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			m_pMapped = nullptr;
+		}
+
+		glDeleteBuffers(1, &m_uBuffer);
+		m_uBuffer = 0;
+	}
+}
+//========================================
+
+//========================================
+uint32_t CTextureUploader::Queue(std::shared_ptr<FileHelper::tPixelBuffer> _pData,
+								 int32_t const _iWidth,
+								 int32_t const _iHeight,
+								 uint32_t const _uChannels,
+								 tOnComplete _OnComplete,
+								 std::vector<mip_chain::SLevel> const& _vectorMips)
+{
+	assert(m_uBuffer != 0);
+	assert(_pData != nullptr && _pData->size() >= static_cast<size_t>(_iWidth) * _iHeight * _uChannels);
+
+	SJob _Job;
+	_Job.m_pData = _pData;
+	_Job.m_vectorMips = _vectorMips;
+	_Job.m_iWidth = _iWidth;
+	_Job.m_iHeight = _iHeight;
+	_Job.m_uChannels = _uChannels;
+	_Job.m_OnComplete = _OnComplete;
+
+	CreateTexture(_Job);
+
+	uint32_t const _uTexture = _Job.m_uTexture;
+	m_dequeJobs.push_back(std::move(_Job));
+	return _uTexture;
+}
+
+uint32_t CTextureUploader::Queue(std::shared_ptr<FileHelper::CPNGStream> _pStream,
+								 tOnComplete _OnComplete,
+								 bool const _bMipmaps)
+{
+	assert(m_uBuffer != 0);
+	assert(_pStream != nullptr && _pStream->GetRowsRead() == 0);
+
+	SJob _Job;
+	_Job.m_pStream = _pStream;
+	_Job.m_bGenerateMips = _bMipmaps && (glGenerateMipmap != nullptr);
+	_Job.m_iWidth = _pStream->GetWidth();
+	_Job.m_iHeight = _pStream->GetHeight();
+	_Job.m_uChannels = _pStream->GetChannels();
+	_Job.m_OnComplete = _OnComplete;
+
+	CreateTexture(_Job);
+
+	uint32_t const _uTexture = _Job.m_uTexture;
+	m_dequeJobs.push_back(std::move(_Job));
+	return _uTexture;
+}
+
+void CTextureUploader::CreateTexture(SJob& _Job)
+{
+	int32_t const _iWidth = _Job.m_iWidth;
+	int32_t const _iHeight = _Job.m_iHeight;
+	uint32_t const _uChannels = _Job.m_uChannels;
+	uint32_t const _uLevels = _Job.GetLevelCount();
+
+	glGenTextures(1, &_Job.m_uTexture);
+	glBindTexture(GL_TEXTURE_2D, _Job.m_uTexture);
+	if (m_bTextureStorage)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, _uLevels, (_uChannels == 4) ? GL_RGBA8 : GL_RGB8, _iWidth, _iHeight);
+	}
+	else
+	{
+		uint32_t _eChannels = (_uChannels == 4) ? GL_RGBA : GL_RGB;
+		glTexImage2D(GL_TEXTURE_2D, 0, _eChannels, _iWidth, _iHeight, 0, _eChannels, GL_UNSIGNED_BYTE, nullptr);
+		for (uint32_t i = 0; i < _Job.m_vectorMips.size(); ++i)
+		{
+			mip_chain::SLevel const& _Level = _Job.m_vectorMips[i];
+			glTexImage2D(GL_TEXTURE_2D, i + 1, _eChannels, _Level.m_iWidth, _Level.m_iHeight, 0, _eChannels, GL_UNSIGNED_BYTE, nullptr);
+		}
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (_uLevels > 1) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _uLevels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+uint32_t CTextureUploader::SJob::GetLevelCount() const
+{
+	if (m_bGenerateMips)
+	{
+		return mip_chain::GetLevelCount(m_iWidth, m_iHeight);
+	}
+	return 1 + static_cast<uint32_t>(m_vectorMips.size());
+}
+
+uint8_t const* CTextureUploader::SJob::GetLevelData() const
+{
+	if (m_uLevel == 0)
+	{
+		return (m_pData != nullptr) ? m_pData->data() : nullptr;
+	}
+	return m_vectorMips[m_uLevel - 1].m_pData->data();
+}
+
+void CTextureUploader::Update(double const _dBudgetSeconds)
+{
+	if (m_dequeJobs.empty())
+	{
+		return;
+	}
+
+	auto const _Start = std::chrono::steady_clock::now();
+
+	// RGB rows aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_uBuffer);
+
+	while (m_dequeJobs.empty() == false)
+	{
+		SJob& _Job = m_dequeJobs.front();
+
+		if (UploadBand(_Job) == false)
+		{
+			break;
+		}
+
+		if (_Job.IsFinished())
+		{
+			SJob _Finished = std::move(_Job);
+			m_dequeJobs.pop_front();
+
+			if (_Finished.m_bGenerateMips)
+			{
+				glBindTexture(GL_TEXTURE_2D, _Finished.m_uTexture);
+				glGenerateMipmap(GL_TEXTURE_2D);
+			}
+
+			if (_Finished.m_OnComplete)
+			{
+				_Finished.m_OnComplete(_Finished.m_uTexture);
+			}
+		}
+
+		if (std::chrono::duration<double>(std::chrono::steady_clock::now() - _Start).count() > _dBudgetSeconds)
+		{
+			break;
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void CTextureUploader::CancelAll()
+{
+	for (auto& _Job : m_dequeJobs)
+	{
+		glDeleteTextures(1, &_Job.m_uTexture);
+	}
+	m_dequeJobs.clear();
+}
+
+bool CTextureUploader::UploadBand(SJob& _Job)
+{
+	int32_t const _iWidth = _Job.GetLevelWidth();
+	int32_t const _iHeight = _Job.GetLevelHeight();
+	GLint const _iLevel = static_cast<GLint>(_Job.m_uLevel);
+
+	size_t const _uRowBytes = static_cast<size_t>(_iWidth) * _Job.m_uChannels;
+	size_t const _uMaxBandBytes = (_Job.m_pStream != nullptr) ? std::min<size_t>(c_uStreamBandBytes, m_uSegmentSize) : m_uSegmentSize;
+	int32_t const _iMaxRows = std::max<int32_t>(1, static_cast<int32_t>(_uMaxBandBytes / _uRowBytes));
+	int32_t const _iRows = std::min(_iMaxRows, _iHeight - _Job.m_iNextRow);
+	size_t const _uBandBytes = _uRowBytes * _iRows;
+
+	uint8_t const* _pSource = (_Job.m_pStream == nullptr) ? _Job.GetLevelData() + _uRowBytes * _Job.m_iNextRow : nullptr;
+	GLenum const _eFormat = (_Job.m_uChannels == 4) ? GL_RGBA : GL_RGB;
+
+	if (m_pMapped != nullptr)
+	{
+		assert(_uBandBytes <= m_uSegmentSize);
+
+		// Segment is free once the GPU has finished the last upload that used it
+		GLsync _Fence = static_cast<GLsync>(m_arrayFences[m_uSegment]);
+		if (_Fence != nullptr)
+		{
+			if (glClientWaitSync(_Fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				return false;
+			}
+			glDeleteSync(_Fence);
+		}
+
+		size_t const _uOffset = static_cast<size_t>(m_uSegment) * m_uSegmentSize;
+		if (_Job.m_pStream != nullptr)
+		{
+			_Job.m_pStream->ReadRows(m_pMapped + _uOffset, _iRows);
+		}
+		else
+		{
+			memcpy(m_pMapped + _uOffset, _pSource, _uBandBytes);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, _Job.m_uTexture);
+		glTexSubImage2D(GL_TEXTURE_2D, _iLevel, 0, _Job.m_iNextRow, _iWidth, _iRows, _eFormat, GL_UNSIGNED_BYTE, reinterpret_cast<void const*>(_uOffset));
+
+		m_arrayFences[m_uSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_uSegment = (m_uSegment + 1) % c_uSegmentCount;
+	}
+	else
+	{
+		// Orphan so the driver never has to wait for the previous band
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, _uBandBytes, nullptr, GL_STREAM_DRAW);
+		if (_Job.m_pStream != nullptr)
+		{
+			// Decoded into the mapped buffer, the rows never exist anywhere else
+			uint8_t* _pBand = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, _uBandBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			if (_pBand == nullptr)
+			{
+				return false;
+			}
+			_Job.m_pStream->ReadRows(_pBand, _iRows);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		else
+		{
+			glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, _uBandBytes, _pSource);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, _Job.m_uTexture);
+		glTexSubImage2D(GL_TEXTURE_2D, _iLevel, 0, _Job.m_iNextRow, _iWidth, _iRows, _eFormat, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	// On to the next level once this one is in, the job is finished after the last
+	_Job.m_iNextRow += _iRows;
+	if (_Job.m_iNextRow >= _iHeight)
+	{
+		++_Job.m_uLevel;
+		_Job.m_iNextRow = 0;
+	}
+	return true;
+}
+//========================================
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "utility/file_helper.hpp"
+#include "utility/mip_chain.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+//========================================
+// Streams decoded images into GL textures a band of rows at a time, through a ring of
+// pixel unpack buffer segments, so a big atlas is spread over several frames instead
+// of one long glTexImage2D.
+//
+// With ARB_buffer_storage + ARB_sync the ring is one persistently mapped buffer and
+// each segment is fenced, rows are copied straight into it and never wait on the GPU.
+// Without, each band is orphaned into a plain PBO with glBufferData/glBufferSubData.
+// Textures get immutable storage (glTexStorage2D) where ARB_texture_storage exists.
+//
+// PNG streams are decoded straight into the buffer a band at a time as they're uploaded,
+// so nothing but the ring ever holds their pixels.
+//
+// Mip levels decoded with the pixels follow level 0 through the ring the same way. Streams
+// have none, they're mipmapped with glGenerateMipmap once their last row is in.
+//
+// Everything here must be called on the thread that owns the context.
+class CTextureUploader
+{
+public:
+	typedef std::function<void(uint32_t _uTexture)> tOnComplete;
+
+	static uint32_t const c_uDefaultRingSize = 16 * 1024 * 1024;
+	static uint32_t const c_uSegmentCount = 4;
+
+	CTextureUploader();
+	~CTextureUploader();
+
+	void Init(uint32_t const _uRingSize = c_uDefaultRingSize);
+	void Shutdown();
+
+	// Creates the texture now and queues its pixels (tightly packed rows, 3 or 4 channels) and
+	// any levels below them. The texture's contents are undefined until _OnComplete is called from Update().
+	uint32_t Queue(std::shared_ptr<FileHelper::tPixelBuffer> _pData,
+				   int32_t const _iWidth,
+				   int32_t const _iHeight,
+				   uint32_t const _uChannels,
+				   tOnComplete _OnComplete,
+				   std::vector<mip_chain::SLevel> const& _vectorMips = std::vector<mip_chain::SLevel>());
+
+	// Decodes and uploads the rows a band at a time in Update(), always RGBA
+	uint32_t Queue(std::shared_ptr<FileHelper::CPNGStream> _pStream,
+				   tOnComplete _OnComplete,
+				   bool const _bMipmaps = false);
+
+	// Uploads bands until the time budget is spent or the ring is full (never waits on the GPU)
+	void Update(double const _dBudgetSeconds);
+
+	// Drops everything queued and deletes the textures that hadn't finished
+	void CancelAll();
+
+	bool IsIdle() const { return m_dequeJobs.empty(); }
+	bool IsPersistent() const { return m_pMapped != nullptr; }
+
+protected:
+	struct SJob
+	{
+		std::shared_ptr<FileHelper::tPixelBuffer> m_pData;
+		std::shared_ptr<FileHelper::CPNGStream> m_pStream;	// instead of m_pData
+		std::vector<mip_chain::SLevel> m_vectorMips;		// levels 1 and down
+		bool m_bGenerateMips = false;						// streams only
+		uint32_t m_uTexture = 0;
+		int32_t m_iWidth = 0;
+		int32_t m_iHeight = 0;
+		uint32_t m_uChannels = 4;
+		uint32_t m_uLevel = 0;			// being uploaded
+		int32_t m_iNextRow = 0;			// of m_uLevel
+		tOnComplete m_OnComplete;
+
+		uint32_t GetLevelCount() const;
+		int32_t GetLevelWidth() const { return (m_uLevel == 0) ? m_iWidth : m_vectorMips[m_uLevel - 1].m_iWidth; }
+		int32_t GetLevelHeight() const { return (m_uLevel == 0) ? m_iHeight : m_vectorMips[m_uLevel - 1].m_iHeight; }
+		uint8_t const* GetLevelData() const;
+		bool IsFinished() const { return m_uLevel > m_vectorMips.size(); }
+	};
+
+	// Creates the texture for a job that has its size and channels set
+	void CreateTexture(SJob& _Job);
+	// False if the next segment is still in use by the GPU
+	bool UploadBand(SJob& _Job);
+
+	std::deque<SJob> m_dequeJobs;
+
+	uint32_t m_uBuffer = 0;
+	uint32_t m_uRingSize = 0;
+	uint32_t m_uSegmentSize = 0;
+	uint32_t m_uSegment = 0;		// next segment to write
+	uint8_t* m_pMapped = nullptr;	// persistent mapping, null on the fallback path
+	void* m_arrayFences[c_uSegmentCount] = {};
+
+	bool m_bTextureStorage = false;
+};
+//========================================
@@ -0,0 +1,449 @@
+#include "asset_pack.hpp"
+
+#include "file_helper.hpp"
+#include "hash_helper.hpp"
+#include "stl_helper.hpp"
+#include "thread_pool.hpp"
+
+#include "zlib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+
+//========================================
+namespace
+{
+	uint32_t const c_uMagic = 0x4B505453;	// "STPK"
+	uint32_t const c_uVersion = 1;
+
+	// Files read and compressed at once while building, bounds the memory used
+	size_t const c_uBuildBatchSize = 64;
+
+	// Deflate can't shrink anything by more than this, a zlib entry claiming more is damaged
+	uint64_t const c_uMaxInflateRatio = 1032;
+	// Whatever it claims, nothing bigger is inflated into memory
+	uint64_t const c_uMaxInflatedSize = 1024ull * 1024 * 1024;
+
+	struct SHeader
+	{
+		uint32_t m_uMagic = c_uMagic;
+		uint32_t m_uVersion = c_uVersion;
+		uint32_t m_uEntryCount = 0;
+		uint32_t m_uPathBlobSize = 0;
+		uint64_t m_uIndexOffset = 0;		// paths follow the index
+		uint64_t m_uReserved = 0;
+	};
+	static_assert(sizeof(SHeader) == 32, "pack header layout changed, bump c_uVersion");
+	static_assert(sizeof(CAssetPack::SEntry) == 56, "pack entry layout changed, bump c_uVersion");
+
+	bool EntryLess(CAssetPack::SEntry const& _A, CAssetPack::SEntry const& _B)
+	{
+		return _A.m_uPathHash < _B.m_uPathHash;
+	}
+
+	struct SMount
+	{
+		std::string m_sFolder;		// normalised, no trailing '/'
+		std::shared_ptr<CAssetPack const> m_pPack;
+	};
+
+	std::mutex s_MountMutex;
+	std::vector<SMount> s_vectorMounts;
+	std::atomic<bool> s_bHasMounts(false);
+};
+//========================================
+
+//========================================
+CAssetPack::CAssetPack()
+{
+
+}
+
+CAssetPack::~CAssetPack()
+{
+	Close();
+}
+
+bool CAssetPack::Open(std::string const& _sPackPath)
+{
+	Close();
+
+	if (m_MappedFile.Open(_sPackPath) == false)
+	{
+		fprintf(stdout, "Failed to open asset pack '%s'.\n", _sPackPath.c_str());
+		return false;
+	}
+
+	uint8_t const* _pData = m_MappedFile.GetData();
+	size_t const _uSize = m_MappedFile.GetSize();
+
+	SHeader _Header;
+	if (_uSize < sizeof(SHeader))
+	{
+		Close();
+		return false;
+	}
+	memcpy(&_Header, _pData, sizeof(SHeader));
+
+	uint64_t const _uIndexSize = static_cast<uint64_t>(_Header.m_uEntryCount) * sizeof(SEntry);
+	if (_Header.m_uMagic != c_uMagic ||
+		_Header.m_uVersion != c_uVersion ||
+		(_Header.m_uIndexOffset % 8) != 0 ||
+		_Header.m_uIndexOffset > _uSize ||
+		_uIndexSize + _Header.m_uPathBlobSize > _uSize - _Header.m_uIndexOffset)
+	{
+		fprintf(stdout, "'%s' isn't an asset pack, or is damaged.\n", _sPackPath.c_str());
+		Close();
+		return false;
+	}
+
+	m_pEntries = reinterpret_cast<SEntry const*>(_pData + _Header.m_uIndexOffset);
+	m_uEntryCount = _Header.m_uEntryCount;
+	m_pPaths = reinterpret_cast<char const*>(_pData + _Header.m_uIndexOffset + _uIndexSize);
+
+	for (uint32_t i = 0; i < m_uEntryCount; ++i)
+	{
+		SEntry const& _Entry = m_pEntries[i];
+		if (_Entry.m_uOffset > _uSize ||
+			_Entry.m_uStoredSize > _uSize - _Entry.m_uOffset ||
+			_Entry.m_uPathOffset > _Header.m_uPathBlobSize ||
+			_Entry.m_uPathLength > _Header.m_uPathBlobSize - _Entry.m_uPathOffset ||
+			_Entry.m_uCompression > static_cast<uint32_t>(Compression::Zlib))
+		{
+			fprintf(stdout, "Asset pack '%s' is damaged.\n", _sPackPath.c_str());
+			Close();
+			return false;
+		}
+
+		// Stored entries are read straight out of the mapping, so their size has to be what's there.
+		// Zlib sizes are allocated up front before inflating.
+		bool const _bStored = (_Entry.m_uCompression == static_cast<uint32_t>(Compression::Stored));
+		if ((_bStored && _Entry.m_uSize != _Entry.m_uStoredSize) ||
+			(_bStored == false && (_Entry.m_uSize > _Entry.m_uStoredSize * c_uMaxInflateRatio || _Entry.m_uSize > c_uMaxInflatedSize)))
+		{
+			fprintf(stdout, "Asset pack '%s' is damaged.\n", _sPackPath.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CAssetPack::Close()
+{
+	m_MappedFile.Close();
+	m_pEntries = nullptr;
+	m_uEntryCount = 0;
+	m_pPaths = nullptr;
+}
+
+CAssetPack::SEntry const* CAssetPack::Find(std::string const& _sRelativePath) const
+{
+	std::string const _sPath = NormalisePath(_sRelativePath);
+
+	SEntry _Key = {};
+	_Key.m_uPathHash = hash_helper::Hash64(_sPath.data(), _sPath.size());
+
+	SEntry const* const _pEnd = m_pEntries + m_uEntryCount;
+	for (SEntry const* _pEntry = std::lower_bound(m_pEntries, _pEnd, _Key, EntryLess); _pEntry != _pEnd && _pEntry->m_uPathHash == _Key.m_uPathHash; ++_pEntry)
+	{
+		if (_pEntry->m_uPathLength == _sPath.size() && memcmp(m_pPaths + _pEntry->m_uPathOffset, _sPath.data(), _sPath.size()) == 0)
+		{
+			return _pEntry;
+		}
+	}
+
+	return nullptr;
+}
+
+std::string CAssetPack::GetPath(SEntry const& _Entry) const
+{
+	return std::string(m_pPaths + _Entry.m_uPathOffset, _Entry.m_uPathLength);
+}
+
+uint8_t const* CAssetPack::GetStoredData(SEntry const& _Entry) const
+{
+	if (_Entry.m_uCompression != static_cast<uint32_t>(Compression::Stored))
+	{
+		return nullptr;
+	}
+	return m_MappedFile.GetData() + _Entry.m_uOffset;
+}
+
+bool CAssetPack::Read(SEntry const& _Entry, std::vector<uint8_t>& _vectorData) const
+{
+	uint8_t const* _pStored = m_MappedFile.GetData() + _Entry.m_uOffset;
+
+	if (_Entry.m_uCompression == static_cast<uint32_t>(Compression::Stored))
+	{
+		_vectorData.assign(_pStored, _pStored + _Entry.m_uStoredSize);
+		return true;
+	}
+
+	_vectorData.resize(static_cast<size_t>(_Entry.m_uSize));
+	uLongf _uInflatedSize = static_cast<uLongf>(_Entry.m_uSize);
+	int const _iResult = uncompress(_vectorData.data(), &_uInflatedSize, _pStored, static_cast<uLong>(_Entry.m_uStoredSize));
+	if (_iResult != Z_OK || _uInflatedSize != _Entry.m_uSize)
+	{
+		fprintf(stdout, "Failed to inflate '%s' from an asset pack.\n", GetPath(_Entry).c_str());
+		_vectorData.clear();
+		return false;
+	}
+
+	return true;
+}
+//========================================
+
+//========================================
+bool CAssetPack::Build(std::string const& _sFolder, std::string const& _sPackPath, bool const _bCompress, bool const _bRestartMarkers)
+{
+	struct SSource
+	{
+		std::string m_sPath;		// as on disk, relative
+		std::string m_sPackPath;	// normalised
+	};
+
+	std::vector<SSource> _vectorSources;
+	for (auto const& _sFile : FileHelper::ListFiles(_sFolder))
+	{
+		SSource _Source;
+		_Source.m_sPath = _sFile;
+		_Source.m_sPackPath = NormalisePath(_sFile);
+		_vectorSources.push_back(_Source);
+	}
+
+	std::sort(_vectorSources.begin(), _vectorSources.end(), [](SSource const& _A, SSource const& _B) { return _A.m_sPackPath < _B.m_sPackPath; });
+
+	std::ofstream _File(_sPackPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!_File)
+	{
+		fprintf(stdout, "Couldn't create asset pack '%s'.\n", _sPackPath.c_str());
+		return false;
+	}
+
+	SHeader _Header;
+	_File.write(reinterpret_cast<char const*>(&_Header), sizeof(_Header));
+	uint64_t _uOffset = sizeof(_Header);
+
+	char const _arrayPadding[8] = {};
+	auto PadTo8 = [&]()
+	{
+		size_t const _uPadding = static_cast<size_t>((8 - (_uOffset % 8)) % 8);
+		_File.write(_arrayPadding, _uPadding);
+		_uOffset += _uPadding;
+	};
+
+	std::vector<SEntry> _vectorEntries;
+	std::string _sPathBlob;
+
+	struct SPacked
+	{
+		std::vector<uint8_t> m_vectorData;
+		uint64_t m_uSize = 0;
+		uint64_t m_uModifiedTime = 0;
+		Compression m_eCompression = Compression::Stored;
+	};
+
+	for (size_t _uBatch = 0; _uBatch < _vectorSources.size(); _uBatch += c_uBuildBatchSize)
+	{
+		size_t const _uBatchCount = std::min(c_uBuildBatchSize, _vectorSources.size() - _uBatch);
+		std::vector<SPacked> _vectorPacked(_uBatchCount);
+
+		CTaskGroup _Tasks(CThreadPool::GetShared());
+		for (size_t i = 0; i < _uBatchCount; ++i)
+		{
+			_Tasks.Run([&, i]()
+			{
+				std::string const _sSourcePath = _sFolder + "/" + _vectorSources[_uBatch + i].m_sPath;
+
+				SPacked& _Packed = _vectorPacked[i];
+				_Packed.m_vectorData = FileHelper::GetFileContents(_sSourcePath);
+
+				if (_bRestartMarkers)
+				{
+					std::string const _sExtension = stl_helper::ToLower(_sSourcePath.substr(_sSourcePath.rfind('.') + 1));
+					if (_sExtension == "jpg" || _sExtension == "jpeg" || _sExtension == "jpng")
+					{
+						if (FileHelper::AddJPEGRestartMarkers(_Packed.m_vectorData, _sExtension == "jpng") == false)
+						{
+							fprintf(stdout, "Couldn't add restart markers to '%s', packed as is.\n", _sSourcePath.c_str());
+						}
+					}
+				}
+				_Packed.m_uSize = _Packed.m_vectorData.size();
+				_Packed.m_uModifiedTime = FileHelper::GetFileModifiedTime(_sSourcePath);
+
+				// Too big to be inflated back when it's opened, kept as it is
+				if (_bCompress == false || _Packed.m_vectorData.empty() || _Packed.m_uSize > c_uMaxInflatedSize)
+				{
+					return;
+				}
+
+				std::vector<uint8_t> _vectorCompressed(compressBound(static_cast<uLong>(_Packed.m_vectorData.size())));
+				uLongf _uCompressedSize = static_cast<uLongf>(_vectorCompressed.size());
+				if (compress2(_vectorCompressed.data(), &_uCompressedSize, _Packed.m_vectorData.data(), static_cast<uLong>(_Packed.m_vectorData.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+				{
+					return;
+				}
+
+				// Already compressed formats barely shrink, not worth inflating on every load
+				if (_uCompressedSize < _Packed.m_uSize - _Packed.m_uSize / 16)
+				{
+					_vectorCompressed.resize(_uCompressedSize);
+					_Packed.m_vectorData.swap(_vectorCompressed);
+					_Packed.m_eCompression = Compression::Zlib;
+				}
+			});
+		}
+		_Tasks.Wait();
+
+		for (size_t i = 0; i < _uBatchCount; ++i)
+		{
+			SSource const& _Source = _vectorSources[_uBatch + i];
+			SPacked const& _Packed = _vectorPacked[i];
+
+			// Only differed by case or separators
+			if (_vectorEntries.empty() == false && _sPathBlob.compare(_vectorEntries.back().m_uPathOffset, _vectorEntries.back().m_uPathLength, _Source.m_sPackPath) == 0)
+			{
+				fprintf(stdout, "Skipping '%s', already packed under the same name.\n", _Source.m_sPath.c_str());
+				continue;
+			}
+
+			PadTo8();
+
+			SEntry _Entry = {};
+			_Entry.m_uPathHash = hash_helper::Hash64(_Source.m_sPackPath.data(), _Source.m_sPackPath.size());
+			_Entry.m_uOffset = _uOffset;
+			_Entry.m_uStoredSize = _Packed.m_vectorData.size();
+			_Entry.m_uSize = _Packed.m_uSize;
+			_Entry.m_uModifiedTime = _Packed.m_uModifiedTime;
+			_Entry.m_uPathOffset = static_cast<uint32_t>(_sPathBlob.size());
+			_Entry.m_uPathLength = static_cast<uint32_t>(_Source.m_sPackPath.size());
+			_Entry.m_uCompression = static_cast<uint32_t>(_Packed.m_eCompression);
+			_vectorEntries.push_back(_Entry);
+			_sPathBlob += _Source.m_sPackPath;
+
+			_File.write(reinterpret_cast<char const*>(_Packed.m_vectorData.data()), _Packed.m_vectorData.size());
+			_uOffset += _Packed.m_vectorData.size();
+		}
+	}
+
+	// Stable, so colliding hashes stay in path order
+	std::stable_sort(_vectorEntries.begin(), _vectorEntries.end(), EntryLess);
+
+	PadTo8();
+	_Header.m_uEntryCount = static_cast<uint32_t>(_vectorEntries.size());
+	_Header.m_uPathBlobSize = static_cast<uint32_t>(_sPathBlob.size());
+	_Header.m_uIndexOffset = _uOffset;
+
+	_File.write(reinterpret_cast<char const*>(_vectorEntries.data()), _vectorEntries.size() * sizeof(SEntry));
+	_File.write(_sPathBlob.data(), _sPathBlob.size());
+
+	_File.seekp(0);
+	_File.write(reinterpret_cast<char const*>(&_Header), sizeof(_Header));
+
+	if (!_File)
+	{
+		fprintf(stdout, "Failed writing asset pack '%s'.\n", _sPackPath.c_str());
+		return false;
+	}
+
+	fprintf(stdout, "Packed %u files from '%s' into '%s'.\n", _Header.m_uEntryCount, _sFolder.c_str(), _sPackPath.c_str());
+	return true;
+}
+
+std::string CAssetPack::NormalisePath(std::string const& _sPath)
+{
+	std::string _sNormalised = _sPath;
+	for (auto& _c : _sNormalised)
+	{
+		_c = (_c == '\\') ? '/' : static_cast<char>(tolower(static_cast<unsigned char>(_c)));
+	}
+	return _sNormalised;
+}
+//========================================
+
+//========================================
+bool CAssetPack::Mount(std::string const& _sPackPath, std::string const& _sMountFolder)
+{
+	auto _pPack = std::make_shared<CAssetPack>();
+	if (_pPack->Open(_sPackPath) == false)
+	{
+		return false;
+	}
+
+	std::string _sFolder = _sMountFolder;
+	if (_sFolder.empty())
+	{
+		std::string const _sAbsPackPath = FileHelper::GetAbsolutePath(_sPackPath);
+		size_t const _uSlash = _sAbsPackPath.find_last_of("/\\");
+		_sFolder = (_uSlash == std::string::npos) ? std::string() : _sAbsPackPath.substr(0, _uSlash);
+	}
+
+	SMount _Mount;
+	_Mount.m_sFolder = NormalisePath(FileHelper::GetAbsolutePath(_sFolder));
+	while (_Mount.m_sFolder.empty() == false && _Mount.m_sFolder.back() == '/')
+	{
+		_Mount.m_sFolder.pop_back();
+	}
+	_Mount.m_pPack = _pPack;
+
+	std::lock_guard<std::mutex> _Lock(s_MountMutex);
+	s_vectorMounts.push_back(_Mount);
+	s_bHasMounts = true;
+
+	fprintf(stdout, "Mounted asset pack '%s' (%u files) at '%s'.\n", _sPackPath.c_str(), _pPack->GetEntryCount(), _Mount.m_sFolder.c_str());
+	return true;
+}
+
+void CAssetPack::UnmountAll()
+{
+	// Anything still reading holds its own reference to the pack
+	std::lock_guard<std::mutex> _Lock(s_MountMutex);
+	s_vectorMounts.clear();
+	s_bHasMounts = false;
+}
+
+bool CAssetPack::HasMounts()
+{
+	return s_bHasMounts;
+}
+
+bool CAssetPack::FindMounted(std::string const& _sAbsPath, SMountedEntry& _Entry)
+{
+	if (s_bHasMounts == false)
+	{
+		return false;
+	}
+
+	std::string const _sPath = NormalisePath(_sAbsPath);
+
+	std::lock_guard<std::mutex> _Lock(s_MountMutex);
+	for (auto _itMount = s_vectorMounts.rbegin(); _itMount != s_vectorMounts.rend(); ++_itMount)
+	{
+		std::string const& _sFolder = _itMount->m_sFolder;
+		if (_sPath.size() <= _sFolder.size() + 1 ||
+			_sPath.compare(0, _sFolder.size(), _sFolder) != 0 ||
+			_sPath[_sFolder.size()] != '/')
+		{
+			continue;
+		}
+
+		SEntry const* _pEntry = _itMount->m_pPack->Find(_sPath.substr(_sFolder.size() + 1));
+		if (_pEntry != nullptr)
+		{
+			_Entry.m_pPack = _itMount->m_pPack;
+			_Entry.m_pEntry = _pEntry;
+			return true;
+		}
+	}
+
+	return false;
+}
+//========================================
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//========================================
+// One file holding a whole asset folder, so a deployment opens one file instead of
+// thousands of small ones.
+//
+// Layout: header, then every entry's data (8 byte aligned), then the index sorted by
+// path hash, then the paths. The pack is mapped and never read into memory; stored
+// entries are handed out as pointers into the mapping, zlib ones are inflated by whoever
+// asks for them, so any number of threads can decompress at once.
+//
+// Paths are relative to the packed folder, '/' separated and lower case.
+//
+// Mounted packs sit under a folder on disk and FileHelper looks in them first, so
+// everything that goes through it (compounds, sheets, images) reads from the pack
+// without knowing.
+class CAssetPack
+{
+public:
+	enum class Compression : uint32_t
+	{
+		Stored = 0,
+		Zlib = 1,
+	};
+
+	struct SEntry
+	{
+		uint64_t m_uPathHash;
+		uint64_t m_uOffset;			// from the start of the pack
+		uint64_t m_uStoredSize;
+		uint64_t m_uSize;
+		uint64_t m_uModifiedTime;	// of the source file when packed
+		uint32_t m_uPathOffset;		// into the path blob
+		uint32_t m_uPathLength;
+		uint32_t m_uCompression;
+		uint32_t m_uReserved;
+	};
+
+	CAssetPack();
+	~CAssetPack();
+
+	bool Open(std::string const& _sPackPath);
+	void Close();
+
+	uint32_t GetEntryCount() const { return m_uEntryCount; }
+	SEntry const* Find(std::string const& _sRelativePath) const;
+	std::string GetPath(SEntry const& _Entry) const;
+
+	// Straight into the mapping for stored entries, null for compressed ones
+	uint8_t const* GetStoredData(SEntry const& _Entry) const;
+	// Copies or inflates, safe from any thread
+	bool Read(SEntry const& _Entry, std::vector<uint8_t>& _vectorData) const;
+
+	// Packs every file under _sFolder. Compressing is spread over the shared thread pool,
+	// anything that doesn't shrink (PNG, JPEG) is stored as is. _bRestartMarkers re-exports
+	// JPEG and JPNG with restart markers (see FileHelper::AddJPEGRestartMarkers()).
+	static bool Build(std::string const& _sFolder, std::string const& _sPackPath, bool const _bCompress = true, bool const _bRestartMarkers = false);
+
+	static std::string NormalisePath(std::string const& _sPath);
+
+	//---------- mounted packs, searched by FileHelper
+	// _sMountFolder defaults to the folder the pack is in
+	static bool Mount(std::string const& _sPackPath, std::string const& _sMountFolder = "");
+	static void UnmountAll();
+	static bool HasMounts();
+
+	struct SMountedEntry
+	{
+		std::shared_ptr<CAssetPack const> m_pPack;	// keeps the mapping alive
+		SEntry const* m_pEntry = nullptr;
+	};
+	// _sAbsPath is absolute. The most recently mounted pack wins.
+	static bool FindMounted(std::string const& _sAbsPath, SMountedEntry& _Entry);
+
+protected:
+	CMappedFile m_MappedFile;
+
+	SEntry const* m_pEntries = nullptr;
+	uint32_t m_uEntryCount = 0;
+	char const* m_pPaths = nullptr;
+};
+//========================================
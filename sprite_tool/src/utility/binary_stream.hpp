@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//========================================
+// Flat little endian blobs of plain structs, for files that are read back by pointing
+// at them rather than parsing. Arrays are 8 byte aligned relative to the start, so a
+// reader over an aligned buffer (or a mapping) can use them in place.
+class CBinaryWriter
+{
+public:
+	template<typename T>
+	void Write(T const& _Value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written");
+		Append(&_Value, sizeof(T));
+	}
+
+	template<typename T>
+	void WriteArray(T const* _pValues, size_t _uCount)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data can be written");
+		Align();
+		Append(_pValues, sizeof(T) * _uCount);
+	}
+
+	void Align()
+	{
+		m_vectorData.resize((m_vectorData.size() + 7) & ~static_cast<size_t>(7), 0);
+	}
+
+	std::vector<uint8_t>& GetData() { return m_vectorData; }
+
+protected:
+	void Append(void const* _pData, size_t _uSize)
+	{
+		size_t const _uOffset = m_vectorData.size();
+		m_vectorData.resize(_uOffset + _uSize);
+		if (_uSize > 0)
+		{
+			memcpy(m_vectorData.data() + _uOffset, _pData, _uSize);
+		}
+	}
+
+	std::vector<uint8_t> m_vectorData;
+};
+
+// Bounds checked, once anything runs off the end every read fails and IsValid() is false
+class CBinaryReader
+{
+public:
+	CBinaryReader(uint8_t const* _pData, size_t _uSize)
+		: m_pData(_pData)
+		, m_uSize(_uSize)
+	{ }
+
+	template<typename T>
+	bool Read(T& _Value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read");
+		if (Reserve(sizeof(T)) == false)
+		{
+			return false;
+		}
+		memcpy(&_Value, m_pData + m_uOffset, sizeof(T));
+		m_uOffset += sizeof(T);
+		return true;
+	}
+
+	// Points into the data, null if there aren't _uCount of them
+	template<typename T>
+	T const* ReadArray(size_t _uCount)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "only plain data can be read");
+		Align();
+		if (_uCount > (m_uSize / sizeof(T)) || Reserve(sizeof(T) * _uCount) == false)
+		{
+			m_bValid = false;
+			return nullptr;
+		}
+		T const* _pValues = reinterpret_cast<T const*>(m_pData + m_uOffset);
+		m_uOffset += sizeof(T) * _uCount;
+		return _pValues;
+	}
+
+	bool IsValid() const { return m_bValid; }
+
+protected:
+	void Align()
+	{
+		m_uOffset = (m_uOffset + 7) & ~static_cast<size_t>(7);
+	}
+
+	bool Reserve(size_t _uSize)
+	{
+		m_bValid = m_bValid && m_uOffset <= m_uSize && _uSize <= m_uSize - m_uOffset;
+		return m_bValid;
+	}
+
+	uint8_t const* m_pData = nullptr;
+	size_t m_uSize = 0;
+	size_t m_uOffset = 0;
+	bool m_bValid = true;
+};
+
+// Strings as indices into one shared blob, repeats are only stored once
+class CStringTableWriter
+{
+public:
+	uint32_t Add(std::string const& _sString)
+	{
+		auto _itString = m_mapIndices.find(_sString);
+		if (_itString != m_mapIndices.end())
+		{
+			return _itString->second;
+		}
+
+		uint32_t const _uIndex = static_cast<uint32_t>(m_vectorRanges.size());
+		m_vectorRanges.push_back(static_cast<uint32_t>(m_sBlob.size()));
+		m_vectorRanges.push_back(static_cast<uint32_t>(_sString.size()));
+		m_sBlob += _sString;
+		m_mapIndices[_sString] = _uIndex / 2;
+		return _uIndex / 2;
+	}
+
+	void Write(CBinaryWriter& _Writer) const
+	{
+		_Writer.Write(static_cast<uint32_t>(m_vectorRanges.size() / 2));
+		_Writer.Write(static_cast<uint32_t>(m_sBlob.size()));
+		_Writer.WriteArray(m_vectorRanges.data(), m_vectorRanges.size());
+		_Writer.WriteArray(m_sBlob.data(), m_sBlob.size());
+	}
+
+protected:
+	std::map<std::string, uint32_t> m_mapIndices;
+	std::vector<uint32_t> m_vectorRanges;	// offset, length pairs
+	std::string m_sBlob;
+};
+
+class CStringTableReader
+{
+public:
+	bool Read(CBinaryReader& _Reader)
+	{
+		uint32_t _uBlobSize = 0;
+		if (_Reader.Read(m_uCount) == false || _Reader.Read(_uBlobSize) == false)
+		{
+			return false;
+		}
+
+		m_pRanges = _Reader.ReadArray<uint32_t>(static_cast<size_t>(m_uCount) * 2);
+		m_pBlob = _Reader.ReadArray<char>(_uBlobSize);
+		if (_Reader.IsValid() == false)
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < m_uCount; ++i)
+		{
+			if (m_pRanges[i * 2] > _uBlobSize || m_pRanges[i * 2 + 1] > _uBlobSize - m_pRanges[i * 2])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IsValidIndex(uint32_t _uIndex) const { return _uIndex < m_uCount; }
+	std::string Get(uint32_t _uIndex) const { return std::string(m_pBlob + m_pRanges[_uIndex * 2], m_pRanges[_uIndex * 2 + 1]); }
+	// Into an existing string, reuses its buffer
+	void Get(uint32_t _uIndex, std::string& _sOut) const { _sOut.assign(m_pBlob + m_pRanges[_uIndex * 2], m_pRanges[_uIndex * 2 + 1]); }
+
+protected:
+	uint32_t m_uCount = 0;
+	uint32_t const* m_pRanges = nullptr;
+	char const* m_pBlob = nullptr;
+};
+//========================================
@@ -0,0 +1,893 @@
+#include "block_compression.hpp"
+
+#include "cpu_features.hpp"
+#include "thread_pool.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+//========================================
+namespace block_compression
+{
+	namespace
+	{
+		// Bump whenever the encoders write anything different, so cached results are redone
+		uint32_t const c_uEncoderVersion = 1;
+
+		// Fewer than this and the threads cost more than they save
+		size_t const c_uMinBlocksPerThread = 4096;
+
+		uint32_t const c_uBlockTexels = 16;
+
+		// How far each index is from the first endpoint to the second
+		float const c_arrayBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float const c_arrayAlphaWeights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+		// Out of 64, from the BC7 spec
+		uint32_t const c_arrayBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		uint32_t GetRefinePasses(Quality const _eQuality)
+		{
+			switch (_eQuality)
+			{
+				case Quality::Fast: return 0;
+				case Quality::Normal: return 2;
+				default: return 8;
+			}
+		}
+
+		float Saturate(float const _fValue)
+		{
+			return std::min(255.0f, std::max(0.0f, _fValue));
+		}
+
+		uint8_t ToByte(float const _fValue)
+		{
+			return static_cast<uint8_t>(Saturate(_fValue) + 0.5f);
+		}
+
+		// 4x4 RGBA texels from the rows, repeating the last column and row past the edges
+		void GatherBlock(uint8_t const* _pRows, size_t const _uRowBytes, uint32_t const _uChannels, int32_t const _iWidth, int32_t const _iRows, int32_t const _iX, uint8_t* _pTexels)
+		{
+			for (int32_t y = 0; y < 4; ++y)
+			{
+				uint8_t const* _pRow = _pRows + std::min(y, _iRows - 1) * _uRowBytes;
+				for (int32_t x = 0; x < 4; ++x)
+				{
+					uint8_t const* _pTexel = _pRow + std::min(_iX + x, _iWidth - 1) * _uChannels;
+					uint8_t* _pDest = _pTexels + (y * 4 + x) * 4;
+					_pDest[0] = _pTexel[0];
+					_pDest[1] = _pTexel[1];
+					_pDest[2] = _pTexel[2];
+					_pDest[3] = (_uChannels == 4) ? _pTexel[3] : 0xff;
+				}
+			}
+		}
+
+		// Ends of the principal axis of the texels' first N channels, as far along it as the
+		// texels reach either way
+		template <uint32_t N>
+		void FitPrincipalAxis(uint8_t const* _pTexels, float* _pLow, float* _pHigh)
+		{
+			// Sums in integers, exact and a lot quicker than accumulating offsets from the mean
+			int32_t _arraySums[4] = {};
+			int32_t _arrayProducts[4][4] = {};
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				uint8_t const* _pTexel = _pTexels + i * 4;
+				for (uint32_t a = 0; a < N; ++a)
+				{
+					_arraySums[a] += _pTexel[a];
+					for (uint32_t b = a; b < N; ++b)
+					{
+						_arrayProducts[a][b] += _pTexel[a] * _pTexel[b];
+					}
+				}
+			}
+
+			float _arrayMean[4] = {};
+			float _arrayCovariance[4][4] = {};
+			for (uint32_t a = 0; a < N; ++a)
+			{
+				_arrayMean[a] = _arraySums[a] / static_cast<float>(c_uBlockTexels);
+				_pLow[a] = _arrayMean[a];
+				_pHigh[a] = _arrayMean[a];
+				for (uint32_t b = a; b < N; ++b)
+				{
+					int32_t const _iScaled = _arrayProducts[a][b] * static_cast<int32_t>(c_uBlockTexels) - _arraySums[a] * _arraySums[b];
+					_arrayCovariance[a][b] = _iScaled / static_cast<float>(c_uBlockTexels);
+				}
+			}
+
+			// Power iteration, from the channel that varies most
+			uint32_t _uWidest = 0;
+			for (uint32_t a = 0; a < N; ++a)
+			{
+				for (uint32_t b = 0; b < a; ++b)
+				{
+					_arrayCovariance[a][b] = _arrayCovariance[b][a];
+				}
+				if (_arrayCovariance[a][a] > _arrayCovariance[_uWidest][_uWidest])
+				{
+					_uWidest = a;
+				}
+			}
+
+			float _arrayAxis[4] = {};
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				_arrayAxis[c] = _arrayCovariance[_uWidest][c];
+			}
+			for (uint32_t _uPass = 0; _uPass < 4; ++_uPass)
+			{
+				float _arrayNext[4] = {};
+				float _fLargest = 0.0f;
+				for (uint32_t a = 0; a < N; ++a)
+				{
+					for (uint32_t b = 0; b < N; ++b)
+					{
+						_arrayNext[a] += _arrayCovariance[a][b] * _arrayAxis[b];
+					}
+					_fLargest = std::max(_fLargest, std::fabs(_arrayNext[a]));
+				}
+				if (_fLargest <= 0.0f)
+				{
+					break;
+				}
+				for (uint32_t c = 0; c < N; ++c)
+				{
+					_arrayAxis[c] = _arrayNext[c] / _fLargest;
+				}
+			}
+
+			float _fLengthSquared = 0.0f;
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				_fLengthSquared += _arrayAxis[c] * _arrayAxis[c];
+			}
+			// Every texel the same
+			if (_fLengthSquared < 1e-12f)
+			{
+				return;
+			}
+
+			float _fMin = 0.0f;
+			float _fMax = 0.0f;
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				float _fAlong = 0.0f;
+				for (uint32_t c = 0; c < N; ++c)
+				{
+					_fAlong += (_pTexels[i * 4 + c] - _arrayMean[c]) * _arrayAxis[c];
+				}
+				_fMin = std::min(_fMin, _fAlong);
+				_fMax = std::max(_fMax, _fAlong);
+			}
+
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				float const _fDirection = _arrayAxis[c] / _fLengthSquared;
+				_pLow[c] = Saturate(_arrayMean[c] + _fDirection * _fMin);
+				_pHigh[c] = Saturate(_arrayMean[c] + _fDirection * _fMax);
+			}
+		}
+
+		// Endpoints that best reproduce the texels from the indices they picked (least squares),
+		// _pWeights[index] being how far that index is from the first endpoint to the second.
+		// False if every texel picked the same weight, there's nothing to fit.
+		template <uint32_t N>
+		bool FitEndpoints(uint8_t const* _pTexels, uint8_t const* _pIndices, float const* _pWeights, float* _pFirst, float* _pSecond)
+		{
+			float _fFirstFirst = 0.0f;
+			float _fFirstSecond = 0.0f;
+			float _fSecondSecond = 0.0f;
+			float _arrayFirstTexels[4] = {};
+			float _arraySecondTexels[4] = {};
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				float const _fSecond = _pWeights[_pIndices[i]];
+				float const _fFirst = 1.0f - _fSecond;
+				_fFirstFirst += _fFirst * _fFirst;
+				_fFirstSecond += _fFirst * _fSecond;
+				_fSecondSecond += _fSecond * _fSecond;
+				for (uint32_t c = 0; c < N; ++c)
+				{
+					_arrayFirstTexels[c] += _fFirst * _pTexels[i * 4 + c];
+					_arraySecondTexels[c] += _fSecond * _pTexels[i * 4 + c];
+				}
+			}
+
+			float const _fDeterminant = _fFirstFirst * _fSecondSecond - _fFirstSecond * _fFirstSecond;
+			if (_fDeterminant < 1e-4f)
+			{
+				return false;
+			}
+
+			for (uint32_t c = 0; c < N; ++c)
+			{
+				_pFirst[c] = Saturate((_fSecondSecond * _arrayFirstTexels[c] - _fFirstSecond * _arraySecondTexels[c]) / _fDeterminant);
+				_pSecond[c] = Saturate((_fFirstFirst * _arraySecondTexels[c] - _fFirstSecond * _arrayFirstTexels[c]) / _fDeterminant);
+			}
+			return true;
+		}
+
+		// Least significant bit first, into a zeroed block
+		struct SBitWriter
+		{
+			uint8_t* m_pOut = nullptr;
+			uint32_t m_uBit = 0;
+
+			void Write(uint32_t const _uValue, uint32_t const _uBits)
+			{
+				for (uint32_t b = 0; b < _uBits; ++b, ++m_uBit)
+				{
+					m_pOut[m_uBit >> 3] |= static_cast<uint8_t>(((_uValue >> b) & 1) << (m_uBit & 7));
+				}
+			}
+		};
+	};
+
+	//---------- BC1 colour, also the colour half of BC3
+	namespace
+	{
+		uint16_t ToRGB565(float const* _pColour)
+		{
+			uint32_t const _uR = static_cast<uint32_t>(Saturate(_pColour[0]) * (31.0f / 255.0f) + 0.5f);
+			uint32_t const _uG = static_cast<uint32_t>(Saturate(_pColour[1]) * (63.0f / 255.0f) + 0.5f);
+			uint32_t const _uB = static_cast<uint32_t>(Saturate(_pColour[2]) * (31.0f / 255.0f) + 0.5f);
+			return static_cast<uint16_t>((_uR << 11) | (_uG << 5) | _uB);
+		}
+
+		void FromRGB565(uint16_t const _uColour, uint8_t* _pRGBA)
+		{
+			uint32_t const _uR = (_uColour >> 11) & 31;
+			uint32_t const _uG = (_uColour >> 5) & 63;
+			uint32_t const _uB = _uColour & 31;
+			_pRGBA[0] = static_cast<uint8_t>((_uR << 3) | (_uR >> 2));
+			_pRGBA[1] = static_cast<uint8_t>((_uG << 2) | (_uG >> 4));
+			_pRGBA[2] = static_cast<uint8_t>((_uB << 3) | (_uB >> 2));
+			_pRGBA[3] = 0;
+		}
+
+		// Four colour mode, alpha left at zero like the texels it's compared against
+		void MakeColourPalette(uint16_t const _uColour0, uint16_t const _uColour1, uint8_t* _pPalette)
+		{
+			FromRGB565(_uColour0, _pPalette + 0);
+			FromRGB565(_uColour1, _pPalette + 4);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				_pPalette[8 + c] = static_cast<uint8_t>((2 * _pPalette[c] + _pPalette[4 + c] + 1) / 3);
+				_pPalette[12 + c] = static_cast<uint8_t>((_pPalette[c] + 2 * _pPalette[4 + c] + 1) / 3);
+			}
+		}
+
+		void EncodeColourBlock(uint8_t const* _pTexels, Quality const _eQuality, tFindIndices const _FindIndices, uint8_t* _pOut)
+		{
+			uint8_t _arrayColours[c_uBlockTexels * 4];
+			memcpy(_arrayColours, _pTexels, sizeof(_arrayColours));
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				_arrayColours[i * 4 + 3] = 0;
+			}
+
+			float _arrayLow[4];
+			float _arrayHigh[4];
+			FitPrincipalAxis<3>(_arrayColours, _arrayLow, _arrayHigh);
+
+			uint16_t _uColour0 = ToRGB565(_arrayHigh);
+			uint16_t _uColour1 = ToRGB565(_arrayLow);
+			uint8_t _arrayPalette[16];
+			uint8_t _arrayIndices[c_uBlockTexels];
+			MakeColourPalette(_uColour0, _uColour1, _arrayPalette);
+			uint32_t _uError = _FindIndices(_arrayColours, _arrayPalette, 4, _arrayIndices);
+
+			uint32_t const _uPasses = GetRefinePasses(_eQuality);
+			for (uint32_t _uPass = 0; _uPass < _uPasses && _uError > 0; ++_uPass)
+			{
+				float _arrayFirst[4];
+				float _arraySecond[4];
+				if (FitEndpoints<3>(_arrayColours, _arrayIndices, c_arrayBC1Weights, _arrayFirst, _arraySecond) == false)
+				{
+					break;
+				}
+
+				uint16_t const _uTry0 = ToRGB565(_arrayFirst);
+				uint16_t const _uTry1 = ToRGB565(_arraySecond);
+				if (_uTry0 == _uColour0 && _uTry1 == _uColour1)
+				{
+					break;
+				}
+
+				uint8_t _arrayTryIndices[c_uBlockTexels];
+				MakeColourPalette(_uTry0, _uTry1, _arrayPalette);
+				uint32_t const _uTryError = _FindIndices(_arrayColours, _arrayPalette, 4, _arrayTryIndices);
+				if (_uTryError >= _uError)
+				{
+					break;
+				}
+
+				_uColour0 = _uTry0;
+				_uColour1 = _uTry1;
+				_uError = _uTryError;
+				memcpy(_arrayIndices, _arrayTryIndices, sizeof(_arrayIndices));
+			}
+
+			// Four colour mode needs the first endpoint greater, swapping them swaps indices 0/1
+			// and 2/3. Equal endpoints would be three colour mode, every texel takes the first.
+			if (_uColour0 < _uColour1)
+			{
+				std::swap(_uColour0, _uColour1);
+				for (auto& _uIndex : _arrayIndices)
+				{
+					_uIndex ^= 1;
+				}
+			}
+			else if (_uColour0 == _uColour1)
+			{
+				memset(_arrayIndices, 0, sizeof(_arrayIndices));
+			}
+
+			uint32_t _uBits = 0;
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				_uBits |= static_cast<uint32_t>(_arrayIndices[i]) << (i * 2);
+			}
+			_pOut[0] = static_cast<uint8_t>(_uColour0);
+			_pOut[1] = static_cast<uint8_t>(_uColour0 >> 8);
+			_pOut[2] = static_cast<uint8_t>(_uColour1);
+			_pOut[3] = static_cast<uint8_t>(_uColour1 >> 8);
+			for (uint32_t b = 0; b < 4; ++b)
+			{
+				_pOut[4 + b] = static_cast<uint8_t>(_uBits >> (b * 8));
+			}
+		}
+	};
+
+	//---------- BC3 alpha
+	namespace
+	{
+		// Eight values between the endpoints when the first is greater, otherwise six plus 0 and 255.
+		// Alpha goes in the first channel, for FitEndpoints().
+		void MakeAlphaPalette(uint8_t const _uAlpha0, uint8_t const _uAlpha1, uint8_t* _pPalette)
+		{
+			uint32_t _arrayValues[8] = { _uAlpha0, _uAlpha1 };
+			if (_uAlpha0 > _uAlpha1)
+			{
+				for (uint32_t i = 2; i < 8; ++i)
+				{
+					_arrayValues[i] = ((8 - i) * _uAlpha0 + (i - 1) * _uAlpha1 + 3) / 7;
+				}
+			}
+			else
+			{
+				for (uint32_t i = 2; i < 6; ++i)
+				{
+					_arrayValues[i] = ((6 - i) * _uAlpha0 + (i - 1) * _uAlpha1 + 2) / 5;
+				}
+				_arrayValues[6] = 0;
+				_arrayValues[7] = 255;
+			}
+
+			memset(_pPalette, 0, 8 * 4);
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				_pPalette[i * 4] = static_cast<uint8_t>(_arrayValues[i]);
+			}
+		}
+
+		void EncodeAlphaBlock(uint8_t const* _pTexels, Quality const _eQuality, tFindIndices const _FindIndices, uint8_t* _pOut)
+		{
+			uint8_t _arrayAlphas[c_uBlockTexels * 4] = {};
+			uint8_t _uMin = 255;
+			uint8_t _uMax = 0;
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				uint8_t const _uAlpha = _pTexels[i * 4 + 3];
+				_arrayAlphas[i * 4] = _uAlpha;
+				_uMin = std::min(_uMin, _uAlpha);
+				_uMax = std::max(_uMax, _uAlpha);
+			}
+
+			if (_uMin == _uMax)
+			{
+				memset(_pOut, 0, 8);
+				_pOut[0] = _uMin;
+				_pOut[1] = _uMin;
+				return;
+			}
+
+			// Eight values over the whole range
+			uint8_t _uAlpha0 = _uMax;
+			uint8_t _uAlpha1 = _uMin;
+			uint8_t _arrayPalette[8 * 4];
+			uint8_t _arrayIndices[c_uBlockTexels];
+			MakeAlphaPalette(_uAlpha0, _uAlpha1, _arrayPalette);
+			uint32_t _uError = _FindIndices(_arrayAlphas, _arrayPalette, 8, _arrayIndices);
+
+			uint32_t const _uPasses = GetRefinePasses(_eQuality);
+			for (uint32_t _uPass = 0; _uPass < _uPasses && _uError > 0; ++_uPass)
+			{
+				float _fFirst;
+				float _fSecond;
+				if (FitEndpoints<1>(_arrayAlphas, _arrayIndices, c_arrayAlphaWeights, &_fFirst, &_fSecond) == false)
+				{
+					break;
+				}
+
+				uint8_t _uTry0 = ToByte(_fFirst);
+				uint8_t _uTry1 = ToByte(_fSecond);
+				if (_uTry0 < _uTry1)
+				{
+					std::swap(_uTry0, _uTry1);
+				}
+				if (_uTry0 == _uTry1 || (_uTry0 == _uAlpha0 && _uTry1 == _uAlpha1))
+				{
+					break;
+				}
+
+				uint8_t _arrayTryIndices[c_uBlockTexels];
+				MakeAlphaPalette(_uTry0, _uTry1, _arrayPalette);
+				uint32_t const _uTryError = _FindIndices(_arrayAlphas, _arrayPalette, 8, _arrayTryIndices);
+				if (_uTryError >= _uError)
+				{
+					break;
+				}
+
+				_uAlpha0 = _uTry0;
+				_uAlpha1 = _uTry1;
+				_uError = _uTryError;
+				memcpy(_arrayIndices, _arrayTryIndices, sizeof(_arrayIndices));
+			}
+
+			// Texels at exactly 0 or 255 come free in six value mode, all six can go on the rest
+			if (_eQuality != Quality::Fast && _uError > 0)
+			{
+				uint8_t _uInnerMin = 255;
+				uint8_t _uInnerMax = 0;
+				for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+				{
+					uint8_t const _uAlpha = _arrayAlphas[i * 4];
+					if (_uAlpha != 0 && _uAlpha != 255)
+					{
+						_uInnerMin = std::min(_uInnerMin, _uAlpha);
+						_uInnerMax = std::max(_uInnerMax, _uAlpha);
+					}
+				}
+				if (_uInnerMin > _uInnerMax)
+				{
+					_uInnerMin = 0;
+					_uInnerMax = 0;
+				}
+
+				uint8_t _arrayTryIndices[c_uBlockTexels];
+				MakeAlphaPalette(_uInnerMin, _uInnerMax, _arrayPalette);
+				uint32_t const _uTryError = _FindIndices(_arrayAlphas, _arrayPalette, 8, _arrayTryIndices);
+				if (_uTryError < _uError)
+				{
+					_uAlpha0 = _uInnerMin;
+					_uAlpha1 = _uInnerMax;
+					memcpy(_arrayIndices, _arrayTryIndices, sizeof(_arrayIndices));
+				}
+			}
+
+			uint64_t _uBits = 0;
+			for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+			{
+				_uBits |= static_cast<uint64_t>(_arrayIndices[i]) << (i * 3);
+			}
+			_pOut[0] = _uAlpha0;
+			_pOut[1] = _uAlpha1;
+			for (uint32_t b = 0; b < 6; ++b)
+			{
+				_pOut[2 + b] = static_cast<uint8_t>(_uBits >> (b * 8));
+			}
+		}
+	};
+
+	//---------- BC7 mode 6
+	namespace
+	{
+		// 7 bits a channel, plus a low bit shared by all four
+		struct SBC7Endpoint
+		{
+			uint8_t m_arrayValues[4] = {};
+			uint8_t m_uPBit = 0;
+
+			bool operator==(SBC7Endpoint const& _Other) const
+			{
+				return memcmp(m_arrayValues, _Other.m_arrayValues, sizeof(m_arrayValues)) == 0 && m_uPBit == _Other.m_uPBit;
+			}
+		};
+
+		float QuantizeBC7(float const* _pColour, uint8_t const _uPBit, SBC7Endpoint& _Endpoint)
+		{
+			float _fError = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				float const _fValue = Saturate(_pColour[c]);
+				int32_t const _iQuantized = std::min(127, std::max(0, static_cast<int32_t>(std::floor((_fValue - _uPBit) * 0.5f + 0.5f))));
+				_Endpoint.m_arrayValues[c] = static_cast<uint8_t>(_iQuantized);
+
+				float const _fDifference = static_cast<float>(_iQuantized * 2 + _uPBit) - _fValue;
+				_fError += _fDifference * _fDifference;
+			}
+			_Endpoint.m_uPBit = _uPBit;
+			return _fError;
+		}
+
+		// Whichever low bit lands closer
+		SBC7Endpoint QuantizeBC7(float const* _pColour)
+		{
+			SBC7Endpoint _Even;
+			SBC7Endpoint _Odd;
+			float const _fEvenError = QuantizeBC7(_pColour, 0, _Even);
+			float const _fOddError = QuantizeBC7(_pColour, 1, _Odd);
+			return (_fOddError < _fEvenError) ? _Odd : _Even;
+		}
+
+		void MakeBC7Palette(SBC7Endpoint const& _Endpoint0, SBC7Endpoint const& _Endpoint1, uint8_t* _pPalette)
+		{
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				uint32_t const _uValue0 = (_Endpoint0.m_arrayValues[c] << 1) | _Endpoint0.m_uPBit;
+				uint32_t const _uValue1 = (_Endpoint1.m_arrayValues[c] << 1) | _Endpoint1.m_uPBit;
+				for (uint32_t i = 0; i < 16; ++i)
+				{
+					uint32_t const _uWeight = c_arrayBC7Weights[i];
+					_pPalette[i * 4 + c] = static_cast<uint8_t>(((64 - _uWeight) * _uValue0 + _uWeight * _uValue1 + 32) >> 6);
+				}
+			}
+		}
+
+		uint32_t EvaluateBC7(uint8_t const* _pTexels, SBC7Endpoint const& _Endpoint0, SBC7Endpoint const& _Endpoint1, tFindIndices const _FindIndices, uint8_t* _pIndices)
+		{
+			uint8_t _arrayPalette[16 * 4];
+			MakeBC7Palette(_Endpoint0, _Endpoint1, _arrayPalette);
+			return _FindIndices(_pTexels, _arrayPalette, 16, _pIndices);
+		}
+
+		void EncodeBC7Block(uint8_t const* _pTexels, Quality const _eQuality, tFindIndices const _FindIndices, uint8_t* _pOut)
+		{
+			float _arrayFirst[4];
+			float _arraySecond[4];
+			FitPrincipalAxis<4>(_pTexels, _arrayFirst, _arraySecond);
+
+			SBC7Endpoint _Endpoint0 = QuantizeBC7(_arrayFirst);
+			SBC7Endpoint _Endpoint1 = QuantizeBC7(_arraySecond);
+			uint8_t _arrayIndices[c_uBlockTexels];
+			uint32_t _uError = EvaluateBC7(_pTexels, _Endpoint0, _Endpoint1, _FindIndices, _arrayIndices);
+
+			float _arrayWeights[16];
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				_arrayWeights[i] = c_arrayBC7Weights[i] / 64.0f;
+			}
+
+			uint32_t const _uPasses = GetRefinePasses(_eQuality);
+			for (uint32_t _uPass = 0; _uPass < _uPasses && _uError > 0; ++_uPass)
+			{
+				float _arrayTryFirst[4];
+				float _arrayTrySecond[4];
+				if (FitEndpoints<4>(_pTexels, _arrayIndices, _arrayWeights, _arrayTryFirst, _arrayTrySecond) == false)
+				{
+					break;
+				}
+
+				SBC7Endpoint const _Try0 = QuantizeBC7(_arrayTryFirst);
+				SBC7Endpoint const _Try1 = QuantizeBC7(_arrayTrySecond);
+				if (_Try0 == _Endpoint0 && _Try1 == _Endpoint1)
+				{
+					break;
+				}
+
+				uint8_t _arrayTryIndices[c_uBlockTexels];
+				uint32_t const _uTryError = EvaluateBC7(_pTexels, _Try0, _Try1, _FindIndices, _arrayTryIndices);
+				if (_uTryError >= _uError)
+				{
+					break;
+				}
+
+				_Endpoint0 = _Try0;
+				_Endpoint1 = _Try1;
+				_uError = _uTryError;
+				memcpy(_arrayIndices, _arrayTryIndices, sizeof(_arrayIndices));
+				memcpy(_arrayFirst, _arrayTryFirst, sizeof(_arrayFirst));
+				memcpy(_arraySecond, _arrayTrySecond, sizeof(_arraySecond));
+			}
+
+			// Each low bit was picked for its own endpoint, a different pair can interpolate better
+			if (_eQuality == Quality::High && _uError > 0)
+			{
+				for (uint8_t _uPBit = 0; _uPBit < 4; ++_uPBit)
+				{
+					SBC7Endpoint _Try0;
+					SBC7Endpoint _Try1;
+					QuantizeBC7(_arrayFirst, static_cast<uint8_t>(_uPBit & 1), _Try0);
+					QuantizeBC7(_arraySecond, static_cast<uint8_t>(_uPBit >> 1), _Try1);
+
+					uint8_t _arrayTryIndices[c_uBlockTexels];
+					uint32_t const _uTryError = EvaluateBC7(_pTexels, _Try0, _Try1, _FindIndices, _arrayTryIndices);
+					if (_uTryError < _uError)
+					{
+						_Endpoint0 = _Try0;
+						_Endpoint1 = _Try1;
+						_uError = _uTryError;
+						memcpy(_arrayIndices, _arrayTryIndices, sizeof(_arrayIndices));
+					}
+				}
+			}
+
+			// The first texel's index has its top bit left out, it has to be in the lower half
+			if (_arrayIndices[0] & 8)
+			{
+				std::swap(_Endpoint0, _Endpoint1);
+				for (auto& _uIndex : _arrayIndices)
+				{
+					_uIndex = static_cast<uint8_t>(15 - _uIndex);
+				}
+			}
+
+			memset(_pOut, 0, 16);
+			SBitWriter _Writer;
+			_Writer.m_pOut = _pOut;
+			_Writer.Write(1 << 6, 7);
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				_Writer.Write(_Endpoint0.m_arrayValues[c], 7);
+				_Writer.Write(_Endpoint1.m_arrayValues[c], 7);
+			}
+			_Writer.Write(_Endpoint0.m_uPBit, 1);
+			_Writer.Write(_Endpoint1.m_uPBit, 1);
+			_Writer.Write(_arrayIndices[0], 3);
+			for (uint32_t i = 1; i < c_uBlockTexels; ++i)
+			{
+				_Writer.Write(_arrayIndices[i], 4);
+			}
+		}
+
+		void EncodeBlock(Format const _eFormat, Quality const _eQuality, tFindIndices const _FindIndices, uint8_t const* _pTexels, uint8_t* _pOut)
+		{
+			switch (_eFormat)
+			{
+				case Format::BC1:
+					EncodeColourBlock(_pTexels, _eQuality, _FindIndices, _pOut);
+					break;
+				case Format::BC3:
+					EncodeAlphaBlock(_pTexels, _eQuality, _FindIndices, _pOut);
+					EncodeColourBlock(_pTexels, _eQuality, _FindIndices, _pOut + 8);
+					break;
+				case Format::BC7:
+					EncodeBC7Block(_pTexels, _eQuality, _FindIndices, _pOut);
+					break;
+				default:
+					break;
+			}
+		}
+	};
+
+	Format SSettings::ChooseFormat(bool const _bAlpha) const
+	{
+		if (m_bEnabled == false)
+		{
+			return Format::None;
+		}
+
+		// BC7 keeps far more of an alpha gradient than BC3 does, BC1 is half the size of either
+		if (_bAlpha)
+		{
+			return m_bBPTC ? Format::BC7 : (m_bS3TC ? Format::BC3 : Format::None);
+		}
+		return m_bS3TC ? Format::BC1 : (m_bBPTC ? Format::BC7 : Format::None);
+	}
+
+	uint32_t SSettings::GetVariant() const
+	{
+		if (ChooseFormat(false) == Format::None && ChooseFormat(true) == Format::None)
+		{
+			return 0;
+		}
+		return (c_uEncoderVersion << 8) | (static_cast<uint32_t>(m_eQuality) << 4) | (m_bBPTC ? 4u : 0u) | (m_bS3TC ? 2u : 0u) | 1u;
+	}
+
+	uint32_t GetBlockBytes(Format const _eFormat)
+	{
+		switch (_eFormat)
+		{
+			case Format::BC1: return 8;
+			case Format::BC3: return 16;
+			case Format::BC7: return 16;
+			default: return 0;
+		}
+	}
+
+	size_t GetCompressedSize(Format const _eFormat, int32_t const _iWidth, int32_t const _iHeight)
+	{
+		return static_cast<size_t>(GetBlockCount(_iWidth)) * GetBlockCount(_iHeight) * GetBlockBytes(_eFormat);
+	}
+
+	bool HasAlpha(uint8_t const* _pPixels, size_t const _uTexels, uint32_t const _uChannels)
+	{
+		if (_uChannels != 4)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < _uTexels; ++i)
+		{
+			if (_pPixels[i * 4 + 3] != 0xff)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void EncodeRows(Format const _eFormat, Quality const _eQuality, uint8_t const* _pRows, size_t const _uRowBytes, uint32_t const _uChannels, int32_t const _iWidth, int32_t const _iRows, uint8_t* _pBlocks)
+	{
+		uint32_t const _uBlockBytes = GetBlockBytes(_eFormat);
+		if (_uBlockBytes == 0 || _iWidth <= 0 || _iRows <= 0)
+		{
+			return;
+		}
+
+		tFindIndices const _FindIndices = GetFindIndices();
+		int32_t const _iBlocksWide = GetBlockCount(_iWidth);
+		size_t const _uBlockRows = GetBlockCount(_iRows);
+		size_t const _uBlockRowBytes = static_cast<size_t>(_iBlocksWide) * _uBlockBytes;
+
+		size_t const _uMaxThreads = std::max<size_t>(1, _iBlocksWide * _uBlockRows / c_uMinBlocksPerThread);
+		uint32_t const _uThreads = static_cast<uint32_t>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), _uMaxThreads));
+
+		ParallelFor(_uBlockRows, _uThreads, [&](size_t const _uBlockRow)
+		{
+			int32_t const _iFirstRow = static_cast<int32_t>(_uBlockRow) * 4;
+			uint8_t const* _pBlockRows = _pRows + _iFirstRow * _uRowBytes;
+			int32_t const _iRowsLeft = std::min(4, _iRows - _iFirstRow);
+			uint8_t* _pOut = _pBlocks + _uBlockRow * _uBlockRowBytes;
+
+			uint8_t _arrayTexels[c_uBlockTexels * 4];
+			for (int32_t x = 0; x < _iBlocksWide; ++x)
+			{
+				GatherBlock(_pBlockRows, _uRowBytes, _uChannels, _iWidth, _iRowsLeft, x * 4, _arrayTexels);
+				EncodeBlock(_eFormat, _eQuality, _FindIndices, _arrayTexels, _pOut + x * _uBlockBytes);
+			}
+		});
+	}
+
+	SCompressedImage Encode(Format const _eFormat, Quality const _eQuality, uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels)
+	{
+		SCompressedImage _Image;
+		if (GetBlockBytes(_eFormat) == 0 || _pPixels == nullptr || _iWidth <= 0 || _iHeight <= 0 || (_uChannels != 3 && _uChannels != 4))
+		{
+			return _Image;
+		}
+
+		_Image.m_eFormat = _eFormat;
+		_Image.m_iWidth = _iWidth;
+		_Image.m_iHeight = _iHeight;
+		_Image.m_pBlocks = std::make_shared<std::vector<uint8_t>>(GetCompressedSize(_eFormat, _iWidth, _iHeight));
+		EncodeRows(_eFormat, _eQuality, _pPixels, static_cast<size_t>(_iWidth) * _uChannels, _uChannels, _iWidth, _iHeight, _Image.m_pBlocks->data());
+		return _Image;
+	}
+};
+//========================================
+
+//========================================
+namespace block_compression
+{
+	uint32_t FindIndicesScalar(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices)
+	{
+		uint32_t _uTotal = 0;
+		for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+		{
+			uint8_t const* _pTexel = _pTexels + i * 4;
+			uint32_t _uBest = UINT32_MAX;
+			uint32_t _uBestIndex = 0;
+			for (uint32_t p = 0; p < _uPaletteSize; ++p)
+			{
+				uint8_t const* _pEntry = _pPalette + p * 4;
+				uint32_t _uDistance = 0;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					int32_t const _iDifference = static_cast<int32_t>(_pTexel[c]) - _pEntry[c];
+					_uDistance += static_cast<uint32_t>(_iDifference * _iDifference);
+				}
+				if (_uDistance < _uBest)
+				{
+					_uBest = _uDistance;
+					_uBestIndex = p;
+				}
+			}
+			_pIndices[i] = static_cast<uint8_t>(_uBestIndex);
+			_uTotal += _uBest;
+		}
+		return _uTotal;
+	}
+
+#if defined(SPRITE_TOOL_X86)
+	uint32_t FindIndicesSSE2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices)
+	{
+		__m128i const _Zero = _mm_setzero_si128();
+
+		// Two texels a register, 16 bits a channel
+		__m128i _arrayTexels[8];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			__m128i const _Texels = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pTexels + i * 16));
+			_arrayTexels[i * 2 + 0] = _mm_unpacklo_epi8(_Texels, _Zero);
+			_arrayTexels[i * 2 + 1] = _mm_unpackhi_epi8(_Texels, _Zero);
+		}
+
+		// Four texels a register
+		__m128i _arrayBest[4];
+		__m128i _arrayBestIndex[4];
+		for (uint32_t g = 0; g < 4; ++g)
+		{
+			_arrayBest[g] = _mm_set1_epi32(INT32_MAX);
+			_arrayBestIndex[g] = _Zero;
+		}
+
+		for (uint32_t p = 0; p < _uPaletteSize; ++p)
+		{
+			int32_t _iEntry;
+			memcpy(&_iEntry, _pPalette + p * 4, sizeof(_iEntry));
+			__m128i const _Entry = _mm_unpacklo_epi8(_mm_set1_epi32(_iEntry), _Zero);
+			__m128i const _Index = _mm_set1_epi32(static_cast<int32_t>(p));
+
+			for (uint32_t g = 0; g < 4; ++g)
+			{
+				__m128i const _Difference0 = _mm_sub_epi16(_arrayTexels[g * 2 + 0], _Entry);
+				__m128i const _Difference1 = _mm_sub_epi16(_arrayTexels[g * 2 + 1], _Entry);
+				// R*R + G*G and B*B + A*A of each texel, then the two halves added
+				__m128 const _Squares0 = _mm_castsi128_ps(_mm_madd_epi16(_Difference0, _Difference0));
+				__m128 const _Squares1 = _mm_castsi128_ps(_mm_madd_epi16(_Difference1, _Difference1));
+				__m128i const _Distance = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(_Squares0, _Squares1, _MM_SHUFFLE(2, 0, 2, 0))),
+														_mm_castps_si128(_mm_shuffle_ps(_Squares0, _Squares1, _MM_SHUFFLE(3, 1, 3, 1))));
+
+				__m128i const _Closer = _mm_cmplt_epi32(_Distance, _arrayBest[g]);
+				_arrayBest[g] = _mm_or_si128(_mm_and_si128(_Closer, _Distance), _mm_andnot_si128(_Closer, _arrayBest[g]));
+				_arrayBestIndex[g] = _mm_or_si128(_mm_and_si128(_Closer, _Index), _mm_andnot_si128(_Closer, _arrayBestIndex[g]));
+			}
+		}
+
+		int32_t _arrayDistances[16];
+		int32_t _arrayIndices[16];
+		for (uint32_t g = 0; g < 4; ++g)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_arrayDistances + g * 4), _arrayBest[g]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_arrayIndices + g * 4), _arrayBestIndex[g]);
+		}
+
+		uint32_t _uTotal = 0;
+		for (uint32_t i = 0; i < c_uBlockTexels; ++i)
+		{
+			_pIndices[i] = static_cast<uint8_t>(_arrayIndices[i]);
+			_uTotal += static_cast<uint32_t>(_arrayDistances[i]);
+		}
+		return _uTotal;
+	}
+#else
+	uint32_t FindIndicesSSE2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices)
+	{
+		return FindIndicesScalar(_pTexels, _pPalette, _uPaletteSize, _pIndices);
+	}
+#endif
+
+	tFindIndices GetFindIndices()
+	{
+		if (cpu_features::HasAVX2())
+		{
+			return FindIndicesAVX2;
+		}
+		if (cpu_features::HasSSE2())
+		{
+			return FindIndicesSSE2;
+		}
+		return FindIndicesScalar;
+	}
+};
+//========================================
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//========================================
+// Encodes RGB(A) pixels into GPU block compressed formats on the CPU, so an atlas takes an
+// eighth (BC1) or a quarter (BC3, BC7) of the video memory and uploads that much quicker.
+//
+//  BC1  opaque. 4x4 texels in 8 bytes, two 565 endpoints and 2 bit indices.
+//  BC3  BC1 colour plus an 8 byte alpha block, two 8 bit endpoints and 3 bit indices.
+//  BC7  only mode 6 is written, one RGBA endpoint pair (7 bits and a shared low bit each)
+//       with 4 bit indices. Alpha and colour interpolate together, which suits sprites.
+//
+// Endpoints start at the ends of the principal axis of a block's texels and are refitted
+// by least squares to the indices they pick, more passes the higher the quality. Picking
+// indices is the hot loop, it has SSE2 and AVX2 kernels.
+namespace block_compression
+{
+	enum class Format : uint32_t
+	{
+		None = 0,
+		BC1,
+		BC3,
+		BC7,
+	};
+
+	enum class Quality : uint32_t
+	{
+		Fast = 0,	// principal axis endpoints as they are
+		Normal,
+		High,
+	};
+
+	struct SSettings
+	{
+		bool m_bEnabled = false;
+		Quality m_eQuality = Quality::Normal;
+
+		// What the context can sample, from its extensions
+		bool m_bS3TC = false;	// BC1 and BC3
+		bool m_bBPTC = false;	// BC7
+
+		// For an image with or without alpha, None if nothing suitable is enabled
+		Format ChooseFormat(bool const _bAlpha) const;
+		// Zero if nothing would be compressed, otherwise different for every combination that
+		// changes what's encoded. Keys cached copies of the results.
+		uint32_t GetVariant() const;
+	};
+
+	struct SCompressedImage
+	{
+		Format m_eFormat = Format::None;
+		int32_t m_iWidth = 0;		// in texels
+		int32_t m_iHeight = 0;
+		std::shared_ptr<std::vector<uint8_t>> m_pBlocks;	// rows of blocks, top down
+	};
+
+	uint32_t GetBlockBytes(Format const _eFormat);
+	inline int32_t GetBlockCount(int32_t const _iTexels) { return (_iTexels + 3) / 4; }
+	size_t GetCompressedSize(Format const _eFormat, int32_t const _iWidth, int32_t const _iHeight);
+
+	// False if every texel is fully opaque, always for 3 channels
+	bool HasAlpha(uint8_t const* _pPixels, size_t const _uTexels, uint32_t const _uChannels);
+
+	// _iRows rows of texels (3 or 4 channels, _uRowBytes apart) into the rows of blocks that cover
+	// them, those rows side by side. A width or a last band that isn't a multiple of 4 repeats
+	// the edge texels, so only the last band of an image may be short.
+	void EncodeRows(Format const _eFormat, Quality const _eQuality, uint8_t const* _pRows, size_t const _uRowBytes, uint32_t const _uChannels, int32_t const _iWidth, int32_t const _iRows, uint8_t* _pBlocks);
+
+	// The whole image, no blocks if _eFormat is None
+	SCompressedImage Encode(Format const _eFormat, Quality const _eQuality, uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels);
+
+	//---------- kernels, shared with the translation units built with wider instruction sets
+	// For each of 16 RGBA texels, the nearest of _uPaletteSize RGBA colours by squared distance
+	// (the lowest index on a tie). Returns the distances summed.
+	typedef uint32_t (*tFindIndices)(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices);
+
+	// Every kernel picks the same indices
+	uint32_t FindIndicesScalar(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices);
+	uint32_t FindIndicesSSE2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices);
+	uint32_t FindIndicesAVX2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices);
+
+	// Widest the machine supports
+	tFindIndices GetFindIndices();
+};
+//========================================
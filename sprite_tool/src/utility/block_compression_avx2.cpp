@@ -0,0 +1,91 @@
+// block_compression_avx2.cpp : AVX2 index search, only called when cpu_features::HasAVX2().
+//  Built with /arch:AVX2 (see the vcxproj), GCC/Clang get the target pragma below.
+
+#include "block_compression.hpp"
+
+#include "cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+#include <climits>
+#include <cstring>
+
+//========================================
+namespace block_compression
+{
+	uint32_t FindIndicesAVX2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices)
+	{
+		// Four texels a register, 16 bits a channel
+		__m256i _arrayTexels[4];
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			_arrayTexels[i] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(_pTexels + i * 16)));
+		}
+
+		// Eight texels a register, in the order the horizontal add leaves them (0 1 4 5 | 2 3 6 7)
+		__m256i _arrayBest[2];
+		__m256i _arrayBestIndex[2];
+		for (uint32_t g = 0; g < 2; ++g)
+		{
+			_arrayBest[g] = _mm256_set1_epi32(INT_MAX);
+			_arrayBestIndex[g] = _mm256_setzero_si256();
+		}
+
+		for (uint32_t p = 0; p < _uPaletteSize; ++p)
+		{
+			int32_t _iEntry;
+			memcpy(&_iEntry, _pPalette + p * 4, sizeof(_iEntry));
+			__m256i const _Entry = _mm256_cvtepu8_epi16(_mm_set1_epi32(_iEntry));
+			__m256i const _Index = _mm256_set1_epi32(static_cast<int32_t>(p));
+
+			for (uint32_t g = 0; g < 2; ++g)
+			{
+				__m256i const _Difference0 = _mm256_sub_epi16(_arrayTexels[g * 2 + 0], _Entry);
+				__m256i const _Difference1 = _mm256_sub_epi16(_arrayTexels[g * 2 + 1], _Entry);
+				__m256i const _Distance = _mm256_hadd_epi32(_mm256_madd_epi16(_Difference0, _Difference0), _mm256_madd_epi16(_Difference1, _Difference1));
+
+				__m256i const _Closer = _mm256_cmpgt_epi32(_arrayBest[g], _Distance);
+				_arrayBest[g] = _mm256_blendv_epi8(_arrayBest[g], _Distance, _Closer);
+				_arrayBestIndex[g] = _mm256_blendv_epi8(_arrayBestIndex[g], _Index, _Closer);
+			}
+		}
+
+		__m256i const _Order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+		int32_t _arrayDistances[16];
+		int32_t _arrayIndices[16];
+		for (uint32_t g = 0; g < 2; ++g)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_arrayDistances + g * 8), _mm256_permutevar8x32_epi32(_arrayBest[g], _Order));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_arrayIndices + g * 8), _mm256_permutevar8x32_epi32(_arrayBestIndex[g], _Order));
+		}
+
+		uint32_t _uTotal = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			_pIndices[i] = static_cast<uint8_t>(_arrayIndices[i]);
+			_uTotal += static_cast<uint32_t>(_arrayDistances[i]);
+		}
+		return _uTotal;
+	}
+};
+//========================================
+
+#else
+
+//========================================
+namespace block_compression
+{
+	uint32_t FindIndicesAVX2(uint8_t const* _pTexels, uint8_t const* _pPalette, uint32_t _uPaletteSize, uint8_t* _pIndices)
+	{
+		return FindIndicesScalar(_pTexels, _pPalette, _uPaletteSize, _pIndices);
+	}
+};
+//========================================
+
+#endif
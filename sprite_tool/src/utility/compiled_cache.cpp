@@ -0,0 +1,212 @@
+#include "compiled_cache.hpp"
+
+#include "file_helper.hpp"
+#include "hash_helper.hpp"
+#include "stl_helper.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//========================================
+namespace compiled_cache
+{
+	namespace
+	{
+		uint32_t const c_uMagic = 0x43435453;	// "STCC"
+		uint32_t const c_uVersion = 1;
+
+		struct SHeader
+		{
+			uint32_t m_uMagic = c_uMagic;
+			uint32_t m_uVersion = c_uVersion;
+			uint32_t m_uKind = 0;
+			uint32_t m_uPathLength = 0;		// source path follows the header, padded to 8 bytes
+
+			uint64_t m_uSourceSize = 0;
+			uint64_t m_uSourceModifiedTime = 0;
+			uint64_t m_uSourceHash = 0;
+
+			uint64_t m_uPayloadSize = 0;
+			uint64_t m_uPayloadHash = 0;	// catches truncated or corrupt entries
+			uint64_t m_uReserved = 0;
+		};
+		static_assert(sizeof(SHeader) == 64, "cache header layout changed, bump c_uVersion");
+
+		std::mutex s_Mutex;
+		std::string s_sDirectory;
+		bool s_bDirectorySet = false;
+
+		size_t GetPayloadOffset(uint32_t const _uPathLength)
+		{
+			return sizeof(SHeader) + ((static_cast<size_t>(_uPathLength) + 7) & ~static_cast<size_t>(7));
+		}
+
+		std::string GetEntryPath(std::string const& _sDirectory, std::string const& _sSourcePath, Kind const _eKind)
+		{
+			uint64_t const _uPathHash = hash_helper::Hash64(_sSourcePath.data(), _sSourcePath.size());
+			return stl_helper::Format("%s/%016llx_%u.bin", _sDirectory.c_str(), static_cast<unsigned long long>(_uPathHash), static_cast<uint32_t>(_eKind));
+		}
+	};
+
+	void SetDirectory(std::string const& _sDirectory)
+	{
+		std::lock_guard<std::mutex> _Lock(s_Mutex);
+		s_sDirectory = _sDirectory.empty() ? _sDirectory : FileHelper::GetAbsolutePath(_sDirectory);
+		s_bDirectorySet = true;
+	}
+
+	std::string GetDirectory()
+	{
+		std::lock_guard<std::mutex> _Lock(s_Mutex);
+		if (s_bDirectorySet == false)
+		{
+			s_sDirectory = FileHelper::GetAbsolutePath("sprite_tool_cache");
+			s_bDirectorySet = true;
+		}
+		return s_sDirectory;
+	}
+
+	bool Load(std::string const& _sSourcePath, Kind const _eKind, FileHelper::SFileView& _Payload)
+	{
+		_Payload = FileHelper::SFileView();
+
+		std::string const _sDirectory = GetDirectory();
+		if (_sDirectory.empty())
+		{
+			return false;
+		}
+
+		FileHelper::SFileView _Entry = FileHelper::MapFileContents(GetEntryPath(_sDirectory, _sSourcePath, _eKind));
+		if (_Entry.m_uSize < sizeof(SHeader))
+		{
+			return false;
+		}
+
+		SHeader _Header;
+		memcpy(&_Header, _Entry.m_pData, sizeof(SHeader));
+
+		size_t const _uPayloadOffset = GetPayloadOffset(_Header.m_uPathLength);
+		if (_Header.m_uMagic != c_uMagic ||
+			_Header.m_uVersion != c_uVersion ||
+			_Header.m_uKind != static_cast<uint32_t>(_eKind) ||
+			_uPayloadOffset > _Entry.m_uSize ||
+			_Header.m_uPayloadSize != _Entry.m_uSize - _uPayloadOffset)
+		{
+			return false;
+		}
+
+		// Different file that happens to share the path hash
+		if (_Header.m_uPathLength != _sSourcePath.size() ||
+			memcmp(_Entry.m_pData + sizeof(SHeader), _sSourcePath.data(), _sSourcePath.size()) != 0)
+		{
+			return false;
+		}
+
+		uint64_t const _uSourceSize = FileHelper::GetFileSize(_sSourcePath);
+		uint64_t const _uSourceModifiedTime = FileHelper::GetFileModifiedTime(_sSourcePath);
+		if (_uSourceSize != _Header.m_uSourceSize)
+		{
+			return false;
+		}
+
+		FileHelper::SFileView _Source;
+		if (_uSourceModifiedTime != _Header.m_uSourceModifiedTime)
+		{
+			_Source = FileHelper::MapFileContents(_sSourcePath);
+			if (hash_helper::Hash64(_Source.m_pData, _Source.m_uSize) != _Header.m_uSourceHash)
+			{
+				return false;
+			}
+		}
+
+		uint8_t const* _pPayload = _Entry.m_pData + _uPayloadOffset;
+		if (hash_helper::Hash64(_pPayload, static_cast<size_t>(_Header.m_uPayloadSize)) != _Header.m_uPayloadHash)
+		{
+			return false;
+		}
+
+		_Payload.m_pData = _pPayload;
+		_Payload.m_uSize = static_cast<size_t>(_Header.m_uPayloadSize);
+		_Payload.m_pOwner = _Entry.m_pOwner;
+
+		// Same contents, new time. Rewrite it so the next open doesn't have to hash again.
+		// Windows won't replace a mapped file, so this (rare) path copies the payload out first.
+		if (_Source.IsEmpty() == false)
+		{
+			auto _pCopy = std::make_shared<std::vector<uint8_t>>(_pPayload, _pPayload + _Header.m_uPayloadSize);
+			_Payload.m_pData = _pCopy->data();
+			_Payload.m_pOwner = _pCopy;
+			_Entry = FileHelper::SFileView();
+
+			Store(_sSourcePath, _eKind, _Source, *_pCopy);
+		}
+
+		return true;
+	}
+
+	void Store(std::string const& _sSourcePath, Kind const _eKind, FileHelper::SFileView const& _Source, std::vector<uint8_t> const& _vectorPayload)
+	{
+		std::string const _sDirectory = GetDirectory();
+		if (_sDirectory.empty())
+		{
+			return;
+		}
+
+		// Changed since it was read, the entry would be stamped with the wrong version
+		if (FileHelper::GetFileSize(_sSourcePath) != _Source.m_uSize)
+		{
+			return;
+		}
+
+		if (FileHelper::CreateDirectories(_sDirectory) == false)
+		{
+			return;
+		}
+
+		SHeader _Header;
+		_Header.m_uKind = static_cast<uint32_t>(_eKind);
+		_Header.m_uPathLength = static_cast<uint32_t>(_sSourcePath.size());
+		_Header.m_uSourceSize = _Source.m_uSize;
+		_Header.m_uSourceModifiedTime = FileHelper::GetFileModifiedTime(_sSourcePath);
+		_Header.m_uSourceHash = hash_helper::Hash64(_Source.m_pData, _Source.m_uSize);
+		_Header.m_uPayloadSize = _vectorPayload.size();
+		_Header.m_uPayloadHash = hash_helper::Hash64(_vectorPayload.data(), _vectorPayload.size());
+
+		std::string const _sEntryPath = GetEntryPath(_sDirectory, _sSourcePath, _eKind);
+		std::string const _sTempPath = stl_helper::Format("%s.%zx.tmp", _sEntryPath.c_str(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+		{
+			std::ofstream _File(_sTempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!_File)
+			{
+				return;
+			}
+
+			char const _arrayPadding[8] = {};
+			_File.write(reinterpret_cast<char const*>(&_Header), sizeof(_Header));
+			_File.write(_sSourcePath.data(), _sSourcePath.size());
+			_File.write(_arrayPadding, GetPayloadOffset(_Header.m_uPathLength) - sizeof(SHeader) - _sSourcePath.size());
+			_File.write(reinterpret_cast<char const*>(_vectorPayload.data()), _vectorPayload.size());
+
+			if (!_File)
+			{
+				_File.close();
+				std::remove(_sTempPath.c_str());
+				return;
+			}
+		}
+
+		// Windows won't rename over an existing file
+		std::remove(_sEntryPath.c_str());
+		if (std::rename(_sTempPath.c_str(), _sEntryPath.c_str()) != 0)
+		{
+			std::remove(_sTempPath.c_str());
+		}
+	}
+};
+//========================================
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "file_helper.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//========================================
+// Binary payloads compiled from source files (compound JSON, sprite sheet XML), kept in a
+// cache directory so later opens skip the text parsing.
+//
+// An entry matches while the source's size and modification time are what they were when
+// it was written. If only the time changed (touched, checked out again) the source is
+// hashed and the entry is still used when the contents are the same.
+//
+// Safe to call from any thread. Entries are written to a temporary and renamed into place,
+// so readers never see half a file.
+namespace compiled_cache
+{
+	enum class Kind : uint32_t
+	{
+		Compound = 1,
+		SpriteSheet = 2,
+	};
+
+	// Empty disables the cache. Defaults to "sprite_tool_cache" in the working directory.
+	void SetDirectory(std::string const& _sDirectory);
+	std::string GetDirectory();
+
+	// True with the payload if there's a current entry for _sSourcePath. The payload points
+	// into the mapped entry, nothing is copied.
+	bool Load(std::string const& _sSourcePath, Kind const _eKind, FileHelper::SFileView& _Payload);
+
+	// _Source is what the payload was compiled from
+	void Store(std::string const& _sSourcePath, Kind const _eKind, FileHelper::SFileView const& _Source, std::vector<uint8_t> const& _vectorPayload);
+};
+//========================================
@@ -0,0 +1,96 @@
+#include "cpu_features.hpp"
+
+#include <cstdint>
+
+#if defined(SPRITE_TOOL_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+	struct SFeatures
+	{
+		bool m_bSSE2 = false;
+		bool m_bSSSE3 = false;
+		bool m_bSSE41 = false;
+		bool m_bAVX2 = false;
+	};
+
+#if defined(SPRITE_TOOL_X86)
+	void CPUID(uint32_t _uLeaf, uint32_t _uSubLeaf, uint32_t _arrayRegisters[4])
+	{
+#if defined(_MSC_VER)
+		int _arrayInfo[4];
+		__cpuidex(_arrayInfo, static_cast<int>(_uLeaf), static_cast<int>(_uSubLeaf));
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			_arrayRegisters[i] = static_cast<uint32_t>(_arrayInfo[i]);
+		}
+#else
+		__cpuid_count(_uLeaf, _uSubLeaf, _arrayRegisters[0], _arrayRegisters[1], _arrayRegisters[2], _arrayRegisters[3]);
+#endif
+	}
+
+	uint64_t ReadXCR0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t _uLow = 0, _uHigh = 0;
+		__asm__ volatile("xgetbv" : "=a"(_uLow), "=d"(_uHigh) : "c"(0));
+		return (static_cast<uint64_t>(_uHigh) << 32) | _uLow;
+#endif
+	}
+#endif
+
+	SFeatures DetectFeatures()
+	{
+		SFeatures _Features;
+
+#if defined(SPRITE_TOOL_X86)
+		uint32_t _arrayRegisters[4] = { 0 };	// eax, ebx, ecx, edx
+
+		CPUID(0, 0, _arrayRegisters);
+		uint32_t const _uMaxLeaf = _arrayRegisters[0];
+
+		CPUID(1, 0, _arrayRegisters);
+		_Features.m_bSSE2 = (_arrayRegisters[3] & (1u << 26)) != 0;
+		_Features.m_bSSSE3 = (_arrayRegisters[2] & (1u << 9)) != 0;
+		_Features.m_bSSE41 = (_arrayRegisters[2] & (1u << 19)) != 0;
+
+		// AVX state has to be enabled by the OS as well as supported by the CPU
+		bool const _bOSXSave = (_arrayRegisters[2] & (1u << 27)) != 0;
+		bool const _bAVX = (_arrayRegisters[2] & (1u << 28)) != 0;
+		bool const _bOSSavesYMM = _bOSXSave && (ReadXCR0() & 0x6) == 0x6;
+
+		if (_uMaxLeaf >= 7 && _bAVX && _bOSSavesYMM)
+		{
+			CPUID(7, 0, _arrayRegisters);
+			_Features.m_bAVX2 = (_arrayRegisters[1] & (1u << 5)) != 0;
+		}
+#endif
+
+		return _Features;
+	}
+
+	SFeatures const& GetFeatures()
+	{
+		static SFeatures const s_Features = DetectFeatures();
+		return s_Features;
+	}
+};
+
+//========================================
+namespace cpu_features
+{
+	bool HasSSE2() { return GetFeatures().m_bSSE2; }
+	bool HasSSSE3() { return GetFeatures().m_bSSSE3; }
+	bool HasSSE41() { return GetFeatures().m_bSSE41; }
+	bool HasAVX2() { return GetFeatures().m_bAVX2; }
+};
+//========================================
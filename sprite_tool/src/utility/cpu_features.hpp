@@ -0,0 +1,18 @@
+#pragma once
+
+// SIMD kernels are only compiled for x86/x64, everything else takes the scalar paths
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SPRITE_TOOL_X86 1
+#endif
+
+//========================================
+// Runtime instruction set checks, so one binary can pick the widest kernel the
+// machine (and OS) supports. Results are cached on first use.
+namespace cpu_features
+{
+	bool HasSSE2();
+	bool HasSSSE3();
+	bool HasSSE41();
+	bool HasAVX2();
+};
+//========================================
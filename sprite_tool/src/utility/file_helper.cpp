@@ -2,6 +2,12 @@
 #include "file_helper.hpp"
 
 #include "stl_helper.hpp"
+#include "asset_pack.hpp"
+#include "mapped_file.hpp"
+#include "pixel_kernels.hpp"
+#include "texture_cache.hpp"
+#include "thread_pool.hpp"
+#include "hash_helper.hpp"
 
 #include "libpng/png.h"
 
@@ -9,12 +15,14 @@
 #include "libjpeg/jpeglib.h"
 #include "libjpeg/jerror.h"
 
-// native file dialog
-#include "nfd/nfd.h"
-
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <cassert>
 #include <sys/stat.h>
 
@@ -22,58 +30,27 @@
 //========================================
 namespace FileHelper
 {
-    std::string OpenFileDialog(std::string const& _sExt, std::string const& _sDefaultPath /*= ""*/)
-    {
-        std::string _sPathResult;
-
-        nfdchar_t* _pOutPath = nullptr;
-        nfdresult_t _Result = NFD_OpenDialog(_sExt.c_str(), _sDefaultPath.c_str(), &_pOutPath);
-
-        if (_Result == NFD_OKAY)
-        {
-            _sPathResult = std::string(_pOutPath);
-            free(_pOutPath);
-        }
-        else if (_Result == NFD_CANCEL)
-        {
-            printf("User cancelled.\n");
-        }
-        else
-        {
-            printf("Error: %s\n", NFD_GetError());
-        }
-
-        return _sPathResult;
-    }
-
-    std::string PickFolderDialog(std::string const& _sDefaultPath /*= ""*/)
+    namespace
     {
-        std::string _sPathResult;
-
-        nfdchar_t* _pOutPath = nullptr;
-        nfdresult_t _Result = NFD_PickFolder(_sDefaultPath.c_str(), &_pOutPath);
-
-        if (_Result == NFD_OKAY)
-        {
-            _sPathResult = std::string(_pOutPath);
-            free(_pOutPath);
-        }
-        else if (_Result == NFD_CANCEL)
-        {
-            printf("User cancelled.\n");
-        }
-        else
+        bool FindInPacks(std::string const& _sFilePath, CAssetPack::SMountedEntry& _Entry)
         {
-            printf("Error: %s\n", NFD_GetError());
+            return CAssetPack::HasMounts() && CAssetPack::FindMounted(GetAbsolutePath(_sFilePath), _Entry);
         }
-
-        return _sPathResult;
     }
 
 	std::string GetFileContentsString(std::string const& _sFilePath)
 	{
         std::string _sContents;
 
+        CAssetPack::SMountedEntry _PackEntry;
+        if (FindInPacks(_sFilePath, _PackEntry))
+        {
+            std::vector<uint8_t> _vectorData;
+            _PackEntry.m_pPack->Read(*_PackEntry.m_pEntry, _vectorData);
+            _sContents.assign(_vectorData.begin(), _vectorData.end());
+            return _sContents;
+        }
+
         std::ifstream _File(_sFilePath, std::ios::in | std::ios::binary);
         if (_File)
         {
@@ -91,6 +68,13 @@ namespace FileHelper
     {
         std::vector<uint8_t> _Contents;
 
+        CAssetPack::SMountedEntry _PackEntry;
+        if (FindInPacks(_sFilePath, _PackEntry))
+        {
+            _PackEntry.m_pPack->Read(*_PackEntry.m_pEntry, _Contents);
+            return _Contents;
+        }
+
         std::ifstream _File(_sFilePath, std::ios::in | std::ios::binary);
         if (_File)
         {
@@ -104,12 +88,111 @@ namespace FileHelper
         return _Contents;
     }
 
+    namespace
+    {
+        SFileView MapFile(std::string const& _sFilePath, bool const _bWritable)
+        {
+            SFileView _View;
+
+            CAssetPack::SMountedEntry _PackEntry;
+            if (FindInPacks(_sFilePath, _PackEntry))
+            {
+                _View.m_pData = _PackEntry.m_pPack->GetStoredData(*_PackEntry.m_pEntry);
+                if (_View.m_pData != nullptr && _bWritable == false)
+                {
+                    _View.m_uSize = static_cast<size_t>(_PackEntry.m_pEntry->m_uSize);
+                    _View.m_pOwner = _PackEntry.m_pPack;
+                    return _View;
+                }
+
+                auto _pBuffer = std::make_shared<std::vector<uint8_t>>();
+                if (_View.m_pData != nullptr)
+                {
+                    _pBuffer->assign(_View.m_pData, _View.m_pData + _PackEntry.m_pEntry->m_uSize);
+                }
+                else
+                {
+                    _PackEntry.m_pPack->Read(*_PackEntry.m_pEntry, *_pBuffer);
+                }
+
+                _View = SFileView();
+                if (_pBuffer->empty() == false)
+                {
+                    _View.m_pData = _pBuffer->data();
+                    _View.m_uSize = _pBuffer->size();
+                    _View.m_pWritableData = _bWritable ? _pBuffer->data() : nullptr;
+                    _View.m_pOwner = _pBuffer;
+                }
+                return _View;
+            }
+
+            auto _pMappedFile = std::make_shared<CMappedFile>();
+            CMappedFile::Protection const _eProtection = _bWritable ? CMappedFile::Protection::CopyOnWrite : CMappedFile::Protection::ReadOnly;
+            if (_pMappedFile->Open(_sFilePath, CMappedFile::Access::Sequential, _eProtection) && _pMappedFile->GetSize() > 0)
+            {
+                _View.m_pData = _pMappedFile->GetData();
+                _View.m_uSize = _pMappedFile->GetSize();
+                _View.m_pWritableData = _pMappedFile->GetWritableData();
+                _View.m_pOwner = _pMappedFile;
+            }
+            return _View;
+        }
+    }
+
+    SFileView MapFileContents(std::string const& _sFilePath)
+    {
+        return MapFile(_sFilePath, false);
+    }
+
+    SFileView MapFileContentsWritable(std::string const& _sFilePath)
+    {
+        return MapFile(_sFilePath, true);
+    }
+
     bool FileExists(std::string const& _sFilePath)
     {
+        CAssetPack::SMountedEntry _PackEntry;
+        if (FindInPacks(_sFilePath, _PackEntry))
+        {
+            return true;
+        }
+
         struct stat buffer;
         return (stat(_sFilePath.c_str(), &buffer) == 0);
     }
 
+    uint64_t GetFileSize(std::string const& _sFilePath)
+    {
+        CAssetPack::SMountedEntry _PackEntry;
+        if (FindInPacks(_sFilePath, _PackEntry))
+        {
+            return _PackEntry.m_pEntry->m_uSize;
+        }
+
+        struct stat buffer;
+        if (stat(_sFilePath.c_str(), &buffer) != 0)
+        {
+            return 0;
+        }
+        return static_cast<uint64_t>(buffer.st_size);
+    }
+
+    uint64_t GetFileModifiedTime(std::string const& _sFilePath)
+    {
+        CAssetPack::SMountedEntry _PackEntry;
+        if (FindInPacks(_sFilePath, _PackEntry))
+        {
+            return _PackEntry.m_pEntry->m_uModifiedTime;
+        }
+
+        struct stat buffer;
+        if (stat(_sFilePath.c_str(), &buffer) != 0)
+        {
+            return 0;
+        }
+        return static_cast<uint64_t>(buffer.st_mtime);
+    }
+
     namespace
     {
         void PNGErrorFunction(png_struct* pstruct, const char* perror)
@@ -119,12 +202,15 @@ namespace FileHelper
 
         struct SPNGCustomReadInfo
         {
-            SPNGCustomReadInfo(uint8_t* _pData,
+            SPNGCustomReadInfo(uint8_t const* _pData,
+                               size_t const _uDataSize,
                                size_t& _uReadIndex)
                 : m_pData(_pData)
+                , m_uDataSize(_uDataSize)
                 , m_uReadIndex(_uReadIndex)
             { }
-            uint8_t* m_pData;
+            uint8_t const* m_pData;
+            size_t m_uDataSize;
             size_t& m_uReadIndex;
         };
 
@@ -133,7 +219,16 @@ namespace FileHelper
             png_voidp _pPngIO = png_get_io_ptr(_pPNG);
 
             SPNGCustomReadInfo* _pCustomReadInfo = static_cast<SPNGCustomReadInfo*>(_pPngIO);
-            memcpy(_pData, &_pCustomReadInfo->m_pData[_pCustomReadInfo->m_uReadIndex], _uLength);
+
+            // Truncated file, the mapping ends here. Hand back zeros rather than read past it.
+            size_t const _uAvailable = _pCustomReadInfo->m_uDataSize - std::min(_pCustomReadInfo->m_uReadIndex, _pCustomReadInfo->m_uDataSize);
+            size_t const _uCopy = std::min(_uAvailable, static_cast<size_t>(_uLength));
+            memcpy(_pData, &_pCustomReadInfo->m_pData[_pCustomReadInfo->m_uReadIndex], _uCopy);
+            if (_uCopy < _uLength)
+            {
+                memset(_pData + _uCopy, 0, _uLength - _uCopy);
+                PNGErrorFunction(_pPNG, "Read past the end of the data");
+            }
             _pCustomReadInfo->m_uReadIndex += _uLength;
         }
     }
@@ -148,7 +243,8 @@ namespace FileHelper
 
     SImageData LoadImageFromFile(std::string const& _sFilePath,
                                  int32_t& _iWidth,
-                                 int32_t& _iHeight)
+                                 int32_t& _iHeight,
+                                 uint32_t const _uScaleDenom /*= 1*/)
     {
         std::string _sExtension;
 
@@ -158,30 +254,36 @@ namespace FileHelper
             _sExtension = stl_helper::ToLower( _sFilePath.substr(_uExtpos+1) );
         }
 
-        if (_sExtension == "png")
-        {
-            auto _pContents = std::make_shared<std::vector<uint8_t>>(FileHelper::GetFileContents(_sFilePath));
-
-            return LoadPNG(_pContents->data(),
-                           _iWidth,
-                           _iHeight);
-        }
-        else if (_sExtension == "jpeg" || _sExtension == "jpg")
+        if (_sExtension == "png" || _sExtension == "jpeg" || _sExtension == "jpg" || _sExtension == "jpng")
         {
-            auto _pContents = std::make_shared<std::vector<uint8_t>>(FileHelper::GetFileContents(_sFilePath));
+            // Decoded straight out of the mapping, the view is released once decoded
+            SFileView const _View = MapFileContents(_sFilePath);
+            if (_View.IsEmpty())
+            {
+                return SImageData();
+            }
 
-            return LoadJPEG(_pContents,
-                            _pContents->size(),
-                            _iWidth,
-                            _iHeight);
-        }
-        else if (_sExtension == "jpng")
-        {
-            auto _pContents = std::make_shared<std::vector<uint8_t>>(FileHelper::GetFileContents(_sFilePath));
+            if (_sExtension == "png")
+            {
+                return LoadPNG(_View.m_pData,
+                               _View.m_uSize,
+                               _iWidth,
+                               _iHeight);
+            }
+            else if (_sExtension == "jpng")
+            {
+                return LoadJPNG(_View.m_pData,
+                                _View.m_uSize,
+                                _iWidth,
+                                _iHeight,
+                                _uScaleDenom);
+            }
 
-            return LoadJPNG(_pContents,
+            return LoadJPEG(_View.m_pData,
+                            _View.m_uSize,
                             _iWidth,
-                            _iHeight);
+                            _iHeight,
+                            _uScaleDenom);
         }
         else
         {
@@ -193,7 +295,8 @@ namespace FileHelper
                     {
                         return FileHelper::LoadImageFromFile(_sFilePath + "." + _sExt,
                                                              _iWidth,
-                                                             _iHeight);
+                                                             _iHeight,
+                                                             _uScaleDenom);
                     }
                 }
             }
@@ -202,108 +305,344 @@ namespace FileHelper
         }
     }
 
-    SImageData LoadPNG(uint8_t* _pData,
+    namespace
+    {
+        // Rows of the image (in file order) that are fully decoded so far
+        typedef std::function<void(int32_t _iRowsDone)> tOnRowsDecoded;
+
+        // Checks the signature, reads the header and sets up the transforms, ready for
+        // png_read_rows(). Null if it isn't a PNG.
+        png_structp BeginPNGRead(SPNGCustomReadInfo& _ReadInfo,
+                                 bool const _bConvertGrey,
+                                 bool const _bSetFiller,
+                                 png_infop& _pPngInfo,
+                                 int& _iPasses)
+        {
+            size_t const c_uPngSigBytes = 8;
+
+            if (_ReadInfo.m_uDataSize < c_uPngSigBytes)
+            {
+                fprintf(stderr, "PNG too small.\n");
+                return nullptr;
+            }
+
+            uint8_t _Header[c_uPngSigBytes];
+            memcpy(_Header, _ReadInfo.m_pData, c_uPngSigBytes);
+            _ReadInfo.m_uReadIndex = c_uPngSigBytes;
+
+            if (png_sig_cmp(_Header, 0, c_uPngSigBytes) != 0)
+            {
+                fprintf(stderr, "PNG Signature mismatch.\n");
+                return nullptr;
+            }
+
+            png_structp _pPngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, PNGErrorFunction, PNGErrorFunction);
+            assert(_pPngStruct);
+
+            _pPngInfo = png_create_info_struct(_pPngStruct);
+            assert(_pPngInfo);
+
+            png_set_read_fn(_pPngStruct, (png_voidp)(&_ReadInfo), PNGCustomReadData);
+            png_set_sig_bytes(_pPngStruct, c_uPngSigBytes);
+            png_read_info(_pPngStruct, _pPngInfo);
+
+            png_uint_32 _uBitDepth, _uColourType;
+            _uBitDepth = png_get_bit_depth(_pPngStruct, _pPngInfo);
+            _uColourType = png_get_color_type(_pPngStruct, _pPngInfo);
+
+            if (_uColourType == PNG_COLOR_TYPE_GRAY && _uBitDepth < 8) 
+            {
+                png_set_expand_gray_1_2_4_to_8(_pPngStruct);
+            }
+
+            if (_uBitDepth == 16)
+            {
+                png_set_strip_16(_pPngStruct);
+            }
+
+            if (_uColourType == PNG_COLOR_TYPE_PALETTE)
+            {
+                png_set_palette_to_rgb(_pPngStruct);
+            }
+            else if (_bConvertGrey && (_uColourType == PNG_COLOR_TYPE_GRAY ||
+                                       _uColourType == PNG_COLOR_TYPE_GRAY_ALPHA))
+            {
+                png_set_gray_to_rgb(_pPngStruct);
+            }
+
+            if (png_get_valid(_pPngStruct, _pPngInfo, PNG_INFO_tRNS))
+            {
+                png_set_tRNS_to_alpha(_pPngStruct);
+            }
+            else if (_bSetFiller)
+            {
+                png_set_filler(_pPngStruct, 0xff, PNG_FILLER_AFTER);
+            }
+
+            _iPasses = png_set_interlace_handling(_pPngStruct);
+            png_read_update_info(_pPngStruct, _pPngInfo);
+
+            return _pPngStruct;
+        }
+
+        bool DecodePNG(uint8_t const* _pData,
+                       size_t const _uDataSize,
+                       int32_t& _iWidth,
+                       int32_t& _iHeight,
+                       bool const _bConvertGrey,
+                       bool const _bSetFiller,
+                       bool const _bFlipPng,
+                       tPixelBuffer& _Pixels,
+                       tOnRowsDecoded const& _OnRowsDecoded)
+        {
+            size_t _uReadIndex = 0;
+            SPNGCustomReadInfo _CustomReadInfo(_pData, _uDataSize, _uReadIndex);
+
+            png_infop _pPngInfo = nullptr;
+            int _iPasses = 1;
+            png_structp _pPngStruct = BeginPNGRead(_CustomReadInfo, _bConvertGrey, _bSetFiller, _pPngInfo, _iPasses);
+            if (_pPngStruct == nullptr)
+            {
+                return false;
+            }
+
+            _iWidth = png_get_image_width(_pPngStruct, _pPngInfo);
+            _iHeight = png_get_image_height(_pPngStruct, _pPngInfo);
+
+            png_size_t _uRowBytes = png_get_rowbytes(_pPngStruct, _pPngInfo);
+            png_size_t _uTotalBytes = _uRowBytes * (_iHeight);
+
+            _Pixels.resize(_uTotalBytes);
+
+            png_byte** _pRowPtrs = (png_byte**)malloc((_iHeight) * sizeof(png_byte*));
+
+            if (_bFlipPng)
+            {
+                for (int32_t i = 0; i < _iHeight; i++)
+                {
+                    _pRowPtrs[i] = _Pixels.data() + i * _uRowBytes;
+                }
+            }
+            else
+            {
+                for (int32_t i = 0; i < _iHeight; i++)
+                {
+                    _pRowPtrs[i] = _Pixels.data() + (int32_t(_iHeight) - int32_t(1) - i) * _uRowBytes;
+                }
+            }
+
+            // A band at a time so whoever's waiting on the rows can start on them, interlaced
+            // images are only complete after the last pass
+            int32_t const c_iRowBand = 16;
+            for (int _iPass = 0; _iPass < _iPasses; ++_iPass)
+            {
+                for (int32_t _iRow = 0; _iRow < _iHeight; _iRow += c_iRowBand)
+                {
+                    int32_t const _iRows = std::min(c_iRowBand, _iHeight - _iRow);
+                    png_read_rows(_pPngStruct, _pRowPtrs + _iRow, nullptr, _iRows);
+
+                    if (_OnRowsDecoded && _iPass == _iPasses - 1)
+                    {
+                        _OnRowsDecoded(_iRow + _iRows);
+                    }
+                }
+            }
+
+            free(_pRowPtrs);
+            png_destroy_read_struct(&_pPngStruct, &_pPngInfo, nullptr);
+
+            return true;
+        }
+    };
+
+    SImageData LoadPNG(uint8_t const* _pData,
+                       size_t const _uDataSize,
                        int32_t& _iWidth,
                        int32_t& _iHeight,
                        bool const _bConvertGrey /*= true*/,
                        bool const _bSetFiller /*= true*/,
                        bool const _bFlipPng /*= true*/)
     {
-        size_t _uReadIndex = 0;
-
-        size_t const c_uPngSigBytes = 8;
-
-        uint8_t _Header[c_uPngSigBytes];
-        memcpy(_Header, _pData, c_uPngSigBytes);
-        _uReadIndex += c_uPngSigBytes;
-
-        if (png_sig_cmp(_Header, 0, c_uPngSigBytes) != 0)
+        std::shared_ptr<tPixelBuffer> _pOutData = std::make_shared<tPixelBuffer>();
+        if (DecodePNG(_pData, _uDataSize, _iWidth, _iHeight, _bConvertGrey, _bSetFiller, _bFlipPng, *_pOutData, nullptr) == false)
         {
-            fprintf(stderr, "PNG Signature mismatch.\n");
             return SImageData();
         }
+        return SImageData{ _pOutData, 4 };
+    }
 
-        png_structp _pPngStruct = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, PNGErrorFunction, PNGErrorFunction);
-        assert(_pPngStruct);
+    bool PNGHasAlpha(uint8_t const* _pData, size_t const _uDataSize)
+    {
+        static uint8_t const c_arraySignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        if (_uDataSize < sizeof(c_arraySignature) || memcmp(_pData, c_arraySignature, sizeof(c_arraySignature)) != 0)
+        {
+            return true;
+        }
 
-        png_infop _pPngInfo = png_create_info_struct(_pPngStruct);
-        assert(_pPngInfo);
+        // Chunks are a big endian length, a 4 byte type, the data and a CRC
+        size_t _uOffset = sizeof(c_arraySignature);
+        while (_uDataSize - _uOffset >= 12)
+        {
+            uint8_t const* _pChunk = _pData + _uOffset;
+            uint32_t const _uLength = (uint32_t(_pChunk[0]) << 24) | (uint32_t(_pChunk[1]) << 16) | (uint32_t(_pChunk[2]) << 8) | _pChunk[3];
+            if (_uLength > _uDataSize - _uOffset - 12)
+            {
+                return true;
+            }
 
-        png_infop _pPngEndInfo = png_create_info_struct(_pPngStruct);
-        assert(_pPngEndInfo);
+            if (memcmp(_pChunk + 4, "IHDR", 4) == 0 && _uLength >= 13)
+            {
+                // Colour types 4 (grey and alpha) and 6 (RGBA)
+                if ((_pChunk[8 + 9] & 4) != 0)
+                {
+                    return true;
+                }
+            }
+            else if (memcmp(_pChunk + 4, "tRNS", 4) == 0)
+            {
+                return true;
+            }
+            else if (memcmp(_pChunk + 4, "IDAT", 4) == 0)
+            {
+                // tRNS has to come before the image data
+                return false;
+            }
+            _uOffset += 12 + _uLength;
+        }
+        return true;
+    }
+
+    CPNGStream::CPNGStream()
+    {
 
-        SPNGCustomReadInfo _CustomReadInfo(_pData, _uReadIndex);
-        png_set_read_fn(_pPngStruct, (png_voidp)(&_CustomReadInfo), PNGCustomReadData);
-        png_set_sig_bytes(_pPngStruct, c_uPngSigBytes);
-        png_read_info(_pPngStruct, _pPngInfo);
+    }
+
+    CPNGStream::~CPNGStream()
+    {
+        Close();
+    }
 
-        png_uint_32 _uBitDepth, _uColourType;
-        _uBitDepth = png_get_bit_depth(_pPngStruct, _pPngInfo);
-        _uColourType = png_get_color_type(_pPngStruct, _pPngInfo);
+    bool CPNGStream::Open(std::string const& _sFilePath)
+    {
+        Close();
 
-        if (_uColourType == PNG_COLOR_TYPE_GRAY && _uBitDepth < 8) 
+        m_View = MapFileContents(_sFilePath);
+        if (m_View.IsEmpty())
         {
-            png_set_expand_gray_1_2_4_to_8(_pPngStruct);
+            return false;
         }
 
-        if (_uBitDepth == 16)
+        // PNGs always decode at full size
+        uint32_t const c_uScaleDenom = 1;
+
+        bool const _bUseTextureCache = texture_cache::IsEnabled();
+        uint64_t const _uSourceHash = _bUseTextureCache ? hash_helper::Hash64(m_View.m_pData, m_View.m_uSize) : 0;
+        if (_bUseTextureCache)
         {
-            png_set_strip_16(_pPngStruct);
+            auto _pReader = std::make_unique<texture_cache::CReader>();
+            if (_pReader->Open(_uSourceHash, c_uScaleDenom) && _pReader->GetChannels() == 4)
+            {
+                m_pCacheReader = std::move(_pReader);
+                m_iWidth = m_pCacheReader->GetWidth();
+                m_iHeight = m_pCacheReader->GetHeight();
+                m_View = SFileView();
+                return true;
+            }
         }
 
-        if (_uColourType == PNG_COLOR_TYPE_PALETTE)
+        SPNGCustomReadInfo* _pReadInfo = new SPNGCustomReadInfo(m_View.m_pData, m_View.m_uSize, m_uReadIndex);
+        m_pReadInfo = _pReadInfo;
+
+        png_infop _pPngInfo = nullptr;
+        int _iPasses = 1;
+        png_structp _pPngStruct = BeginPNGRead(*_pReadInfo, true, true, _pPngInfo, _iPasses);
+        m_pPngStruct = _pPngStruct;
+        m_pPngInfo = _pPngInfo;
+
+        // Interlaced, or something the transforms didn't turn into RGBA
+        if (_pPngStruct == nullptr || _iPasses != 1 || png_get_rowbytes(_pPngStruct, _pPngInfo) != static_cast<size_t>(png_get_image_width(_pPngStruct, _pPngInfo)) * 4)
         {
-            png_set_palette_to_rgb(_pPngStruct);
+            Close();
+            return false;
         }
-        else if (_bConvertGrey && (_uColourType == PNG_COLOR_TYPE_GRAY ||
-                                   _uColourType == PNG_COLOR_TYPE_GRAY_ALPHA))
+
+        m_iWidth = png_get_image_width(_pPngStruct, _pPngInfo);
+        m_iHeight = png_get_image_height(_pPngStruct, _pPngInfo);
+
+        if (_bUseTextureCache)
         {
-            png_set_gray_to_rgb(_pPngStruct);
+            m_pCacheWriter = std::make_unique<texture_cache::CWriter>();
+            if (m_pCacheWriter->Begin(_uSourceHash, c_uScaleDenom, m_iWidth, m_iHeight, GetChannels()) == false)
+            {
+                m_pCacheWriter.reset();
+            }
         }
+        return true;
+    }
 
-        if (png_get_valid(_pPngStruct, _pPngInfo, PNG_INFO_tRNS))
+    void CPNGStream::Close()
+    {
+        if (m_pPngStruct != nullptr)
         {
-            png_set_tRNS_to_alpha(_pPngStruct);
+            png_structp _pPngStruct = static_cast<png_structp>(m_pPngStruct);
+            png_infop _pPngInfo = static_cast<png_infop>(m_pPngInfo);
+            png_destroy_read_struct(&_pPngStruct, &_pPngInfo, nullptr);
         }
-        else if (_bSetFiller)
+        delete static_cast<SPNGCustomReadInfo*>(m_pReadInfo);
+
+        m_pPngStruct = nullptr;
+        m_pPngInfo = nullptr;
+        m_pReadInfo = nullptr;
+        m_pCacheReader.reset();
+        m_pCacheWriter.reset();
+        m_View = SFileView();
+        m_uReadIndex = 0;
+        m_iWidth = 0;
+        m_iHeight = 0;
+        m_iRowsRead = 0;
+    }
+
+    int32_t CPNGStream::ReadRows(uint8_t* _pRows, int32_t const _iRows)
+    {
+        if (m_pCacheReader != nullptr)
         {
-            png_set_filler(_pPngStruct, 0xff, PNG_FILLER_AFTER);
+            int32_t const _iRead = m_pCacheReader->ReadRows(_pRows, _iRows);
+            m_iRowsRead += _iRead;
+            return _iRead;
         }
 
-        png_read_update_info(_pPngStruct, _pPngInfo);
-
-        _iWidth = png_get_image_width(_pPngStruct, _pPngInfo);
-        _iHeight = png_get_image_height(_pPngStruct, _pPngInfo);
-
-        png_size_t _uRowBytes = png_get_rowbytes(_pPngStruct, _pPngInfo);
-        png_size_t _uTotalBytes = _uRowBytes * (_iHeight);
-
-        std::shared_ptr<std::vector<uint8_t>> _pOutData = std::make_shared<std::vector<uint8_t>>();
-        _pOutData->resize(_uTotalBytes);
+        int32_t const _iCount = std::min(_iRows, m_iHeight - m_iRowsRead);
+        if (m_pPngStruct == nullptr || _iCount <= 0)
+        {
+            return 0;
+        }
 
-        png_byte** _pRowPtrs = (png_byte**)malloc((_iHeight) * sizeof(png_byte*));
+        int32_t const c_iRowBand = 16;
+        png_bytep _arrayRowPtrs[c_iRowBand];
 
-        if (_bFlipPng)
+        size_t const _uRowBytes = GetRowBytes();
+        for (int32_t _iRow = 0; _iRow < _iCount; _iRow += c_iRowBand)
         {
-            for (int32_t i = 0; i < _iHeight; i++)
+            int32_t const _iBandRows = std::min(c_iRowBand, _iCount - _iRow);
+            for (int32_t i = 0; i < _iBandRows; ++i)
             {
-                _pRowPtrs[i] = _pOutData->data() + i * _uRowBytes;
+                _arrayRowPtrs[i] = _pRows + (_iRow + i) * _uRowBytes;
             }
+            png_read_rows(static_cast<png_structp>(m_pPngStruct), _arrayRowPtrs, nullptr, _iBandRows);
         }
-        else
+
+        m_iRowsRead += _iCount;
+
+        if (m_pCacheWriter != nullptr)
         {
-            for (int32_t i = 0; i < _iHeight; i++)
+            m_pCacheWriter->AddRows(_pRows, _iCount);
+            if (IsFinished())
             {
-                _pRowPtrs[i] = _pOutData->data() + (int32_t(_iHeight) - int32_t(1) - i) * _uRowBytes;
+                m_pCacheWriter->Finish();
+                m_pCacheWriter.reset();
             }
         }
-
-        png_read_image(_pPngStruct, _pRowPtrs);
-
-        free(_pRowPtrs);
-        png_destroy_read_struct(&_pPngStruct, &_pPngInfo, &_pPngEndInfo);
-
-        return SImageData{ _pOutData, 4 };
+        return _iCount;
     }
 
     namespace
@@ -314,112 +653,542 @@ namespace FileHelper
             throw std::runtime_error("JPEG code error.");
         }
 
-        static char s_JPEGError[JMSG_LENGTH_MAX] = "<NO ERROR>";
+        // Per thread, the headless renderer decodes on several threads at once
+        static thread_local char s_JPEGError[JMSG_LENGTH_MAX] = "<NO ERROR>";
         static void JPEGCustomOutputMessage(j_common_ptr _pCommon)
         {
             (*_pCommon->err->format_message)(_pCommon, s_JPEGError);
         }
-    };
 
-    SImageData LoadJPEG(std::shared_ptr<std::vector<uint8_t>> _pFileData,
-                        size_t m_uDataSize,
-                        int32_t& _iWidth,
-                        int32_t& _iHeight)
-    {
-        std::shared_ptr<std::vector<uint8_t>> _pData = std::make_shared<std::vector<uint8_t>>();
+        // Reads straight out of _pData, which has to outlive the decode
+        void SetJPEGMemorySource(jpeg_decompress_struct& _JPEGInfo, uint8_t const* _pData, size_t const _uDataSize)
+        {
+            struct jpeg_source_mgr* _pSrc;
 
-        // JPEG decompression parameters and pointers to working space
-        struct jpeg_decompress_struct _JPEGInfo;
+            if (_JPEGInfo.src == NULL)
+            {
+                _JPEGInfo.src = (struct jpeg_source_mgr*)
+                    (*_JPEGInfo.mem->alloc_small) ((j_common_ptr)&_JPEGInfo,
+                                                    JPOOL_PERMANENT,
+                                                    sizeof(struct jpeg_source_mgr));
+            }
 
-        JSAMPARRAY _pOutputRowbuffer = nullptr;    // Output row buffer
+            _pSrc = (struct jpeg_source_mgr*) _JPEGInfo.src;
+            _pSrc->init_source = [](j_decompress_ptr _pJPEGInfo) -> void {};
+            _pSrc->fill_input_buffer = [](j_decompress_ptr _pJPEGInfo) -> boolean
+            {
+                ERREXIT(_pJPEGInfo, JERR_INPUT_EMPTY);
+                return true;
+            };
+            _pSrc->skip_input_data = [](j_decompress_ptr _pJPEGInfo, long num_bytes) -> void
+            {
+                struct jpeg_source_mgr* _pSrc = (struct jpeg_source_mgr*) _pJPEGInfo->src;
 
-        // Override error_exit and output message.
-        jpeg_error_mgr _ErrorMgr;
-        _JPEGInfo.err = jpeg_std_error(&_ErrorMgr);
-        _ErrorMgr.error_exit = JPEGCustomErrorExit;
-        _ErrorMgr.output_message = JPEGCustomOutputMessage;
+                if (num_bytes > 0) {
+                    _pSrc->next_input_byte += (size_t)num_bytes;
+                    _pSrc->bytes_in_buffer -= (size_t)num_bytes;
+                }
+            };
+            _pSrc->resync_to_restart = jpeg_resync_to_restart; /* use default method */
+            _pSrc->term_source = [](j_decompress_ptr _pJPEGInfo) {};
+            _pSrc->bytes_in_buffer = _uDataSize;
+            _pSrc->next_input_byte = (JOCTET const*)_pData;
+        }
 
-        try
+        // Where a decode's rows go. Either the whole image into m_pPixels, sized to fit, or a
+        // window of it: rows [m_iFirstRow, m_iFirstRow + m_iRowCount) land in m_pRows, the rows
+        // above are decoded and dropped and the ones below are never decoded at all.
+        struct SJPEGOutput
+        {
+            tPixelBuffer* m_pPixels = nullptr;
+
+            uint8_t* m_pRows = nullptr;
+            int32_t m_iWidth = 0;       // the window's, a decode of any other width fails
+            int32_t m_iFirstRow = 0;
+            int32_t m_iRowCount = 0;
+        };
+
+        // Always 4 bytes a texel. With _bPackedRGB each row is left as RGB packed into the back
+        // three quarters of the row, for the caller to spread out (see pixel_kernels::MergeRGBA()),
+        // otherwise it's finished RGBX.
+        bool DecodeJPEGRows(uint8_t const* _pFileData,
+                            size_t const _uDataSize,
+                            int32_t& _iWidth,
+                            int32_t& _iHeight,
+                            uint32_t const _uScaleDenom,
+                            bool const _bPackedRGB,
+                            SJPEGOutput const& _Output,
+                            tOnRowsDecoded const& _OnRowsDecoded)
         {
-            // Initialize JPEG decompression object
-            jpeg_create_decompress(&_JPEGInfo);
+            // JPEG decompression parameters and pointers to working space
+            struct jpeg_decompress_struct _JPEGInfo;
+
+            // Override error_exit and output message.
+            jpeg_error_mgr _ErrorMgr;
+            _JPEGInfo.err = jpeg_std_error(&_ErrorMgr);
+            _ErrorMgr.error_exit = JPEGCustomErrorExit;
+            _ErrorMgr.output_message = JPEGCustomOutputMessage;
 
-            // Setup data source
+            try
             {
-                struct jpeg_source_mgr* _pSrc;
+                // Initialize JPEG decompression object
+                jpeg_create_decompress(&_JPEGInfo);
 
-                if (_JPEGInfo.src == NULL)
+                // Setup data source
+                SetJPEGMemorySource(_JPEGInfo, _pFileData, _uDataSize);
+
+                (void)jpeg_read_header(&_JPEGInfo, TRUE);
+
+                // Scaled in the IDCT, so the skipped coefficients are never computed.
+                // Output is ceil(size / denom).
+                _JPEGInfo.scale_num = 1;
+                _JPEGInfo.scale_denom = std::max(1u, _uScaleDenom);
+
+                // Always RGB out (greyscale is expanded too), with libjpeg-turbo straight to RGBX
+                _JPEGInfo.out_color_space = JCS_RGB;
+#if defined(JCS_EXTENSIONS)
+                if (_bPackedRGB == false)
                 {
-                    _JPEGInfo.src = (struct jpeg_source_mgr*)
-                        (*_JPEGInfo.mem->alloc_small) ((j_common_ptr)&_JPEGInfo,
-                                                        JPOOL_PERMANENT,
-                                                        sizeof(struct jpeg_source_mgr));
+                    _JPEGInfo.out_color_space = JCS_EXT_RGBX;
                 }
+#endif
+
+                (void)jpeg_start_decompress(&_JPEGInfo);
 
-                _pSrc = (struct jpeg_source_mgr*) _JPEGInfo.src;
-                _pSrc->init_source = [](j_decompress_ptr _pJPEGInfo) -> void {};
-                _pSrc->fill_input_buffer = [](j_decompress_ptr _pJPEGInfo) -> boolean
+                _iWidth = _JPEGInfo.output_width;
+                _iHeight = _JPEGInfo.output_height;
+
+                size_t const _uRowStride = static_cast<size_t>(_iWidth) * 4;
+
+                uint8_t* _pRows = _Output.m_pRows;
+                JDIMENSION _uFirstKept = 0;
+                JDIMENSION _uEndKept = _JPEGInfo.output_height;
+                if (_Output.m_pPixels != nullptr)
                 {
-                    ERREXIT(_pJPEGInfo, JERR_INPUT_EMPTY);
-                    return true;
-                };
-                _pSrc->skip_input_data = [](j_decompress_ptr _pJPEGInfo, long num_bytes) -> void
+                    _Output.m_pPixels->resize(_uRowStride * _iHeight);
+                    _pRows = _Output.m_pPixels->data();
+                }
+                else
+                {
+                    _uFirstKept = _Output.m_iFirstRow;
+                    _uEndKept = _Output.m_iFirstRow + _Output.m_iRowCount;
+                    if (_iWidth != _Output.m_iWidth || _uEndKept > _JPEGInfo.output_height)
+                    {
+                        throw std::runtime_error("JPEG window doesn't fit the image.");
+                    }
+                }
+
+                // Rows above the window all land on the one scratch row
+                tPixelBuffer _ScratchRow(_uFirstKept > 0 ? _uRowStride : 0);
+
+                // Plain RGB lands in the back three quarters of its row
+                size_t const _uRowOffset = (_JPEGInfo.output_components == 4) ? 0 : _iWidth;
+                pixel_kernels::tMergeRGBA const _MergeRGBA = pixel_kernels::GetMergeRGBA();
+
+                // Rows are decoded in place, libjpeg gets pointers straight into the output
+                JDIMENSION const c_uRowBatch = 16;
+                JSAMPROW _arrayRows[c_uRowBatch];
+                while (_JPEGInfo.output_scanline < _uEndKept)
+                {
+                    JDIMENSION const _uFirstRow = _JPEGInfo.output_scanline;
+                    JDIMENSION const _uRows = std::min(c_uRowBatch, _uEndKept - _uFirstRow);
+                    for (JDIMENSION i = 0; i < _uRows; ++i)
+                    {
+                        JDIMENSION const _uRow = _uFirstRow + i;
+                        _arrayRows[i] = (_uRow < _uFirstKept) ? _ScratchRow.data() + _uRowOffset : _pRows + (_uRow - _uFirstKept) * _uRowStride + _uRowOffset;
+                    }
+
+                    JDIMENSION const _uRead = jpeg_read_scanlines(&_JPEGInfo, _arrayRows, _uRows);
+
+                    if (_JPEGInfo.output_components == 3 && _bPackedRGB == false)
+                    {
+                        for (JDIMENSION i = 0; i < _uRead; ++i)
+                        {
+                            if (_uFirstRow + i >= _uFirstKept)
+                            {
+                                uint8_t* _pRow = _pRows + (_uFirstRow + i - _uFirstKept) * _uRowStride;
+                                _MergeRGBA(_pRow, _pRow + _uRowOffset, nullptr, _iWidth);
+                            }
+                        }
+                    }
+
+                    if (_OnRowsDecoded)
+                    {
+                        _OnRowsDecoded(static_cast<int32_t>(_uFirstRow + _uRead));
+                    }
+                }
+
+                // A window can stop short of the bottom, libjpeg won't finish early
+                if (_JPEGInfo.output_scanline < _JPEGInfo.output_height)
                 {
-                    struct jpeg_source_mgr* _pSrc = (struct jpeg_source_mgr*) _pJPEGInfo->src;
+                    jpeg_abort_decompress(&_JPEGInfo);
+                }
+                else
+                {
+                    (void)jpeg_finish_decompress(&_JPEGInfo);
+                }
+
+                // Release some memory
+                jpeg_destroy_decompress(&_JPEGInfo);
+            }
+            catch (std::runtime_error const& e)
+            {
+                std::cout << e.what() << ": '" << s_JPEGError << "'." << std::endl;
+
+                // JPEG error, clean up
+                jpeg_destroy_decompress(&_JPEGInfo);
+                return false;
+            }
 
-                    if (num_bytes > 0) {
-                        _pSrc->next_input_byte += (size_t)num_bytes;
-                        _pSrc->bytes_in_buffer -= (size_t)num_bytes;
+            return true;
+        }
+
+        // Where the restart intervals are in a single scan, sequential, Huffman coded JPEG
+        struct SJPEGRestartLayout
+        {
+            size_t m_uHeightOffset = 0;     // of the frame height, in the SOF segment
+            size_t m_uScanOffset = 0;       // first byte of entropy coded data, everything before is headers
+            size_t m_uScanEnd = 0;          // the EOI marker
+            std::vector<size_t> m_vectorIntervals;  // where each interval's data starts
+
+            uint32_t m_uWidth = 0;
+            uint32_t m_uHeight = 0;
+            uint32_t m_uMCUHeight = 0;      // pixels
+            uint32_t m_uMCUsPerRow = 0;
+            uint32_t m_uMCURows = 0;
+            uint32_t m_uRestartInterval = 0;    // MCUs
+        };
+
+        // False for anything that can't be split: no restart markers, progressive, lossless or
+        // arithmetic coding, more than one scan, a DNL height or markers out of sequence
+        bool FindJPEGRestartIntervals(uint8_t const* _pData, size_t const _uDataSize, SJPEGRestartLayout& _Layout)
+        {
+            if (_uDataSize < 4 || _pData[0] != 0xFF || _pData[1] != 0xD8)
+            {
+                return false;
+            }
+
+            // Headers, up to the start of the scan
+            //========================================
+            uint32_t _uComponents = 0;
+            uint32_t _uMaxH = 1;
+            uint32_t _uMaxV = 1;
+
+            size_t i = 2;
+            for (;;)
+            {
+                // Any number of 0xFF can pad a marker
+                if (i >= _uDataSize || _pData[i] != 0xFF)
+                {
+                    return false;
+                }
+                while (i < _uDataSize && _pData[i] == 0xFF)
+                {
+                    ++i;
+                }
+                if (i + 3 > _uDataSize)
+                {
+                    return false;
+                }
+
+                uint8_t const _uMarker = _pData[i++];
+                if (_uMarker == 0x01 || (_uMarker >= 0xD0 && _uMarker <= 0xD7))
+                {
+                    continue;
+                }
+                if (_uMarker == 0xD8 || _uMarker == 0xD9)
+                {
+                    return false;
+                }
+
+                size_t const _uLength = (static_cast<size_t>(_pData[i]) << 8) | _pData[i + 1];
+                if (_uLength < 2 || i + _uLength > _uDataSize)
+                {
+                    return false;
+                }
+                uint8_t const* _pSegment = _pData + i + 2;
+                size_t const _uSegmentSize = _uLength - 2;
+
+                if (_uMarker == 0xC0 || _uMarker == 0xC1)
+                {
+                    if (_uSegmentSize < 6)
+                    {
+                        return false;
                     }
-                };
-                _pSrc->resync_to_restart = jpeg_resync_to_restart; /* use default method */
-                _pSrc->term_source = [](j_decompress_ptr _pJPEGInfo) {};
-                _pSrc->bytes_in_buffer = static_cast<long>(m_uDataSize);
-                _pSrc->next_input_byte = (JOCTET*)_pFileData->data();
+                    _Layout.m_uHeightOffset = i + 3;
+                    _Layout.m_uHeight = (static_cast<uint32_t>(_pSegment[1]) << 8) | _pSegment[2];
+                    _Layout.m_uWidth = (static_cast<uint32_t>(_pSegment[3]) << 8) | _pSegment[4];
+                    _uComponents = _pSegment[5];
+                    if (_uSegmentSize < 6 + 3 * static_cast<size_t>(_uComponents))
+                    {
+                        return false;
+                    }
+
+                    for (uint32_t c = 0; c < _uComponents; ++c)
+                    {
+                        uint32_t const _uH = _pSegment[7 + 3 * c] >> 4;
+                        uint32_t const _uV = _pSegment[7 + 3 * c] & 0xF;
+                        if (_uH == 0 || _uV == 0)
+                        {
+                            return false;
+                        }
+                        _uMaxH = std::max(_uMaxH, _uH);
+                        _uMaxV = std::max(_uMaxV, _uV);
+                    }
+                }
+                else if (_uMarker >= 0xC2 && _uMarker <= 0xCF && _uMarker != 0xC4 && _uMarker != 0xC8 && _uMarker != 0xCC)
+                {
+                    return false;
+                }
+                else if (_uMarker == 0xDD)
+                {
+                    if (_uSegmentSize < 2)
+                    {
+                        return false;
+                    }
+                    _Layout.m_uRestartInterval = (static_cast<uint32_t>(_pSegment[0]) << 8) | _pSegment[1];
+                }
+                else if (_uMarker == 0xDC)
+                {
+                    return false;
+                }
+                else if (_uMarker == 0xDA)
+                {
+                    // Every component has to be in this one scan
+                    if (_uSegmentSize < 1 || _uComponents == 0 || _pSegment[0] != _uComponents)
+                    {
+                        return false;
+                    }
+                    _Layout.m_uScanOffset = i + _uLength;
+                    break;
+                }
+
+                i += _uLength;
             }
 
-            (void)jpeg_read_header(&_JPEGInfo, TRUE);
+            if (_Layout.m_uRestartInterval == 0 || _Layout.m_uWidth == 0 || _Layout.m_uHeight == 0)
+            {
+                return false;
+            }
 
-            (void)jpeg_start_decompress(&_JPEGInfo);
+            // A single component scan isn't interleaved, its MCU is one block
+            uint32_t const _uMCUWidth = (_uComponents == 1) ? 8 : 8 * _uMaxH;
+            _Layout.m_uMCUHeight = (_uComponents == 1) ? 8 : 8 * _uMaxV;
+            _Layout.m_uMCUsPerRow = (_Layout.m_uWidth + _uMCUWidth - 1) / _uMCUWidth;
+            _Layout.m_uMCURows = (_Layout.m_uHeight + _Layout.m_uMCUHeight - 1) / _Layout.m_uMCUHeight;
+            //========================================
 
-            int32_t _iRowStride = _JPEGInfo.output_width * _JPEGInfo.output_components;
+            // Entropy coded data. 0xFF is always followed by a stuffed 0, fill or a marker.
+            //========================================
+            _Layout.m_vectorIntervals.push_back(_Layout.m_uScanOffset);
+
+            size_t j = _Layout.m_uScanOffset;
+            for (;;)
+            {
+                uint8_t const* _pFF = static_cast<uint8_t const*>(memchr(_pData + j, 0xFF, _uDataSize - j));
+                if (_pFF == nullptr || _pFF + 1 >= _pData + _uDataSize)
+                {
+                    return false;
+                }
+                j = _pFF - _pData;
 
-            // Make one-row-high sample array
-            _pOutputRowbuffer = (*_JPEGInfo.mem->alloc_sarray)
-                ((j_common_ptr)&_JPEGInfo, JPOOL_IMAGE, _iRowStride, 1);
+                uint8_t const _uNext = _pData[j + 1];
+                if (_uNext == 0x00)
+                {
+                    j += 2;
+                }
+                else if (_uNext == 0xFF)
+                {
+                    j += 1;
+                }
+                else if (_uNext >= 0xD0 && _uNext <= 0xD7)
+                {
+                    if (static_cast<size_t>(_uNext - 0xD0) != ((_Layout.m_vectorIntervals.size() - 1) & 7))
+                    {
+                        return false;
+                    }
+                    j += 2;
+                    _Layout.m_vectorIntervals.push_back(j);
+                }
+                else if (_uNext == 0xD9)
+                {
+                    _Layout.m_uScanEnd = j;
+                    break;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            //========================================
 
-            _iWidth = _JPEGInfo.output_width;
-            _iHeight = _JPEGInfo.output_height;
+            uint64_t const _uMCUs = static_cast<uint64_t>(_Layout.m_uMCUsPerRow) * _Layout.m_uMCURows;
+            return _Layout.m_vectorIntervals.size() == (_uMCUs + _Layout.m_uRestartInterval - 1) / _Layout.m_uRestartInterval;
+        }
 
-            uint32_t _uTotalBytes = _iWidth * _iHeight * _JPEGInfo.output_components;
+        // Below this a JPEG is decoded on the one thread, starting more isn't worth it
+        uint64_t const c_uMinTexelsForRestartThreads = 1024 * 1024;
+        // Least each thread is given
+        uint64_t const c_uMinTexelsPerRestartSegment = 256 * 1024;
 
-            // Allocate data buffer
-            _pData->resize(_uTotalBytes);
+        uint32_t GreatestCommonDivisor(uint32_t _uA, uint32_t _uB)
+        {
+            while (_uB != 0)
+            {
+                uint32_t const _uRemainder = _uA % _uB;
+                _uA = _uB;
+                _uB = _uRemainder;
+            }
+            return _uA;
+        }
 
-            // Read JPEG scanlines
-            while (_JPEGInfo.output_scanline < _JPEGInfo.output_height)
+        // A restart marker resets the entropy decoder, so the intervals between them decode on
+        // their own. The image is cut into bands at MCU rows an interval starts on and each band
+        // is decoded on its own thread as a JPEG of its own: the original headers with the height
+        // patched, the band's intervals (markers renumbered from RST0) and an EOI. Bands also
+        // decode the interval row either side of them and drop it, so chroma upsampling at the
+        // seams sees the same neighbours as a serial decode and the output is identical.
+        //
+        // Bands go through ParallelFor() rather than the pool, image decodes already run on the
+        // pool and mustn't wait on other tasks. False if the JPEG can't be split (or a band
+        // failed), the caller decodes it serially.
+        bool DecodeJPEGRestartSegments(uint8_t const* _pFileData,
+                                       size_t const _uDataSize,
+                                       int32_t& _iWidth,
+                                       int32_t& _iHeight,
+                                       uint32_t const _uScaleDenom,
+                                       bool const _bPackedRGB,
+                                       tPixelBuffer& _Pixels)
+        {
+            SJPEGRestartLayout _Layout;
+            if (FindJPEGRestartIntervals(_pFileData, _uDataSize, _Layout) == false)
             {
-                // Reading 1 at a time
-                (void)jpeg_read_scanlines(&_JPEGInfo, _pOutputRowbuffer, 1);
+                return false;
+            }
 
-                memcpy(&_pData->data()[(_JPEGInfo.output_scanline - 1) * _iWidth * _JPEGInfo.output_components], _pOutputRowbuffer[0], _iRowStride);
+            uint64_t const _uTexels = static_cast<uint64_t>(_Layout.m_uWidth) * _Layout.m_uHeight;
+            if (_uTexels < c_uMinTexelsForRestartThreads)
+            {
+                return false;
             }
 
-            (void)jpeg_finish_decompress(&_JPEGInfo);
+            // Units are the fewest MCU rows that start and end on an interval boundary
+            uint32_t const _uGCD = GreatestCommonDivisor(_Layout.m_uRestartInterval, _Layout.m_uMCUsPerRow);
+            uint32_t const _uUnitHeight = (_Layout.m_uRestartInterval / _uGCD) * _Layout.m_uMCUHeight;
+            size_t const _uUnitIntervals = _Layout.m_uMCUsPerRow / _uGCD;
+            uint32_t const _uUnits = (_Layout.m_uHeight + _uUnitHeight - 1) / _uUnitHeight;
+
+            // Bands have to start on a whole output row
+            uint32_t const _uScale = std::max(1u, _uScaleDenom);
+            if (_uUnitHeight % _uScale != 0)
+            {
+                return false;
+            }
 
-            // Release some memory
-            jpeg_destroy_decompress(&_JPEGInfo);
+            uint32_t const _uThreads = std::max(1u, std::thread::hardware_concurrency());
+            uint32_t const _uBands = static_cast<uint32_t>(std::min<uint64_t>({ _uThreads, _uUnits, _uTexels / c_uMinTexelsPerRestartSegment }));
+            if (_uBands < 2)
+            {
+                return false;
+            }
+
+            _iWidth = static_cast<int32_t>((_Layout.m_uWidth + _uScale - 1) / _uScale);
+            _iHeight = static_cast<int32_t>((_Layout.m_uHeight + _uScale - 1) / _uScale);
+            size_t const _uRowStride = static_cast<size_t>(_iWidth) * 4;
+            _Pixels.resize(_uRowStride * _iHeight);
+
+            std::vector<size_t> const& _vectorIntervals = _Layout.m_vectorIntervals;
+            std::atomic<bool> _bFailed(false);
+
+            auto _DecodeBand = [&](uint32_t const _uBand)
+            {
+                uint32_t const _uFirstUnit = _uUnits * _uBand / _uBands;
+                uint32_t const _uEndUnit = _uUnits * (_uBand + 1) / _uBands;
+                uint32_t const _uDecodeFirst = (_uFirstUnit > 0) ? _uFirstUnit - 1 : 0;
+                uint32_t const _uDecodeEnd = std::min(_uEndUnit + 1, _uUnits);
+
+                size_t const _uFirstInterval = _uDecodeFirst * _uUnitIntervals;
+                size_t const _uEndInterval = std::min(_uDecodeEnd * _uUnitIntervals, _vectorIntervals.size());
+                uint32_t const _uTop = _uDecodeFirst * _uUnitHeight;
+                uint32_t const _uBottom = std::min(_uDecodeEnd * _uUnitHeight, _Layout.m_uHeight);
+
+                // Headers, the band's intervals and an EOI
+                size_t const _uDataStart = _vectorIntervals[_uFirstInterval];
+                size_t const _uDataEnd = (_uEndInterval < _vectorIntervals.size()) ? _vectorIntervals[_uEndInterval] - 2 : _Layout.m_uScanEnd;
+
+                std::vector<uint8_t> _vectorBand;
+                _vectorBand.reserve(_Layout.m_uScanOffset + (_uDataEnd - _uDataStart) + 2);
+                _vectorBand.insert(_vectorBand.end(), _pFileData, _pFileData + _Layout.m_uScanOffset);
+                _vectorBand.insert(_vectorBand.end(), _pFileData + _uDataStart, _pFileData + _uDataEnd);
+                _vectorBand.push_back(0xFF);
+                _vectorBand.push_back(0xD9);
+
+                _vectorBand[_Layout.m_uHeightOffset] = static_cast<uint8_t>((_uBottom - _uTop) >> 8);
+                _vectorBand[_Layout.m_uHeightOffset + 1] = static_cast<uint8_t>(_uBottom - _uTop);
+                for (size_t k = _uFirstInterval + 1; k < _uEndInterval; ++k)
+                {
+                    size_t const _uMarker = _Layout.m_uScanOffset + (_vectorIntervals[k] - 1 - _uDataStart);
+                    _vectorBand[_uMarker] = static_cast<uint8_t>(0xD0 + ((k - _uFirstInterval - 1) & 7));
+                }
+
+                int32_t const _iFirstRow = static_cast<int32_t>(_uFirstUnit * _uUnitHeight / _uScale);
+                int32_t const _iEndRow = (_uEndUnit == _uUnits) ? _iHeight : static_cast<int32_t>(_uEndUnit * _uUnitHeight / _uScale);
+
+                SJPEGOutput _Output;
+                _Output.m_pRows = _Pixels.data() + _iFirstRow * _uRowStride;
+                _Output.m_iWidth = _iWidth;
+                _Output.m_iFirstRow = static_cast<int32_t>((_uFirstUnit - _uDecodeFirst) * _uUnitHeight / _uScale);
+                _Output.m_iRowCount = _iEndRow - _iFirstRow;
+
+                int32_t _iBandWidth = 0, _iBandHeight = 0;
+                if (DecodeJPEGRows(_vectorBand.data(), _vectorBand.size(), _iBandWidth, _iBandHeight, _uScale, _bPackedRGB, _Output, nullptr) == false)
+                {
+                    _bFailed = true;
+                }
+            };
+
+            ParallelFor(_uBands, _uBands, [&](size_t const _uBand) { _DecodeBand(static_cast<uint32_t>(_uBand)); });
+            return _bFailed == false;
         }
-        catch (std::runtime_error const& e)
+
+        // Big JPEGs with restart markers are decoded on several threads, and then every row
+        // arrives at once. Everything else is decoded here a batch of rows at a time.
+        bool DecodeJPEG(uint8_t const* _pFileData,
+                        size_t const _uDataSize,
+                        int32_t& _iWidth,
+                        int32_t& _iHeight,
+                        uint32_t const _uScaleDenom,
+                        bool const _bPackedRGB,
+                        tPixelBuffer& _Pixels,
+                        tOnRowsDecoded const& _OnRowsDecoded)
         {
-            std::cout << e.what() << ": '" << s_JPEGError << "'." << std::endl;
+            if (DecodeJPEGRestartSegments(_pFileData, _uDataSize, _iWidth, _iHeight, _uScaleDenom, _bPackedRGB, _Pixels))
+            {
+                if (_OnRowsDecoded)
+                {
+                    _OnRowsDecoded(_iHeight);
+                }
+                return true;
+            }
 
-            // JPEG error, clean up
-            jpeg_destroy_decompress(&_JPEGInfo);
-            return SImageData();
+            SJPEGOutput _Output;
+            _Output.m_pPixels = &_Pixels;
+            return DecodeJPEGRows(_pFileData, _uDataSize, _iWidth, _iHeight, _uScaleDenom, _bPackedRGB, _Output, _OnRowsDecoded);
         }
+    };
 
-        return SImageData{ _pData, 3 };
+    SImageData LoadJPEG(uint8_t const* _pFileData,
+                        size_t const _uDataSize,
+                        int32_t& _iWidth,
+                        int32_t& _iHeight,
+                        uint32_t const _uScaleDenom /*= 1*/)
+    {
+        std::shared_ptr<tPixelBuffer> _pData = std::make_shared<tPixelBuffer>();
+        if (DecodeJPEG(_pFileData, _uDataSize, _iWidth, _iHeight, _uScaleDenom, false, *_pData, nullptr) == false)
+        {
+            return SImageData();
+        }
+        return SImageData{ _pData, 4 };
     }
 
     namespace
@@ -434,66 +1203,374 @@ namespace FileHelper
             uint32_t m_uID;
         };
 
-        struct SRGB
+        // The alpha half of a JPNG, decoded on its own thread while the colour half is
+        // decoded on the caller's. Rows (and the size) are written before m_iRowsDone says so.
+        struct SJPNGAlpha
         {
-            uint8_t m_RGB[3];
+            SJPNGAlpha() : m_iRowsDone(0) {}
+
+            tPixelBuffer m_Pixels;
+            int32_t m_iWidth = 0;
+            int32_t m_iHeight = 0;
+            std::atomic<int32_t> m_iRowsDone;
+            bool m_bDecoded = false;    // only read once the thread's joined
         };
 
-        struct SRGBA
+        // Below this the alpha is decoded first on the same thread, a thread isn't worth starting
+        uint64_t const c_uMinTexelsForAlphaThread = 512 * 512;
+
+        // Row _iRow of the alpha box filtered down by _uScale, each texel averages the (up to)
+        // scale x scale block it came from, like the DCT scaling does for the colour
+        void DownsampleAlphaRow(uint8_t const* _pAlpha, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uScale, int32_t const _iRow, uint8_t* _pOut, int32_t const _iOutWidth)
         {
-            SRGBA(SRGB const & _RGB, uint8_t const _A)
+            int32_t const _iY0 = _iRow * _uScale;
+            int32_t const _iY1 = std::min<int32_t>(_iY0 + _uScale, _iHeight);
+            for (int32_t x = 0; x < _iOutWidth; ++x)
             {
-                memcpy(m_RGBA, _RGB.m_RGB, sizeof(SRGB));
-                m_RGBA[3] = _A;
+                int32_t const _iX0 = x * _uScale;
+                int32_t const _iX1 = std::min<int32_t>(_iX0 + _uScale, _iWidth);
+
+                uint32_t _uSum = 0;
+                for (int32_t sy = _iY0; sy < _iY1; ++sy)
+                {
+                    uint8_t const* _pRow = _pAlpha + static_cast<size_t>(sy) * _iWidth;
+                    for (int32_t sx = _iX0; sx < _iX1; ++sx)
+                    {
+                        _uSum += _pRow[sx];
+                    }
+                }
+                uint32_t const _uCount = static_cast<uint32_t>((_iY1 - _iY0) * (_iX1 - _iX0));
+                _pOut[x] = static_cast<uint8_t>((_uSum + _uCount / 2) / _uCount);
             }
+        }
 
-            uint8_t m_RGBA[4];
+        struct SJoinOnExit
+        {
+            std::thread& m_Thread;
+            ~SJoinOnExit()
+            {
+                if (m_Thread.joinable())
+                {
+                    m_Thread.join();
+                }
+            }
         };
     };
 
-
-    SImageData LoadJPNG(std::shared_ptr<std::vector<uint8_t>> _pFileData, int32_t& _iWidth, int32_t& _iHeight)
+    SImageData LoadJPNG(uint8_t const* _pFileData, size_t const _uDataSize, int32_t& _iWidth, int32_t& _iHeight, uint32_t const _uScaleDenom /*= 1*/)
     {
+        if (_uDataSize < sizeof(SJPNGInfo))
+        {
+            return SImageData();
+        }
+
         // Read the JPNG info chunk
         SJPNGInfo _JPNGInfo;
-        memcpy(&_JPNGInfo, &_pFileData->data()[_pFileData->size() - sizeof(SJPNGInfo)], sizeof(SJPNGInfo));
+        memcpy(&_JPNGInfo, &_pFileData[_uDataSize - sizeof(SJPNGInfo)], sizeof(SJPNGInfo));
+
+        if (_JPNGInfo.m_uDataSizeJPEG > _uDataSize - sizeof(SJPNGInfo))
+        {
+            return SImageData();
+        }
 
         // Get pointer to the PNG data
-        uint8_t* _pPNGData = _pFileData->data() + _JPNGInfo.m_uDataSizeJPEG;
+        uint8_t const* _pPNGData = _pFileData + _JPNGInfo.m_uDataSizeJPEG;
+        size_t const _uPNGDataSize = _uDataSize - sizeof(SJPNGInfo) - _JPNGInfo.m_uDataSizeJPEG;
+
+        // Alpha, always full size. Big ones get their own thread, the size comes straight
+        // out of the IHDR chunk (after the 8 byte signature and the chunk's length and type).
+        //========================================
+        SJPNGAlpha _Alpha;
+        auto _DecodeAlpha = [&_Alpha, _pPNGData, _uPNGDataSize]()
+        {
+            _Alpha.m_bDecoded = DecodePNG(_pPNGData, _uPNGDataSize, _Alpha.m_iWidth, _Alpha.m_iHeight, false, false, true, _Alpha.m_Pixels, [&_Alpha](int32_t _iRowsDone)
+            {
+                _Alpha.m_iRowsDone.store(_iRowsDone, std::memory_order_release);
+            });
+        };
 
-        // Read PNG data
-        int32_t _iPNGWidth = 0, _iPNGHeight = 0;
-        SImageData _ImageDataPNG = LoadPNG(_pPNGData, _iPNGWidth, _iPNGHeight, false, false);
+        uint64_t _uAlphaTexels = 0;
+        if (_uPNGDataSize >= 24)
+        {
+            uint8_t const* _pIHDR = _pPNGData + 16;
+            uint32_t const _uPNGWidth = (uint32_t(_pIHDR[0]) << 24) | (uint32_t(_pIHDR[1]) << 16) | (uint32_t(_pIHDR[2]) << 8) | _pIHDR[3];
+            uint32_t const _uPNGHeight = (uint32_t(_pIHDR[4]) << 24) | (uint32_t(_pIHDR[5]) << 16) | (uint32_t(_pIHDR[6]) << 8) | _pIHDR[7];
+            _uAlphaTexels = static_cast<uint64_t>(_uPNGWidth) * _uPNGHeight;
+        }
 
-        // Resize output buffer
-        int32_t _uTotalBytes = _iPNGWidth * _iPNGHeight * 4;
-        std::shared_ptr<std::vector<uint8_t>> _pOutData = std::make_shared<std::vector<uint8_t>>();
-        _pOutData->resize(_uTotalBytes);
+        std::thread _AlphaThread;
+        SJoinOnExit _JoinAlpha{ _AlphaThread };
+        if (_uAlphaTexels >= c_uMinTexelsForAlphaThread)
+        {
+            _AlphaThread = std::thread(_DecodeAlpha);
+        }
+        else
+        {
+            _DecodeAlpha();
+        }
+        //========================================
 
-        // Read JPEG Data
+        // Colour, merged with the alpha a row at a time as soon as both halves have it, while
+        // the row is still in cache. The RGB sits packed in the back of each row until then.
+        //========================================
+        std::shared_ptr<tPixelBuffer> _pOutData = std::make_shared<tPixelBuffer>();
         int32_t _iJPGWidth = 0, _iJPGHeight = 0;
-        SImageData _ImageDataJPEG = LoadJPEG(_pFileData, _JPNGInfo.m_uDataSizeJPEG, _iJPGWidth, _iJPGHeight);
 
-        // Put RGB and A data together
+        uint32_t const _uScale = std::max(1u, _uScaleDenom);
+        pixel_kernels::tMergeRGBA const _MergeRGBA = pixel_kernels::GetMergeRGBA();
+        tPixelBuffer _vectorScaledAlpha;
+        int32_t _iMerged = 0;
+        bool _bSizeChecked = false;
+        bool _bSizeMismatch = false;
+
+        auto _MergeRows = [&](int32_t const _iColourRows)
+        {
+            int32_t const _iAlphaRows = _Alpha.m_iRowsDone.load(std::memory_order_acquire);
+            if (_iAlphaRows == 0 || _bSizeMismatch)
+            {
+                return;
+            }
+
+            // One byte of alpha per texel, covering the colour once it's scaled the same way (up to the last partial block)
+            if (_bSizeChecked == false)
+            {
+                _bSizeChecked = true;
+                _bSizeMismatch = _Alpha.m_Pixels.size() != static_cast<size_t>(_Alpha.m_iWidth) * _Alpha.m_iHeight ||
+                    static_cast<int64_t>(_iJPGWidth) * _uScale < _Alpha.m_iWidth || static_cast<int64_t>(_iJPGWidth - 1) * _uScale >= _Alpha.m_iWidth ||
+                    static_cast<int64_t>(_iJPGHeight) * _uScale < _Alpha.m_iHeight || static_cast<int64_t>(_iJPGHeight - 1) * _uScale >= _Alpha.m_iHeight;
+                if (_bSizeMismatch)
+                {
+                    return;
+                }
+                _vectorScaledAlpha.resize(_uScale > 1 ? _iJPGWidth : 0);
+            }
+
+            int32_t const _iAlphaReady = (_iAlphaRows >= _Alpha.m_iHeight) ? _iJPGHeight : _iAlphaRows / static_cast<int32_t>(_uScale);
+            int32_t const _iReady = std::min(_iColourRows, _iAlphaReady);
+            for (; _iMerged < _iReady; ++_iMerged)
+            {
+                uint8_t* _pRow = _pOutData->data() + static_cast<size_t>(_iMerged) * _iJPGWidth * 4;
+
+                uint8_t const* _pRowAlpha = _Alpha.m_Pixels.data() + static_cast<size_t>(_iMerged) * _Alpha.m_iWidth;
+                if (_uScale > 1)
+                {
+                    DownsampleAlphaRow(_Alpha.m_Pixels.data(), _Alpha.m_iWidth, _Alpha.m_iHeight, _uScale, _iMerged, _vectorScaledAlpha.data(), _iJPGWidth);
+                    _pRowAlpha = _vectorScaledAlpha.data();
+                }
+
+                _MergeRGBA(_pRow, _pRow + _iJPGWidth, _pRowAlpha, _iJPGWidth);
+            }
+        };
+
+        bool const _bColourDecoded = DecodeJPEG(_pFileData, _JPNGInfo.m_uDataSizeJPEG, _iJPGWidth, _iJPGHeight, _uScale, true, *_pOutData, _MergeRows);
         //========================================
-        SRGB* _pDataRGB = (SRGB*)_ImageDataJPEG.m_pData->data();
-        SRGBA* _pDataRGBA = (SRGBA*)_pOutData->data();
-        uint8_t* _pDataA = _ImageDataPNG.m_pData->data();
+
+        // Whatever the alpha thread finished after the colour
+        if (_AlphaThread.joinable())
+        {
+            _AlphaThread.join();
+        }
+
+        if (_bColourDecoded == false || _Alpha.m_bDecoded == false)
+        {
+            return SImageData();
+        }
+
+        _MergeRows(_iJPGHeight);
+        if (_iMerged != _iJPGHeight)
+        {
+            return SImageData();
+        }
 
         _iWidth = _iJPGWidth;
         _iHeight = _iJPGHeight;
 
-        for (int x = 0; x < _iWidth; x++)
+        return SImageData{ _pOutData, 4 };
+    }
+
+    namespace
+    {
+        // libjpeg destination that writes into a vector, grown as needed
+        struct SJPEGVectorDestination
+        {
+            jpeg_destination_mgr m_Manager;     // first, libjpeg only knows about this
+            std::vector<uint8_t>* m_pData = nullptr;
+        };
+
+        void SetJPEGVectorDestination(jpeg_compress_struct& _JPEGInfo, SJPEGVectorDestination& _Destination, std::vector<uint8_t>& _vectorData)
+        {
+            _Destination.m_pData = &_vectorData;
+            _Destination.m_Manager.init_destination = [](j_compress_ptr _pJPEGInfo) -> void
+            {
+                SJPEGVectorDestination* _pDestination = reinterpret_cast<SJPEGVectorDestination*>(_pJPEGInfo->dest);
+                _pDestination->m_pData->resize(64 * 1024);
+                _pDestination->m_Manager.next_output_byte = _pDestination->m_pData->data();
+                _pDestination->m_Manager.free_in_buffer = _pDestination->m_pData->size();
+            };
+            _Destination.m_Manager.empty_output_buffer = [](j_compress_ptr _pJPEGInfo) -> boolean
+            {
+                // Only called once the whole buffer is full
+                SJPEGVectorDestination* _pDestination = reinterpret_cast<SJPEGVectorDestination*>(_pJPEGInfo->dest);
+                size_t const _uUsed = _pDestination->m_pData->size();
+                _pDestination->m_pData->resize(_uUsed * 2);
+                _pDestination->m_Manager.next_output_byte = _pDestination->m_pData->data() + _uUsed;
+                _pDestination->m_Manager.free_in_buffer = _pDestination->m_pData->size() - _uUsed;
+                return TRUE;
+            };
+            _Destination.m_Manager.term_destination = [](j_compress_ptr _pJPEGInfo) -> void
+            {
+                SJPEGVectorDestination* _pDestination = reinterpret_cast<SJPEGVectorDestination*>(_pJPEGInfo->dest);
+                _pDestination->m_pData->resize(_pDestination->m_pData->size() - _pDestination->m_Manager.free_in_buffer);
+            };
+            _JPEGInfo.dest = &_Destination.m_Manager;
+        }
+    };
+
+    bool AddJPEGRestartMarkers(std::vector<uint8_t>& _vectorData, bool const _bJPNG)
+    {
+        size_t _uJPEGSize = _vectorData.size();
+
+        SJPNGInfo _JPNGInfo;
+        if (_bJPNG)
         {
-            for (int y = 0; y < _iHeight; y++)
+            if (_vectorData.size() < sizeof(SJPNGInfo))
             {
-                _pDataRGBA[(y * _iWidth) + x] = SRGBA(_pDataRGB[(y * _iWidth) + x],
-                                                      _pDataA[(y * _iWidth) + x]);
+                return false;
             }
+
+            memcpy(&_JPNGInfo, &_vectorData[_vectorData.size() - sizeof(SJPNGInfo)], sizeof(SJPNGInfo));
+            if (_JPNGInfo.m_uDataSizeJPEG > _vectorData.size() - sizeof(SJPNGInfo))
+            {
+                return false;
+            }
+            _uJPEGSize = _JPNGInfo.m_uDataSizeJPEG;
         }
-        //========================================
 
-        return SImageData{ _pOutData , 4 };
+        jpeg_decompress_struct _SourceInfo;
+        jpeg_error_mgr _SourceErrorMgr;
+        _SourceInfo.err = jpeg_std_error(&_SourceErrorMgr);
+        _SourceErrorMgr.error_exit = JPEGCustomErrorExit;
+        _SourceErrorMgr.output_message = JPEGCustomOutputMessage;
+        jpeg_create_decompress(&_SourceInfo);
+
+        jpeg_compress_struct _DestinationInfo;
+        jpeg_error_mgr _DestinationErrorMgr;
+        _DestinationInfo.err = jpeg_std_error(&_DestinationErrorMgr);
+        _DestinationErrorMgr.error_exit = JPEGCustomErrorExit;
+        _DestinationErrorMgr.output_message = JPEGCustomOutputMessage;
+        jpeg_create_compress(&_DestinationInfo);
+
+        std::vector<uint8_t> _vectorJPEG;
+        try
+        {
+            SetJPEGMemorySource(_SourceInfo, _vectorData.data(), _uJPEGSize);
+            (void)jpeg_read_header(&_SourceInfo, TRUE);
+            jvirt_barray_ptr* _pCoefficients = jpeg_read_coefficients(&_SourceInfo);
+
+            // Same quantised coefficients, only the entropy coding is redone. Written as one
+            // sequential scan even if it was progressive, with a marker at every MCU row.
+            jpeg_copy_critical_parameters(&_SourceInfo, &_DestinationInfo);
+            _DestinationInfo.restart_in_rows = 1;
+            _DestinationInfo.optimize_coding = TRUE;
+
+            SJPEGVectorDestination _Destination;
+            SetJPEGVectorDestination(_DestinationInfo, _Destination, _vectorJPEG);
+
+            jpeg_write_coefficients(&_DestinationInfo, _pCoefficients);
+            jpeg_finish_compress(&_DestinationInfo);
+            (void)jpeg_finish_decompress(&_SourceInfo);
+        }
+        catch (std::runtime_error const& e)
+        {
+            std::cout << e.what() << ": '" << s_JPEGError << "'." << std::endl;
+
+            jpeg_destroy_compress(&_DestinationInfo);
+            jpeg_destroy_decompress(&_SourceInfo);
+            return false;
+        }
+
+        jpeg_destroy_compress(&_DestinationInfo);
+        jpeg_destroy_decompress(&_SourceInfo);
+
+        // The alpha PNG follows unchanged, with the info pointing past the new JPEG
+        if (_bJPNG)
+        {
+            _JPNGInfo.m_uDataSizeJPEG = static_cast<uint32_t>(_vectorJPEG.size());
+            _vectorJPEG.insert(_vectorJPEG.end(), _vectorData.begin() + _uJPEGSize, _vectorData.end() - sizeof(SJPNGInfo));
+
+            uint8_t const* _pInfo = reinterpret_cast<uint8_t const*>(&_JPNGInfo);
+            _vectorJPEG.insert(_vectorJPEG.end(), _pInfo, _pInfo + sizeof(SJPNGInfo));
+        }
+
+        _vectorData.swap(_vectorJPEG);
+        return true;
+    }
+
+    namespace
+    {
+        void PNGCustomWriteData(png_structp _pPNG, png_bytep _pData, png_size_t _uLength)
+        {
+            std::ofstream* _pFile = static_cast<std::ofstream*>(png_get_io_ptr(_pPNG));
+            _pFile->write(reinterpret_cast<char const*>(_pData), _uLength);
+        }
+
+        void PNGCustomFlushData(png_structp _pPNG)
+        {
+            std::ofstream* _pFile = static_cast<std::ofstream*>(png_get_io_ptr(_pPNG));
+            _pFile->flush();
+        }
+    };
+
+    bool SavePNG(std::string const& _sFilePath,
+                 uint8_t const* _pData,
+                 int32_t const _iWidth,
+                 int32_t const _iHeight,
+                 uint32_t const _uChannels,
+                 bool const _bFlipRows /*= false*/)
+    {
+        assert(_uChannels == 3 || _uChannels == 4);
+
+        std::ofstream _File(_sFilePath, std::ios::out | std::ios::binary);
+        if (!_File)
+        {
+            fprintf(stderr, "Failed to open '%s' for writing.\n", _sFilePath.c_str());
+            return false;
+        }
+
+        png_structp _pPngStruct = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, PNGErrorFunction, PNGErrorFunction);
+        assert(_pPngStruct);
+
+        png_infop _pPngInfo = png_create_info_struct(_pPngStruct);
+        assert(_pPngInfo);
+
+        png_set_write_fn(_pPngStruct, (png_voidp)(&_File), PNGCustomWriteData, PNGCustomFlushData);
+
+        // Frames are written constantly by the batch renderer, favour speed over size
+        png_set_compression_level(_pPngStruct, 1);
+
+        png_set_IHDR(_pPngStruct,
+                     _pPngInfo,
+                     _iWidth,
+                     _iHeight,
+                     8,
+                     (_uChannels == 4) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT,
+                     PNG_FILTER_TYPE_DEFAULT);
+
+        png_write_info(_pPngStruct, _pPngInfo);
+
+        size_t const _uRowBytes = static_cast<size_t>(_iWidth) * _uChannels;
+        for (int32_t i = 0; i < _iHeight; i++)
+        {
+            int32_t const _iRow = _bFlipRows ? (_iHeight - 1 - i) : i;
+            png_write_row(_pPngStruct, const_cast<png_bytep>(_pData + _iRow * _uRowBytes));
+        }
+
+        png_write_end(_pPngStruct, NULL);
+        png_destroy_write_struct(&_pPngStruct, &_pPngInfo);
+
+        return _File.good();
     }
 };
 //========================================
\ No newline at end of file
@@ -1,46 +1,159 @@
+#pragma once
+
+#include "stl_helper.hpp"
 
 #include <string>
 #include <vector>
 #include <memory>
 
+namespace texture_cache
+{
+    class CReader;
+    class CWriter;
+};
+
 //========================================
 namespace FileHelper
 {
     std::string GetAbsolutePath(std::string const& _sPath);
+    bool CreateDirectories(std::string const& _sPath);
 
     std::string OpenFileDialog(std::string const& _sExt, std::string const& _sDefaultPath = "");
     std::string PickFolderDialog(std::string const& _sDefaultPath = "");
 
+    // Every file under _sFolder, recursively, as paths relative to it
+    std::vector<std::string> ListFiles(std::string const& _sFolder);
+
+    // These look in mounted asset packs first (see CAssetPack::Mount)
 	std::string GetFileContentsString(std::string const &_sFilePath);
 	std::vector<uint8_t> GetFileContents(std::string const& _sFilePath);
 
+    // Read only view of a whole file without copying it. Loose files are memory mapped and
+    // stored pack entries point into the pack; compressed pack entries are inflated into a
+    // buffer the view owns. Empty if the file is missing or empty.
+    struct SFileView
+    {
+        uint8_t const* m_pData = nullptr;
+        size_t m_uSize = 0;
+        std::shared_ptr<void const> m_pOwner;  // mapping or buffer behind m_pData
+
+        uint8_t* m_pWritableData = nullptr;    // only from MapFileContentsWritable, same bytes as m_pData
+
+        bool IsEmpty() const { return m_uSize == 0; }
+        char const* GetChars() const { return reinterpret_cast<char const*>(m_pData); }
+    };
+    SFileView MapFileContents(std::string const& _sFilePath);
+    // Private writable copy for parsing in place. Loose files are mapped copy on write, so
+    // only the pages written to are copied; pack entries are copied out.
+    SFileView MapFileContentsWritable(std::string const& _sFilePath);
+
     bool FileExists(std::string const& _sFilePath);
+    uint64_t GetFileSize(std::string const& _sFilePath);
+    // Seconds since the epoch, 0 if the file doesn't exist
+    uint64_t GetFileModifiedTime(std::string const& _sFilePath);
+
+    // Decoded pixels, tightly packed rows. Sized without being zeroed, decoders write every byte.
+    typedef std::vector<uint8_t, stl_helper::CDefaultInitAllocator<uint8_t>> tPixelBuffer;
 
     struct SImageData
     {
-        std::shared_ptr<std::vector<uint8_t>> m_pData;
+        std::shared_ptr<tPixelBuffer> m_pData;
         uint32_t m_uChannels = 0;
     };
 
+    // _uScaleDenom (1, 2, 4 or 8) decodes JPEG and JPNG straight at 1/n size, rounded up.
+    // PNG is always decoded at full size.
     SImageData LoadImageFromFile(std::string const& _sFilePath,
                                  int32_t& _iWidth,
-                                 int32_t& _iHeight);
+                                 int32_t& _iHeight,
+                                 uint32_t const _uScaleDenom = 1);
 
-    SImageData LoadPNG(uint8_t* _pData,
+    SImageData LoadPNG(uint8_t const* _pData,
+                       size_t const _uDataSize,
                        int32_t & _iWidth,
                        int32_t & _iHeight,
                        bool bConvertGrey = true,
                        bool bSetFiller = true,
                        bool bFlipPng = true);
 
-    SImageData LoadJPEG(std::shared_ptr<std::vector<uint8_t>> _pFileData,
-                        size_t _uDataSize,
-                        int32_t& _iWidth, 
-                        int32_t& _iHeight);
+    // From the header chunks alone: true if the colour type has alpha or there's a tRNS chunk,
+    // and whenever it can't tell. Only a hint, an alpha channel can still be fully opaque.
+    bool PNGHasAlpha(uint8_t const* _pData, size_t const _uDataSize);
 
-    SImageData LoadJPNG(std::shared_ptr<std::vector<uint8_t>> _pFileData, 
+    // Big JPEGs with restart markers (see AddJPEGRestartMarkers()) are decoded on several threads
+    SImageData LoadJPEG(uint8_t const* _pData,
+                        size_t const _uDataSize,
                         int32_t& _iWidth, 
-                        int32_t& _iHeight);
+                        int32_t& _iHeight,
+                        uint32_t const _uScaleDenom = 1);
+
+    SImageData LoadJPNG(uint8_t const* _pData,
+                        size_t const _uDataSize,
+                        int32_t& _iWidth,
+                        int32_t& _iHeight,
+                        uint32_t const _uScaleDenom = 1);
+
+    // Decodes a PNG a band of rows at a time, so a texture can be filled without the whole
+    // image ever being in memory. Rows come out top down as RGBA, same as LoadPNG().
+    // Interlaced images need every pass before any row is finished, Open() fails for them
+    // and they have to go through LoadPNG() instead.
+    //
+    // Goes through the texture cache (see texture_cache.hpp): rows come out of the decoded
+    // copy when there is one, and one is written as the rows are decoded when there isn't.
+    class CPNGStream
+    {
+    public:
+        CPNGStream();
+        ~CPNGStream();
+
+        CPNGStream(CPNGStream const&) = delete;
+        CPNGStream& operator=(CPNGStream const&) = delete;
+
+        // Maps the file and reads the header, nothing is decoded yet
+        bool Open(std::string const& _sFilePath);
+        void Close();
+
+        int32_t GetWidth() const { return m_iWidth; }
+        int32_t GetHeight() const { return m_iHeight; }
+        uint32_t GetChannels() const { return 4; }
+        size_t GetRowBytes() const { return static_cast<size_t>(m_iWidth) * 4; }
+
+        int32_t GetRowsRead() const { return m_iRowsRead; }
+        bool IsFinished() const { return m_iRowsRead >= m_iHeight; }
+
+        // Decodes up to _iRows more rows into _pRows, GetRowBytes() apart. Returns how many
+        // were read, 0 once finished.
+        int32_t ReadRows(uint8_t* _pRows, int32_t const _iRows);
+
+    protected:
+        SFileView m_View;
+        size_t m_uReadIndex = 0;
+        int32_t m_iWidth = 0;
+        int32_t m_iHeight = 0;
+        int32_t m_iRowsRead = 0;
+
+        // libpng handles, kept out of the header
+        void* m_pPngStruct = nullptr;
+        void* m_pPngInfo = nullptr;
+        void* m_pReadInfo = nullptr;
+
+        // At most one of these, libpng isn't set up when reading from the cache
+        std::unique_ptr<texture_cache::CReader> m_pCacheReader;
+        std::unique_ptr<texture_cache::CWriter> m_pCacheWriter;
+    };
+
+    // Rewrites a JPEG (or the JPEG half of a JPNG) with a restart marker at every MCU row, so
+    // LoadJPEG() can split it over threads. Lossless, the coefficients are copied across and
+    // only the entropy coding is redone, with optimised Huffman tables to win back the space
+    // the markers take. False, and _vectorData left alone, if it can't be read.
+    bool AddJPEGRestartMarkers(std::vector<uint8_t>& _vectorData, bool const _bJPNG);
+
+    bool SavePNG(std::string const& _sFilePath,
+                 uint8_t const* _pData,
+                 int32_t const _iWidth,
+                 int32_t const _iHeight,
+                 uint32_t const _uChannels,
+                 bool const _bFlipRows = false);
 
 };
 //========================================
\ No newline at end of file
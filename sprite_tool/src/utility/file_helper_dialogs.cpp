@@ -0,0 +1,63 @@
+#include "file_helper.hpp"
+
+// native file dialog
+#include "nfd/nfd.h"
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+
+//========================================
+// Kept apart from file_helper.cpp so headless builds don't need nfd
+namespace FileHelper
+{
+    std::string OpenFileDialog(std::string const& _sExt, std::string const& _sDefaultPath /*= ""*/)
+    {
+        std::string _sPathResult;
+
+        nfdchar_t* _pOutPath = nullptr;
+        nfdresult_t _Result = NFD_OpenDialog(_sExt.c_str(), _sDefaultPath.c_str(), &_pOutPath);
+
+        if (_Result == NFD_OKAY)
+        {
+            _sPathResult = std::string(_pOutPath);
+            free(_pOutPath);
+        }
+        else if (_Result == NFD_CANCEL)
+        {
+            printf("User cancelled.\n");
+        }
+        else
+        {
+            printf("Error: %s\n", NFD_GetError());
+        }
+
+        return _sPathResult;
+    }
+
+    std::string PickFolderDialog(std::string const& _sDefaultPath /*= ""*/)
+    {
+        std::string _sPathResult;
+
+        nfdchar_t* _pOutPath = nullptr;
+        nfdresult_t _Result = NFD_PickFolder(_sDefaultPath.c_str(), &_pOutPath);
+
+        if (_Result == NFD_OKAY)
+        {
+            _sPathResult = std::string(_pOutPath);
+            free(_pOutPath);
+        }
+        else if (_Result == NFD_CANCEL)
+        {
+            printf("User cancelled.\n");
+        }
+        else
+        {
+            printf("Error: %s\n", NFD_GetError());
+        }
+
+        return _sPathResult;
+    }
+};
+//========================================
@@ -0,0 +1,141 @@
+#if !defined(_WIN32)
+
+#include "file_helper.hpp"
+
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+#include <cassert>
+
+
+//========================================
+namespace FileHelper
+{
+    std::string GetAbsolutePath(std::string const& _sPath)
+    {
+        std::string _sFullPath = _sPath;
+
+        if (_sFullPath.empty() || _sFullPath[0] != '/')
+        {
+            char _cBuffer[PATH_MAX + 1] = { 0 };
+            if (getcwd(_cBuffer, PATH_MAX) != nullptr)
+            {
+                _sFullPath = std::string(_cBuffer) + "/" + _sFullPath;
+            }
+        }
+
+        // Like GetFullPathName, resolve '.' and '..' without requiring the file to exist
+        std::vector<std::string> _vectorParts;
+        size_t _uStart = 0;
+        while (_uStart <= _sFullPath.size())
+        {
+            size_t _uEnd = _sFullPath.find_first_of("/\\", _uStart);
+            if (_uEnd == std::string::npos)
+            {
+                _uEnd = _sFullPath.size();
+            }
+
+            std::string _sPart = _sFullPath.substr(_uStart, _uEnd - _uStart);
+            if (_sPart == "..")
+            {
+                if (_vectorParts.empty() == false)
+                {
+                    _vectorParts.pop_back();
+                }
+            }
+            else if (_sPart.empty() == false && _sPart != ".")
+            {
+                _vectorParts.push_back(_sPart);
+            }
+
+            _uStart = _uEnd + 1;
+        }
+
+        std::string _sRetVal;
+        for (auto const& _sPart : _vectorParts)
+        {
+            _sRetVal += "/" + _sPart;
+        }
+
+        return _sRetVal.empty() ? "/" : _sRetVal;
+    }
+
+    bool CreateDirectories(std::string const& _sPath)
+    {
+        std::string _sAbsPath = GetAbsolutePath(_sPath);
+
+        // Create each parent in turn, existing folders are fine
+        for (size_t _uPos = _sAbsPath.find('/', 1); ; _uPos = _sAbsPath.find('/', _uPos + 1))
+        {
+            std::string _sPartial = _sAbsPath.substr(0, _uPos);
+            if (mkdir(_sPartial.c_str(), 0755) != 0 && errno != EEXIST)
+            {
+                return false;
+            }
+
+            if (_uPos == std::string::npos)
+            {
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<std::string> ListFiles(std::string const& _sFolder)
+    {
+        std::vector<std::string> _vectorFiles;
+
+        // Folders still to walk, relative to _sFolder
+        std::vector<std::string> _vectorFolders(1, std::string());
+        while (_vectorFolders.empty() == false)
+        {
+            std::string const _sRelative = _vectorFolders.back();
+            _vectorFolders.pop_back();
+
+            std::string const _sPath = _sRelative.empty() ? _sFolder : _sFolder + "/" + _sRelative;
+            DIR* _pDir = opendir(_sPath.c_str());
+            if (_pDir == nullptr)
+            {
+                continue;
+            }
+
+            while (dirent* _pEntry = readdir(_pDir))
+            {
+                std::string const _sName = _pEntry->d_name;
+                if (_sName == "." || _sName == "..")
+                {
+                    continue;
+                }
+
+                std::string const _sChild = _sRelative.empty() ? _sName : _sRelative + "/" + _sName;
+
+                struct stat _Stat;
+                if (stat((_sFolder + "/" + _sChild).c_str(), &_Stat) != 0)
+                {
+                    continue;
+                }
+
+                if (S_ISDIR(_Stat.st_mode))
+                {
+                    _vectorFolders.push_back(_sChild);
+                }
+                else if (S_ISREG(_Stat.st_mode))
+                {
+                    _vectorFiles.push_back(_sChild);
+                }
+            }
+            closedir(_pDir);
+        }
+
+        return _vectorFiles;
+    }
+};
+//========================================
+
+#endif // !_WIN32
@@ -1,4 +1,6 @@
 
+#if defined(_WIN32)
+
 #include "file_helper.hpp"
 
 #include <windows.h>
@@ -6,6 +8,7 @@
 #define NOMINMAX
 
 #include <string>
+#include <vector>
 #include <cassert>
 
 
@@ -22,5 +25,74 @@ namespace FileHelper
 
         return _sRetVal;
     }
+
+    bool CreateDirectories(std::string const& _sPath)
+    {
+        std::string _sAbsPath = GetAbsolutePath(_sPath);
+
+        // Create each parent in turn, existing folders are fine
+        for (size_t _uPos = _sAbsPath.find_first_of("\\/", 3); ; _uPos = _sAbsPath.find_first_of("\\/", _uPos + 1))
+        {
+            std::string _sPartial = _sAbsPath.substr(0, _uPos);
+            if (CreateDirectoryA(_sPartial.c_str(), NULL) == FALSE && GetLastError() != ERROR_ALREADY_EXISTS)
+            {
+                return false;
+            }
+
+            if (_uPos == std::string::npos)
+            {
+                break;
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<std::string> ListFiles(std::string const& _sFolder)
+    {
+        std::vector<std::string> _vectorFiles;
+
+        // Folders still to walk, relative to _sFolder
+        std::vector<std::string> _vectorFolders(1, std::string());
+        while (_vectorFolders.empty() == false)
+        {
+            std::string const _sRelative = _vectorFolders.back();
+            _vectorFolders.pop_back();
+
+            std::string const _sPattern = (_sRelative.empty() ? _sFolder : _sFolder + "\\" + _sRelative) + "\\*";
+
+            WIN32_FIND_DATAA _FindData;
+            HANDLE _hFind = FindFirstFileA(_sPattern.c_str(), &_FindData);
+            if (_hFind == INVALID_HANDLE_VALUE)
+            {
+                continue;
+            }
+
+            do
+            {
+                std::string const _sName = _FindData.cFileName;
+                if (_sName == "." || _sName == "..")
+                {
+                    continue;
+                }
+
+                std::string const _sChild = _sRelative.empty() ? _sName : _sRelative + "\\" + _sName;
+                if (_FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    _vectorFolders.push_back(_sChild);
+                }
+                else
+                {
+                    _vectorFiles.push_back(_sChild);
+                }
+            } while (FindNextFileA(_hFind, &_FindData));
+
+            FindClose(_hFind);
+        }
+
+        return _vectorFiles;
+    }
 };
-//========================================
\ No newline at end of file
+//========================================
+
+#endif // _WIN32
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "hash_helper.hpp"
+
+#include <cstring>
+
+//========================================
+namespace hash_helper
+{
+	namespace
+	{
+		uint64_t const c_uPrime1 = 0x9E3779B185EBCA87ull;
+		uint64_t const c_uPrime2 = 0xC2B2AE3D27D4EB4Full;
+		uint64_t const c_uPrime3 = 0x165667B19E3779F9ull;
+		uint64_t const c_uPrime4 = 0x85EBCA77C2B2AE63ull;
+		uint64_t const c_uPrime5 = 0x27D4EB2F165667C5ull;
+
+		uint64_t RotateLeft(uint64_t const _uValue, int const _iBits)
+		{
+			return (_uValue << _iBits) | (_uValue >> (64 - _iBits));
+		}
+
+		// Unaligned little endian reads, memcpy compiles down to a plain load
+		uint64_t Read64(uint8_t const* _pData)
+		{
+			uint64_t _uValue;
+			memcpy(&_uValue, _pData, sizeof(_uValue));
+			return _uValue;
+		}
+
+		uint32_t Read32(uint8_t const* _pData)
+		{
+			uint32_t _uValue;
+			memcpy(&_uValue, _pData, sizeof(_uValue));
+			return _uValue;
+		}
+
+		uint64_t Round(uint64_t _uAccumulator, uint64_t const _uInput)
+		{
+			_uAccumulator += _uInput * c_uPrime2;
+			_uAccumulator = RotateLeft(_uAccumulator, 31);
+			return _uAccumulator * c_uPrime1;
+		}
+
+		uint64_t MergeRound(uint64_t _uAccumulator, uint64_t const _uValue)
+		{
+			_uAccumulator ^= Round(0, _uValue);
+			return _uAccumulator * c_uPrime1 + c_uPrime4;
+		}
+	};
+
+	uint64_t Hash64(void const* _pData, size_t _uSize, uint64_t const _uSeed)
+	{
+		uint8_t const* _pInput = static_cast<uint8_t const*>(_pData);
+		uint8_t const* const _pEnd = _pInput + _uSize;
+
+		uint64_t _uHash = 0;
+
+		if (_uSize >= 32)
+		{
+			// Four independent lanes over 32 byte stripes
+			uint64_t _uV1 = _uSeed + c_uPrime1 + c_uPrime2;
+			uint64_t _uV2 = _uSeed + c_uPrime2;
+			uint64_t _uV3 = _uSeed;
+			uint64_t _uV4 = _uSeed - c_uPrime1;
+
+			uint8_t const* const _pLimit = _pEnd - 32;
+			do
+			{
+				_uV1 = Round(_uV1, Read64(_pInput));
+				_uV2 = Round(_uV2, Read64(_pInput + 8));
+				_uV3 = Round(_uV3, Read64(_pInput + 16));
+				_uV4 = Round(_uV4, Read64(_pInput + 24));
+				_pInput += 32;
+			} while (_pInput <= _pLimit);
+
+			_uHash = RotateLeft(_uV1, 1) + RotateLeft(_uV2, 7) + RotateLeft(_uV3, 12) + RotateLeft(_uV4, 18);
+			_uHash = MergeRound(_uHash, _uV1);
+			_uHash = MergeRound(_uHash, _uV2);
+			_uHash = MergeRound(_uHash, _uV3);
+			_uHash = MergeRound(_uHash, _uV4);
+		}
+		else
+		{
+			_uHash = _uSeed + c_uPrime5;
+		}
+
+		_uHash += static_cast<uint64_t>(_uSize);
+
+		// Tail
+		while (_pInput + 8 <= _pEnd)
+		{
+			_uHash ^= Round(0, Read64(_pInput));
+			_uHash = RotateLeft(_uHash, 27) * c_uPrime1 + c_uPrime4;
+			_pInput += 8;
+		}
+
+		if (_pInput + 4 <= _pEnd)
+		{
+			_uHash ^= static_cast<uint64_t>(Read32(_pInput)) * c_uPrime1;
+			_uHash = RotateLeft(_uHash, 23) * c_uPrime2 + c_uPrime3;
+			_pInput += 4;
+		}
+
+		while (_pInput < _pEnd)
+		{
+			_uHash ^= (*_pInput) * c_uPrime5;
+			_uHash = RotateLeft(_uHash, 11) * c_uPrime1;
+			++_pInput;
+		}
+
+		// Avalanche
+		_uHash ^= _uHash >> 33;
+		_uHash *= c_uPrime2;
+		_uHash ^= _uHash >> 29;
+		_uHash *= c_uPrime3;
+		_uHash ^= _uHash >> 32;
+
+		return _uHash;
+	}
+};
+//========================================
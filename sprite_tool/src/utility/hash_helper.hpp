@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//========================================
+namespace hash_helper
+{
+	// XXH64, same results as the reference implementation. Not for anything security related.
+	uint64_t Hash64(void const* _pData, size_t _uSize, uint64_t const _uSeed = 0);
+};
+//========================================
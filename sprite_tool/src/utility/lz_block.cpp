@@ -0,0 +1,285 @@
+#include "lz_block.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//========================================
+namespace lz_block
+{
+	namespace
+	{
+		size_t const c_uMinMatch = 4;
+		size_t const c_uLastLiterals = 5;		// a block always ends on at least this many literals
+		size_t const c_uMatchSearchLimit = 12;	// and its last match starts at least this far from the end
+		size_t const c_uMaxOffset = 65535;
+
+		uint32_t const c_uHashBits = 14;
+
+		uint32_t Read32(uint8_t const* _pData)
+		{
+			uint32_t _uValue;
+			memcpy(&_uValue, _pData, sizeof(_uValue));
+			return _uValue;
+		}
+
+		uint32_t Hash(uint32_t const _uValue)
+		{
+			return (_uValue * 2654435761u) >> (32 - c_uHashBits);
+		}
+
+		// 15 in the token's nibble, then 255s until the rest fits in a byte
+		uint8_t* WriteLength(uint8_t* _pOut, size_t _uLength)
+		{
+			for (; _uLength >= 255; _uLength -= 255)
+			{
+				*_pOut++ = 255;
+			}
+			*_pOut++ = static_cast<uint8_t>(_uLength);
+			return _pOut;
+		}
+
+		uint8_t* WriteSequence(uint8_t* _pOut, uint8_t const* _pLiterals, size_t const _uLiterals, size_t const _uOffset, size_t const _uMatch)
+		{
+			uint8_t* _pToken = _pOut++;
+			*_pToken = static_cast<uint8_t>(std::min<size_t>(_uLiterals, 15) << 4);
+			if (_uLiterals >= 15)
+			{
+				_pOut = WriteLength(_pOut, _uLiterals - 15);
+			}
+			if (_uLiterals > 0)
+			{
+				memcpy(_pOut, _pLiterals, _uLiterals);
+				_pOut += _uLiterals;
+			}
+
+			// Last sequence, literals only
+			if (_uMatch == 0)
+			{
+				return _pOut;
+			}
+
+			*_pOut++ = static_cast<uint8_t>(_uOffset);
+			*_pOut++ = static_cast<uint8_t>(_uOffset >> 8);
+
+			size_t const _uMatchCode = _uMatch - c_uMinMatch;
+			*_pToken |= static_cast<uint8_t>(std::min<size_t>(_uMatchCode, 15));
+			if (_uMatchCode >= 15)
+			{
+				_pOut = WriteLength(_pOut, _uMatchCode - 15);
+			}
+			return _pOut;
+		}
+
+		// Copies are done 16 bytes at a time and may run up to 15 bytes past the end, into
+		// space that's overwritten later. Only where the buffer has that much left.
+		size_t const c_uWildCopyBytes = 16;
+
+		bool HasWildCopyRoom(uint8_t const* _pAt, uint8_t const* _pEnd, size_t const _uCount)
+		{
+			return static_cast<size_t>(_pEnd - _pAt) >= _uCount + c_uWildCopyBytes;
+		}
+
+		// _pSource has to be at least c_uWildCopyBytes behind _pDest if they overlap
+		void WildCopy(uint8_t* _pDest, uint8_t const* _pSource, size_t const _uCount)
+		{
+			for (size_t i = 0; i < _uCount; i += c_uWildCopyBytes)
+			{
+				memcpy(_pDest + i, _pSource + i, c_uWildCopyBytes);
+			}
+		}
+
+		// Bytes the same from the start of both, stopping at _pEnd
+		size_t CountMatching(uint8_t const* _pA, uint8_t const* _pB, uint8_t const* _pEnd)
+		{
+			uint8_t const* const _pStart = _pA;
+			while (_pEnd - _pA >= 8)
+			{
+				uint64_t _uA, _uB;
+				memcpy(&_uA, _pA, sizeof(_uA));
+				memcpy(&_uB, _pB, sizeof(_uB));
+				uint64_t const _uDifference = _uA ^ _uB;
+				if (_uDifference != 0)
+				{
+					// Little endian, the lowest set bit is the first byte that differs
+#if defined(_MSC_VER)
+					unsigned long _uBit;
+					_BitScanForward64(&_uBit, _uDifference);
+#else
+					unsigned long const _uBit = static_cast<unsigned long>(__builtin_ctzll(_uDifference));
+#endif
+					return static_cast<size_t>(_pA - _pStart) + (_uBit >> 3);
+				}
+				_pA += 8;
+				_pB += 8;
+			}
+			while (_pA < _pEnd && *_pA == *_pB)
+			{
+				++_pA;
+				++_pB;
+			}
+			return static_cast<size_t>(_pA - _pStart);
+		}
+
+		bool ReadLength(uint8_t const*& _pIn, uint8_t const* _pEnd, size_t& _uLength)
+		{
+			uint8_t _uByte;
+			do
+			{
+				if (_pIn >= _pEnd)
+				{
+					return false;
+				}
+				_uByte = *_pIn++;
+				_uLength += _uByte;
+			} while (_uByte == 255);
+			return true;
+		}
+	};
+
+	size_t GetMaxCompressedSize(size_t const _uSize)
+	{
+		return _uSize + _uSize / 255 + 16;
+	}
+
+	size_t Compress(uint8_t const* _pSource, size_t const _uSize, uint8_t* _pDest)
+	{
+		uint8_t* _pOut = _pDest;
+		size_t _uAnchor = 0;
+
+		if (_uSize > c_uMatchSearchLimit)
+		{
+			// Last position seen for each hash, plus one so zero means none
+			std::vector<uint32_t> _vectorTable(static_cast<size_t>(1) << c_uHashBits, 0);
+
+			size_t const _uSearchEnd = _uSize - c_uMatchSearchLimit;
+			size_t const _uMatchEnd = _uSize - c_uLastLiterals;
+
+			size_t i = 0;
+			while (i <= _uSearchEnd)
+			{
+				uint32_t const _uValue = Read32(_pSource + i);
+				uint32_t& _uSlot = _vectorTable[Hash(_uValue)];
+				size_t _uCandidate = _uSlot;
+				_uSlot = static_cast<uint32_t>(i + 1);
+
+				if (_uCandidate == 0 || i + 1 - _uCandidate > c_uMaxOffset || Read32(_pSource + _uCandidate - 1) != _uValue)
+				{
+					// Step further the longer nothing's matched, incompressible data goes by quickly
+					i += 1 + ((i - _uAnchor) >> 6);
+					continue;
+				}
+				--_uCandidate;
+
+				// Back over anything the literals share with the match
+				while (i > _uAnchor && _uCandidate > 0 && _pSource[i - 1] == _pSource[_uCandidate - 1])
+				{
+					--i;
+					--_uCandidate;
+				}
+
+				size_t const _uMatch = c_uMinMatch + CountMatching(_pSource + i + c_uMinMatch, _pSource + _uCandidate + c_uMinMatch, _pSource + _uMatchEnd);
+
+				_pOut = WriteSequence(_pOut, _pSource + _uAnchor, i - _uAnchor, i - _uCandidate, _uMatch);
+				i += _uMatch;
+				_uAnchor = i;
+
+				if (i <= _uSearchEnd)
+				{
+					_vectorTable[Hash(Read32(_pSource + i - 2))] = static_cast<uint32_t>(i - 1);
+				}
+			}
+		}
+
+		_pOut = WriteSequence(_pOut, _pSource + _uAnchor, _uSize - _uAnchor, 0, 0);
+		return static_cast<size_t>(_pOut - _pDest);
+	}
+
+	bool Decompress(uint8_t const* _pSource, size_t const _uSourceSize, uint8_t* _pDest, size_t const _uDestSize)
+	{
+		uint8_t const* _pIn = _pSource;
+		uint8_t const* const _pInEnd = _pSource + _uSourceSize;
+		uint8_t* _pOut = _pDest;
+		uint8_t* const _pOutEnd = _pDest + _uDestSize;
+
+		for (;;)
+		{
+			if (_pIn >= _pInEnd)
+			{
+				return false;
+			}
+			uint8_t const _uToken = *_pIn++;
+
+			size_t _uLiterals = _uToken >> 4;
+			if (_uLiterals == 15 && ReadLength(_pIn, _pInEnd, _uLiterals) == false)
+			{
+				return false;
+			}
+			if (_uLiterals > static_cast<size_t>(_pInEnd - _pIn) || _uLiterals > static_cast<size_t>(_pOutEnd - _pOut))
+			{
+				return false;
+			}
+			if (HasWildCopyRoom(_pIn, _pInEnd, _uLiterals) && HasWildCopyRoom(_pOut, _pOutEnd, _uLiterals))
+			{
+				WildCopy(_pOut, _pIn, _uLiterals);
+			}
+			else if (_uLiterals > 0)
+			{
+				memcpy(_pOut, _pIn, _uLiterals);
+			}
+			_pIn += _uLiterals;
+			_pOut += _uLiterals;
+
+			// Only the last sequence has no match
+			if (_pIn == _pInEnd)
+			{
+				return _pOut == _pOutEnd;
+			}
+
+			if (_pInEnd - _pIn < 2)
+			{
+				return false;
+			}
+			size_t const _uOffset = _pIn[0] | (static_cast<size_t>(_pIn[1]) << 8);
+			_pIn += 2;
+
+			size_t _uMatch = _uToken & 15;
+			if (_uMatch == 15 && ReadLength(_pIn, _pInEnd, _uMatch) == false)
+			{
+				return false;
+			}
+			_uMatch += c_uMinMatch;
+
+			if (_uOffset == 0 || _uOffset > static_cast<size_t>(_pOut - _pDest) || _uMatch > static_cast<size_t>(_pOutEnd - _pOut))
+			{
+				return false;
+			}
+
+			if (_uOffset >= c_uWildCopyBytes && HasWildCopyRoom(_pOut, _pOutEnd, _uMatch))
+			{
+				WildCopy(_pOut, _pOut - _uOffset, _uMatch);
+			}
+			else
+			{
+				// A match can overlap what it's writing (a run repeating every _uOffset bytes).
+				// Whatever's been written is a whole number of repeats, so copy that much at a
+				// time and the distance doubles each pass.
+				size_t _uCopied = 0;
+				size_t _uDistance = _uOffset;
+				while (_uCopied < _uMatch)
+				{
+					size_t const _uCount = std::min(_uMatch - _uCopied, _uDistance);
+					memcpy(_pOut + _uCopied, _pOut + _uCopied - _uDistance, _uCount);
+					_uCopied += _uCount;
+					_uDistance = _uCopied + _uOffset;
+				}
+			}
+			_pOut += _uMatch;
+		}
+	}
+};
+//========================================
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//========================================
+// Byte oriented LZ77 in the LZ4 block format: no entropy coding, so it decompresses at
+// close to memcpy speed. Each call is one self contained block, split big buffers up
+// and they can be (de)compressed side by side.
+namespace lz_block
+{
+	// Worst case output of Compress(), for data that doesn't compress at all
+	size_t GetMaxCompressedSize(size_t const _uSize);
+
+	// _pDest has to hold GetMaxCompressedSize(_uSize) bytes. Returns the compressed size.
+	size_t Compress(uint8_t const* _pSource, size_t const _uSize, uint8_t* _pDest);
+
+	// Never reads or writes outside either buffer. False if the block is corrupt or doesn't
+	// decompress to exactly _uDestSize bytes.
+	bool Decompress(uint8_t const* _pSource, size_t const _uSourceSize, uint8_t* _pDest, size_t const _uDestSize);
+};
+//========================================
@@ -0,0 +1,170 @@
+#include "mapped_file.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//========================================
+CMappedFile::CMappedFile()
+{
+
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool CMappedFile::Open(std::string const& _sFilePath, Access const _eAccess /*= Access::Random*/, Protection const _eProtection /*= Protection::ReadOnly*/)
+{
+	Close();
+
+	DWORD const _uFlags = (_eAccess == Access::Sequential) ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+	HANDLE _hFile = CreateFileA(_sFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, _uFlags, NULL);
+	if (_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER _Size;
+	if (GetFileSizeEx(_hFile, &_Size) == FALSE)
+	{
+		CloseHandle(_hFile);
+		return false;
+	}
+
+	m_pFile = _hFile;
+	m_uSize = static_cast<size_t>(_Size.QuadPart);
+	m_bOpen = true;
+
+	// Can't map an empty file
+	if (m_uSize == 0)
+	{
+		return true;
+	}
+
+	bool const _bCopyOnWrite = (_eProtection == Protection::CopyOnWrite);
+	HANDLE _hMapping = CreateFileMappingA(_hFile, NULL, _bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	void const* _pView = (_hMapping != NULL) ? MapViewOfFile(_hMapping, _bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (_pView == nullptr)
+	{
+		if (_hMapping != NULL)
+		{
+			CloseHandle(_hMapping);
+		}
+		Close();
+		return false;
+	}
+
+	m_pMapping = _hMapping;
+	m_pData = static_cast<uint8_t const*>(_pView);
+	m_bWritable = _bCopyOnWrite;
+
+#if _WIN32_WINNT >= _WIN32_WINNT_WIN8
+	// Fault the whole view in with large reads rather than a page at a time
+	if (_eAccess == Access::Sequential)
+	{
+		WIN32_MEMORY_RANGE_ENTRY _Range;
+		_Range.VirtualAddress = const_cast<uint8_t*>(m_pData);
+		_Range.NumberOfBytes = m_uSize;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &_Range, 0);
+	}
+#endif
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (m_pData != nullptr)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_pMapping != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_pMapping));
+	}
+	if (m_pFile != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(m_pFile));
+	}
+
+	m_pData = nullptr;
+	m_pMapping = nullptr;
+	m_pFile = nullptr;
+	m_uSize = 0;
+	m_bOpen = false;
+	m_bWritable = false;
+}
+
+#else
+
+bool CMappedFile::Open(std::string const& _sFilePath, Access const _eAccess /*= Access::Random*/, Protection const _eProtection /*= Protection::ReadOnly*/)
+{
+	Close();
+
+	int const _iFile = open(_sFilePath.c_str(), O_RDONLY);
+	if (_iFile < 0)
+	{
+		return false;
+	}
+
+	struct stat _Stat;
+	if (fstat(_iFile, &_Stat) != 0)
+	{
+		close(_iFile);
+		return false;
+	}
+
+	m_uSize = static_cast<size_t>(_Stat.st_size);
+	m_bOpen = true;
+
+	if (m_uSize > 0)
+	{
+		bool const _bCopyOnWrite = (_eProtection == Protection::CopyOnWrite);
+		void* _pView = mmap(nullptr, m_uSize, _bCopyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, _iFile, 0);
+		if (_pView == MAP_FAILED)
+		{
+			close(_iFile);
+			m_uSize = 0;
+			m_bOpen = false;
+			return false;
+		}
+		m_pData = static_cast<uint8_t const*>(_pView);
+		m_bWritable = _bCopyOnWrite;
+
+		if (_eAccess == Access::Sequential)
+		{
+			madvise(_pView, m_uSize, MADV_SEQUENTIAL);
+			madvise(_pView, m_uSize, MADV_WILLNEED);
+		}
+	}
+
+	// The mapping keeps its own reference to the file
+	close(_iFile);
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (m_pData != nullptr)
+	{
+		munmap(const_cast<uint8_t*>(m_pData), m_uSize);
+	}
+
+	m_pData = nullptr;
+	m_uSize = 0;
+	m_bOpen = false;
+	m_bWritable = false;
+}
+
+#endif
+//========================================
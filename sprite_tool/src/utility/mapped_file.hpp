@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//========================================
+// Read only view of a whole file, mapped rather than read. The data stays valid until
+// Close() or destruction, and is shared between threads without any locking.
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	CMappedFile(CMappedFile const&) = delete;
+	CMappedFile& operator=(CMappedFile const&) = delete;
+
+	enum class Access
+	{
+		Random,			// looked up here and there (packs)
+		Sequential,		// read once front to back (decoders, parsers), read ahead aggressively
+	};
+
+	enum class Protection
+	{
+		ReadOnly,
+		CopyOnWrite,	// writable, pages are copied as they're first written and never reach the file
+	};
+
+	// False if the file can't be opened. An empty file opens fine with no data.
+	bool Open(std::string const& _sFilePath, Access const _eAccess = Access::Random, Protection const _eProtection = Protection::ReadOnly);
+	void Close();
+
+	bool IsOpen() const { return m_bOpen; }
+	uint8_t const* GetData() const { return m_pData; }
+	// Null unless opened copy on write
+	uint8_t* GetWritableData() const { return m_bWritable ? const_cast<uint8_t*>(m_pData) : nullptr; }
+	size_t GetSize() const { return m_uSize; }
+
+protected:
+	uint8_t const* m_pData = nullptr;
+	size_t m_uSize = 0;
+	bool m_bOpen = false;
+	bool m_bWritable = false;
+
+	// Platform handles
+	void* m_pFile = nullptr;
+	void* m_pMapping = nullptr;
+};
+//========================================
@@ -0,0 +1,102 @@
+#include "mip_chain.hpp"
+
+#include "pixel_kernels.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+//========================================
+namespace mip_chain
+{
+	namespace
+	{
+		size_t const c_uMinBytesPerThread = 1024 * 1024;	// of the level being written
+	};
+
+	uint32_t GetLevelCount(int32_t const _iWidth, int32_t const _iHeight)
+	{
+		uint32_t _uLevels = 1;
+		for (int32_t _iSize = std::max(_iWidth, _iHeight); _iSize > 1; _iSize /= 2)
+		{
+			++_uLevels;
+		}
+		return _uLevels;
+	}
+
+	void HalveRows(uint8_t const* _pSource, size_t const _uSourceRowBytes, int32_t const _iSourceWidth, int32_t const _iSourceRows, uint32_t const _uChannels, uint8_t* _pDest)
+	{
+		pixel_kernels::tHalveRow const _HalveRow = pixel_kernels::GetHalveRow(_uChannels);
+		int32_t const _iDestWidth = GetHalfSize(_iSourceWidth);
+		int32_t const _iDestRows = GetHalfSize(_iSourceRows);
+		size_t const _uDestRowBytes = static_cast<size_t>(_iDestWidth) * _uChannels;
+
+		size_t const _uMaxThreads = std::max<size_t>(1, _uDestRowBytes * _iDestRows / c_uMinBytesPerThread);
+		uint32_t const _uThreads = static_cast<uint32_t>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), _uMaxThreads));
+
+		ParallelFor(static_cast<size_t>(_iDestRows), _uThreads, [&](size_t const y)
+		{
+			// A single row or column pairs with itself
+			uint8_t const* _pRow0 = _pSource + y * 2 * _uSourceRowBytes;
+			uint8_t const* _pRow1 = (_iSourceRows > 1) ? _pRow0 + _uSourceRowBytes : _pRow0;
+			uint8_t* _pOut = _pDest + y * _uDestRowBytes;
+
+			if (_iSourceWidth > 1)
+			{
+				_HalveRow(_pOut, _pRow0, _pRow1, static_cast<size_t>(_iDestWidth));
+			}
+			else
+			{
+				uint8_t _arrayPair0[8];
+				uint8_t _arrayPair1[8];
+				memcpy(_arrayPair0, _pRow0, _uChannels);
+				memcpy(_arrayPair0 + _uChannels, _pRow0, _uChannels);
+				memcpy(_arrayPair1, _pRow1, _uChannels);
+				memcpy(_arrayPair1 + _uChannels, _pRow1, _uChannels);
+				_HalveRow(_pOut, _arrayPair0, _arrayPair1, 1);
+			}
+		});
+	}
+
+	SLevel Halve(uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels)
+	{
+		SLevel _Level;
+		if (_pPixels == nullptr || _iWidth <= 0 || _iHeight <= 0 || (_uChannels != 3 && _uChannels != 4))
+		{
+			return _Level;
+		}
+
+		_Level.m_iWidth = GetHalfSize(_iWidth);
+		_Level.m_iHeight = GetHalfSize(_iHeight);
+		_Level.m_pData = std::make_shared<FileHelper::tPixelBuffer>(static_cast<size_t>(_Level.m_iWidth) * _Level.m_iHeight * _uChannels);
+		HalveRows(_pPixels, static_cast<size_t>(_iWidth) * _uChannels, _iWidth, _iHeight, _uChannels, _Level.m_pData->data());
+		return _Level;
+	}
+
+	std::vector<SLevel> Generate(uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels)
+	{
+		std::vector<SLevel> _vectorLevels;
+		if (_pPixels == nullptr || _iWidth <= 0 || _iHeight <= 0 || (_uChannels != 3 && _uChannels != 4))
+		{
+			return _vectorLevels;
+		}
+
+		_vectorLevels.reserve(GetLevelCount(_iWidth, _iHeight) - 1);
+
+		uint8_t const* _pAbove = _pPixels;
+		int32_t _iAboveWidth = _iWidth;
+		int32_t _iAboveHeight = _iHeight;
+		while (_iAboveWidth > 1 || _iAboveHeight > 1)
+		{
+			_vectorLevels.push_back(Halve(_pAbove, _iAboveWidth, _iAboveHeight, _uChannels));
+
+			SLevel const& _Level = _vectorLevels.back();
+			_pAbove = _Level.m_pData->data();
+			_iAboveWidth = _Level.m_iWidth;
+			_iAboveHeight = _Level.m_iHeight;
+		}
+		return _vectorLevels;
+	}
+};
+//========================================
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "file_helper.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//========================================
+// Mip levels built on the CPU when a texture is decoded, so a zoomed out view samples
+// something close to its own size instead of skipping across a huge atlas.
+//
+// Each level is the 2x2 box of the one above (see pixel_kernels::tHalveRow), colour weighted
+// by alpha so sprite edges don't pick up the black of their transparent surroundings. Sizes
+// follow GL: each level is half the last rounded down, to 1x1, and an odd last row or
+// column is left out of the box below it.
+namespace mip_chain
+{
+	struct SLevel
+	{
+		int32_t m_iWidth = 0;
+		int32_t m_iHeight = 0;
+		std::shared_ptr<FileHelper::tPixelBuffer> m_pData;	// tightly packed, same channels as the image
+	};
+
+	// Levels GL wants for a complete texture, the image itself included
+	uint32_t GetLevelCount(int32_t const _iWidth, int32_t const _iHeight);
+	inline int32_t GetHalfSize(int32_t const _iSize) { return (_iSize > 1) ? _iSize / 2 : 1; }
+
+	// _iSourceRows rows (3 or 4 channels, _uSourceRowBytes apart) into the rows of the level
+	// below, GetHalfSize() of each. Only the last band of an image may have an odd number of rows.
+	void HalveRows(uint8_t const* _pSource, size_t const _uSourceRowBytes, int32_t const _iSourceWidth, int32_t const _iSourceRows, uint32_t const _uChannels, uint8_t* _pDest);
+
+	// The level below
+	SLevel Halve(uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels);
+	// Every level below the image, down to 1x1. Empty for anything that isn't RGB or RGBA.
+	std::vector<SLevel> Generate(uint8_t const* _pPixels, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels);
+};
+//========================================
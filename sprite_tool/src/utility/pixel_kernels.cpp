@@ -0,0 +1,92 @@
+#include "pixel_kernels.hpp"
+
+#include "cpu_features.hpp"
+
+//========================================
+namespace pixel_kernels
+{
+	void MergeRGBAScalar(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount)
+	{
+		for (size_t i = 0; i < _uCount; ++i)
+		{
+			uint8_t const _uR = _pRGB[i * 3 + 0];
+			uint8_t const _uG = _pRGB[i * 3 + 1];
+			uint8_t const _uB = _pRGB[i * 3 + 2];
+			_pRGBA[i * 4 + 0] = _uR;
+			_pRGBA[i * 4 + 1] = _uG;
+			_pRGBA[i * 4 + 2] = _uB;
+			_pRGBA[i * 4 + 3] = (_pAlpha != nullptr) ? _pAlpha[i] : 0xff;
+		}
+	}
+
+	void HalveRowRGBAScalar(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		for (size_t x = 0; x < _uDestTexels; ++x)
+		{
+			uint8_t const* _arrayTexels[4] = { _pRow0 + x * 8, _pRow0 + x * 8 + 4, _pRow1 + x * 8, _pRow1 + x * 8 + 4 };
+
+			uint32_t _uAlpha = 0;
+			for (uint8_t const* _pTexel : _arrayTexels)
+			{
+				_uAlpha += _pTexel[3];
+			}
+
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				uint32_t _uSum = 0;
+				uint32_t _uWeighted = 0;
+				for (uint8_t const* _pTexel : _arrayTexels)
+				{
+					_uSum += _pTexel[c];
+					_uWeighted += _pTexel[c] * _pTexel[3];
+				}
+
+				// Sums are exact in a float, so the SIMD kernels get the same rounding. Fully
+				// transparent boxes have nothing to weight by, they keep the plain average.
+				_pDest[x * 4 + c] = (_uAlpha == 0) ? static_cast<uint8_t>((_uSum + 2) >> 2)
+												   : static_cast<uint8_t>(static_cast<float>(_uWeighted) / static_cast<float>(_uAlpha) + 0.5f);
+			}
+			_pDest[x * 4 + 3] = static_cast<uint8_t>((_uAlpha + 2) >> 2);
+		}
+	}
+
+	void HalveRowRGBScalar(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		for (size_t x = 0; x < _uDestTexels; ++x)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				uint32_t const _uSum = _pRow0[x * 6 + c] + _pRow0[x * 6 + 3 + c] + _pRow1[x * 6 + c] + _pRow1[x * 6 + 3 + c];
+				_pDest[x * 3 + c] = static_cast<uint8_t>((_uSum + 2) >> 2);
+			}
+		}
+	}
+
+	tMergeRGBA GetMergeRGBA()
+	{
+		if (cpu_features::HasAVX2())
+		{
+			return MergeRGBAAVX2;
+		}
+		if (cpu_features::HasSSSE3())
+		{
+			return MergeRGBASSSE3;
+		}
+		return MergeRGBAScalar;
+	}
+
+	tHalveRow GetHalveRow(uint32_t const _uChannels)
+	{
+		bool const _bRGBA = (_uChannels == 4);
+		if (cpu_features::HasAVX2())
+		{
+			return _bRGBA ? HalveRowRGBAAVX2 : HalveRowRGBAVX2;
+		}
+		if (cpu_features::HasSSSE3())
+		{
+			return _bRGBA ? HalveRowRGBASSSE3 : HalveRowRGBSSSE3;
+		}
+		return _bRGBA ? HalveRowRGBAScalar : HalveRowRGBScalar;
+	}
+};
+//========================================
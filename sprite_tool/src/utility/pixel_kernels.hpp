@@ -0,0 +1,43 @@
+#pragma once
+
+// Pixel format conversions for the image loaders, shared with the translation units
+// built with wider instruction sets.
+
+#include <cstddef>
+#include <cstdint>
+
+//========================================
+namespace pixel_kernels
+{
+	// _pRGBA[i] = { _pRGB[i], _pAlpha[i] } for _uCount texels, opaque if _pAlpha is null.
+	// Safe in place when the RGB is packed into the back three quarters of the destination
+	// (_pRGB == _pRGBA + _uCount), every texel is read before anything is written over it.
+	typedef void (*tMergeRGBA)(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount);
+
+	// Every kernel writes the same bytes
+	void MergeRGBAScalar(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount);
+	void MergeRGBASSSE3(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount);
+	void MergeRGBAAVX2(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount);
+
+	// Widest the machine supports
+	tMergeRGBA GetMergeRGBA();
+
+	// One row of the next mip level down: _pDest[x] is the 2x2 box of texels 2x and 2x+1 of
+	// _pRow0 and _pRow1, for _uDestTexels texels. RGBA weights colour by alpha so fully
+	// transparent texels don't bleed their (usually black) colour into the edges, RGB is a
+	// plain average. Both round to nearest.
+	typedef void (*tHalveRow)(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+
+	// Every kernel writes the same bytes
+	void HalveRowRGBAScalar(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+	void HalveRowRGBASSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+	void HalveRowRGBAAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+
+	void HalveRowRGBScalar(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+	void HalveRowRGBSSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+	void HalveRowRGBAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels);
+
+	// Widest the machine supports, for 3 or 4 channels
+	tHalveRow GetHalveRow(uint32_t const _uChannels);
+};
+//========================================
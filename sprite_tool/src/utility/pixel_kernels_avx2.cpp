@@ -0,0 +1,196 @@
+// pixel_kernels_avx2.cpp : AVX2 conversions, only called when cpu_features::HasAVX2().
+//  Built with /arch:AVX2 (see the vcxproj), GCC/Clang get the target pragma below.
+
+#include "pixel_kernels.hpp"
+
+#include "cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+
+#if defined(__GNUC__) && !defined(__AVX2__)
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+#include <cstring>
+
+//========================================
+namespace pixel_kernels
+{
+	void MergeRGBAAVX2(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount)
+	{
+		// 24 bytes of RGB, 12 to each lane, then 12 bytes -> 4 texels with a zero alpha byte per lane
+		__m256i const _Lanes = _mm256_setr_epi32(0, 1, 2, 2, 3, 4, 5, 5);
+		__m256i const _Spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+												 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		__m256i const _Opaque = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+
+		// 16 texels a pass. Every load happens before the stores and reads up to 8 bytes past
+		// this pass's RGB, the stores end below the next pass's RGB when in place, so stop 19 short.
+		size_t i = 0;
+		for (; i + 19 <= _uCount; i += 16)
+		{
+			uint8_t const* _pSource = _pRGB + i * 3;
+			__m256i _Low = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_pSource + 0));
+			__m256i _High = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(_pSource + 24));
+			_Low = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(_Low, _Lanes), _Spread);
+			_High = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(_High, _Lanes), _Spread);
+
+			if (_pAlpha != nullptr)
+			{
+				__m128i const _Alpha = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pAlpha + i));
+				_Low = _mm256_or_si256(_Low, _mm256_slli_epi32(_mm256_cvtepu8_epi32(_Alpha), 24));
+				_High = _mm256_or_si256(_High, _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_srli_si128(_Alpha, 8)), 24));
+			}
+			else
+			{
+				_Low = _mm256_or_si256(_Low, _Opaque);
+				_High = _mm256_or_si256(_High, _Opaque);
+			}
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_pRGBA + i * 4), _Low);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_pRGBA + i * 4 + 32), _High);
+		}
+
+		MergeRGBAScalar(_pRGBA + i * 4, _pRGB + i * 3, (_pAlpha != nullptr) ? _pAlpha + i : nullptr, _uCount - i);
+	}
+
+	void HalveRowRGBAAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		__m256i const _Two = _mm256_set1_epi32(2);
+		__m256 const _Half = _mm256_set1_ps(0.5f);
+		__m256 const _AlphaLane = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1));
+		// Packing leaves the texels in 32 bit elements 0 4 1 5
+		__m256i const _Order = _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0);
+
+		// 4 texels a pass as two pairs, a texel to each 128 bit lane and a channel to each 32 bit
+		// element. Same arithmetic as the SSSE3 kernel.
+		size_t x = 0;
+		for (; x + 4 <= _uDestTexels; x += 4)
+		{
+			__m256i _arraySums[2] = { _Two, _Two };
+			__m256 _arrayWeighted[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };
+			__m256 _arrayAlpha[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };
+
+			for (int r = 0; r < 2; ++r)
+			{
+				uint8_t const* _pRow = ((r == 0) ? _pRow0 : _pRow1) + x * 8;
+				__m128i const _Low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow));
+				__m128i const _High = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow + 16));
+
+				// Source texels 0-7 two at a time, then the first and second of each pair
+				__m256i const _Texels01 = _mm256_cvtepu8_epi32(_Low);
+				__m256i const _Texels23 = _mm256_cvtepu8_epi32(_mm_srli_si128(_Low, 8));
+				__m256i const _Texels45 = _mm256_cvtepu8_epi32(_High);
+				__m256i const _Texels67 = _mm256_cvtepu8_epi32(_mm_srli_si128(_High, 8));
+				__m256i const _arrayTexels[2][2] =
+				{
+					{ _mm256_permute2x128_si256(_Texels01, _Texels23, 0x20), _mm256_permute2x128_si256(_Texels01, _Texels23, 0x31) },
+					{ _mm256_permute2x128_si256(_Texels45, _Texels67, 0x20), _mm256_permute2x128_si256(_Texels45, _Texels67, 0x31) },
+				};
+
+				for (int g = 0; g < 2; ++g)
+				{
+					for (int t = 0; t < 2; ++t)
+					{
+						_arraySums[g] = _mm256_add_epi32(_arraySums[g], _arrayTexels[g][t]);
+						__m256 const _Texel = _mm256_cvtepi32_ps(_arrayTexels[g][t]);
+						__m256 const _TexelAlpha = _mm256_shuffle_ps(_Texel, _Texel, _MM_SHUFFLE(3, 3, 3, 3));
+						_arrayWeighted[g] = _mm256_add_ps(_arrayWeighted[g], _mm256_mul_ps(_Texel, _TexelAlpha));
+						_arrayAlpha[g] = _mm256_add_ps(_arrayAlpha[g], _TexelAlpha);
+					}
+				}
+			}
+
+			__m256i _arrayResults[2];
+			for (int g = 0; g < 2; ++g)
+			{
+				__m256i const _Plain = _mm256_srli_epi32(_arraySums[g], 2);
+				__m256i const _Divided = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_div_ps(_arrayWeighted[g], _arrayAlpha[g]), _Half));
+				__m256 const _UsePlain = _mm256_or_ps(_mm256_cmp_ps(_arrayAlpha[g], _mm256_setzero_ps(), _CMP_EQ_OQ), _AlphaLane);
+				_arrayResults[g] = _mm256_blendv_epi8(_Divided, _Plain, _mm256_castps_si256(_UsePlain));
+			}
+
+			__m256i const _Packed = _mm256_packs_epi32(_arrayResults[0], _arrayResults[1]);
+			__m256i const _Texels = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(_Packed, _Packed), _Order);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_pDest + x * 4), _mm256_castsi256_si128(_Texels));
+		}
+
+		HalveRowRGBAScalar(_pDest + x * 4, _pRow0 + x * 8, _pRow1 + x * 8, _uDestTexels - x);
+	}
+
+	void HalveRowRGBAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		// Per lane, as the SSSE3 kernel
+		__m256i const _First = _mm256_setr_epi8(0, -1, 1, -1, 2, -1, 6, -1, 7, -1, 8, -1, -1, -1, -1, -1,
+												0, -1, 1, -1, 2, -1, 6, -1, 7, -1, 8, -1, -1, -1, -1, -1);
+		__m256i const _Second = _mm256_setr_epi8(3, -1, 4, -1, 5, -1, 9, -1, 10, -1, 11, -1, -1, -1, -1, -1,
+												 3, -1, 4, -1, 5, -1, 9, -1, 10, -1, 11, -1, -1, -1, -1, -1);
+		__m256i const _Compact = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1,
+												  0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+		__m256i const _Two = _mm256_set1_epi16(2);
+
+		// 8 texels a pass from 48 bytes of each row, in 12 byte chunks. Chunks 0 and 2 share a
+		// register, as do 1 and 3, so packing leaves texels 0-3 in the low lane and 4-7 in the
+		// high. The last load reads 4 bytes past them, so stop with at least a texel to spare.
+		size_t x = 0;
+		for (; x + 9 <= _uDestTexels; x += 8)
+		{
+			__m256i _arrayHalves[2];
+			for (int h = 0; h < 2; ++h)
+			{
+				size_t const _uOffset = x * 6 + h * 12;
+				__m256i _arrayRows[2];
+				for (int r = 0; r < 2; ++r)
+				{
+					uint8_t const* _pRow = ((r == 0) ? _pRow0 : _pRow1) + _uOffset;
+					__m128i const _Low = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow));
+					__m128i const _High = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow + 24));
+					_arrayRows[r] = _mm256_inserti128_si256(_mm256_castsi128_si256(_Low), _High, 1);
+				}
+
+				__m256i _Sum = _mm256_add_epi16(_mm256_shuffle_epi8(_arrayRows[0], _First), _mm256_shuffle_epi8(_arrayRows[0], _Second));
+				_Sum = _mm256_add_epi16(_Sum, _mm256_add_epi16(_mm256_shuffle_epi8(_arrayRows[1], _First), _mm256_shuffle_epi8(_arrayRows[1], _Second)));
+				_arrayHalves[h] = _mm256_srli_epi16(_mm256_add_epi16(_Sum, _Two), 2);
+			}
+
+			__m256i const _Texels = _mm256_shuffle_epi8(_mm256_packus_epi16(_arrayHalves[0], _arrayHalves[1]), _Compact);
+			__m128i const _arrayLanes[2] = { _mm256_castsi256_si128(_Texels), _mm256_extracti128_si256(_Texels, 1) };
+			for (int l = 0; l < 2; ++l)
+			{
+				uint8_t* _pOut = _pDest + x * 3 + l * 12;
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(_pOut), _arrayLanes[l]);
+				int32_t const _iTail = _mm_cvtsi128_si32(_mm_srli_si128(_arrayLanes[l], 8));
+				memcpy(_pOut + 8, &_iTail, sizeof(_iTail));
+			}
+		}
+
+		HalveRowRGBScalar(_pDest + x * 3, _pRow0 + x * 6, _pRow1 + x * 6, _uDestTexels - x);
+	}
+};
+//========================================
+
+#else
+
+//========================================
+namespace pixel_kernels
+{
+	void MergeRGBAAVX2(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount)
+	{
+		MergeRGBAScalar(_pRGBA, _pRGB, _pAlpha, _uCount);
+	}
+
+	void HalveRowRGBAAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		HalveRowRGBAScalar(_pDest, _pRow0, _pRow1, _uDestTexels);
+	}
+
+	void HalveRowRGBAVX2(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		HalveRowRGBScalar(_pDest, _pRow0, _pRow1, _uDestTexels);
+	}
+};
+//========================================
+
+#endif
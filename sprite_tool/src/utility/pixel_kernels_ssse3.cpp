@@ -0,0 +1,185 @@
+// pixel_kernels_ssse3.cpp : SSSE3 conversions, only called when cpu_features::HasSSSE3().
+//  MSVC needs no switch for SSSE3 intrinsics, GCC/Clang get the target pragma below.
+
+#include "pixel_kernels.hpp"
+
+#include "cpu_features.hpp"
+
+#if defined(SPRITE_TOOL_X86)
+
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#pragma GCC target("ssse3")
+#endif
+
+#include <tmmintrin.h>
+
+#include <cstring>
+
+//========================================
+namespace pixel_kernels
+{
+	void MergeRGBASSSE3(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount)
+	{
+		// 12 bytes of RGB -> 4 texels with a zero alpha byte
+		__m128i const _Spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		// 4 alpha bytes -> the top byte of each texel
+		__m128i const _AlphaSpread[4] =
+		{
+			_mm_setr_epi8(-1, -1, -1, 0, -1, -1, -1, 1, -1, -1, -1, 2, -1, -1, -1, 3),
+			_mm_setr_epi8(-1, -1, -1, 4, -1, -1, -1, 5, -1, -1, -1, 6, -1, -1, -1, 7),
+			_mm_setr_epi8(-1, -1, -1, 8, -1, -1, -1, 9, -1, -1, -1, 10, -1, -1, -1, 11),
+			_mm_setr_epi8(-1, -1, -1, 12, -1, -1, -1, 13, -1, -1, -1, 14, -1, -1, -1, 15),
+		};
+		__m128i const _Opaque = _mm_set1_epi32(static_cast<int>(0xff000000u));
+
+		// 16 texels a pass. Every load happens before the stores and reads up to 4 bytes past
+		// this pass's RGB, the stores end below the next pass's RGB when in place, so stop 18 short.
+		size_t i = 0;
+		for (; i + 18 <= _uCount; i += 16)
+		{
+			uint8_t const* _pSource = _pRGB + i * 3;
+			__m128i _Texels[4] =
+			{
+				_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(_pSource + 0)), _Spread),
+				_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(_pSource + 12)), _Spread),
+				_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(_pSource + 24)), _Spread),
+				_mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(_pSource + 36)), _Spread),
+			};
+
+			if (_pAlpha != nullptr)
+			{
+				__m128i const _Alpha = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pAlpha + i));
+				for (int j = 0; j < 4; ++j)
+				{
+					_Texels[j] = _mm_or_si128(_Texels[j], _mm_shuffle_epi8(_Alpha, _AlphaSpread[j]));
+				}
+			}
+			else
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					_Texels[j] = _mm_or_si128(_Texels[j], _Opaque);
+				}
+			}
+
+			for (int j = 0; j < 4; ++j)
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_pRGBA + (i + j * 4) * 4), _Texels[j]);
+			}
+		}
+
+		MergeRGBAScalar(_pRGBA + i * 4, _pRGB + i * 3, (_pAlpha != nullptr) ? _pAlpha + i : nullptr, _uCount - i);
+	}
+
+	void HalveRowRGBASSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		__m128i const _Zero = _mm_setzero_si128();
+		__m128i const _Two = _mm_set1_epi32(2);
+		__m128 const _Half = _mm_set1_ps(0.5f);
+		// Alpha itself is always the plain average
+		__m128 const _AlphaLane = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+
+		// 2 texels a pass, a channel to each 32 bit lane. Products and sums are whole numbers
+		// well inside a float's mantissa, so only the divide rounds, same as the scalar kernel.
+		size_t x = 0;
+		for (; x + 2 <= _uDestTexels; x += 2)
+		{
+			__m128i const _Row0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow0 + x * 8));
+			__m128i const _Row1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow1 + x * 8));
+
+			__m128i _arrayResults[2];
+			for (int d = 0; d < 2; ++d)
+			{
+				__m128i const _Top = (d == 0) ? _mm_unpacklo_epi8(_Row0, _Zero) : _mm_unpackhi_epi8(_Row0, _Zero);
+				__m128i const _Bottom = (d == 0) ? _mm_unpacklo_epi8(_Row1, _Zero) : _mm_unpackhi_epi8(_Row1, _Zero);
+				__m128i const _arrayTexels[4] =
+				{
+					_mm_unpacklo_epi16(_Top, _Zero), _mm_unpackhi_epi16(_Top, _Zero),
+					_mm_unpacklo_epi16(_Bottom, _Zero), _mm_unpackhi_epi16(_Bottom, _Zero),
+				};
+
+				__m128i _Sum = _Two;
+				__m128 _Weighted = _mm_setzero_ps();
+				__m128 _Alpha = _mm_setzero_ps();
+				for (int t = 0; t < 4; ++t)
+				{
+					_Sum = _mm_add_epi32(_Sum, _arrayTexels[t]);
+					__m128 const _Texel = _mm_cvtepi32_ps(_arrayTexels[t]);
+					__m128 const _TexelAlpha = _mm_shuffle_ps(_Texel, _Texel, _MM_SHUFFLE(3, 3, 3, 3));
+					_Weighted = _mm_add_ps(_Weighted, _mm_mul_ps(_Texel, _TexelAlpha));
+					_Alpha = _mm_add_ps(_Alpha, _TexelAlpha);
+				}
+
+				__m128i const _Plain = _mm_srli_epi32(_Sum, 2);
+				__m128i const _Divided = _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(_Weighted, _Alpha), _Half));
+				__m128i const _UsePlain = _mm_castps_si128(_mm_or_ps(_mm_cmpeq_ps(_Alpha, _mm_setzero_ps()), _AlphaLane));
+				_arrayResults[d] = _mm_or_si128(_mm_and_si128(_UsePlain, _Plain), _mm_andnot_si128(_UsePlain, _Divided));
+			}
+
+			__m128i const _Packed = _mm_packs_epi32(_arrayResults[0], _arrayResults[1]);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(_pDest + x * 4), _mm_packus_epi16(_Packed, _Packed));
+		}
+
+		HalveRowRGBAScalar(_pDest + x * 4, _pRow0 + x * 8, _pRow1 + x * 8, _uDestTexels - x);
+	}
+
+	void HalveRowRGBSSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		// 12 bytes (4 texels) -> the first and second texel of each pair, 16 bits a channel
+		__m128i const _First = _mm_setr_epi8(0, -1, 1, -1, 2, -1, 6, -1, 7, -1, 8, -1, -1, -1, -1, -1);
+		__m128i const _Second = _mm_setr_epi8(3, -1, 4, -1, 5, -1, 9, -1, 10, -1, 11, -1, -1, -1, -1, -1);
+		// Two packed halves of 6 bytes (and 2 of padding) -> 12 bytes
+		__m128i const _Compact = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 8, 9, 10, 11, 12, 13, -1, -1, -1, -1);
+		__m128i const _Two = _mm_set1_epi16(2);
+
+		// 4 texels a pass from 24 bytes of each row. The second load reads 4 bytes past them,
+		// so stop with at least a texel to spare.
+		size_t x = 0;
+		for (; x + 5 <= _uDestTexels; x += 4)
+		{
+			__m128i _arrayHalves[2];
+			for (int h = 0; h < 2; ++h)
+			{
+				size_t const _uOffset = x * 6 + h * 12;
+				__m128i const _Row0 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow0 + _uOffset));
+				__m128i const _Row1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_pRow1 + _uOffset));
+
+				__m128i _Sum = _mm_add_epi16(_mm_shuffle_epi8(_Row0, _First), _mm_shuffle_epi8(_Row0, _Second));
+				_Sum = _mm_add_epi16(_Sum, _mm_add_epi16(_mm_shuffle_epi8(_Row1, _First), _mm_shuffle_epi8(_Row1, _Second)));
+				_arrayHalves[h] = _mm_srli_epi16(_mm_add_epi16(_Sum, _Two), 2);
+			}
+
+			__m128i const _Texels = _mm_shuffle_epi8(_mm_packus_epi16(_arrayHalves[0], _arrayHalves[1]), _Compact);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(_pDest + x * 3), _Texels);
+			int32_t const _iTail = _mm_cvtsi128_si32(_mm_srli_si128(_Texels, 8));
+			memcpy(_pDest + x * 3 + 8, &_iTail, sizeof(_iTail));
+		}
+
+		HalveRowRGBScalar(_pDest + x * 3, _pRow0 + x * 6, _pRow1 + x * 6, _uDestTexels - x);
+	}
+};
+//========================================
+
+#else
+
+//========================================
+namespace pixel_kernels
+{
+	void MergeRGBASSSE3(uint8_t* _pRGBA, uint8_t const* _pRGB, uint8_t const* _pAlpha, size_t _uCount)
+	{
+		MergeRGBAScalar(_pRGBA, _pRGB, _pAlpha, _uCount);
+	}
+
+	void HalveRowRGBASSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		HalveRowRGBAScalar(_pDest, _pRow0, _pRow1, _uDestTexels);
+	}
+
+	void HalveRowRGBSSSE3(uint8_t* _pDest, uint8_t const* _pRow0, uint8_t const* _pRow1, size_t _uDestTexels)
+	{
+		HalveRowRGBScalar(_pDest, _pRow0, _pRow1, _uDestTexels);
+	}
+};
+//========================================
+
+#endif
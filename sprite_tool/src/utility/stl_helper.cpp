@@ -3,6 +3,8 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdarg>
+#include <cstring>
 #include <string>
 
 //========================================
@@ -1,5 +1,8 @@
+#pragma once
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <stdarg.h>
 
 //========================================
@@ -7,5 +10,34 @@ namespace stl_helper
 {
 	std::string Format(char const* _psFmt, ...);
 	std::string ToLower(std::string const &_sText);
+
+	// Leaves elements default initialised, so resize() on a vector of bytes doesn't zero
+	// memory that's about to be written over anyway.
+	template <typename T>
+	class CDefaultInitAllocator : public std::allocator<T>
+	{
+	public:
+		template <typename U>
+		struct rebind
+		{
+			typedef CDefaultInitAllocator<U> other;
+		};
+
+		CDefaultInitAllocator() = default;
+		template <typename U>
+		CDefaultInitAllocator(CDefaultInitAllocator<U> const&) {}
+
+		template <typename U>
+		void construct(U* _pElement)
+		{
+			::new (static_cast<void*>(_pElement)) U;
+		}
+
+		template <typename U, typename... tArgs>
+		void construct(U* _pElement, tArgs&&... _Args)
+		{
+			::new (static_cast<void*>(_pElement)) U(std::forward<tArgs>(_Args)...);
+		}
+	};
 };
 //========================================
\ No newline at end of file
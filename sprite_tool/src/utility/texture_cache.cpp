@@ -0,0 +1,721 @@
+#include "texture_cache.hpp"
+
+#include "compiled_cache.hpp"
+#include "hash_helper.hpp"
+#include "lz_block.hpp"
+#include "stl_helper.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+//========================================
+namespace texture_cache
+{
+	namespace
+	{
+		uint32_t const c_uMagic = 0x58545453;	// "STTX"
+		uint32_t const c_uVersion = 3;	// 3: reduced PNGs used to be stored at full size
+
+		size_t const c_uBlockBytes = 256 * 1024;		// raw pixels per block, rounded to whole rows
+		size_t const c_uMinBytesPerThread = 1024 * 1024;
+		size_t const c_uMinStoredBytes = 256 * 1024;	// smaller decodes about as fast as it loads
+		uint32_t const c_uMaxDimension = 65536;
+		uint64_t const c_uDefaultMaxSize = 2048ull * 1024 * 1024;
+
+		enum class Compression : uint32_t
+		{
+			Stored = 0,		// didn't shrink, kept as is
+			LZ = 1,
+		};
+
+		struct SHeader
+		{
+			uint32_t m_uMagic = c_uMagic;
+			uint32_t m_uVersion = c_uVersion;
+			uint64_t m_uSourceHash = 0;
+
+			uint32_t m_uWidth = 0;
+			uint32_t m_uHeight = 0;
+			uint32_t m_uChannels = 0;
+			uint32_t m_uScaleDenom = 0;
+
+			uint32_t m_uBlockRows = 0;
+			uint32_t m_uBlockCount = 0;		// block table follows the header
+			uint64_t m_uTableHash = 0;
+
+			// SBlockFormat, zero for plain pixels
+			uint32_t m_uVariant = 0;
+			uint32_t m_uFormat = 0;
+			uint32_t m_uImageWidth = 0;
+			uint32_t m_uImageHeight = 0;
+		};
+		static_assert(sizeof(SHeader) == 64, "texture cache header layout changed, bump c_uVersion");
+		static_assert(sizeof(SBlock) == 24, "texture cache block layout changed, bump c_uVersion");
+
+		std::string GetDirectory()
+		{
+			std::string const _sDirectory = compiled_cache::GetDirectory();
+			return _sDirectory.empty() ? _sDirectory : _sDirectory + "/textures";
+		}
+
+		std::string GetEntryPath(std::string const& _sDirectory, uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant)
+		{
+			if (_uVariant == 0)
+			{
+				return stl_helper::Format("%s/%016llx_%u.bin", _sDirectory.c_str(), static_cast<unsigned long long>(_uSourceHash), _uScaleDenom);
+			}
+			return stl_helper::Format("%s/%016llx_%u_%08x.bin", _sDirectory.c_str(), static_cast<unsigned long long>(_uSourceHash), _uScaleDenom, _uVariant);
+		}
+
+		// Blocks of a known format stored one to a "texel", sized to cover the image
+		bool IsValidBlockFormat(SBlockFormat const& _BlockFormat, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels)
+		{
+			if (_BlockFormat.m_uVariant == 0)
+			{
+				return _BlockFormat.m_uFormat == 0 && _uChannels <= 4;
+			}
+
+			block_compression::Format const _eFormat = static_cast<block_compression::Format>(_BlockFormat.m_uFormat);
+			return
+				_eFormat != block_compression::Format::None &&
+				block_compression::GetBlockBytes(_eFormat) == _uChannels &&
+				_BlockFormat.m_iImageWidth > 0 && block_compression::GetBlockCount(_BlockFormat.m_iImageWidth) == _iWidth &&
+				_BlockFormat.m_iImageHeight > 0 && block_compression::GetBlockCount(_BlockFormat.m_iImageHeight) == _iHeight;
+		}
+
+		uint32_t GetThreadCount(size_t const _uBytes)
+		{
+			size_t const _uMaxThreads = std::max<size_t>(1, _uBytes / c_uMinBytesPerThread);
+			return static_cast<uint32_t>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), _uMaxThreads));
+		}
+
+		int32_t GetBlockRows(size_t const _uRowBytes)
+		{
+			return static_cast<int32_t>(std::max<size_t>(1, c_uBlockBytes / _uRowBytes));
+		}
+
+		std::mutex s_Mutex;
+		uint64_t s_uMaxSize = c_uDefaultMaxSize;
+		std::string s_sScannedDirectory;	// s_uTotalSize is for this folder
+		uint64_t s_uTotalSize = 0;
+
+		struct SEntryFile
+		{
+			std::string m_sPath;
+			uint64_t m_uSize = 0;
+			uint64_t m_uModifiedTime = 0;
+		};
+
+		std::vector<SEntryFile> ListEntries(std::string const& _sDirectory)
+		{
+			std::vector<SEntryFile> _vectorEntries;
+			for (std::string const& _sFile : FileHelper::ListFiles(_sDirectory))
+			{
+				// Temporaries belong to writers still going
+				if (_sFile.find('/') != std::string::npos || _sFile.size() < 4 || _sFile.compare(_sFile.size() - 4, 4, ".bin") != 0)
+				{
+					continue;
+				}
+
+				SEntryFile _Entry;
+				_Entry.m_sPath = _sDirectory + "/" + _sFile;
+				_Entry.m_uSize = FileHelper::GetFileSize(_Entry.m_sPath);
+				_Entry.m_uModifiedTime = FileHelper::GetFileModifiedTime(_Entry.m_sPath);
+				_vectorEntries.push_back(_Entry);
+			}
+			return _vectorEntries;
+		}
+
+		// Called with each entry put in place. The folder is only listed the first time and once
+		// the running total goes over the budget, then the oldest entries go until it fits.
+		void TrimToBudget(std::string const& _sDirectory, uint64_t const _uAddedSize)
+		{
+			std::lock_guard<std::mutex> _Lock(s_Mutex);
+
+			if (s_sScannedDirectory == _sDirectory)
+			{
+				s_uTotalSize += _uAddedSize;
+				if (s_uTotalSize <= s_uMaxSize)
+				{
+					return;
+				}
+			}
+
+			std::vector<SEntryFile> _vectorEntries = ListEntries(_sDirectory);
+			s_sScannedDirectory = _sDirectory;
+			s_uTotalSize = 0;
+			for (SEntryFile const& _Entry : _vectorEntries)
+			{
+				s_uTotalSize += _Entry.m_uSize;
+			}
+
+			if (s_uTotalSize <= s_uMaxSize)
+			{
+				return;
+			}
+
+			std::sort(_vectorEntries.begin(), _vectorEntries.end(), [](SEntryFile const& _A, SEntryFile const& _B)
+			{
+				return _A.m_uModifiedTime < _B.m_uModifiedTime;
+			});
+
+			// Entries still mapped by a reader can't be removed on Windows, they're left for next time
+			for (size_t i = 0; i < _vectorEntries.size() && s_uTotalSize > s_uMaxSize; ++i)
+			{
+				if (std::remove(_vectorEntries[i].m_sPath.c_str()) == 0)
+				{
+					s_uTotalSize -= _vectorEntries[i].m_uSize;
+				}
+			}
+		}
+	};
+
+	void SetMaxSize(uint64_t const _uBytes)
+	{
+		std::lock_guard<std::mutex> _Lock(s_Mutex);
+		s_uMaxSize = _uBytes;
+		s_sScannedDirectory.clear();	// trimmed to the new budget on the next store
+	}
+
+	uint64_t GetMaxSize()
+	{
+		std::lock_guard<std::mutex> _Lock(s_Mutex);
+		return s_uMaxSize;
+	}
+
+	bool IsEnabled()
+	{
+		return compiled_cache::GetDirectory().empty() == false && GetMaxSize() > 0;
+	}
+
+	bool Load(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t& _iWidth, int32_t& _iHeight, FileHelper::SImageData& _Image)
+	{
+		CReader _Reader;
+		if (_Reader.Open(_uSourceHash, _uScaleDenom) == false)
+		{
+			return false;
+		}
+
+		auto _pPixels = std::make_shared<FileHelper::tPixelBuffer>(_Reader.GetRowBytes() * _Reader.GetHeight());
+		_Reader.ReadRows(_pPixels->data(), _Reader.GetHeight());
+
+		_iWidth = _Reader.GetWidth();
+		_iHeight = _Reader.GetHeight();
+		_Image.m_pData = _pPixels;
+		_Image.m_uChannels = _Reader.GetChannels();
+		return true;
+	}
+
+	void Store(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t const _iWidth, int32_t const _iHeight, FileHelper::SImageData const& _Image)
+	{
+		if (_Image.m_pData == nullptr || _Image.m_pData->size() != static_cast<size_t>(_iWidth) * _iHeight * _Image.m_uChannels)
+		{
+			return;
+		}
+
+		CWriter _Writer;
+		if (_Writer.Begin(_uSourceHash, _uScaleDenom, _iWidth, _iHeight, _Image.m_uChannels))
+		{
+			_Writer.AddRows(_Image.m_pData->data(), _iHeight);
+			_Writer.Finish();
+		}
+	}
+
+	bool LoadCompressed(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant, block_compression::SCompressedImage& _Image)
+	{
+		CReader _Reader;
+		if (_uVariant == 0 || _Reader.Open(_uSourceHash, _uScaleDenom, _uVariant) == false)
+		{
+			return false;
+		}
+
+		auto _pBlocks = std::make_shared<std::vector<uint8_t>>(_Reader.GetRowBytes() * _Reader.GetHeight());
+		_Reader.ReadRows(_pBlocks->data(), _Reader.GetHeight());
+
+		SBlockFormat const& _BlockFormat = _Reader.GetBlockFormat();
+		_Image.m_eFormat = static_cast<block_compression::Format>(_BlockFormat.m_uFormat);
+		_Image.m_iWidth = _BlockFormat.m_iImageWidth;
+		_Image.m_iHeight = _BlockFormat.m_iImageHeight;
+		_Image.m_pBlocks = _pBlocks;
+		return true;
+	}
+
+	void StoreCompressed(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant, block_compression::SCompressedImage const& _Image)
+	{
+		if (_uVariant == 0 || _Image.m_eFormat == block_compression::Format::None || _Image.m_pBlocks == nullptr ||
+			_Image.m_pBlocks->size() != block_compression::GetCompressedSize(_Image.m_eFormat, _Image.m_iWidth, _Image.m_iHeight))
+		{
+			return;
+		}
+
+		SBlockFormat _BlockFormat;
+		_BlockFormat.m_uVariant = _uVariant;
+		_BlockFormat.m_uFormat = static_cast<uint32_t>(_Image.m_eFormat);
+		_BlockFormat.m_iImageWidth = _Image.m_iWidth;
+		_BlockFormat.m_iImageHeight = _Image.m_iHeight;
+
+		int32_t const _iBlocksWide = block_compression::GetBlockCount(_Image.m_iWidth);
+		int32_t const _iBlocksHigh = block_compression::GetBlockCount(_Image.m_iHeight);
+
+		CWriter _Writer;
+		if (_Writer.Begin(_uSourceHash, _uScaleDenom, _iBlocksWide, _iBlocksHigh, block_compression::GetBlockBytes(_Image.m_eFormat), _BlockFormat))
+		{
+			_Writer.AddRows(_Image.m_pBlocks->data(), _iBlocksHigh);
+			_Writer.Finish();
+		}
+	}
+};
+//========================================
+
+//========================================
+namespace texture_cache
+{
+	CReader::CReader()
+	{
+
+	}
+
+	CReader::~CReader()
+	{
+		Close();
+	}
+
+	bool CReader::Open(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant)
+	{
+		Close();
+
+		std::string const _sDirectory = GetDirectory();
+		if (_sDirectory.empty())
+		{
+			return false;
+		}
+
+		FileHelper::SFileView _Entry = FileHelper::MapFileContents(GetEntryPath(_sDirectory, _uSourceHash, _uScaleDenom, _uVariant));
+		if (_Entry.m_uSize < sizeof(SHeader))
+		{
+			return false;
+		}
+
+		SHeader _Header;
+		memcpy(&_Header, _Entry.m_pData, sizeof(SHeader));
+
+		SBlockFormat _BlockFormat;
+		_BlockFormat.m_uVariant = _Header.m_uVariant;
+		_BlockFormat.m_uFormat = _Header.m_uFormat;
+		_BlockFormat.m_iImageWidth = static_cast<int32_t>(std::min(_Header.m_uImageWidth, c_uMaxDimension));
+		_BlockFormat.m_iImageHeight = static_cast<int32_t>(std::min(_Header.m_uImageHeight, c_uMaxDimension));
+
+		if (_Header.m_uMagic != c_uMagic ||
+			_Header.m_uVersion != c_uVersion ||
+			_Header.m_uSourceHash != _uSourceHash ||
+			_Header.m_uScaleDenom != _uScaleDenom ||
+			_Header.m_uWidth == 0 || _Header.m_uWidth > c_uMaxDimension ||
+			_Header.m_uHeight == 0 || _Header.m_uHeight > c_uMaxDimension ||
+			_Header.m_uChannels == 0 ||
+			_Header.m_uVariant != _uVariant ||
+			IsValidBlockFormat(_BlockFormat, static_cast<int32_t>(_Header.m_uWidth), static_cast<int32_t>(_Header.m_uHeight), _Header.m_uChannels) == false ||
+			_Header.m_uBlockRows == 0 || _Header.m_uBlockRows > _Header.m_uHeight ||
+			_Header.m_uBlockCount != (_Header.m_uHeight + _Header.m_uBlockRows - 1) / _Header.m_uBlockRows)
+		{
+			return false;
+		}
+
+		size_t const _uTableSize = static_cast<size_t>(_Header.m_uBlockCount) * sizeof(SBlock);
+		if (_uTableSize > _Entry.m_uSize - sizeof(SHeader) ||
+			hash_helper::Hash64(_Entry.m_pData + sizeof(SHeader), _uTableSize) != _Header.m_uTableHash)
+		{
+			return false;
+		}
+
+		m_Entry = _Entry;
+		m_iWidth = static_cast<int32_t>(_Header.m_uWidth);
+		m_iHeight = static_cast<int32_t>(_Header.m_uHeight);
+		m_uChannels = _Header.m_uChannels;
+		m_iBlockRows = static_cast<int32_t>(_Header.m_uBlockRows);
+		m_BlockFormat = _BlockFormat;
+
+		// All checked up front, so once rows start coming out none of them can fail
+		size_t const _uRawBlockBytes = GetRowBytes() * m_iBlockRows;
+		std::atomic<bool> _bFailed(false);
+		ParallelFor(_Header.m_uBlockCount, GetThreadCount(_Entry.m_uSize), [&](size_t const _uBlock)
+		{
+			SBlock const _Block = GetBlock(_uBlock);
+			bool const _bValid =
+				_Block.m_uOffset <= _Entry.m_uSize &&
+				_Block.m_uStoredSize <= _Entry.m_uSize - _Block.m_uOffset &&
+				(_Block.m_uCompression == static_cast<uint32_t>(Compression::LZ) || (_Block.m_uCompression == static_cast<uint32_t>(Compression::Stored) && _Block.m_uStoredSize <= _uRawBlockBytes)) &&
+				hash_helper::Hash64(_Entry.m_pData + _Block.m_uOffset, _Block.m_uStoredSize) == _Block.m_uHash;
+			if (_bValid == false)
+			{
+				_bFailed = true;
+			}
+		});
+
+		if (_bFailed)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void CReader::Close()
+	{
+		m_Entry = FileHelper::SFileView();
+		m_iWidth = 0;
+		m_iHeight = 0;
+		m_uChannels = 0;
+		m_iBlockRows = 0;
+		m_iRowsRead = 0;
+		m_BlockFormat = SBlockFormat();
+		m_vectorScratch = FileHelper::tPixelBuffer();
+		m_uScratchBlock = SIZE_MAX;
+	}
+
+	int32_t CReader::ReadRows(uint8_t* _pRows, int32_t const _iRows)
+	{
+		int32_t const _iCount = std::min(_iRows, m_iHeight - m_iRowsRead);
+		if (m_Entry.IsEmpty() || _iCount <= 0)
+		{
+			return 0;
+		}
+
+		int32_t const _iFirst = m_iRowsRead;
+		int32_t const _iEnd = _iFirst + _iCount;
+		size_t const _uRowBytes = GetRowBytes();
+
+		size_t const _uBlockCount = (m_iHeight + m_iBlockRows - 1) / m_iBlockRows;
+		auto _GetBlockEnd = [&](size_t const _uBlock) { return std::min(static_cast<int32_t>(_uBlock + 1) * m_iBlockRows, m_iHeight); };
+
+		// Rest of a block the last read stopped part way through
+		int32_t _iRow = _iFirst;
+		if (_iRow % m_iBlockRows != 0)
+		{
+			size_t const _uBlock = _iRow / m_iBlockRows;
+			int32_t const _iPartEnd = std::min(_GetBlockEnd(_uBlock), _iEnd);
+			ReadPartialBlock(_uBlock, _iRow, _iPartEnd, _pRows);
+			_iRow = _iPartEnd;
+		}
+
+		// Whole blocks go straight to the caller's rows, side by side
+		if (_iRow < _iEnd)
+		{
+			size_t const _uFirstBlock = _iRow / m_iBlockRows;
+			size_t _uEndBlock = _uFirstBlock;
+			while (_uEndBlock < _uBlockCount && _GetBlockEnd(_uEndBlock) <= _iEnd)
+			{
+				++_uEndBlock;
+			}
+
+			if (_uEndBlock > _uFirstBlock)
+			{
+				int32_t const _iWholeEnd = _GetBlockEnd(_uEndBlock - 1);
+				ParallelFor(_uEndBlock - _uFirstBlock, GetThreadCount((_iWholeEnd - _iRow) * _uRowBytes), [&](size_t const i)
+				{
+					size_t const _uBlock = _uFirstBlock + i;
+					DecompressBlock(_uBlock, _pRows + (_uBlock * m_iBlockRows - _iFirst) * _uRowBytes);
+				});
+				_iRow = _iWholeEnd;
+			}
+		}
+
+		// Start of a block the read stops part way through
+		if (_iRow < _iEnd)
+		{
+			ReadPartialBlock(_iRow / m_iBlockRows, _iRow, _iEnd, _pRows + (_iRow - _iFirst) * _uRowBytes);
+		}
+
+		m_iRowsRead = _iEnd;
+		return _iCount;
+	}
+
+	SBlock CReader::GetBlock(size_t const _uBlock) const
+	{
+		SBlock _Block;
+		memcpy(&_Block, m_Entry.m_pData + sizeof(SHeader) + _uBlock * sizeof(SBlock), sizeof(SBlock));
+		return _Block;
+	}
+
+	void CReader::ReadPartialBlock(size_t const _uBlock, int32_t const _iFirst, int32_t const _iEnd, uint8_t* _pRows)
+	{
+		if (m_uScratchBlock != _uBlock)
+		{
+			m_vectorScratch.resize(GetRowBytes() * m_iBlockRows);
+			DecompressBlock(_uBlock, m_vectorScratch.data());
+			m_uScratchBlock = _uBlock;
+		}
+
+		int32_t const _iBlockFirst = static_cast<int32_t>(_uBlock) * m_iBlockRows;
+		memcpy(_pRows, m_vectorScratch.data() + (_iFirst - _iBlockFirst) * GetRowBytes(), (_iEnd - _iFirst) * GetRowBytes());
+	}
+
+	void CReader::DecompressBlock(size_t const _uBlock, uint8_t* _pDest) const
+	{
+		SBlock const _Block = GetBlock(_uBlock);
+		int32_t const _iRows = std::min(m_iBlockRows, m_iHeight - static_cast<int32_t>(_uBlock) * m_iBlockRows);
+		size_t const _uRawSize = _iRows * GetRowBytes();
+		uint8_t const* _pStored = m_Entry.m_pData + _Block.m_uOffset;
+
+		bool _bDecompressed = false;
+		if (_Block.m_uCompression == static_cast<uint32_t>(Compression::LZ))
+		{
+			_bDecompressed = lz_block::Decompress(_pStored, _Block.m_uStoredSize, _pDest, _uRawSize);
+		}
+		else if (_Block.m_uStoredSize == _uRawSize)
+		{
+			memcpy(_pDest, _pStored, _uRawSize);
+			_bDecompressed = true;
+		}
+
+		// The hash matched, so only if it was written wrong. Black rather than garbage.
+		if (_bDecompressed == false)
+		{
+			memset(_pDest, 0, _uRawSize);
+		}
+	}
+};
+//========================================
+
+//========================================
+namespace texture_cache
+{
+	CWriter::CWriter()
+	{
+
+	}
+
+	CWriter::~CWriter()
+	{
+		Abandon();
+	}
+
+	bool CWriter::Begin(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels, SBlockFormat const& _BlockFormat)
+	{
+		Abandon();
+
+		if (_iWidth <= 0 || static_cast<uint32_t>(_iWidth) > c_uMaxDimension ||
+			_iHeight <= 0 || static_cast<uint32_t>(_iHeight) > c_uMaxDimension ||
+			_uChannels == 0 ||
+			IsValidBlockFormat(_BlockFormat, _iWidth, _iHeight, _uChannels) == false ||
+			(_BlockFormat.m_uVariant == 0 && static_cast<size_t>(_iWidth) * _iHeight * _uChannels < c_uMinStoredBytes))
+		{
+			return false;
+		}
+
+		std::string const _sDirectory = GetDirectory();
+		if (_sDirectory.empty() || GetMaxSize() == 0)
+		{
+			return false;
+		}
+
+		// Nothing's created until the first rows arrive, plenty of streams are opened and dropped
+		m_sEntryPath = GetEntryPath(_sDirectory, _uSourceHash, _uScaleDenom, _BlockFormat.m_uVariant);
+		m_uSourceHash = _uSourceHash;
+		m_uScaleDenom = _uScaleDenom;
+		m_iWidth = _iWidth;
+		m_iHeight = _iHeight;
+		m_uChannels = _uChannels;
+		m_BlockFormat = _BlockFormat;
+		m_iBlockRows = std::min(GetBlockRows(static_cast<size_t>(_iWidth) * _uChannels), _iHeight);
+		m_vectorBlocks.resize((_iHeight + m_iBlockRows - 1) / m_iBlockRows);
+		return true;
+	}
+
+	void CWriter::AddRows(uint8_t const* _pRows, int32_t _iRows)
+	{
+		if (m_sEntryPath.empty())
+		{
+			return;
+		}
+
+		if (m_File.is_open() == false && OpenTemporary() == false)
+		{
+			Abandon();
+			return;
+		}
+
+		size_t const _uRowBytes = static_cast<size_t>(m_iWidth) * m_uChannels;
+		while (_iRows > 0 && m_uBlocksWritten < m_vectorBlocks.size())
+		{
+			int32_t const _iBlockFirst = static_cast<int32_t>(m_uBlocksWritten) * m_iBlockRows;
+			int32_t const _iBlockRows = std::min(m_iBlockRows, m_iHeight - _iBlockFirst);
+
+			// As many whole blocks as there are rows for, compressed from the caller's rows
+			if (m_iPendingRows == 0 && _iRows >= _iBlockRows)
+			{
+				size_t _uBlocks = 0;
+				int32_t _iCovered = 0;
+				while (m_uBlocksWritten + _uBlocks < m_vectorBlocks.size())
+				{
+					int32_t const _iRowsInBlock = std::min(m_iBlockRows, m_iHeight - (_iBlockFirst + _iCovered));
+					if (_iCovered + _iRowsInBlock > _iRows)
+					{
+						break;
+					}
+					_iCovered += _iRowsInBlock;
+					++_uBlocks;
+				}
+
+				WriteBlocks(_pRows, _uBlocks);
+				_pRows += _iCovered * _uRowBytes;
+				_iRows -= _iCovered;
+				continue;
+			}
+
+			// Otherwise gather rows until the block is complete
+			int32_t const _iTake = std::min(_iRows, _iBlockRows - m_iPendingRows);
+			m_vectorPending.resize(static_cast<size_t>(m_iBlockRows) * _uRowBytes);
+			memcpy(m_vectorPending.data() + m_iPendingRows * _uRowBytes, _pRows, _iTake * _uRowBytes);
+			m_iPendingRows += _iTake;
+			_pRows += _iTake * _uRowBytes;
+			_iRows -= _iTake;
+
+			if (m_iPendingRows == _iBlockRows)
+			{
+				WriteBlocks(m_vectorPending.data(), 1);
+				m_iPendingRows = 0;
+			}
+		}
+	}
+
+	void CWriter::Finish()
+	{
+		if (m_File.is_open() == false || m_uBlocksWritten != m_vectorBlocks.size())
+		{
+			Abandon();
+			return;
+		}
+
+		SHeader _Header;
+		_Header.m_uSourceHash = m_uSourceHash;
+		_Header.m_uWidth = static_cast<uint32_t>(m_iWidth);
+		_Header.m_uHeight = static_cast<uint32_t>(m_iHeight);
+		_Header.m_uChannels = m_uChannels;
+		_Header.m_uScaleDenom = m_uScaleDenom;
+		_Header.m_uBlockRows = static_cast<uint32_t>(m_iBlockRows);
+		_Header.m_uBlockCount = static_cast<uint32_t>(m_vectorBlocks.size());
+		_Header.m_uTableHash = hash_helper::Hash64(m_vectorBlocks.data(), m_vectorBlocks.size() * sizeof(SBlock));
+		_Header.m_uVariant = m_BlockFormat.m_uVariant;
+		_Header.m_uFormat = m_BlockFormat.m_uFormat;
+		_Header.m_uImageWidth = static_cast<uint32_t>(m_BlockFormat.m_iImageWidth);
+		_Header.m_uImageHeight = static_cast<uint32_t>(m_BlockFormat.m_iImageHeight);
+
+		m_File.seekp(0);
+		m_File.write(reinterpret_cast<char const*>(&_Header), sizeof(_Header));
+		m_File.write(reinterpret_cast<char const*>(m_vectorBlocks.data()), m_vectorBlocks.size() * sizeof(SBlock));
+		m_File.close();
+
+		if (!m_File)
+		{
+			Abandon();
+			return;
+		}
+
+		// Windows won't rename over an existing file
+		std::remove(m_sEntryPath.c_str());
+		if (std::rename(m_sTempPath.c_str(), m_sEntryPath.c_str()) != 0)
+		{
+			std::remove(m_sTempPath.c_str());
+		}
+		else
+		{
+			TrimToBudget(GetDirectory(), m_uOffset);
+		}
+		m_sTempPath.clear();
+		Abandon();
+	}
+
+	void CWriter::Abandon()
+	{
+		if (m_File.is_open())
+		{
+			m_File.close();
+		}
+		m_File.clear();
+
+		if (m_sTempPath.empty() == false)
+		{
+			std::remove(m_sTempPath.c_str());
+		}
+
+		m_sEntryPath.clear();
+		m_sTempPath.clear();
+		m_vectorBlocks.clear();
+		m_BlockFormat = SBlockFormat();
+		m_uBlocksWritten = 0;
+		m_uOffset = 0;
+		m_vectorPending = FileHelper::tPixelBuffer();
+		m_iPendingRows = 0;
+	}
+
+	bool CWriter::OpenTemporary()
+	{
+		if (FileHelper::CreateDirectories(GetDirectory()) == false)
+		{
+			return false;
+		}
+
+		m_sTempPath = stl_helper::Format("%s.%zx.tmp", m_sEntryPath.c_str(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+		m_File.open(m_sTempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!m_File)
+		{
+			m_sTempPath.clear();
+			return false;
+		}
+
+		// Header and table are filled in by Finish(), once the block sizes are known
+		m_uOffset = sizeof(SHeader) + m_vectorBlocks.size() * sizeof(SBlock);
+		std::vector<char> const _vectorPlaceholder(static_cast<size_t>(m_uOffset), 0);
+		m_File.write(_vectorPlaceholder.data(), _vectorPlaceholder.size());
+		return true;
+	}
+
+	void CWriter::WriteBlocks(uint8_t const* _pRows, size_t const _uBlocks)
+	{
+		size_t const _uRowBytes = static_cast<size_t>(m_iWidth) * m_uChannels;
+		size_t const _uFirstBlock = m_uBlocksWritten;
+		std::vector<std::vector<uint8_t>> _vectorStored(_uBlocks);
+
+		ParallelFor(_uBlocks, GetThreadCount(_uBlocks * m_iBlockRows * _uRowBytes), [&](size_t const i)
+		{
+			int32_t const _iBlockFirst = static_cast<int32_t>(_uFirstBlock + i) * m_iBlockRows;
+			size_t const _uRawSize = std::min(m_iBlockRows, m_iHeight - _iBlockFirst) * _uRowBytes;
+			uint8_t const* _pSource = _pRows + i * m_iBlockRows * _uRowBytes;
+
+			std::vector<uint8_t>& _vectorData = _vectorStored[i];
+			_vectorData.resize(lz_block::GetMaxCompressedSize(_uRawSize));
+			size_t const _uCompressedSize = lz_block::Compress(_pSource, _uRawSize, _vectorData.data());
+
+			SBlock& _Block = m_vectorBlocks[_uFirstBlock + i];
+			if (_uCompressedSize < _uRawSize)
+			{
+				_vectorData.resize(_uCompressedSize);
+				_Block.m_uCompression = static_cast<uint32_t>(Compression::LZ);
+			}
+			else
+			{
+				_vectorData.assign(_pSource, _pSource + _uRawSize);
+				_Block.m_uCompression = static_cast<uint32_t>(Compression::Stored);
+			}
+			_Block.m_uStoredSize = static_cast<uint32_t>(_vectorData.size());
+			_Block.m_uHash = hash_helper::Hash64(_vectorData.data(), _vectorData.size());
+		});
+
+		for (size_t i = 0; i < _uBlocks; ++i)
+		{
+			SBlock& _Block = m_vectorBlocks[_uFirstBlock + i];
+			_Block.m_uOffset = m_uOffset;
+			m_uOffset += _Block.m_uStoredSize;
+			m_File.write(reinterpret_cast<char const*>(_vectorStored[i].data()), _vectorStored[i].size());
+		}
+		m_uBlocksWritten += _uBlocks;
+	}
+};
+//========================================
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "block_compression.hpp"
+#include "file_helper.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//========================================
+// Decoded pixels kept on disk, so reopening a texture skips PNG inflate and JPEG IDCT.
+// Entries live in a "textures" folder of the compiled_cache directory and are keyed by a
+// hash of the source file's contents and the scale it was decoded at, so a copy, a rename
+// or a pack entry with the same bytes all hit the same entry.
+//
+// Pixels are split into blocks of whole rows, each LZ compressed (see lz_block) on its own,
+// and blocks are (de)compressed side by side straight between the caller's rows and the file.
+//
+// Block compressed textures (see block_compression.hpp) are kept the same way, with a whole
+// block for each "texel" and a row of blocks for each row.
+//
+// Safe to call from any thread. Entries are written to a temporary and renamed into place.
+namespace texture_cache
+{
+	// Follows compiled_cache::SetDirectory(), and off with a budget of 0
+	bool IsEnabled();
+
+	// Bytes of entries kept on disk, 2GB by default. Once a new entry takes the folder over,
+	// the oldest written are removed until it fits.
+	void SetMaxSize(uint64_t const _uBytes);
+	uint64_t GetMaxSize();
+
+	// _uSourceHash is hash_helper::Hash64() of the source file. False on a miss or a bad entry.
+	bool Load(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t& _iWidth, int32_t& _iHeight, FileHelper::SImageData& _Image);
+	void Store(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t const _iWidth, int32_t const _iHeight, FileHelper::SImageData const& _Image);
+
+	// _uVariant is block_compression::SSettings::GetVariant(), entries encoded with other settings never match
+	bool LoadCompressed(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant, block_compression::SCompressedImage& _Image);
+	void StoreCompressed(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant, block_compression::SCompressedImage const& _Image);
+
+	// What an entry of blocks holds, all zero for plain pixels
+	struct SBlockFormat
+	{
+		uint32_t m_uVariant = 0;
+		uint32_t m_uFormat = 0;			// block_compression::Format
+		int32_t m_iImageWidth = 0;		// in texels, the entry's own size is in blocks
+		int32_t m_iImageHeight = 0;
+	};
+
+	// On disk, after the header
+	struct SBlock
+	{
+		uint64_t m_uOffset = 0;			// from the start of the entry
+		uint32_t m_uStoredSize = 0;
+		uint32_t m_uCompression = 0;
+		uint64_t m_uHash = 0;			// of the stored bytes, catches truncated or corrupt entries
+	};
+
+	// Reads an entry a band of rows at a time, for streaming into a texture
+	class CReader
+	{
+	public:
+		CReader();
+		~CReader();
+
+		CReader(CReader const&) = delete;
+		CReader& operator=(CReader const&) = delete;
+
+		// Maps the entry and checks every block, nothing is decompressed yet
+		bool Open(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, uint32_t const _uVariant = 0);
+		void Close();
+
+		SBlockFormat const& GetBlockFormat() const { return m_BlockFormat; }
+
+		int32_t GetWidth() const { return m_iWidth; }
+		int32_t GetHeight() const { return m_iHeight; }
+		uint32_t GetChannels() const { return m_uChannels; }
+		size_t GetRowBytes() const { return static_cast<size_t>(m_iWidth) * m_uChannels; }
+
+		int32_t GetRowsRead() const { return m_iRowsRead; }
+		bool IsFinished() const { return m_iRowsRead >= m_iHeight; }
+
+		// Up to _iRows more rows into _pRows, GetRowBytes() apart. Returns how many were read,
+		// 0 once finished.
+		int32_t ReadRows(uint8_t* _pRows, int32_t const _iRows);
+
+	protected:
+		SBlock GetBlock(size_t const _uBlock) const;
+		// Rows [_iFirst, _iEnd) of the image, all inside one block
+		void ReadPartialBlock(size_t const _uBlock, int32_t const _iFirst, int32_t const _iEnd, uint8_t* _pRows);
+		void DecompressBlock(size_t const _uBlock, uint8_t* _pDest) const;
+
+		FileHelper::SFileView m_Entry;
+		int32_t m_iWidth = 0;
+		int32_t m_iHeight = 0;
+		uint32_t m_uChannels = 0;
+		int32_t m_iBlockRows = 0;
+		int32_t m_iRowsRead = 0;
+		SBlockFormat m_BlockFormat;
+
+		// Last block only partly read
+		FileHelper::tPixelBuffer m_vectorScratch;
+		size_t m_uScratchBlock = SIZE_MAX;
+	};
+
+	// Writes an entry as rows are decoded, only ever holding a band's worth of blocks
+	class CWriter
+	{
+	public:
+		CWriter();
+		// Throws away anything not finished
+		~CWriter();
+
+		CWriter(CWriter const&) = delete;
+		CWriter& operator=(CWriter const&) = delete;
+
+		// False if the cache is off or the image is too small to be worth keeping. Blocks are always
+		// kept, they took far longer to make than they take to load.
+		bool Begin(uint64_t const _uSourceHash, uint32_t const _uScaleDenom, int32_t const _iWidth, int32_t const _iHeight, uint32_t const _uChannels, SBlockFormat const& _BlockFormat = SBlockFormat());
+		// The next _iRows rows, top down
+		void AddRows(uint8_t const* _pRows, int32_t const _iRows);
+		// The entry is only put in place once every row has been added
+		void Finish();
+		void Abandon();
+
+	protected:
+		bool OpenTemporary();
+		void WriteBlocks(uint8_t const* _pRows, size_t const _uBlocks);
+
+		std::ofstream m_File;
+		std::string m_sEntryPath;
+		std::string m_sTempPath;
+
+		uint64_t m_uSourceHash = 0;
+		uint32_t m_uScaleDenom = 0;
+		int32_t m_iWidth = 0;
+		int32_t m_iHeight = 0;
+		uint32_t m_uChannels = 0;
+		int32_t m_iBlockRows = 0;
+		SBlockFormat m_BlockFormat;
+
+		std::vector<SBlock> m_vectorBlocks;
+		size_t m_uBlocksWritten = 0;
+		uint64_t m_uOffset = 0;
+
+		// Rows of a block still being filled
+		FileHelper::tPixelBuffer m_vectorPending;
+		int32_t m_iPendingRows = 0;
+	};
+};
+//========================================
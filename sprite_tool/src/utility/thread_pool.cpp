@@ -0,0 +1,167 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+
+//========================================
+CThreadPool::CThreadPool(uint32_t _uThreadCount)
+{
+	if (_uThreadCount == 0)
+	{
+		uint32_t const _uHardwareThreads = std::thread::hardware_concurrency();
+		_uThreadCount = std::max(_uHardwareThreads, 2u) - 1;
+	}
+
+	m_vectorThreads.reserve(_uThreadCount);
+	for (uint32_t i = 0; i < _uThreadCount; ++i)
+	{
+		m_vectorThreads.emplace_back(&CThreadPool::WorkerMain, this);
+	}
+}
+
+CThreadPool::~CThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> _Lock(m_Mutex);
+		m_bStopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (auto& _Thread : m_vectorThreads)
+	{
+		_Thread.join();
+	}
+}
+
+CThreadPool& CThreadPool::GetShared()
+{
+	static CThreadPool s_Pool;
+	return s_Pool;
+}
+
+void CThreadPool::Enqueue(std::function<void()> _Task)
+{
+	{
+		std::lock_guard<std::mutex> _Lock(m_Mutex);
+		m_dequeTasks.push_back(std::move(_Task));
+	}
+	m_Condition.notify_one();
+}
+
+void CThreadPool::WorkerMain()
+{
+	for (;;)
+	{
+		std::function<void()> _Task;
+		{
+			std::unique_lock<std::mutex> _Lock(m_Mutex);
+			m_Condition.wait(_Lock, [this]() { return m_bStopping || m_dequeTasks.empty() == false; });
+
+			// Drain whatever is left before stopping, someone may be waiting on it
+			if (m_dequeTasks.empty())
+			{
+				return;
+			}
+
+			_Task = std::move(m_dequeTasks.front());
+			m_dequeTasks.pop_front();
+		}
+
+		_Task();
+	}
+}
+//========================================
+
+//========================================
+CTaskGroup::~CTaskGroup()
+{
+	// Tasks hold a reference to us, so they have to finish first. Exceptions are dropped here.
+	std::unique_lock<std::mutex> _Lock(m_Mutex);
+	m_Condition.wait(_Lock, [this]() { return m_uPending == 0; });
+}
+
+void CTaskGroup::Run(std::function<void()> _Task)
+{
+	{
+		std::lock_guard<std::mutex> _Lock(m_Mutex);
+		++m_uPending;
+	}
+
+	m_Pool.Enqueue([this, _Task]()
+	{
+		std::exception_ptr _pException;
+		try
+		{
+			_Task();
+		}
+		catch (...)
+		{
+			_pException = std::current_exception();
+		}
+
+		std::lock_guard<std::mutex> _Lock(m_Mutex);
+		if (_pException && !m_pException)
+		{
+			m_pException = _pException;
+		}
+		if (--m_uPending == 0)
+		{
+			m_Condition.notify_all();
+		}
+	});
+}
+
+void CTaskGroup::Wait()
+{
+	std::unique_lock<std::mutex> _Lock(m_Mutex);
+	m_Condition.wait(_Lock, [this]() { return m_uPending == 0; });
+
+	if (m_pException)
+	{
+		std::exception_ptr _pException = m_pException;
+		m_pException = nullptr;
+		std::rethrow_exception(_pException);
+	}
+}
+//========================================
+
+//========================================
+void ParallelFor(size_t const _uCount, uint32_t const _uMaxThreads, std::function<void(size_t)> const& _Task)
+{
+	std::atomic<size_t> _uNext(0);
+	auto _Worker = [&]()
+	{
+		for (size_t i = _uNext++; i < _uCount; i = _uNext++)
+		{
+			_Task(i);
+		}
+	};
+
+	size_t const _uThreads = std::min<size_t>(std::max(1u, _uMaxThreads), _uCount);
+
+	std::vector<std::thread> _vectorThreads;
+	if (_uThreads > 1)
+	{
+		_vectorThreads.reserve(_uThreads - 1);
+		try
+		{
+			for (size_t i = 1; i < _uThreads; ++i)
+			{
+				_vectorThreads.emplace_back(_Worker);
+			}
+		}
+		catch (std::system_error const&)
+		{
+			// Out of threads, whoever did start (and this one) pick up the rest
+		}
+	}
+
+	_Worker();
+
+	for (auto& _Thread : _vectorThreads)
+	{
+		_Thread.join();
+	}
+}
+//========================================
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//========================================
+// Fixed set of worker threads pulling from one FIFO queue.
+// Tasks must not block waiting on other tasks, there may be no worker left to run them.
+class CThreadPool
+{
+public:
+	// 0 : one per hardware thread, less one for the thread that's waiting on the results
+	explicit CThreadPool(uint32_t _uThreadCount = 0);
+	~CThreadPool();
+
+	CThreadPool(CThreadPool const&) = delete;
+	CThreadPool& operator=(CThreadPool const&) = delete;
+
+	// Exceptions thrown by the task come back out of the future's get()
+	template<typename F>
+	auto Submit(F&& _Func) -> std::future<decltype(_Func())>
+	{
+		typedef decltype(_Func()) tResult;
+
+		auto _pTask = std::make_shared<std::packaged_task<tResult()>>(std::forward<F>(_Func));
+		std::future<tResult> _Future = _pTask->get_future();
+		Enqueue([_pTask]() { (*_pTask)(); });
+		return _Future;
+	}
+
+	uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_vectorThreads.size()); }
+
+	// Used by the asset loaders, created on first use
+	static CThreadPool& GetShared();
+
+protected:
+	friend class CTaskGroup;
+
+	void Enqueue(std::function<void()> _Task);
+	void WorkerMain();
+
+	std::vector<std::thread> m_vectorThreads;
+	std::deque<std::function<void()>> m_dequeTasks;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_bStopping = false;
+};
+//========================================
+
+//========================================
+// Tracks a batch of tasks so the caller can wait for all of them, including any
+// the batch queues up itself while running (fan out as work is discovered).
+// The first exception thrown by a task is rethrown from Wait().
+class CTaskGroup
+{
+public:
+	explicit CTaskGroup(CThreadPool& _Pool) : m_Pool(_Pool) {}
+	~CTaskGroup();
+
+	CTaskGroup(CTaskGroup const&) = delete;
+	CTaskGroup& operator=(CTaskGroup const&) = delete;
+
+	void Run(std::function<void()> _Task);
+	void Wait();
+
+protected:
+	CThreadPool& m_Pool;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	uint32_t m_uPending = 0;
+	std::exception_ptr m_pException;
+};
+//========================================
+
+//========================================
+// Runs _Task(0) to _Task(_uCount - 1) across up to _uMaxThreads threads, the caller's
+// included, and returns once every one has run. The other threads are started for the call
+// rather than taken from a pool, so it's safe from inside a pool task. _Task must not throw.
+void ParallelFor(size_t const _uCount, uint32_t const _uMaxThreads, std::function<void(size_t)> const& _Task);
+//========================================